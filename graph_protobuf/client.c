@@ -188,9 +188,22 @@ static void print_response(Request__OpCase op, const Response * response) {
             break;
 
         case REQUEST__OP_RETURN:
+            if (success_response->value_case == RESPONSE_SUCCESS__VALUE_CURSOR) {
+                printf("Cursor %lu was declared.\n", success_response->cursor);
+                break;
+            }
+
+            print_table_response(success_response);
+            break;
+
+        case REQUEST__OP_FETCH:
             print_table_response(success_response);
             break;
 
+        case REQUEST__OP_CLOSE_CURSOR:
+            printf("Cursor was closed.\n");
+            break;
+
         default:
             break;
     }
@@ -84,6 +84,7 @@ void yyerror(Request ** result, char ** error, const char * str);
 }
 
 %token T_MATCH T_WHERE T_CREATE T_SET T_REMOVE T_DELETE T_RETURN T_LIMIT T_SKIP
+    T_DECLARE T_CURSOR T_FOR T_FETCH T_FROM T_CLOSE
     T_RIGHT_ARROW T_LEFT_ARROW T_IDENTIFIER T_STR_LITERAL T_UINT_LITERAL T_NOT
 
 %left T_OR
@@ -161,6 +162,49 @@ command
             break;
         }
     }
+    | T_DECLARE T_CURSOR T_FOR match_non_req where_non_req return_operation {
+        $$ = malloc(sizeof(*$$));
+        *$$ = (Request) REQUEST__INIT;
+
+        $$->n_match = $4.amount;
+        $$->match = $4.content;
+
+        $$->where = $5;
+
+        $$->op_case = REQUEST__OP_RETURN;
+        $$->return_ = $6;
+        $$->return_->has_cursor = true;
+        $$->return_->cursor = true;
+    }
+    | T_FETCH T_FROM T_UINT_LITERAL {
+        $$ = malloc(sizeof(*$$));
+        *$$ = (Request) REQUEST__INIT;
+
+        $$->op_case = REQUEST__OP_FETCH;
+        $$->fetch = malloc(sizeof(*$$->fetch));
+        *$$->fetch = (RequestFetchOp) REQUEST_FETCH_OP__INIT;
+        $$->fetch->cursor = $3;
+    }
+    | T_FETCH T_UINT_LITERAL T_FROM T_UINT_LITERAL {
+        $$ = malloc(sizeof(*$$));
+        *$$ = (Request) REQUEST__INIT;
+
+        $$->op_case = REQUEST__OP_FETCH;
+        $$->fetch = malloc(sizeof(*$$->fetch));
+        *$$->fetch = (RequestFetchOp) REQUEST_FETCH_OP__INIT;
+        $$->fetch->cursor = $4;
+        $$->fetch->has_amount = true;
+        $$->fetch->amount = $2;
+    }
+    | T_CLOSE T_UINT_LITERAL {
+        $$ = malloc(sizeof(*$$));
+        *$$ = (Request) REQUEST__INIT;
+
+        $$->op_case = REQUEST__OP_CLOSE_CURSOR;
+        $$->close_cursor = malloc(sizeof(*$$->close_cursor));
+        *$$->close_cursor = (RequestCloseCursorOp) REQUEST_CLOSE_CURSOR_OP__INIT;
+        $$->close_cursor->cursor = $2;
+    }
     ;
 
 match_non_req
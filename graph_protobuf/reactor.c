@@ -0,0 +1,504 @@
+#define _GNU_SOURCE
+
+#include "reactor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+#define REACTOR_EVENTS (64)
+#define REACTOR_READ_SIZE (64 * 1024)
+
+
+// bytes from offset up to size are not parsed or not sent yet
+struct reactor_buffer {
+    uint8_t * data;
+    size_t offset;
+    size_t size;
+    size_t capacity;
+};
+
+struct reactor_connection {
+    int socket;
+
+    struct reactor_buffer input;
+    struct reactor_buffer output;
+
+    // frame of connection is handled by executor, the next frames wait for it
+    bool executing;
+
+    // client will not send more, or connection is closed after output is sent
+    bool read_closed;
+    bool closing;
+
+    struct reactor_connection * prev;
+    struct reactor_connection * next;
+};
+
+struct reactor_job {
+    struct reactor_connection * connection;
+
+    uint8_t * frame;
+    uint32_t size;
+
+    uint8_t * output;
+    size_t output_size;
+    bool keep;
+
+    struct reactor_job * next;
+};
+
+struct reactor_jobs {
+    struct reactor_job * first;
+    struct reactor_job * last;
+};
+
+struct reactor {
+    int server_socket;
+    int epoll;
+    int wakeup;
+
+    reactor_handler handler;
+    void * context;
+
+    // open connections and connections closed during the current poll
+    struct reactor_connection * connections;
+    struct reactor_connection * closed;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool stopping;
+
+    // frames waiting for executor and handled frames waiting for loop
+    struct reactor_jobs jobs;
+    struct reactor_jobs done;
+
+    unsigned int threads_amount;
+    pthread_t threads[];
+};
+
+
+static void reactor_jobs_push(struct reactor_jobs * jobs, struct reactor_job * job) {
+    job->next = NULL;
+
+    if (jobs->last) {
+        jobs->last->next = job;
+    } else {
+        jobs->first = job;
+    }
+
+    jobs->last = job;
+}
+
+static struct reactor_job * reactor_jobs_pop(struct reactor_jobs * jobs) {
+    struct reactor_job * const job = jobs->first;
+
+    if (job) {
+        jobs->first = job->next;
+
+        if (!jobs->first) {
+            jobs->last = NULL;
+        }
+    }
+
+    return job;
+}
+
+static void reactor_job_free(struct reactor_job * job) {
+    free(job->frame);
+    free(job->output);
+    free(job);
+}
+
+static void * reactor_executor(void * arg) {
+    struct reactor * const reactor = arg;
+
+    pthread_mutex_lock(&reactor->lock);
+
+    while (true) {
+        while (!reactor->stopping && !reactor->jobs.first) {
+            pthread_cond_wait(&reactor->changed, &reactor->lock);
+        }
+
+        if (reactor->stopping) {
+            break;
+        }
+
+        struct reactor_job * const job = reactor_jobs_pop(&reactor->jobs);
+        pthread_mutex_unlock(&reactor->lock);
+
+        job->output = NULL;
+        job->output_size = 0;
+        job->keep = reactor->handler(job->frame, job->size, &job->output, &job->output_size, reactor->context);
+
+        free(job->frame);
+        job->frame = NULL;
+
+        pthread_mutex_lock(&reactor->lock);
+        reactor_jobs_push(&reactor->done, job);
+
+        // wakes the loop up
+        const uint64_t one = 1;
+        write(reactor->wakeup, &one, sizeof(one));
+    }
+
+    pthread_mutex_unlock(&reactor->lock);
+    return NULL;
+}
+
+static void reactor_buffer_reserve(struct reactor_buffer * buffer, size_t length) {
+    // parsed or sent bytes are dropped before the buffer grows
+    if (buffer->offset > 0) {
+        memmove(buffer->data, buffer->data + buffer->offset, buffer->size - buffer->offset);
+        buffer->size -= buffer->offset;
+        buffer->offset = 0;
+    }
+
+    if (buffer->size + length <= buffer->capacity) {
+        return;
+    }
+
+    while (buffer->size + length > buffer->capacity) {
+        buffer->capacity = buffer->capacity ? 2 * buffer->capacity : REACTOR_READ_SIZE;
+    }
+
+    buffer->data = realloc(buffer->data, buffer->capacity);
+}
+
+static void reactor_close(struct reactor * reactor, struct reactor_connection * connection) {
+    epoll_ctl(reactor->epoll, EPOLL_CTL_DEL, connection->socket, NULL);
+    close(connection->socket);
+    connection->socket = -1;
+
+    if (connection->prev) {
+        connection->prev->next = connection->next;
+    } else {
+        reactor->connections = connection->next;
+    }
+
+    if (connection->next) {
+        connection->next->prev = connection->prev;
+    }
+
+    // events of the current poll may still point to the connection
+    connection->next = reactor->closed;
+    reactor->closed = connection;
+
+    printf("Disconnected\n");
+}
+
+static void reactor_accept(struct reactor * reactor) {
+    while (true) {
+        const int socket = accept4(reactor->server_socket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (socket < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return;
+        }
+
+        struct reactor_connection * const connection = calloc(1, sizeof(*connection));
+        connection->socket = socket;
+
+        struct epoll_event event = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = connection };
+        if (epoll_ctl(reactor->epoll, EPOLL_CTL_ADD, socket, &event) != 0) {
+            close(socket);
+            free(connection);
+            continue;
+        }
+
+        connection->next = reactor->connections;
+        if (connection->next) {
+            connection->next->prev = connection;
+        }
+
+        reactor->connections = connection;
+        printf("Connected\n");
+    }
+}
+
+// edge-triggered socket is read until it has no data
+static void reactor_read(struct reactor_connection * connection) {
+    while (!connection->read_closed) {
+        reactor_buffer_reserve(&connection->input, REACTOR_READ_SIZE);
+
+        const ssize_t was_read = read(connection->socket, connection->input.data + connection->input.size,
+            connection->input.capacity - connection->input.size);
+
+        if (was_read > 0) {
+            connection->input.size += was_read;
+            continue;
+        }
+
+        if (was_read < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (was_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        connection->read_closed = true;
+    }
+}
+
+// writes output until socket is full, the rest is written when socket is ready again
+static void reactor_write(struct reactor_connection * connection) {
+    while (connection->output.offset < connection->output.size) {
+        const ssize_t wrote = send(connection->socket, connection->output.data + connection->output.offset,
+            connection->output.size - connection->output.offset, MSG_NOSIGNAL);
+
+        if (wrote > 0) {
+            connection->output.offset += wrote;
+            continue;
+        }
+
+        if (wrote < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (wrote < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        // client is gone, output is dropped
+        connection->closing = true;
+        break;
+    }
+
+    connection->output.offset = 0;
+    connection->output.size = 0;
+}
+
+// returns size of complete frame at the start of input, skipping empty frames, or -1
+static int64_t reactor_next_frame(struct reactor_connection * connection) {
+    while (connection->input.size - connection->input.offset >= sizeof(uint32_t)) {
+        uint32_t size;
+        memcpy(&size, connection->input.data + connection->input.offset, sizeof(size));
+        size = ntohl(size);
+
+        if (size == 0) {
+            connection->input.offset += sizeof(size);
+            continue;
+        }
+
+        if (connection->input.size - connection->input.offset - sizeof(size) < size) {
+            return -1;
+        }
+
+        return size;
+    }
+
+    return -1;
+}
+
+// hands the next frame to executors or closes connection that has nothing to do
+static void reactor_update(struct reactor * reactor, struct reactor_connection * connection) {
+    if (connection->executing || connection->socket < 0) {
+        return;
+    }
+
+    const int64_t size = connection->closing ? -1 : reactor_next_frame(connection);
+
+    if (size < 0) {
+        const bool sent = connection->output.offset == connection->output.size;
+
+        if (sent && (connection->closing || connection->read_closed)) {
+            reactor_close(reactor, connection);
+        }
+
+        return;
+    }
+
+    struct reactor_job * const job = malloc(sizeof(*job));
+    job->connection = connection;
+    job->size = (uint32_t) size;
+    job->frame = malloc(job->size);
+    memcpy(job->frame, connection->input.data + connection->input.offset + sizeof(uint32_t), job->size);
+
+    connection->input.offset += sizeof(uint32_t) + job->size;
+    connection->executing = true;
+
+    pthread_mutex_lock(&reactor->lock);
+    reactor_jobs_push(&reactor->jobs, job);
+    pthread_cond_signal(&reactor->changed);
+    pthread_mutex_unlock(&reactor->lock);
+}
+
+// sends outputs of handled frames
+static void reactor_complete(struct reactor * reactor) {
+    uint64_t value;
+    read(reactor->wakeup, &value, sizeof(value));
+
+    pthread_mutex_lock(&reactor->lock);
+    struct reactor_jobs done = reactor->done;
+    reactor->done.first = NULL;
+    reactor->done.last = NULL;
+    pthread_mutex_unlock(&reactor->lock);
+
+    struct reactor_job * job;
+    while ((job = reactor_jobs_pop(&done))) {
+        struct reactor_connection * const connection = job->connection;
+
+        connection->executing = false;
+
+        // output is dropped if the client is already gone
+        if (job->output_size > 0 && !connection->closing) {
+            reactor_buffer_reserve(&connection->output, job->output_size);
+            memcpy(connection->output.data + connection->output.size, job->output, job->output_size);
+            connection->output.size += job->output_size;
+        }
+
+        // connection is closed after the output
+        connection->closing = connection->closing || !job->keep;
+        reactor_job_free(job);
+
+        reactor_write(connection);
+        reactor_update(reactor, connection);
+    }
+}
+
+struct reactor * reactor_new(int server_socket, unsigned int threads, reactor_handler handler, void * context) {
+    struct reactor * reactor = malloc(sizeof(*reactor) + threads * sizeof(*reactor->threads));
+
+    reactor->server_socket = server_socket;
+    reactor->epoll = epoll_create1(EPOLL_CLOEXEC);
+    reactor->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    reactor->handler = handler;
+    reactor->context = context;
+
+    reactor->connections = NULL;
+    reactor->closed = NULL;
+
+    pthread_mutex_init(&reactor->lock, NULL);
+    pthread_cond_init(&reactor->changed, NULL);
+    reactor->stopping = false;
+
+    reactor->jobs.first = NULL;
+    reactor->jobs.last = NULL;
+    reactor->done.first = NULL;
+    reactor->done.last = NULL;
+
+    // server socket is marked by NULL and wakeup by reactor
+    fcntl(server_socket, F_SETFL, fcntl(server_socket, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event event = { .events = EPOLLIN | EPOLLET, .data.ptr = NULL };
+    epoll_ctl(reactor->epoll, EPOLL_CTL_ADD, server_socket, &event);
+
+    event.data.ptr = reactor;
+    epoll_ctl(reactor->epoll, EPOLL_CTL_ADD, reactor->wakeup, &event);
+
+    // signals are handled by the loop thread
+    sigset_t signals, old_signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_SETMASK, &signals, &old_signals);
+
+    reactor->threads_amount = threads;
+    for (unsigned int i = 0; i < threads; ++i) {
+        pthread_create(&reactor->threads[i], NULL, reactor_executor, reactor);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    return reactor;
+}
+
+bool reactor_poll(struct reactor * reactor) {
+    struct epoll_event events[REACTOR_EVENTS];
+
+    const int amount = epoll_wait(reactor->epoll, events, REACTOR_EVENTS, -1);
+    if (amount < 0) {
+        return errno == EINTR;
+    }
+
+    for (int i = 0; i < amount; ++i) {
+        struct reactor_connection * const connection = events[i].data.ptr;
+
+        if (!connection) {
+            reactor_accept(reactor);
+            continue;
+        }
+
+        if (events[i].data.ptr == reactor) {
+            reactor_complete(reactor);
+            continue;
+        }
+
+        if (connection->socket < 0) {
+            continue;
+        }
+
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            reactor_read(connection);
+        }
+
+        if (events[i].events & EPOLLOUT) {
+            reactor_write(connection);
+        }
+
+        reactor_update(reactor, connection);
+    }
+
+    while (reactor->closed) {
+        struct reactor_connection * const connection = reactor->closed;
+
+        reactor->closed = connection->next;
+        free(connection->input.data);
+        free(connection->output.data);
+        free(connection);
+    }
+
+    return true;
+}
+
+void reactor_delete(struct reactor * reactor) {
+    pthread_mutex_lock(&reactor->lock);
+    reactor->stopping = true;
+    pthread_cond_broadcast(&reactor->changed);
+    pthread_mutex_unlock(&reactor->lock);
+
+    for (unsigned int i = 0; i < reactor->threads_amount; ++i) {
+        pthread_join(reactor->threads[i], NULL);
+    }
+
+    struct reactor_job * job;
+    while ((job = reactor_jobs_pop(&reactor->jobs))) {
+        reactor_job_free(job);
+    }
+
+    while ((job = reactor_jobs_pop(&reactor->done))) {
+        reactor_job_free(job);
+    }
+
+    while (reactor->connections) {
+        reactor_close(reactor, reactor->connections);
+    }
+
+    while (reactor->closed) {
+        struct reactor_connection * const connection = reactor->closed;
+
+        reactor->closed = connection->next;
+        free(connection->input.data);
+        free(connection->output.data);
+        free(connection);
+    }
+
+    close(reactor->epoll);
+    close(reactor->wakeup);
+
+    pthread_cond_destroy(&reactor->changed);
+    pthread_mutex_destroy(&reactor->lock);
+    free(reactor);
+}
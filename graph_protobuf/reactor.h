@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// edge-triggered epoll loop that serves connections by frames: every frame
+// is 4-byte length in network byte order and the data of that length.
+// The loop reads and writes non-blocking sockets into connection buffers
+// and hands complete frames to executor threads, frames of one connection
+// are handled one by one in their order, so do responses.
+struct reactor;
+
+// handles frame of connection: output is set to allocated bytes sent back
+// to client (NULL to send nothing), returns false to close the connection
+// after the output is sent
+typedef bool (* reactor_handler)(const uint8_t * frame, uint32_t size, uint8_t ** output, size_t * output_size, void * context);
+
+
+struct reactor * reactor_new(int server_socket, unsigned int threads, reactor_handler handler, void * context);
+
+// waits for events and handles them, returns false on wait error;
+// the wait is interrupted by signals caught by the calling thread
+bool reactor_poll(struct reactor * reactor);
+
+// waits for executors and closes connections
+void reactor_delete(struct reactor * reactor);
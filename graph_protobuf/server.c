@@ -9,18 +9,24 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include "storage.h"
 #include "match_iterator.h"
 #include "api.pb-c.h"
 #include "utils.h"
+#include "reactor.h"
+#include "cursors.h"
 
 
 #define LIMIT_MAX 1000
 #define LIMIT_DEFAULT 10
+#define CURSOR_TIMEOUT 300
 
 
 struct request_context {
+    const Request * request;
     storage storage;
 
     const Where * where;
@@ -30,7 +36,14 @@ struct request_context {
 };
 
 
-static volatile bool closing = false;
+static atomic_bool closing = false;
+
+// storage is read by offsets, so requests that only return entities run concurrently,
+// while requests that change graph are handled one by one
+static pthread_rwlock_t storage_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// cursors of returns by their ids
+static struct cursors * cursors;
 
 static void close_handler(int sig, siginfo_t * info, void * context) {
     closing = true;
@@ -1275,38 +1288,18 @@ static void free_vertex_entity(VertexEntity * vertex) {
         free(attr);
     }
 
+    free(vertex->name);
     free(vertex->labels);
     free(vertex->attrs);
 }
 
-static bool handle_return_request(const RequestReturnOp * request, struct request_context context) {
-    if (!context.match_definition) {
-        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
-        context.response->error = "you cannot return without match";
-        return true;
-    }
-
-    const uint64_t limit = request->has_limit ? request->limit : LIMIT_DEFAULT;
-    if (limit > LIMIT_MAX) {
-        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
-        context.response->error = "limit value exceeded max value " STRINGIFY_VALUE(LIMIT_MAX);
-        return true;
-    }
-
-    const uint64_t skip = request->has_skip ? request->skip : 0;
-
-    size_t * const indexes = malloc(sizeof(size_t) * request->n_values);
-    if (!indexes) {
-        return false;
-    }
-
-    bool result = true;
+static bool map_return_values(const RequestReturnOp * request, const struct match_iterator_definition * definition, size_t * indexes) {
     for (size_t i = 0; i < request->n_values; ++i) {
         const char * const value_name = request->values[i]->name;
 
         bool found = false;
-        for (size_t j = 0; j < context.match_definition->vertices.amount; ++j) {
-            const char * name = context.match_definition->vertices.vertices[j].name;
+        for (size_t j = 0; j < definition->vertices.amount; ++j) {
+            const char * name = definition->vertices.vertices[j].name;
 
             if (name && strcmp(name, value_name) == 0) {
                 indexes[i] = j;
@@ -1315,20 +1308,70 @@ static bool handle_return_request(const RequestReturnOp * request, struct reques
             }
         }
 
-        if (found) {
-            continue;
+        if (!found) {
+            return false;
         }
+    }
 
-        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
-        context.response->error = "you can return only vertices and they attributes";
-        goto free_indexes;
+    return true;
+}
+
+static void free_return_rows(ResponseSuccessRow ** rows, size_t n_rows, size_t n_columns) {
+    for (size_t i_row = 0; i_row < n_rows; ++i_row) {
+        ResponseSuccessRow * const row = rows[i_row];
+
+        if (!row) {
+            break;
+        }
+
+        for (size_t i_cell = 0; i_cell < n_columns; ++i_cell) {
+            ResponseSuccessCell * const cell = row->cells[i_cell];
+
+            if (!cell) {
+                break;
+            }
+
+            switch (cell->value_case) {
+                case RESPONSE_SUCCESS_CELL__VALUE_STRING:
+                    free(cell->string);
+                    break;
+
+                case RESPONSE_SUCCESS_CELL__VALUE_VERTEX:
+                    free_vertex_entity(cell->vertex);
+                    break;
+
+                default:
+                    ; // do nothing
+            }
+
+            free(cell);
+        }
+
+        free(row->cells);
+        free(row);
     }
 
+    free(rows);
+}
+
+// makes table of up to limit rows that iterator points to after skipped ones,
+// skipped and left amounts are decreased by the taken rows, so iterator can be resumed
+static bool make_return_table(
+    const RequestReturnOp * request,
+    const size_t * indexes,
+    struct match_iterator * iterator,
+    const Where * where,
+    uint64_t * to_skip,
+    uint64_t * left,
+    uint64_t limit,
+    Response * response
+) {
+    bool result = true;
+
     const size_t n_columns = request->n_values;
     char ** const columns = calloc(n_columns, sizeof(char *));
     if (!columns) {
-        result = false;
-        goto free_indexes;
+        return false;
     }
 
     for (size_t i = 0; i < request->n_values; ++i) {
@@ -1338,6 +1381,7 @@ static bool handle_return_request(const RequestReturnOp * request, struct reques
             columns[i] = strdup(value->name);
 
             if (!columns[i]) {
+                result = false;
                 goto free_columns;
             }
 
@@ -1348,34 +1392,31 @@ static bool handle_return_request(const RequestReturnOp * request, struct reques
         columns[i] = malloc(sizeof(char) * length);
 
         if (!columns[i]) {
+            result = false;
             goto free_columns;
         }
 
         snprintf(columns[i], length, "%s.%s", value->name, value->attr);
     }
 
-    struct match_iterator iterator;
-    if (!match_iterator_init(context.storage, &iterator, context.match_definition)) {
-        result = false;
-        goto free_columns;
-    }
-
     ResponseSuccessRow ** const rows = calloc(limit, sizeof(ResponseSuccessRow));
     if (!rows) {
         result = false;
         goto free_columns;
     }
 
+    errno = 0;
+
     uint64_t got_rows = 0;
-    uint64_t to_skip = skip;
-    while (match_iterator_next_where(&iterator, context.where)) {
-        if (to_skip > 0) {
-            --to_skip;
-            continue;
+    while (got_rows < limit && *left > 0) {
+        if (!match_iterator_next_where(iterator, where)) {
+            *left = 0;
+            break;
         }
 
-        if (got_rows == limit) {
-            break;
+        if (*to_skip > 0) {
+            --*to_skip;
+            continue;
         }
 
         ResponseSuccessRow * const row = rows[got_rows] = malloc(sizeof(ResponseSuccessRow));
@@ -1409,7 +1450,7 @@ static bool handle_return_request(const RequestReturnOp * request, struct reques
             ResponseSuccessCell * const cell = row->cells[i];
 
             if (value->attr) {
-                if (!storage_vertex_get_attribute(iterator.vertices[indexes[i]], value->attr, &(cell->string))) {
+                if (!storage_vertex_get_attribute(iterator->vertices[indexes[i]], value->attr, &(cell->string))) {
                     result = false;
                     goto free_rows;
                 }
@@ -1418,96 +1459,228 @@ static bool handle_return_request(const RequestReturnOp * request, struct reques
                     cell->value_case = RESPONSE_SUCCESS_CELL__VALUE_STRING;
                 }
             } else {
-                if (!load_vertex_entity(iterator.vertices[indexes[i]], &(cell->vertex))) {
+                if (!load_vertex_entity(iterator->vertices[indexes[i]], &(cell->vertex))) {
                     result = false;
                     goto free_rows;
                 }
 
-                cell->vertex->name = value->name;
+                // response is packed after the request is freed
+                cell->vertex->name = strdup(value->name);
                 cell->value_case = RESPONSE_SUCCESS_CELL__VALUE_VERTEX;
             }
         }
 
         ++got_rows;
+        --*left;
     }
 
     if (!errno) {
-        context.response->payload_case = RESPONSE__PAYLOAD_SUCCESS;
-        context.response->success = malloc(sizeof(ResponseSuccess));
-        *(context.response->success) = (ResponseSuccess) RESPONSE_SUCCESS__INIT;
-        context.response->success->value_case = RESPONSE_SUCCESS__VALUE_TABLE;
-        context.response->success->table = malloc(sizeof(ResponseSuccessTable));
-        *(context.response->success->table) = (ResponseSuccessTable) RESPONSE_SUCCESS_TABLE__INIT;
-        context.response->success->table->n_columns = n_columns;
-        context.response->success->table->columns = columns;
-        context.response->success->table->n_rows = got_rows;
-        context.response->success->table->rows = rows;
+        response->payload_case = RESPONSE__PAYLOAD_SUCCESS;
+        response->success = malloc(sizeof(ResponseSuccess));
+        *(response->success) = (ResponseSuccess) RESPONSE_SUCCESS__INIT;
+        response->success->value_case = RESPONSE_SUCCESS__VALUE_TABLE;
+        response->success->table = malloc(sizeof(ResponseSuccessTable));
+        *(response->success->table) = (ResponseSuccessTable) RESPONSE_SUCCESS_TABLE__INIT;
+        response->success->table->n_columns = n_columns;
+        response->success->table->columns = columns;
+        response->success->table->n_rows = got_rows;
+        response->success->table->rows = rows;
+        return true;
     }
 
-    result = !errno;
-
-    if (result) {
-        match_iterator_destroy(iterator);
-        goto free_indexes;
-    }
+    result = false;
 
 free_rows:
-    for (size_t i_row = 0; i_row < limit; ++i_row) {
-        ResponseSuccessRow * const row = rows[i_row];
+    free_return_rows(rows, limit, n_columns);
 
-        if (!row) {
+free_columns:
+    for (size_t i = 0; i < n_columns; ++i) {
+        if (!columns[i]) {
             break;
         }
 
-        for (size_t i_cell = 0; i_cell < n_columns; ++i_cell) {
-            ResponseSuccessCell * const cell = row->cells[i_cell];
+        free(columns[i]);
+    }
 
-            if (!cell) {
-                break;
-            }
+    free(columns);
+    return result;
+}
 
-            switch (cell->value_case) {
-                case RESPONSE_SUCCESS_CELL__VALUE_STRING:
-                    free(cell->string);
-                    break;
+// return kept between fetches of its cursor: match iterator is resumed by every fetch,
+// definition of match and where point into the cursor's own copy of the request
+struct return_cursor {
+    Request * request;
 
-                case RESPONSE_SUCCESS_CELL__VALUE_VERTEX:
-                    free_vertex_entity(cell->vertex);
-                    break;
+    struct match_iterator_definition definition;
+    struct match_iterator iterator;
+    size_t * indexes;
 
-                default:
-                    ; // do nothing
-            }
+    uint64_t to_skip;
+    uint64_t left;
+};
 
-            free(cell);
-        }
+static void destroy_return_cursor(void * state) {
+    struct return_cursor * const cursor = state;
 
-        free(row->cells);
-        free(row);
+    match_iterator_destroy(cursor->iterator);
+    match_iterator_definition_destroy(cursor->definition);
+    free(cursor->indexes);
+    request__free_unpacked(cursor->request, NULL);
+    free(cursor);
+}
+
+static Request * copy_request(const Request * request) {
+    const size_t size = request__get_packed_size(request);
+
+    uint8_t * const buffer = malloc(size);
+    if (!buffer) {
+        return NULL;
     }
 
-    free(rows);
+    request__pack(request, buffer);
 
-// free_iterator:
-    match_iterator_destroy(iterator);
+    Request * const copy = request__unpack(NULL, size, buffer);
+    free(buffer);
 
-free_columns:
-    for (size_t i = 0; i < n_columns; ++i) {
-        if (!columns[i]) {
-            break;
-        }
+    return copy;
+}
 
-        free(columns[i]);
+// declares cursor of return, its rows are taken by fetches from skip up to limit (no limit by default)
+static bool declare_return_cursor(const RequestReturnOp * request, size_t * indexes, struct request_context context) {
+    struct return_cursor * const cursor = malloc(sizeof(*cursor));
+    if (!cursor) {
+        free(indexes);
+        return false;
     }
 
-    free(columns);
+    cursor->request = copy_request(context.request);
+    if (!cursor->request) {
+        goto free_cursor;
+    }
 
-free_indexes:
+    // the request is checked already, so definition fails only by errors
+    if (!create_match_definition(cursor->request->n_match, cursor->request->match, &cursor->definition, context.response)) {
+        goto free_request;
+    }
+
+    if (!match_iterator_init(context.storage, &cursor->iterator, &cursor->definition)) {
+        goto free_definition;
+    }
+
+    cursor->indexes = indexes;
+    cursor->to_skip = request->has_skip ? request->skip : 0;
+    cursor->left = request->has_limit ? request->limit : UINT64_MAX;
+
+    context.response->payload_case = RESPONSE__PAYLOAD_SUCCESS;
+    context.response->success = malloc(sizeof(ResponseSuccess));
+    *(context.response->success) = (ResponseSuccess) RESPONSE_SUCCESS__INIT;
+    context.response->success->value_case = RESPONSE_SUCCESS__VALUE_CURSOR;
+    context.response->success->cursor = cursors_add(cursors, cursor);
+    return true;
+
+free_definition:
+    match_iterator_definition_destroy(cursor->definition);
+
+free_request:
+    request__free_unpacked(cursor->request, NULL);
+
+free_cursor:
+    free(cursor);
     free(indexes);
+    return false;
+}
+
+static bool handle_return_request(const RequestReturnOp * request, struct request_context context) {
+    if (!context.match_definition) {
+        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
+        context.response->error = "you cannot return without match";
+        return true;
+    }
+
+    const bool cursor = request->has_cursor && request->cursor;
+
+    const uint64_t limit = request->has_limit ? request->limit : LIMIT_DEFAULT;
+    if (!cursor && limit > LIMIT_MAX) {
+        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
+        context.response->error = "limit value exceeded max value " STRINGIFY_VALUE(LIMIT_MAX);
+        return true;
+    }
 
+    size_t * const indexes = malloc(sizeof(size_t) * request->n_values);
+    if (!indexes) {
+        return false;
+    }
+
+    if (!map_return_values(request, context.match_definition, indexes)) {
+        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
+        context.response->error = "you can return only vertices and they attributes";
+
+        free(indexes);
+        return true;
+    }
+
+    if (cursor) {
+        return declare_return_cursor(request, indexes, context);
+    }
+
+    struct match_iterator iterator;
+    if (!match_iterator_init(context.storage, &iterator, context.match_definition)) {
+        free(indexes);
+        return false;
+    }
+
+    uint64_t to_skip = request->has_skip ? request->skip : 0;
+    uint64_t left = limit;
+
+    const bool result = make_return_table(request, indexes, &iterator, context.where, &to_skip, &left, limit, context.response);
+
+    match_iterator_destroy(iterator);
+    free(indexes);
     return result;
 }
 
+// fetch resumes match iterator of cursor where the previous one stopped
+static bool handle_fetch_request(const RequestFetchOp * request, struct request_context context) {
+    const uint64_t amount = request->has_amount ? request->amount : LIMIT_DEFAULT;
+    if (amount > LIMIT_MAX) {
+        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
+        context.response->error = "amount value exceeded max value " STRINGIFY_VALUE(LIMIT_MAX);
+        return true;
+    }
+
+    struct return_cursor * const cursor = cursors_take(cursors, request->cursor);
+    if (!cursor) {
+        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
+        context.response->error = "cursor with the specified id is not exists";
+        return true;
+    }
+
+    if (!make_return_table(cursor->request->return_, cursor->indexes, &cursor->iterator, cursor->request->where,
+            &cursor->to_skip, &cursor->left, amount, context.response)) {
+        destroy_return_cursor(cursor);
+        return false;
+    }
+
+    cursors_put(cursors, request->cursor, cursor);
+    return true;
+}
+
+static bool handle_close_cursor_request(const RequestCloseCursorOp * request, struct request_context context) {
+    struct return_cursor * const cursor = cursors_take(cursors, request->cursor);
+    if (!cursor) {
+        context.response->payload_case = RESPONSE__PAYLOAD_ERROR;
+        context.response->error = "cursor with the specified id is not exists";
+        return true;
+    }
+
+    destroy_return_cursor(cursor);
+
+    context.response->payload_case = RESPONSE__PAYLOAD_SUCCESS;
+    context.response->success = malloc(sizeof(ResponseSuccess));
+    *(context.response->success) = (ResponseSuccess) RESPONSE_SUCCESS__INIT;
+    return true;
+}
+
 static bool handle_request(const Request * request, storage storage, Response * response) {
     struct match_iterator_definition definition;
 
@@ -1528,6 +1701,7 @@ static bool handle_request(const Request * request, storage storage, Response *
     }
 
     const struct request_context context = {
+        .request = request,
         .where = request->where,
         .storage = storage,
         .match_definition = definition_pointer,
@@ -1556,6 +1730,14 @@ static bool handle_request(const Request * request, storage storage, Response *
             ret = handle_return_request(request->return_, context);
             break;
 
+        case REQUEST__OP_FETCH:
+            ret = handle_fetch_request(request->fetch, context);
+            break;
+
+        case REQUEST__OP_CLOSE_CURSOR:
+            ret = handle_close_cursor_request(request->close_cursor, context);
+            break;
+
         default:
             response->payload_case = RESPONSE__PAYLOAD_ERROR;
             response->error = "bad request";
@@ -1566,103 +1748,105 @@ static bool handle_request(const Request * request, storage storage, Response *
     return ret;
 }
 
-static void handle_client(int socket, storage storage) {
-    printf("Connected\n");
-
-    while (!closing) {
-        uint32_t request_size;
+// handles request frame of client, response is sent back in frame of the same format
+static bool handle_frame(const uint8_t * frame, uint32_t size, uint8_t ** output, size_t * output_size, void * context) {
+    const storage * const storage_pointer = context;
+    const storage storage = *storage_pointer;
 
-        if (!read_full_value(socket, &request_size)) {
-            if (errno == EPIPE || errno == ECONNRESET) {
-                errno = 0;
-            }
+    *output = NULL;
+    *output_size = 0;
 
-            break;
-        }
+    Request * const request = request__unpack(NULL, size, frame);
+    if (!request) {
+        printf("An error occurred while request receiving.\n");
+        return true;
+    }
 
-        request_size = ntohl(request_size);
-        if (request_size == 0) {
-            continue;
-        }
+    printf("Received request of %"PRIu32" bytes.\n", size);
 
-        uint8_t * const request_buffer = malloc(request_size);
-        if (!request_buffer) {
-            break;
-        }
+    Response response = RESPONSE__INIT;
 
-        if (!read_full(socket, request_buffer, request_size)) {
+    switch (request->op_case) {
+        case REQUEST__OP_RETURN:
+        case REQUEST__OP_FETCH:
+        case REQUEST__OP_CLOSE_CURSOR:
+            pthread_rwlock_rdlock(&storage_lock);
             break;
-        }
-
-        Request * const request = request__unpack(NULL, request_size, request_buffer);
-        if (!request) {
-            printf("An error occurred while request receiving.\n");
-            free(request_buffer);
-            continue;
-        }
-
-        free(request_buffer);
-        printf("Received request of %"PRIu32" bytes.\n", request_size);
 
-        Response response = RESPONSE__INIT;
-        if (!handle_request(request, storage, &response)) {
-            request__free_unpacked(request, NULL);
-            break;
-        }
+        default:
+            pthread_rwlock_wrlock(&storage_lock);
+    }
 
-        size_t response_size = response__get_packed_size(&response);
-        if ((int64_t) response_size > (int64_t) UINT32_MAX) {
-            printf("Response is too long: %zu bytes.\n", response_size);
+    // cursors keep positions of vertices and edges, which may be dropped by the request
+    if (request->op_case == REQUEST__OP_DELETE) {
+        cursors_clear(cursors);
+    }
 
-            response_size = 0;
-        }
+    const bool handled = handle_request(request, storage, &response);
+    pthread_rwlock_unlock(&storage_lock);
 
-        uint8_t * const response_buffer = malloc(response_size);
-        if (!response_buffer && response_size > 0) {
-            request__free_unpacked(request, NULL);
-            break;
-        }
+    request__free_unpacked(request, NULL);
 
-        if (response_buffer) {
-            response_size = response__pack(&response, response_buffer);
-        }
+    if (!handled) {
+        return false;
+    }
 
-        request__free_unpacked(request, NULL);
+    size_t response_size = response__get_packed_size(&response);
+    if ((int64_t) response_size > (int64_t) UINT32_MAX) {
+        printf("Response is too long: %zu bytes.\n", response_size);
 
-        const uint32_t response_size_n = htonl((uint32_t) response_size);
-        if (!write_full_value(socket, &response_size_n)) {
-            free(response_buffer);
-            request__free_unpacked(request, NULL);
-            break;
-        }
+        response_size = 0;
+    }
 
-        if (response_buffer) {
-            if (!write_full(socket, response_buffer, response_size)) {
-                free(response_buffer);
-                break;
-            }
+    uint8_t * const response_buffer = malloc(sizeof(uint32_t) + response_size);
+    if (!response_buffer) {
+        return false;
+    }
 
-            printf("Sent response of %zu bytes.\n", response_size);
-            // TODO free response with table
-            free(response_buffer);
-        }
+    if (response_size > 0) {
+        response_size = response__pack(&response, response_buffer + sizeof(uint32_t));
     }
 
-    if (errno) {
-        perror("Error while handling client");
-        errno = 0;
+    const uint32_t response_size_n = htonl((uint32_t) response_size);
+    memcpy(response_buffer, &response_size_n, sizeof(response_size_n));
+
+    if (response_size > 0) {
+        printf("Sent response of %zu bytes.\n", response_size);
     }
 
-    close(socket);
-    printf("Disconnected\n");
+    // TODO free response with table
+    *output = response_buffer;
+    *output_size = sizeof(uint32_t) + response_size;
+    return true;
 }
 
 int main(int argc, char * argv[]) {
-    if (argc < 2) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+            case 't':
+                threads = strtol(optarg, NULL, 10);
+
+                if (threads <= 0) {
+                    fprintf(stderr, "Bad threads amount: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-t threads] <storage file>\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
         return EINVAL;
     }
 
-    int fd = open(argv[1], O_RDWR);
+    int fd = open(argv[optind], O_RDWR);
     storage storage;
 
     if (fd < 0 && errno != ENOENT) {
@@ -1671,7 +1855,7 @@ int main(int argc, char * argv[]) {
     }
 
     if (fd < 0 && errno == ENOENT) {
-        fd = open(argv[1], O_CREAT | O_RDWR, 0644);
+        fd = open(argv[optind], O_CREAT | O_RDWR, 0644);
 
         if (!storage_init(fd, &storage)) {
             perror("Could not init storage");
@@ -1700,7 +1884,7 @@ int main(int argc, char * argv[]) {
     }
 
     // second argument is a backlog - how many connections can be waiting for this socket simultaneously
-    listen(server_socket, 1);
+    listen(server_socket, SOMAXCONN);
 
     {
         struct sigaction sa;
@@ -1713,19 +1897,19 @@ int main(int argc, char * argv[]) {
         sigaction(SIGTERM, &sa, NULL);
     }
 
-    printf("Server started.\n");
+    // cursors that are not fetched for the timeout are closed
+    cursors = cursors_new(CURSOR_TIMEOUT, destroy_return_cursor);
 
-    while (!closing) {
-        int ret = accept(server_socket, NULL, NULL);
+    printf("Server started.\n");
 
-        if (ret < 0) {
-            break;
-        }
+    // connections are served by event loop and requests are handled by executor threads
+    struct reactor * const reactor = reactor_new(server_socket, (unsigned int) threads, handle_frame, &storage);
 
-        handle_client(ret, storage);
-    }
+    while (!closing && reactor_poll(reactor));
 
+    reactor_delete(reactor);
     close(server_socket);
+    cursors_delete(cursors);
     close(fd);
 
     printf("Bye!\n");
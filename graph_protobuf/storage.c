@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "storage_struct.h"
 #include "utils.h"
@@ -14,21 +15,15 @@
 #define POINTER_TO_CHILD(_offset, _type, _member) ((_offset) + offsetof(_type, _member))
 
 
-static bool go_to_offset(int fd, storage_pointer_ offset) {
-    return lseek64(fd, (off64_t) offset, SEEK_SET) != (off64_t) -1;
-}
-
-static bool go_to_end(int fd, storage_pointer_ * offset) {
-    const off64_t off = lseek64(fd, 0, SEEK_END);
+// storage is read and written by offsets, so its descriptor may be shared by threads
+static bool get_end(int fd, storage_pointer_ * offset) {
+    struct stat st;
 
-    if (off == (off64_t) -1) {
+    if (fstat(fd, &st) != 0) {
         return false;
     }
 
-    if (offset) {
-        *offset = (storage_pointer_) off;
-    }
-
+    *offset = (storage_pointer_) st.st_size;
     return true;
 }
 
@@ -39,13 +34,10 @@ static bool get_next_list_node_pointer(struct storage_pointer * current) {
     }
 
     const int fd = current->storage.fd;
-
-    if (!go_to_offset(fd, current->offset)) {
-        return false;
-    }
+    storage_pointer_ offset = current->offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         storage_list_node__destroy(node);
         return false;
     }
@@ -57,24 +49,24 @@ static bool get_next_list_node_pointer(struct storage_pointer * current) {
 }
 
 static bool add_element_to_list(int fd, storage_pointer_ list, storage_pointer_ value, storage_pointer_ * node) {
-    if (!go_to_offset(fd, list)) {
-        return false;
-    }
+    storage_pointer_ offset = list;
 
     struct storage_list_ storage_list;
-    if (!storage_list__read(fd, &storage_list)) {
+    if (!storage_list__read(fd, &offset, &storage_list)) {
         return false;
     }
 
     storage_pointer_ new_node_ptr;
-    if (!go_to_end(fd, &new_node_ptr)) {
+    if (!get_end(fd, &new_node_ptr)) {
         storage_list__destroy(storage_list);
         return false;
     }
 
+    offset = new_node_ptr;
+
     {
         struct storage_list_node_ new_node = {.next = 0, .value = value};
-        if (!storage_list_node__write(fd, &new_node)) {
+        if (!storage_list_node__write(fd, &offset, &new_node)) {
             storage_list_node__destroy(new_node);
             storage_list__destroy(storage_list);
             return false;
@@ -84,26 +76,19 @@ static bool add_element_to_list(int fd, storage_pointer_ list, storage_pointer_
     }
 
     if (storage_list.tail) {
-        if (!go_to_offset(fd, storage_list.tail)) {
-            storage_list__destroy(storage_list);
-            return false;
-        }
+        offset = storage_list.tail;
 
         struct storage_list_node_ tail;
-        if (!storage_list_node__read(fd, &tail)) {
+        if (!storage_list_node__read(fd, &offset, &tail)) {
             storage_list__destroy(storage_list);
             return false;
         }
 
         tail.next = new_node_ptr;
 
-        if (!go_to_offset(fd, storage_list.tail)) {
-            storage_list_node__destroy(tail);
-            storage_list__destroy(storage_list);
-            return false;
-        }
+        offset = storage_list.tail;
 
-        if (!storage_list_node__write(fd, &tail)) {
+        if (!storage_list_node__write(fd, &offset, &tail)) {
             storage_list_node__destroy(tail);
             storage_list__destroy(storage_list);
             return false;
@@ -116,12 +101,9 @@ static bool add_element_to_list(int fd, storage_pointer_ list, storage_pointer_
 
     storage_list.tail = new_node_ptr;
 
-    if (!go_to_offset(fd, list)) {
-        storage_list__destroy(storage_list);
-        return false;
-    }
+    offset = list;
 
-    if (!storage_list__write(fd, &storage_list)) {
+    if (!storage_list__write(fd, &offset, &storage_list)) {
         storage_list__destroy(storage_list);
         return false;
     }
@@ -135,12 +117,10 @@ static bool add_element_to_list(int fd, storage_pointer_ list, storage_pointer_
 }
 
 static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer_ node) {
-    if (!go_to_offset(fd, list)) {
-        return false;
-    }
+    storage_pointer_ offset = list;
 
     struct storage_list_ storage_list;
-    if (!storage_list__read(fd, &storage_list)) {
+    if (!storage_list__read(fd, &offset, &storage_list)) {
         return false;
     }
 
@@ -157,13 +137,10 @@ static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer
             storage_list.head = 0;
             storage_list.tail = 0;
         } else {
-            if (!go_to_offset(fd, node)) {
-                storage_list__destroy(storage_list);
-                return false;
-            }
+            offset = node;
 
             struct storage_list_node_ current_node;
-            if (!storage_list_node__read(fd, &current_node)) {
+            if (!storage_list_node__read(fd, &offset, &current_node)) {
                 storage_list__destroy(storage_list);
                 return false;
             }
@@ -173,12 +150,9 @@ static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer
             storage_list_node__destroy(current_node);
         }
 
-        if (!go_to_offset(fd, list)) {
-            storage_list__destroy(storage_list);
-            return false;
-        }
+        offset = list;
 
-        if (!storage_list__write(fd, &storage_list)) {
+        if (!storage_list__write(fd, &offset, &storage_list)) {
             storage_list__destroy(storage_list);
             return false;
         }
@@ -189,13 +163,10 @@ static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer
 
     storage_pointer_ prev_node_ptr = storage_list.head;
     while (prev_node_ptr) {
-        if (!go_to_offset(fd, prev_node_ptr)) {
-            storage_list__destroy(storage_list);
-            return false;
-        }
+        offset = prev_node_ptr;
 
         struct storage_list_node_ prev_node;
-        if (!storage_list_node__read(fd, &prev_node)) {
+        if (!storage_list_node__read(fd, &offset, &prev_node)) {
             storage_list__destroy(storage_list);
             return false;
         }
@@ -203,14 +174,10 @@ static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer
         if (prev_node.next == node) {
             // general case
 
-            if (!go_to_offset(fd, node)) {
-                storage_list_node__destroy(prev_node);
-                storage_list__destroy(storage_list);
-                return false;
-            }
+            offset = node;
 
             struct storage_list_node_ current_node;
-            if (!storage_list_node__read(fd, &current_node)) {
+            if (!storage_list_node__read(fd, &offset, &current_node)) {
                 storage_list_node__destroy(prev_node);
                 storage_list__destroy(storage_list);
                 return false;
@@ -220,13 +187,9 @@ static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer
 
             storage_list_node__destroy(current_node);
 
-            if (!go_to_offset(fd, prev_node_ptr)) {
-                storage_list_node__destroy(prev_node);
-                storage_list__destroy(storage_list);
-                return false;
-            }
+            offset = prev_node_ptr;
 
-            if (!storage_list_node__write(fd, &prev_node)) {
+            if (!storage_list_node__write(fd, &offset, &prev_node)) {
                 storage_list_node__destroy(prev_node);
                 storage_list__destroy(storage_list);
                 return false;
@@ -238,12 +201,9 @@ static bool remove_node_from_list(int fd, storage_pointer_ list, storage_pointer
             if (storage_list.tail == node) {
                 storage_list.tail = prev_node_ptr;
 
-                if (!go_to_offset(fd, list)) {
-                    storage_list__destroy(storage_list);
-                    return false;
-                }
+                offset = list;
 
-                if (!storage_list__write(fd, &storage_list)) {
+                if (!storage_list__write(fd, &offset, &storage_list)) {
                     storage_list__destroy(storage_list);
                     return false;
                 }
@@ -268,9 +228,7 @@ bool storage_init(int fd, storage * storage) {
         return false;
     }
 
-    if (!go_to_offset(fd, 0)) {
-        return false;
-    }
+    storage_pointer_ offset = 0;
 
     struct storage_header_ header;
 
@@ -278,7 +236,7 @@ bool storage_init(int fd, storage * storage) {
         return false;
     }
 
-    if (!storage_header__write(fd, &header)) {
+    if (!storage_header__write(fd, &offset, &header)) {
         storage_header__destroy(header);
         return false;
     }
@@ -295,12 +253,10 @@ bool storage_open(int fd, storage * storage) {
         return false;
     }
 
-    if (!go_to_offset(fd, 0)) {
-        return false;
-    }
+    storage_pointer_ offset = 0;
 
     struct storage_header_ header;
-    if (!storage_header__read_and_check(fd, &header)) {
+    if (!storage_header__read_and_check(fd, &offset, &header)) {
         return false;
     }
 
@@ -316,12 +272,10 @@ bool storage_get_first_vertex(storage storage, struct storage_vertex * vertex) {
     }
 
     const int fd = storage.fd;
-    if (!go_to_offset(fd, 0)) {
-        return false;
-    }
+    storage_pointer_ offset = 0;
 
     struct storage_header_ header;
-    if (!storage_header__read(fd, &header)) {
+    if (!storage_header__read(fd, &offset, &header)) {
         return false;
     }
 
@@ -339,12 +293,10 @@ bool storage_get_first_edge(storage storage, struct storage_edge * edge) {
     }
 
     const int fd = storage.fd;
-    if (!go_to_offset(fd, 0)) {
-        return false;
-    }
+    storage_pointer_ offset = 0;
 
     struct storage_header_ header;
-    if (!storage_header__read(fd, &header)) {
+    if (!storage_header__read(fd, &offset, &header)) {
         return false;
     }
 
@@ -362,23 +314,23 @@ bool storage_create_vertex(storage storage, struct storage_vertex * vertex) {
     }
 
     const int fd = storage.fd;
-    if (!go_to_offset(fd, 0)) {
-        return false;
-    }
+    storage_pointer_ offset = 0;
 
     struct storage_header_ header;
-    if (!storage_header__read(fd, &header)) {
+    if (!storage_header__read(fd, &offset, &header)) {
         return false;
     }
 
     storage_pointer_ vertex_ptr;
-    if (!go_to_end(fd, &vertex_ptr)) {
+    if (!get_end(fd, &vertex_ptr)) {
         storage_header__destroy(header);
         return false;
     }
 
+    offset = vertex_ptr;
+
     struct storage_vertex_ new_vertex = { 0 };
-    if (!storage_vertex__write(fd, &new_vertex)) {
+    if (!storage_vertex__write(fd, &offset, &new_vertex)) {
         storage_header__destroy(header);
         return false;
     }
@@ -403,23 +355,23 @@ bool storage_create_edge(storage storage, struct storage_edge * edge) {
     }
 
     const int fd = storage.fd;
-    if (!go_to_offset(fd, 0)) {
-        return false;
-    }
+    storage_pointer_ offset = 0;
 
     struct storage_header_ header;
-    if (!storage_header__read(fd, &header)) {
+    if (!storage_header__read(fd, &offset, &header)) {
         return false;
     }
 
     storage_pointer_ edge_ptr;
-    if (!go_to_end(fd, &edge_ptr)) {
+    if (!get_end(fd, &edge_ptr)) {
         storage_header__destroy(header);
         return false;
     }
 
+    offset = edge_ptr;
+
     struct storage_edge_ new_edge = { 0 };
-    if (!storage_edge__write(fd, &new_edge)) {
+    if (!storage_edge__write(fd, &offset, &new_edge)) {
         storage_header__destroy(header);
         return false;
     }
@@ -488,28 +440,28 @@ bool storage_vertex_add_label(struct storage_vertex vertex, const char * label)
     }
 
     const int fd = vertex.pointer.storage.fd;
-    if (!go_to_offset(fd, vertex.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = vertex.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
     storage_pointer_ label_pointer;
-    if (!go_to_end(fd, &label_pointer)) {
+    if (!get_end(fd, &label_pointer)) {
         storage_list_node__destroy(node);
         return false;
     }
 
+    offset = label_pointer;
+
     struct storage_string_ string;
     if (!storage_string__init(label, &string)) {
         storage_list_node__destroy(node);
         return false;
     }
 
-    if (!storage_string__write(fd, &string)) {
+    if (!storage_string__write(fd, &offset, &string)) {
         storage_string__destroy(string);
         storage_list_node__destroy(node);
         return false;
@@ -532,23 +484,17 @@ bool storage_vertex_remove_label(struct storage_vertex vertex, const char * labe
     }
 
     const int fd = vertex.pointer.storage.fd;
-
-    if (!go_to_offset(fd, vertex.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = vertex.pointer.offset;
 
     struct storage_list_node_ vertex_node;
-    if (!storage_list_node__read(fd, &vertex_node)) {
+    if (!storage_list_node__read(fd, &offset, &vertex_node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, vertex_node.value)) {
-        storage_list_node__destroy(vertex_node);
-        return false;
-    }
+    offset = vertex_node.value;
 
     struct storage_vertex_ storage_vertex;
-    if (!storage_vertex__read(fd, &storage_vertex)) {
+    if (!storage_vertex__read(fd, &offset, &storage_vertex)) {
         storage_list_node__destroy(vertex_node);
         return false;
     }
@@ -557,25 +503,18 @@ bool storage_vertex_remove_label(struct storage_vertex vertex, const char * labe
     storage_vertex__destroy(storage_vertex);
 
     while (label_node_ptr) {
-        if (!go_to_offset(fd, label_node_ptr)) {
-            storage_list_node__destroy(vertex_node);
-            return false;
-        }
+        offset = label_node_ptr;
 
         struct storage_list_node_ label_node;
-        if (!storage_list_node__read(fd, &label_node)) {
+        if (!storage_list_node__read(fd, &offset, &label_node)) {
             storage_list_node__destroy(vertex_node);
             return false;
         }
 
-        if (!go_to_offset(fd, label_node.value)) {
-            storage_list_node__destroy(label_node);
-            storage_list_node__destroy(vertex_node);
-            return false;
-        }
+        offset = label_node.value;
 
         struct storage_string_ str;
-        if (!storage_string__read(fd, &str)) {
+        if (!storage_string__read(fd, &offset, &str)) {
             storage_list_node__destroy(label_node);
             storage_list_node__destroy(vertex_node);
             return false;
@@ -638,24 +577,19 @@ bool storage_vertex_get_first_label(struct storage_vertex vertex, struct storage
     }
 
     const int fd = vertex.pointer.storage.fd;
-    if (!go_to_offset(fd, vertex.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = vertex.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_vertex_ storage_vertex;
-    if (!storage_vertex__read(fd, &storage_vertex)) {
+    if (!storage_vertex__read(fd, &offset, &storage_vertex)) {
         return false;
     }
 
@@ -676,23 +610,19 @@ bool storage_vertex_get_attribute(struct storage_vertex vertex, const char * nam
     }
 
     const int fd = vertex.pointer.storage.fd;
-    if (!go_to_offset(fd, vertex.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = vertex.pointer.offset;
 
     struct storage_list_node_ vertex_node;
-    if (!storage_list_node__read(fd, &vertex_node)) {
+    if (!storage_list_node__read(fd, &offset, &vertex_node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, vertex_node.value)) {
-        return false;
-    }
+    offset = vertex_node.value;
 
     storage_list_node__destroy(vertex_node);
 
     struct storage_vertex_ storage_vertex;
-    if (!storage_vertex__read(fd, &storage_vertex)) {
+    if (!storage_vertex__read(fd, &offset, &storage_vertex)) {
         return false;
     }
 
@@ -700,38 +630,29 @@ bool storage_vertex_get_attribute(struct storage_vertex vertex, const char * nam
     storage_vertex__destroy(storage_vertex);
 
     while (attrs_node_ptr) {
-        if (!go_to_offset(fd, attrs_node_ptr)) {
-            return false;
-        }
+        offset = attrs_node_ptr;
 
         struct storage_list_node_ attr_node;
-        if (!storage_list_node__read(fd, &attr_node)) {
+        if (!storage_list_node__read(fd, &offset, &attr_node)) {
             return false;
         }
 
-        if (!go_to_offset(fd, attr_node.value)) {
-            storage_list_node__destroy(attr_node);
-            return false;
-        }
+        offset = attr_node.value;
 
         struct storage_attribute_ attr;
-        if (!storage_attribute__read(fd, &attr)) {
+        if (!storage_attribute__read(fd, &offset, &attr)) {
             storage_list_node__destroy(attr_node);
             return false;
         }
 
         if (strcmp(attr.name.value, name) == 0) {
             if (value) {
-                if (!go_to_offset(fd, attr.value)) {
-                    storage_attribute__destroy(attr);
-                    storage_list_node__destroy(attr_node);
-                    return false;
-                }
+                offset = attr.value;
 
                 storage_attribute__destroy(attr);
 
                 struct storage_string_ value_string;
-                if (!storage_string__read(fd, &value_string)) {
+                if (!storage_string__read(fd, &offset, &value_string)) {
                     storage_list_node__destroy(attr_node);
                     return false;
                 }
@@ -777,26 +698,21 @@ bool storage_vertex_set_attribute(struct storage_vertex vertex, const char * nam
     }
 
     const int fd = vertex.pointer.storage.fd;
-    if (!go_to_offset(fd, vertex.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = vertex.pointer.offset;
 
     struct storage_list_node_ vertex_node;
-    if (!storage_list_node__read(fd, &vertex_node)) {
+    if (!storage_list_node__read(fd, &offset, &vertex_node)) {
         return false;
     }
 
     const storage_pointer_ vertex_ptr = vertex_node.value;
 
-    if (!go_to_offset(fd, vertex_ptr)) {
-        storage_list_node__destroy(vertex_node);
-        return false;
-    }
+    offset = vertex_ptr;
 
     storage_list_node__destroy(vertex_node);
 
     struct storage_vertex_ storage_vertex;
-    if (!storage_vertex__read(fd, &storage_vertex)) {
+    if (!storage_vertex__read(fd, &offset, &storage_vertex)) {
         return false;
     }
 
@@ -805,22 +721,17 @@ bool storage_vertex_set_attribute(struct storage_vertex vertex, const char * nam
     storage_vertex__destroy(storage_vertex);
 
     while (attrs_node_ptr) {
-        if (!go_to_offset(fd, attrs_node_ptr)) {
-            return false;
-        }
+        offset = attrs_node_ptr;
 
         struct storage_list_node_ attr_node;
-        if (!storage_list_node__read(fd, &attr_node)) {
+        if (!storage_list_node__read(fd, &offset, &attr_node)) {
             return false;
         }
 
-        if (!go_to_offset(fd, attr_node.value)) {
-            storage_list_node__destroy(attr_node);
-            return false;
-        }
+        offset = attr_node.value;
 
         struct storage_attribute_ attr;
-        if (!storage_attribute__read(fd, &attr)) {
+        if (!storage_attribute__read(fd, &offset, &attr)) {
             storage_list_node__destroy(attr_node);
             return false;
         }
@@ -836,14 +747,16 @@ bool storage_vertex_set_attribute(struct storage_vertex vertex, const char * nam
                 }
 
                 storage_pointer_ value_ptr;
-                if (!go_to_end(fd, &value_ptr)) {
+                if (!get_end(fd, &value_ptr)) {
                     storage_string__destroy(value_string);
                     storage_attribute__destroy(attr);
                     storage_list_node__destroy(attr_node);
                     return false;
                 }
 
-                if (!storage_string__write(fd, &value_string)) {
+                offset = value_ptr;
+
+                if (!storage_string__write(fd, &offset, &value_string)) {
                     storage_string__destroy(value_string);
                     storage_attribute__destroy(attr);
                     storage_list_node__destroy(attr_node);
@@ -856,13 +769,9 @@ bool storage_vertex_set_attribute(struct storage_vertex vertex, const char * nam
                 attr.value = 0;
             }
 
-            if (!go_to_offset(fd, attr_node.value)) {
-                storage_attribute__destroy(attr);
-                storage_list_node__destroy(attr_node);
-                return false;
-            }
+            offset = attr_node.value;
 
-            if (!storage_attribute__write(fd, &attr)) {
+            if (!storage_attribute__write(fd, &offset, &attr)) {
                 storage_attribute__destroy(attr);
                 storage_list_node__destroy(attr_node);
                 return false;
@@ -890,12 +799,14 @@ bool storage_vertex_set_attribute(struct storage_vertex vertex, const char * nam
     }
 
     storage_pointer_ value_ptr;
-    if (!go_to_end(fd, &value_ptr)) {
+    if (!get_end(fd, &value_ptr)) {
         storage_string__destroy(value_str);
         return false;
     }
 
-    if (!storage_string__write(fd, &value_str)) {
+    offset = value_ptr;
+
+    if (!storage_string__write(fd, &offset, &value_str)) {
         storage_string__destroy(value_str);
         return false;
     }
@@ -910,12 +821,14 @@ bool storage_vertex_set_attribute(struct storage_vertex vertex, const char * nam
     attribute.value = value_ptr;
 
     storage_pointer_ attr_ptr;
-    if (!go_to_end(fd, &attr_ptr)) {
+    if (!get_end(fd, &attr_ptr)) {
         storage_attribute__destroy(attribute);
         return false;
     }
 
-    if (!storage_attribute__write(fd, &attribute)) {
+    offset = attr_ptr;
+
+    if (!storage_attribute__write(fd, &offset, &attribute)) {
         storage_attribute__destroy(attribute);
         return false;
     }
@@ -964,24 +877,19 @@ bool storage_vertex_get_first_attribute(struct storage_vertex vertex, struct sto
     }
 
     const int fd = vertex.pointer.storage.fd;
-    if (!go_to_offset(fd, vertex.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = vertex.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_vertex_ storage_vertex;
-    if (!storage_vertex__read(fd, &storage_vertex)) {
+    if (!storage_vertex__read(fd, &offset, &storage_vertex)) {
         return false;
     }
 
@@ -1016,24 +924,19 @@ bool storage_edge_get_source(struct storage_edge edge, struct storage_vertex * v
     }
 
     const int fd = edge.pointer.storage.fd;
-    if (!go_to_offset(fd, edge.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = edge.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_edge_ storage_edge;
-    if (!storage_edge__read(fd, &storage_edge)) {
+    if (!storage_edge__read(fd, &offset, &storage_edge)) {
         return false;
     }
 
@@ -1046,36 +949,26 @@ bool storage_edge_get_source(struct storage_edge edge, struct storage_vertex * v
 
 bool storage_edge_set_source(struct storage_edge edge, struct storage_vertex vertex) {
     const int fd = edge.pointer.storage.fd;
-
-    if (!go_to_offset(fd, edge.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = edge.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     struct storage_edge_ storage_edge;
-    if (!storage_edge__read(fd, &storage_edge)) {
+    if (!storage_edge__read(fd, &offset, &storage_edge)) {
         storage_list_node__destroy(node);
         return false;
     }
 
     storage_edge.source = vertex.pointer.offset;
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_edge__destroy(storage_edge);
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
-    if (!storage_edge__write(fd, &storage_edge)) {
+    if (!storage_edge__write(fd, &offset, &storage_edge)) {
         storage_edge__destroy(storage_edge);
         storage_list_node__destroy(node);
         return false;
@@ -1093,24 +986,19 @@ bool storage_edge_get_destination(struct storage_edge edge, struct storage_verte
     }
 
     const int fd = edge.pointer.storage.fd;
-    if (!go_to_offset(fd, edge.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = edge.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_edge_ storage_edge;
-    if (!storage_edge__read(fd, &storage_edge)) {
+    if (!storage_edge__read(fd, &offset, &storage_edge)) {
         return false;
     }
 
@@ -1123,36 +1011,26 @@ bool storage_edge_get_destination(struct storage_edge edge, struct storage_verte
 
 bool storage_edge_set_destination(struct storage_edge edge, struct storage_vertex vertex) {
     const int fd = edge.pointer.storage.fd;
-
-    if (!go_to_offset(fd, edge.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = edge.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     struct storage_edge_ storage_edge;
-    if (!storage_edge__read(fd, &storage_edge)) {
+    if (!storage_edge__read(fd, &offset, &storage_edge)) {
         storage_list_node__destroy(node);
         return false;
     }
 
     storage_edge.destination = vertex.pointer.offset;
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_edge__destroy(storage_edge);
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
-    if (!storage_edge__write(fd, &storage_edge)) {
+    if (!storage_edge__write(fd, &offset, &storage_edge)) {
         storage_edge__destroy(storage_edge);
         storage_list_node__destroy(node);
         return false;
@@ -1170,24 +1048,19 @@ bool storage_edge_get_label(struct storage_edge edge, char ** label) {
     }
 
     const int fd = edge.pointer.storage.fd;
-    if (!go_to_offset(fd, edge.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = edge.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_edge_ storage_edge;
-    if (!storage_edge__read(fd, &storage_edge)) {
+    if (!storage_edge__read(fd, &offset, &storage_edge)) {
         return false;
     }
 
@@ -1198,15 +1071,12 @@ bool storage_edge_get_label(struct storage_edge edge, char ** label) {
         return true;
     }
 
-    if (!go_to_offset(fd, storage_edge.label)) {
-        storage_edge__destroy(storage_edge);
-        return false;
-    }
+    offset = storage_edge.label;
 
     storage_edge__destroy(storage_edge);
 
     struct storage_string_ label_str;
-    if (!storage_string__read(fd, &label_str)) {
+    if (!storage_string__read(fd, &offset, &label_str)) {
         return false;
     }
 
@@ -1222,23 +1092,17 @@ bool storage_edge_get_label(struct storage_edge edge, char ** label) {
 
 bool storage_edge_set_label(struct storage_edge edge, const char * label) {
     const int fd = edge.pointer.storage.fd;
-
-    if (!go_to_offset(fd, edge.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = edge.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     struct storage_edge_ storage_edge;
-    if (!storage_edge__read(fd, &storage_edge)) {
+    if (!storage_edge__read(fd, &offset, &storage_edge)) {
         storage_list_node__destroy(node);
         return false;
     }
@@ -1247,13 +1111,9 @@ bool storage_edge_set_label(struct storage_edge edge, const char * label) {
     struct storage_string_ str;
 
     if (has_label) {
-        if (!go_to_offset(fd, storage_edge.label)) {
-            storage_edge__destroy(storage_edge);
-            storage_list_node__destroy(node);
-            return false;
-        }
+        offset = storage_edge.label;
 
-        if (!storage_string__read(fd, &str)) {
+        if (!storage_string__read(fd, &offset, &str)) {
             storage_edge__destroy(storage_edge);
             storage_list_node__destroy(node);
             return false;
@@ -1279,14 +1139,16 @@ bool storage_edge_set_label(struct storage_edge edge, const char * label) {
         }
 
         storage_pointer_ str_ptr;
-        if (!go_to_end(fd, &str_ptr)) {
+        if (!get_end(fd, &str_ptr)) {
             storage_string__destroy(str);
             storage_edge__destroy(storage_edge);
             storage_list_node__destroy(node);
             return false;
         }
 
-        if (!storage_string__write(fd, &str)) {
+        offset = str_ptr;
+
+        if (!storage_string__write(fd, &offset, &str)) {
             storage_string__destroy(str);
             storage_edge__destroy(storage_edge);
             storage_list_node__destroy(node);
@@ -1300,13 +1162,9 @@ bool storage_edge_set_label(struct storage_edge edge, const char * label) {
 
     storage_string__destroy(str);
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_edge__destroy(storage_edge);
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
-    if (!storage_edge__write(fd, &storage_edge)) {
+    if (!storage_edge__write(fd, &offset, &storage_edge)) {
         storage_edge__destroy(storage_edge);
         storage_list_node__destroy(node);
         return false;
@@ -1361,24 +1219,19 @@ bool storage_label_get(struct storage_label label, char ** value) {
     }
 
     const int fd = label.pointer.storage.fd;
-    if (!go_to_offset(fd, label.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = label.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_string_ str;
-    if (!storage_string__read(fd, &str)) {
+    if (!storage_string__read(fd, &offset, &str)) {
         return false;
     }
 
@@ -1408,24 +1261,19 @@ bool storage_attribute_get(struct storage_attribute attribute, char ** name, cha
     }
 
     const int fd = attribute.pointer.storage.fd;
-    if (!go_to_offset(fd, attribute.pointer.offset)) {
-        return false;
-    }
+    storage_pointer_ offset = attribute.pointer.offset;
 
     struct storage_list_node_ node;
-    if (!storage_list_node__read(fd, &node)) {
+    if (!storage_list_node__read(fd, &offset, &node)) {
         return false;
     }
 
-    if (!go_to_offset(fd, node.value)) {
-        storage_list_node__destroy(node);
-        return false;
-    }
+    offset = node.value;
 
     storage_list_node__destroy(node);
 
     struct storage_attribute_ attr;
-    if (!storage_attribute__read(fd, &attr)) {
+    if (!storage_attribute__read(fd, &offset, &attr)) {
         return false;
     }
 
@@ -1439,13 +1287,10 @@ bool storage_attribute_get(struct storage_attribute attribute, char ** name, cha
     }
 
     if (value) {
-        if (!go_to_offset(fd, attr.value)) {
-            storage_attribute__destroy(attr);
-            return false;
-        }
+        offset = attr.value;
 
         struct storage_string_ str;
-        if (!storage_string__read(fd, &str)) {
+        if (!storage_string__read(fd, &offset, &str)) {
             storage_attribute__destroy(attr);
             return false;
         }
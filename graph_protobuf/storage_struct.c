@@ -11,24 +11,24 @@ void storage_list__destroy(struct storage_list_ value) {
     // do nothing
 }
 
-bool storage_list__read(int fd, struct storage_list_ * value) {
-    return read_full_value(fd, value);
+bool storage_list__read(int fd, storage_pointer_ * offset, struct storage_list_ * value) {
+    return pread_full_value(fd, value, offset);
 }
 
-bool storage_list__write(int fd, const struct storage_list_ * value) {
-    return write_full_value(fd, value);
+bool storage_list__write(int fd, storage_pointer_ * offset, const struct storage_list_ * value) {
+    return pwrite_full_value(fd, value, offset);
 }
 
 void storage_list_node__destroy(struct storage_list_node_ value) {
     // do nothing
 }
 
-bool storage_list_node__read(int fd, struct storage_list_node_ * value) {
-    return read_full_value(fd, value);
+bool storage_list_node__read(int fd, storage_pointer_ * offset, struct storage_list_node_ * value) {
+    return pread_full_value(fd, value, offset);
 }
 
-bool storage_list_node__write(int fd, const struct storage_list_node_ * value) {
-    return write_full_value(fd, value);
+bool storage_list_node__write(int fd, storage_pointer_ * offset, const struct storage_list_node_ * value) {
+    return pwrite_full_value(fd, value, offset);
 }
 
 bool storage_string__init(const char * value, struct storage_string_ * string) {
@@ -52,14 +52,14 @@ void storage_string__destroy(struct storage_string_ value) {
     free(value.value);
 }
 
-bool storage_string__read(int fd, struct storage_string_ * value) {
+bool storage_string__read(int fd, storage_pointer_ * offset, struct storage_string_ * value) {
     if (!value) {
         errno = EINVAL;
         return false;
     }
 
     uint64_t length;
-    if (!read_full_value(fd, &length)) {
+    if (!pread_full_value(fd, &length, offset)) {
         return false;
     }
 
@@ -68,7 +68,7 @@ bool storage_string__read(int fd, struct storage_string_ * value) {
         return false;
     }
 
-    if (!read_full(fd, value->value, length)) {
+    if (!pread_full(fd, value->value, length, offset)) {
         return false;
     }
 
@@ -76,18 +76,18 @@ bool storage_string__read(int fd, struct storage_string_ * value) {
     return true;
 }
 
-bool storage_string__write(int fd, const struct storage_string_ * value) {
+bool storage_string__write(int fd, storage_pointer_ * offset, const struct storage_string_ * value) {
     if (!value || !value->value) {
         errno = EINVAL;
         return false;
     }
 
     const uint64_t length = strlen(value->value);
-    if (!write_full_value(fd, &length)) {
+    if (!pwrite_full_value(fd, &length, offset)) {
         return false;
     }
 
-    if (!write_full(fd, value->value, length)) {
+    if (!pwrite_full(fd, value->value, length, offset)) {
         return false;
     }
 
@@ -98,34 +98,34 @@ void storage_attribute__destroy(struct storage_attribute_ value) {
     storage_string__destroy(value.name);
 }
 
-bool storage_attribute__read(int fd, struct storage_attribute_ * value) {
+bool storage_attribute__read(int fd, storage_pointer_ * offset, struct storage_attribute_ * value) {
     if (!value) {
         errno = EINVAL;
         return false;
     }
 
-    if (!storage_string__read(fd, &(value->name))) {
+    if (!storage_string__read(fd, offset, &(value->name))) {
         return false;
     }
 
-    if (!read_full_value(fd, &(value->value))) {
+    if (!pread_full_value(fd, &(value->value), offset)) {
         return false;
     }
 
     return true;
 }
 
-bool storage_attribute__write(int fd, const struct storage_attribute_ * value) {
+bool storage_attribute__write(int fd, storage_pointer_ * offset, const struct storage_attribute_ * value) {
     if (!value) {
         errno = EINVAL;
         return false;
     }
 
-    if (!storage_string__write(fd, &(value->name))) {
+    if (!storage_string__write(fd, offset, &(value->name))) {
         return false;
     }
 
-    if (!write_full_value(fd, &(value->value))) {
+    if (!pwrite_full_value(fd, &(value->value), offset)) {
         return false;
     }
 
@@ -136,24 +136,24 @@ void storage_vertex__destroy(struct storage_vertex_ value) {
     // do nothing
 }
 
-bool storage_vertex__read(int fd, struct storage_vertex_ * value) {
-    return read_full_value(fd, value);
+bool storage_vertex__read(int fd, storage_pointer_ * offset, struct storage_vertex_ * value) {
+    return pread_full_value(fd, value, offset);
 }
 
-bool storage_vertex__write(int fd, const struct storage_vertex_ * value) {
-    return write_full_value(fd, value);
+bool storage_vertex__write(int fd, storage_pointer_ * offset, const struct storage_vertex_ * value) {
+    return pwrite_full_value(fd, value, offset);
 }
 
 void storage_edge__destroy(struct storage_edge_ value) {
     // do nothing
 }
 
-bool storage_edge__read(int fd, struct storage_edge_ * value) {
-    return read_full_value(fd, value);
+bool storage_edge__read(int fd, storage_pointer_ * offset, struct storage_edge_ * value) {
+    return pread_full_value(fd, value, offset);
 }
 
-bool storage_edge__write(int fd, const struct storage_edge_ * value) {
-    return write_full_value(fd, value);
+bool storage_edge__write(int fd, storage_pointer_ * offset, const struct storage_edge_ * value) {
+    return pwrite_full_value(fd, value, offset);
 }
 
 bool storage_header__init(struct storage_header_ * header) {
@@ -169,16 +169,16 @@ void storage_header__destroy(struct storage_header_ value) {
     // do nothing
 }
 
-bool storage_header__read(int fd, struct storage_header_ * value) {
-    return read_full_value(fd, value);
+bool storage_header__read(int fd, storage_pointer_ * offset, struct storage_header_ * value) {
+    return pread_full_value(fd, value, offset);
 }
 
-bool storage_header__write(int fd, const struct storage_header_ * value) {
-    return write_full_value(fd, value);
+bool storage_header__write(int fd, storage_pointer_ * offset, const struct storage_header_ * value) {
+    return pwrite_full_value(fd, value, offset);
 }
 
-bool storage_header__read_and_check(int fd, struct storage_header_ * header) {
-    if (!storage_header__read(fd, header)) {
+bool storage_header__read_and_check(int fd, storage_pointer_ * offset, struct storage_header_ * header) {
+    if (!storage_header__read(fd, offset, header)) {
         return false;
     }
 
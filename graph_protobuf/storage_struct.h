@@ -47,55 +47,57 @@ struct storage_header_ {
 } __attribute__((packed));
 
 
+// values are read and written at the offset in file, which is moved after them
+
 // storage_list_ ops
 
 void storage_list__destroy(struct storage_list_ value);
 
-bool storage_list__read(int fd, struct storage_list_ * value);
-bool storage_list__write(int fd, const struct storage_list_ * value);
+bool storage_list__read(int fd, storage_pointer_ * offset, struct storage_list_ * value);
+bool storage_list__write(int fd, storage_pointer_ * offset, const struct storage_list_ * value);
 
 // storage_list_node_ ops
 
 void storage_list_node__destroy(struct storage_list_node_ value);
 
-bool storage_list_node__read(int fd, struct storage_list_node_ * value);
-bool storage_list_node__write(int fd, const struct storage_list_node_ * value);
+bool storage_list_node__read(int fd, storage_pointer_ * offset, struct storage_list_node_ * value);
+bool storage_list_node__write(int fd, storage_pointer_ * offset, const struct storage_list_node_ * value);
 
 // storage_string_ ops
 
 bool storage_string__init(const char * value, struct storage_string_ * string);
 void storage_string__destroy(struct storage_string_ value);
 
-bool storage_string__read(int fd, struct storage_string_ * value);
-bool storage_string__write(int fd, const struct storage_string_ * value);
+bool storage_string__read(int fd, storage_pointer_ * offset, struct storage_string_ * value);
+bool storage_string__write(int fd, storage_pointer_ * offset, const struct storage_string_ * value);
 
 // storage_attribute_
 
 void storage_attribute__destroy(struct storage_attribute_ value);
 
-bool storage_attribute__read(int fd, struct storage_attribute_ * value);
-bool storage_attribute__write(int fd, const struct storage_attribute_ * value);
+bool storage_attribute__read(int fd, storage_pointer_ * offset, struct storage_attribute_ * value);
+bool storage_attribute__write(int fd, storage_pointer_ * offset, const struct storage_attribute_ * value);
 
 // storage_vertex_ ops
 
 void storage_vertex__destroy(struct storage_vertex_ value);
 
-bool storage_vertex__read(int fd, struct storage_vertex_ * value);
-bool storage_vertex__write(int fd, const struct storage_vertex_ * value);
+bool storage_vertex__read(int fd, storage_pointer_ * offset, struct storage_vertex_ * value);
+bool storage_vertex__write(int fd, storage_pointer_ * offset, const struct storage_vertex_ * value);
 
 // storage_edge_ ops
 
 void storage_edge__destroy(struct storage_edge_ value);
 
-bool storage_edge__read(int fd, struct storage_edge_ * value);
-bool storage_edge__write(int fd, const struct storage_edge_ * value);
+bool storage_edge__read(int fd, storage_pointer_ * offset, struct storage_edge_ * value);
+bool storage_edge__write(int fd, storage_pointer_ * offset, const struct storage_edge_ * value);
 
 // storage_header_ ops
 
 bool storage_header__init(struct storage_header_ * header);
 void storage_header__destroy(struct storage_header_ value);
 
-bool storage_header__read(int fd, struct storage_header_ * value);
-bool storage_header__write(int fd, const struct storage_header_ * value);
+bool storage_header__read(int fd, storage_pointer_ * offset, struct storage_header_ * value);
+bool storage_header__write(int fd, storage_pointer_ * offset, const struct storage_header_ * value);
 
-bool storage_header__read_and_check(int fd, struct storage_header_ * header);
+bool storage_header__read_and_check(int fd, storage_pointer_ * offset, struct storage_header_ * header);
@@ -50,6 +50,52 @@ bool write_full(int fd, const void * buf, size_t size) {
     return false;
 }
 
+bool pread_full(int fd, void * buf, size_t size, uint64_t * offset) {
+    if (!buf || !offset) {
+        errno = EINVAL;
+        return false;
+    }
+
+    uint8_t * ptr = buf;
+    ssize_t bytes_read;
+
+    errno = 0;
+    while (size > 0 && (bytes_read = pread(fd, ptr, size, (off_t) *offset)) > 0) {
+        size -= bytes_read;
+        ptr += bytes_read;
+        *offset += bytes_read;
+    }
+
+    if (size == 0) {
+        return true;
+    }
+
+    if (errno == 0) {
+        errno = EPIPE;
+    }
+
+    return false;
+}
+
+bool pwrite_full(int fd, const void * buf, size_t size, uint64_t * offset) {
+    if (!offset) {
+        errno = EINVAL;
+        return false;
+    }
+
+    const uint8_t * ptr = buf;
+    ssize_t wrote;
+
+    errno = 0;
+    while (size > 0 && (wrote = pwrite(fd, ptr, size, (off_t) *offset)) >= 0) {
+        size -= wrote;
+        ptr += wrote;
+        *offset += wrote;
+    }
+
+    return size == 0;
+}
+
 size_t strlen_utf8(const char * str) {
     const size_t real_strlen = strlen(str);
 
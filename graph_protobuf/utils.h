@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -10,8 +11,15 @@
 #define read_full_value(_fd, _buf) read_full(_fd, _buf, sizeof(*_buf))
 #define write_full_value(_fd, _buf) write_full(_fd, _buf, sizeof(*_buf))
 
+#define pread_full_value(_fd, _buf, _offset) pread_full(_fd, _buf, sizeof(*_buf), _offset)
+#define pwrite_full_value(_fd, _buf, _offset) pwrite_full(_fd, _buf, sizeof(*_buf), _offset)
+
 
 bool read_full(int fd, void * buf, size_t size);
 bool write_full(int fd, const void * buf, size_t size);
 
+// read and write at the offset and move it after the data, the file offset is not used
+bool pread_full(int fd, void * buf, size_t size, uint64_t * offset);
+bool pwrite_full(int fd, const void * buf, size_t size, uint64_t * offset);
+
 size_t strlen_utf8(const char * str);
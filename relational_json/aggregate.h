@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "storage.h"
+
+
+// hash aggregation of rows by values of group keys: groups are kept in hash table
+// while their memory fits the budget, after that rows of new groups are spilled
+// to temporary files by partitions of hash bits, which are aggregated one by one
+// when groups of memory are taken (partition that does not fit either
+// is spilled again by the next bits), so memory of aggregation stays bounded
+struct aggregate;
+
+enum aggregate_function {
+    AGGREGATE_FUNCTION_COUNT = 0,
+    AGGREGATE_FUNCTION_SUM = 1,
+    AGGREGATE_FUNCTION_MIN = 2,
+    AGGREGATE_FUNCTION_MAX = 3,
+    AGGREGATE_FUNCTION_AVG = 4,
+};
+
+
+// rows without keys make one group, which is taken even when no rows are added
+struct aggregate * aggregate_new(unsigned int keys_amount, unsigned int functions_amount,
+    const enum aggregate_function * functions, size_t memory_budget);
+
+// adds row of keys and arguments of functions (NULL values are NULL pointers),
+// values are copied when they are kept, NULL arguments are skipped by functions:
+// count counts arguments, sum and avg take numbers, min and max take values of any type
+void aggregate_add(struct aggregate * aggregate, struct storage_value * const * keys, struct storage_value * const * arguments);
+
+// takes the next group: puts values of keys and then results of functions into the row,
+// they are owned by caller, returns false when there are no groups any more
+bool aggregate_next(struct aggregate * aggregate, struct storage_value ** row);
+
+void aggregate_delete(struct aggregate * aggregate);
@@ -11,6 +11,23 @@
 
 void scan_string(const char * str);
 
+// actions of prepared statements by their ids, responses of executes are printed as of these actions
+static struct {
+    uint64_t amount;
+    enum json_api_action * actions;
+} statements = { 0, NULL };
+
+static enum json_api_action get_request_action(struct json_object * request) {
+    const enum json_api_action action = json_api_get_action(request);
+
+    if (action != JSON_API_TYPE_EXECUTE) {
+        return action;
+    }
+
+    const uint64_t statement = json_api_get_statement(request);
+    return statement < statements.amount ? statements.actions[statement] : action;
+}
+
 static bool is_error_response(struct json_object * response) {
     json_object_object_foreach(response, key, val) {
         if (strcmp("error", key) == 0) {
@@ -119,7 +136,48 @@ static void print_table_response(struct json_object * response) {
     print_table_separator(columns_length, columns_width);
 }
 
-static void print_response(enum json_api_action action, struct json_object * response) {
+// select of cursor answers by its id instead of table
+static void print_select_response(struct json_object * response) {
+    json_object_object_foreach(response, key, val) {
+        if (strcmp("cursor", key) == 0) {
+            printf("Cursor %lu was declared.\n", json_object_get_uint64(val));
+            return;
+        }
+    }
+
+    print_table_response(response);
+}
+
+// remembers action of prepared request by id of its statement
+static void print_prepare_response(struct json_object * response, struct json_object * request) {
+    struct json_object * statement;
+    struct json_object * parameters;
+    struct json_object * prepared;
+
+    if (!json_object_object_get_ex(response, "statement", &statement)
+        || !json_object_object_get_ex(response, "parameters", &parameters)
+        || !json_object_object_get_ex(request, "request", &prepared)) {
+        printf("Bad answer: %s\n", json_object_to_json_string_ext(response, JSON_C_TO_STRING_PRETTY));
+        return;
+    }
+
+    const uint64_t id = json_object_get_uint64(statement);
+
+    if (id >= statements.amount) {
+        statements.actions = realloc(statements.actions, sizeof(*statements.actions) * (id + 1));
+
+        for (uint64_t i = statements.amount; i < id; ++i) {
+            statements.actions[i] = JSON_API_TYPE_EXECUTE;
+        }
+
+        statements.amount = id + 1;
+    }
+
+    statements.actions[id] = json_api_get_action(prepared);
+    printf("Statement %lu was prepared with %lu parameters.\n", id, json_object_get_uint64(parameters));
+}
+
+static void print_response(struct json_object * request, struct json_object * response) {
     if (!response) {
         printf("Server didn't understand request.\n");
         return;
@@ -134,7 +192,7 @@ static void print_response(enum json_api_action action, struct json_object * res
         return;
     }
 
-    switch (action) {
+    switch (get_request_action(request)) {
         case JSON_API_TYPE_CREATE_TABLE:
             printf("Table was created.\n");
             break;
@@ -144,7 +202,7 @@ static void print_response(enum json_api_action action, struct json_object * res
             break;
 
         case JSON_API_TYPE_INSERT:
-            printf("Row was inserted.\n");
+            print_amount_response(response, "inserted");
             break;
 
         case JSON_API_TYPE_DELETE:
@@ -152,13 +210,41 @@ static void print_response(enum json_api_action action, struct json_object * res
             break;
 
         case JSON_API_TYPE_SELECT:
-            print_table_response(response);
+            print_select_response(response);
             break;
 
         case JSON_API_TYPE_UPDATE:
             print_amount_response(response, "updated");
             break;
 
+        case JSON_API_TYPE_VACUUM:
+            print_amount_response(response, "vacuumed");
+            break;
+
+        case JSON_API_TYPE_CREATE_INDEX:
+            printf("Index was created.\n");
+            break;
+
+        case JSON_API_TYPE_FETCH:
+            print_table_response(response);
+            break;
+
+        case JSON_API_TYPE_CLOSE_CURSOR:
+            printf("Cursor was closed.\n");
+            break;
+
+        case JSON_API_TYPE_STATS:
+            printf("%s\n", json_object_to_json_string_ext(response, JSON_C_TO_STRING_PRETTY));
+            break;
+
+        case JSON_API_TYPE_PREPARE:
+            print_prepare_response(response, request);
+            break;
+
+        case JSON_API_TYPE_DEALLOCATE:
+            printf("Statement was deallocated.\n");
+            break;
+
         default:
             return;
     }
@@ -195,7 +281,7 @@ static bool handle_request(int socket, struct json_object * request) {
     enum json_tokener_error response_error;
     struct json_object * response = json_tokener_parse_verbose(buffer, &response_error);
     if (response_error == json_tokener_success) {
-        print_response(json_api_get_action(request), response);
+        print_response(request, response);
     } else {
         printf("Bad answer (%s): %s.\n", json_tokener_error_desc(response_error), buffer);
     }
@@ -13,8 +13,20 @@ enum json_api_action json_api_get_action(struct json_object * object) {
     return -1;
 }
 
+uint64_t json_api_get_statement(struct json_object * object) {
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("statement", key) == 0) {
+            return json_object_get_uint64(val);
+        }
+    }
+
+    return 0;
+}
+
 struct json_api_create_table_request json_api_to_create_table_request(struct json_object * object) {
     struct json_api_create_table_request request;
+    request.columnar = false;
+    request.compressed = false;
 
     json_object_object_foreach(object, key, val) {
         if (strcmp("table", key) == 0) {
@@ -28,6 +40,7 @@ struct json_api_create_table_request json_api_to_create_table_request(struct jso
 
             for (int i = 0; i < request.columns.amount; ++i) {
                 struct json_object * elem = json_object_array_get_idx(val, i);
+                request.columns.columns[i].dictionary = false;
 
                 json_object_object_foreach(elem, elem_key, elem_val) {
                     if (strcmp("name", elem_key) == 0) {
@@ -39,11 +52,26 @@ struct json_api_create_table_request json_api_to_create_table_request(struct jso
                         request.columns.columns[i].type = (enum storage_column_type) json_object_get_int(elem_val);
                         continue;
                     }
+
+                    if (strcmp("dictionary", elem_key) == 0) {
+                        request.columns.columns[i].dictionary = json_object_get_boolean(elem_val);
+                        continue;
+                    }
                 }
             }
 
             continue;
         }
+
+        if (strcmp("columnar", key) == 0) {
+            request.columnar = json_object_get_boolean(val);
+            continue;
+        }
+
+        if (strcmp("compressed", key) == 0) {
+            request.compressed = json_object_get_boolean(val);
+            continue;
+        }
     }
 
     return request;
@@ -101,14 +129,56 @@ static struct storage_value * json_to_storage_value(struct json_object * object)
             break;
     }
 
+    value->view = false;
     return value;
 }
 
-struct json_api_insert_request json_api_to_insert_request(struct json_object * object) {
+// puts value into its place, parameter of prepared request leaves the place NULL and is added to parameters
+static void json_api_read_value(struct json_object * object, struct storage_value ** value, struct json_api_parameters * parameters) {
+    struct json_object * number;
+
+    if (parameters && json_object_is_type(object, json_type_object) && json_object_object_get_ex(object, "parameter", &number)) {
+        const int64_t parameter = json_object_get_int64(number);
+
+        if (parameter >= 1 && parameter <= UINT16_MAX) {
+            parameters->places = realloc(parameters->places, sizeof(*parameters->places) * (parameters->places_amount + 1));
+            parameters->places[parameters->places_amount].parameter = (unsigned int) parameter - 1;
+            parameters->places[parameters->places_amount].value = value;
+            ++parameters->places_amount;
+
+            if (parameters->amount < parameter) {
+                parameters->amount = (unsigned int) parameter;
+            }
+
+            *value = NULL;
+            return;
+        }
+    }
+
+    *value = json_to_storage_value(object);
+}
+
+static struct json_api_insert_request_row json_api_to_insert_request_row(struct json_object * object, struct json_api_parameters * parameters) {
+    struct json_api_insert_request_row row;
+
+    row.amount = json_object_array_length(object);
+    row.values = malloc(sizeof(struct storage_value *) * row.amount);
+
+    for (int i = 0; i < row.amount; ++i) {
+        json_api_read_value(json_object_array_get_idx(object, i), &row.values[i], parameters);
+    }
+
+    return row;
+}
+
+struct json_api_insert_request json_api_to_insert_request(struct json_object * object, struct json_api_parameters * parameters) {
     struct json_api_insert_request request;
 
+    request.table_name = NULL;
     request.columns.amount = 0;
     request.columns.columns = NULL;
+    request.rows.amount = 0;
+    request.rows.rows = NULL;
 
     json_object_object_foreach(object, key, val) {
         if (strcmp("table", key) == 0) {
@@ -128,11 +198,18 @@ struct json_api_insert_request json_api_to_insert_request(struct json_object * o
         }
 
         if (strcmp("values", key) == 0) {
-            request.values.amount = json_object_array_length(val);
-            request.values.values = malloc(sizeof(struct storage_value *) * request.values.amount);
+            request.rows.amount = 1;
+            request.rows.rows = malloc(sizeof(*request.rows.rows));
+            request.rows.rows[0] = json_api_to_insert_request_row(val, parameters);
+            continue;
+        }
 
-            for (int i = 0; i < request.values.amount; ++i) {
-                request.values.values[i] = json_to_storage_value(json_object_array_get_idx(val, i));
+        if (strcmp("rows", key) == 0) {
+            request.rows.amount = json_object_array_length(val);
+            request.rows.rows = malloc(sizeof(*request.rows.rows) * request.rows.amount);
+
+            for (int i = 0; i < request.rows.amount; ++i) {
+                request.rows.rows[i] = json_api_to_insert_request_row(json_object_array_get_idx(val, i), parameters);
             }
 
             continue;
@@ -142,7 +219,7 @@ struct json_api_insert_request json_api_to_insert_request(struct json_object * o
     return request;
 }
 
-static struct json_api_where * json_api_to_where(struct json_object * object) {
+static struct json_api_where * json_api_to_where(struct json_object * object, struct json_api_parameters * parameters) {
     struct json_api_where * where = malloc(sizeof(*where));
 
     {
@@ -162,6 +239,9 @@ static struct json_api_where * json_api_to_where(struct json_object * object) {
         case JSON_API_OPERATOR_LE:
         case JSON_API_OPERATOR_GE:
         {
+            where->column = NULL;
+            where->value = NULL;
+
             json_object_object_foreach(object, key, val) {
                 if (strcmp("column", key) == 0) {
                     where->column = strdup(json_object_get_string(val));
@@ -169,7 +249,7 @@ static struct json_api_where * json_api_to_where(struct json_object * object) {
                 }
 
                 if (strcmp("value", key) == 0) {
-                    where->value = json_to_storage_value(val);
+                    json_api_read_value(val, &where->value, parameters);
                     continue;
                 }
             }
@@ -180,14 +260,17 @@ static struct json_api_where * json_api_to_where(struct json_object * object) {
         case JSON_API_OPERATOR_AND:
         case JSON_API_OPERATOR_OR:
         {
+            where->left = NULL;
+            where->right = NULL;
+
             json_object_object_foreach(object, key, val) {
                 if (strcmp("left", key) == 0) {
-                    where->left = json_api_to_where(val);
+                    where->left = json_api_to_where(val, parameters);
                     continue;
                 }
 
                 if (strcmp("right", key) == 0) {
-                    where->right = json_api_to_where(val);
+                    where->right = json_api_to_where(val, parameters);
                     continue;
                 }
             }
@@ -199,8 +282,9 @@ static struct json_api_where * json_api_to_where(struct json_object * object) {
     return where;
 }
 
-struct json_api_delete_request json_api_to_delete_request(struct json_object * object) {
+struct json_api_delete_request json_api_to_delete_request(struct json_object * object, struct json_api_parameters * parameters) {
     struct json_api_delete_request request;
+    request.table_name = NULL;
     request.where = NULL;
 
     json_object_object_foreach(object, key, val) {
@@ -210,7 +294,7 @@ struct json_api_delete_request json_api_to_delete_request(struct json_object * o
         }
 
         if (strcmp("where", key) == 0) {
-            request.where = json_api_to_where(val);
+            request.where = json_api_to_where(val, parameters);
             continue;
         }
     }
@@ -218,8 +302,27 @@ struct json_api_delete_request json_api_to_delete_request(struct json_object * o
     return request;
 }
 
-struct json_api_select_request json_api_to_select_request(struct json_object * object) {
+static struct json_api_aggregate json_api_to_aggregate(struct json_object * object) {
+    struct json_api_aggregate aggregate;
+    aggregate.function = JSON_API_FUNCTION_COUNT;
+    aggregate.column = NULL;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("function", key) == 0) {
+            aggregate.function = (enum json_api_function) json_object_get_int(val);
+        }
+
+        if (strcmp("column", key) == 0) {
+            aggregate.column = strdup(json_object_get_string(val));
+        }
+    }
+
+    return aggregate;
+}
+
+struct json_api_select_request json_api_to_select_request(struct json_object * object, struct json_api_parameters * parameters) {
     struct json_api_select_request request;
+    request.table_name = NULL;
     request.columns.amount = 0;
     request.columns.columns = NULL;
     request.joins.amount = 0;
@@ -227,6 +330,14 @@ struct json_api_select_request json_api_to_select_request(struct json_object * o
     request.where = NULL;
     request.offset = 0;
     request.limit = 10;
+    request.has_limit = false;
+    request.cursor = false;
+    request.aggregates.amount = 0;
+    request.aggregates.aggregates = NULL;
+    request.group_by.amount = 0;
+    request.group_by.columns = NULL;
+    request.order_by.amount = 0;
+    request.order_by.orders = NULL;
 
     json_object_object_foreach(object, key, val) {
         if (strcmp("table", key) == 0) {
@@ -246,7 +357,7 @@ struct json_api_select_request json_api_to_select_request(struct json_object * o
         }
 
         if (strcmp("where", key) == 0) {
-            request.where = json_api_to_where(val);
+            request.where = json_api_to_where(val, parameters);
             continue;
         }
 
@@ -257,6 +368,63 @@ struct json_api_select_request json_api_to_select_request(struct json_object * o
 
         if (strcmp("limit", key) == 0) {
             request.limit = json_object_get_int(val);
+            request.has_limit = true;
+            continue;
+        }
+
+        if (strcmp("cursor", key) == 0) {
+            request.cursor = json_object_get_boolean(val);
+            continue;
+        }
+
+        if (strcmp("aggregates", key) == 0) {
+            request.aggregates.amount = json_object_array_length(val);
+            request.aggregates.aggregates = malloc(sizeof(*request.aggregates.aggregates) * request.aggregates.amount);
+
+            for (int i = 0; i < request.aggregates.amount; ++i) {
+                request.aggregates.aggregates[i] = json_api_to_aggregate(json_object_array_get_idx(val, i));
+            }
+
+            continue;
+        }
+
+        if (strcmp("group_by", key) == 0) {
+            request.group_by.amount = json_object_array_length(val);
+            request.group_by.columns = malloc(sizeof(*request.group_by.columns) * request.group_by.amount);
+
+            for (int i = 0; i < request.group_by.amount; ++i) {
+                request.group_by.columns[i] = strdup(json_object_get_string(json_object_array_get_idx(val, i)));
+            }
+
+            continue;
+        }
+
+        if (strcmp("order_by", key) == 0) {
+            request.order_by.amount = json_object_array_length(val);
+            request.order_by.orders = malloc(sizeof(*request.order_by.orders) * request.order_by.amount);
+
+            for (int i = 0; i < request.order_by.amount; ++i) {
+                struct json_object * elem = json_object_array_get_idx(val, i);
+                request.order_by.orders[i].column = NULL;
+                request.order_by.orders[i].aggregate = NULL;
+                request.order_by.orders[i].descending = false;
+
+                json_object_object_foreach(elem, elem_key, elem_val) {
+                    if (strcmp("column", elem_key) == 0) {
+                        request.order_by.orders[i].column = strdup(json_object_get_string(elem_val));
+                    }
+
+                    if (strcmp("aggregate", elem_key) == 0) {
+                        request.order_by.orders[i].aggregate = malloc(sizeof(struct json_api_aggregate));
+                        *request.order_by.orders[i].aggregate = json_api_to_aggregate(elem_val);
+                    }
+
+                    if (strcmp("descending", elem_key) == 0) {
+                        request.order_by.orders[i].descending = json_object_get_boolean(elem_val);
+                    }
+                }
+            }
+
             continue;
         }
 
@@ -266,6 +434,9 @@ struct json_api_select_request json_api_to_select_request(struct json_object * o
 
             for (int i = 0; i < request.joins.amount; ++i) {
                 struct json_object * elem = json_object_array_get_idx(val, i);
+                request.joins.joins[i].table = NULL;
+                request.joins.joins[i].t_column = NULL;
+                request.joins.joins[i].s_column = NULL;
 
                 json_object_object_foreach(elem, elem_key, elem_val) {
                     if (strcmp("table", elem_key) == 0) {
@@ -289,8 +460,13 @@ struct json_api_select_request json_api_to_select_request(struct json_object * o
     return request;
 }
 
-struct json_api_update_request json_api_to_update_request(struct json_object * object) {
+struct json_api_update_request json_api_to_update_request(struct json_object * object, struct json_api_parameters * parameters) {
     struct json_api_update_request request;
+    request.table_name = NULL;
+    request.columns.amount = 0;
+    request.columns.columns = NULL;
+    request.values.amount = 0;
+    request.values.values = NULL;
     request.where = NULL;
 
     json_object_object_foreach(object, key, val) {
@@ -315,21 +491,241 @@ struct json_api_update_request json_api_to_update_request(struct json_object * o
             request.values.values = malloc(sizeof(struct storage_value *) * request.values.amount);
 
             for (int i = 0; i < request.values.amount; ++i) {
-                request.values.values[i] = json_to_storage_value(json_object_array_get_idx(val, i));
+                json_api_read_value(json_object_array_get_idx(val, i), &request.values.values[i], parameters);
             }
 
             continue;
         }
 
         if (strcmp("where", key) == 0) {
-            request.where = json_api_to_where(val);
+            request.where = json_api_to_where(val, parameters);
+            continue;
+        }
+    }
+
+    return request;
+}
+
+struct json_api_vacuum_request json_api_to_vacuum_request(struct json_object * object) {
+    struct json_api_vacuum_request request;
+    request.table_name = NULL;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("table", key) == 0) {
+            request.table_name = strdup(json_object_get_string(val));
+            break;
+        }
+    }
+
+    return request;
+}
+
+struct json_api_create_index_request json_api_to_create_index_request(struct json_object * object) {
+    struct json_api_create_index_request request;
+    request.table_name = NULL;
+    request.column = NULL;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("table", key) == 0) {
+            request.table_name = strdup(json_object_get_string(val));
             continue;
         }
+
+        if (strcmp("column", key) == 0) {
+            request.column = strdup(json_object_get_string(val));
+            continue;
+        }
+    }
+
+    return request;
+}
+
+struct json_api_fetch_request json_api_to_fetch_request(struct json_object * object) {
+    struct json_api_fetch_request request;
+    request.cursor = 0;
+    request.amount = 10;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("cursor", key) == 0) {
+            request.cursor = json_object_get_uint64(val);
+            continue;
+        }
+
+        if (strcmp("amount", key) == 0) {
+            request.amount = json_object_get_int(val);
+            continue;
+        }
+    }
+
+    return request;
+}
+
+struct json_api_close_cursor_request json_api_to_close_cursor_request(struct json_object * object) {
+    struct json_api_close_cursor_request request;
+    request.cursor = 0;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("cursor", key) == 0) {
+            request.cursor = json_object_get_uint64(val);
+            break;
+        }
     }
 
     return request;
 }
 
+struct json_api_prepare_request json_api_to_prepare_request(struct json_object * object) {
+    struct json_api_prepare_request request;
+    request.request = NULL;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("request", key) == 0 && json_object_is_type(val, json_type_object)) {
+            request.request = val;
+            break;
+        }
+    }
+
+    return request;
+}
+
+struct json_api_execute_request json_api_to_execute_request(struct json_object * object) {
+    struct json_api_execute_request request;
+    request.statement = 0;
+    request.parameters.amount = 0;
+    request.parameters.values = NULL;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("statement", key) == 0) {
+            request.statement = json_object_get_uint64(val);
+            continue;
+        }
+
+        if (strcmp("parameters", key) == 0) {
+            request.parameters.amount = json_object_array_length(val);
+            request.parameters.values = malloc(sizeof(struct storage_value *) * request.parameters.amount);
+
+            for (int i = 0; i < request.parameters.amount; ++i) {
+                request.parameters.values[i] = json_to_storage_value(json_object_array_get_idx(val, i));
+            }
+
+            continue;
+        }
+    }
+
+    return request;
+}
+
+struct json_api_deallocate_request json_api_to_deallocate_request(struct json_object * object) {
+    struct json_api_deallocate_request request;
+    request.statement = 0;
+
+    json_object_object_foreach(object, key, val) {
+        if (strcmp("statement", key) == 0) {
+            request.statement = json_object_get_uint64(val);
+            break;
+        }
+    }
+
+    return request;
+}
+
+static void json_api_free_names(unsigned int amount, char ** names) {
+    for (unsigned int i = 0; i < amount; ++i) {
+        free(names[i]);
+    }
+
+    free(names);
+}
+
+static void json_api_free_values(unsigned int amount, struct storage_value ** values) {
+    for (unsigned int i = 0; i < amount; ++i) {
+        storage_value_delete(values[i]);
+    }
+
+    free(values);
+}
+
+static void json_api_free_where(struct json_api_where * where) {
+    if (!where) {
+        return;
+    }
+
+    switch (where->op) {
+        case JSON_API_OPERATOR_AND:
+        case JSON_API_OPERATOR_OR:
+            json_api_free_where(where->left);
+            json_api_free_where(where->right);
+            break;
+
+        default:
+            free(where->column);
+            storage_value_delete(where->value);
+            break;
+    }
+
+    free(where);
+}
+
+void json_api_free_insert_request(struct json_api_insert_request request) {
+    free(request.table_name);
+    json_api_free_names(request.columns.amount, request.columns.columns);
+
+    for (unsigned int i = 0; i < request.rows.amount; ++i) {
+        json_api_free_values(request.rows.rows[i].amount, request.rows.rows[i].values);
+    }
+
+    free(request.rows.rows);
+}
+
+void json_api_free_delete_request(struct json_api_delete_request request) {
+    free(request.table_name);
+    json_api_free_where(request.where);
+}
+
+void json_api_free_select_request(struct json_api_select_request request) {
+    free(request.table_name);
+    json_api_free_names(request.columns.amount, request.columns.columns);
+    json_api_free_where(request.where);
+
+    for (unsigned int i = 0; i < request.joins.amount; ++i) {
+        free(request.joins.joins[i].table);
+        free(request.joins.joins[i].t_column);
+        free(request.joins.joins[i].s_column);
+    }
+
+    free(request.joins.joins);
+
+    for (unsigned int i = 0; i < request.aggregates.amount; ++i) {
+        free(request.aggregates.aggregates[i].column);
+    }
+
+    free(request.aggregates.aggregates);
+    json_api_free_names(request.group_by.amount, request.group_by.columns);
+
+    for (unsigned int i = 0; i < request.order_by.amount; ++i) {
+        free(request.order_by.orders[i].column);
+
+        if (request.order_by.orders[i].aggregate) {
+            free(request.order_by.orders[i].aggregate->column);
+        }
+
+        free(request.order_by.orders[i].aggregate);
+    }
+
+    free(request.order_by.orders);
+}
+
+void json_api_free_update_request(struct json_api_update_request request) {
+    free(request.table_name);
+    json_api_free_names(request.columns.amount, request.columns.columns);
+    json_api_free_values(request.values.amount, request.values.values);
+    json_api_free_where(request.where);
+}
+
+void json_api_free_parameters(struct json_api_parameters parameters) {
+    free(parameters.places);
+}
+
 struct json_object * json_api_make_success(struct json_object * answer) {
     struct json_object * object = json_object_new_object();
 
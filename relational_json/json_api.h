@@ -4,7 +4,7 @@
 
 #include "storage.h"
 
-// request object: { "action": <action: 0/1/2/3/4/5>, ... }
+// request object: { "action": <action: 0/1/2/3/4/5/6/7/8/9/10/11/12/13>, ... }
 // response object: { ["success": ...,] ["error": <error message: string>,] }
 //
 // action "create table" (0):
@@ -15,8 +15,11 @@
 //         {
 //             "name": <column name: string>,
 //             "type": <column type: 0/1/2/3>,
+//             ["dictionary": <keep strings of str column in dictionary (default false): boolean>,]
 //         },
 //     ],
+//     ["columnar": <store table in columnar row groups (default false): boolean>,]
+//     ["compressed": <compress row groups of columnar table by vacuum (default false): boolean>,]
 // }
 // - success response: {}
 //
@@ -32,9 +35,13 @@
 //     "action": 2,
 //     "table": <table name: string>,
 //     ["columns": <column names: string[]>,]
-//     "values": <values list: <string/number/null>[]>,
+//     ["values": <values list: <string/number/null>[]>,]
+//     ["rows": <values lists: <string/number/null>[][]>,]
 // }
-// - success response: {}
+// - success response: {
+//     "amount": <amount of inserted rows: number>
+// }
+// - rows are inserted by one batch, request with values inserts one row
 //
 // action "delete" (3):
 // - request: {
@@ -53,7 +60,7 @@
 //     ["columns": <columns list: string[]>,]
 //     ["where": <where expression>,]
 //     ["offset": <offset (default 0): number>,]
-//     ["limit": <limit (from 0 to 1000, default 10): number>,]
+//     ["limit": <limit (from 0 to 1000, default 10; no limit of cursor by default): number>,]
 //     ["joins": [
 //         {
 //             "table": <table name: string>,
@@ -61,11 +68,36 @@
 //             "s_column": <column of slice name: string>,
 //         },
 //     ],]
+//     ["cursor": <declare cursor of rows instead of returning them (default false): boolean>,]
+//     ["aggregates": [
+//         {
+//             "function": <aggregate function: 0/1/2/3/4 - count/sum/min/max/avg>,
+//             ["column": <column name (all rows of count if absent): string>,]
+//         },
+//     ],]
+//     ["group_by": <grouped columns list: string[]>,]
+//     ["order_by": [
+//         {
+//             ["column": <column name: string>,]
+//             ["aggregate": <aggregate of aggregated select, as in "aggregates">,]
+//             ["descending": <descending order (default false): boolean>,]
+//         },
+//     ],]
 // }
 // - success response: {
 //     "columns": <columns list: string[]>,
 //     "values": <values list: <string/number/null>[][]>
 // }
+// - success response of cursor: {
+//     "cursor": <cursor id: number>
+// }
+// - rows of cursor are taken by fetches, cursor is closed when it is not fetched
+//   for some time, when rows of its tables are removed or moved and by schema changes
+// - select with aggregates or grouped columns returns a row for each group of rows
+//   with the same values of grouped columns (one group without them): selected columns,
+//   which must be grouped ones (all of them by default), and then aggregates of the group
+// - ordered rows are sorted before offset and limit, order has either column or aggregate,
+//   rows with equal values of orders are kept in the order of scan, NULL values go first
 //
 // action "update" (5):
 // - request: {
@@ -79,6 +111,85 @@
 //     "amount": <amount of updated rows: number>
 // }
 //
+// action "vacuum" (6):
+// - request: {
+//     "action": 6,
+//     ["table": <table name (all tables if absent): string>,]
+// }
+// - success response: {
+//     "amount": <amount of rewritten rows: number>
+// }
+//
+// action "create index" (7):
+// - request: {
+//     "action": 7,
+//     "table": <table name: string>,
+//     "column": <column name: string>,
+// }
+// - success response: {}
+//
+// action "fetch" (8):
+// - request: {
+//     "action": 8,
+//     "cursor": <cursor id: number>,
+//     ["amount": <amount of rows (from 0 to 1000, default 10): number>,]
+// }
+// - success response: {
+//     "columns": <columns list: string[]>,
+//     "values": <next values of cursor, less than amount at the end: <string/number/null>[][]>
+// }
+//
+// action "close cursor" (9):
+// - request: {
+//     "action": 9,
+//     "cursor": <cursor id: number>,
+// }
+// - success response: {}
+//
+// action "stats" (10):
+// - request: {
+//     "action": 10,
+// }
+// - success response: {
+//     "size": <size of storage file: number>,
+//     "tables": <amount of tables: number>,
+//     "row_groups": <amount of row groups with bodies: number>,
+//     "compressed_row_groups": <amount of row groups with compressed bodies: number>,
+//     "body_size": <size of bodies: number>,
+//     "stored_size": <size of bodies in file: number>,
+//     "compression_ratio": <size of bodies divided by their size in file: number>
+// }
+//
+// action "prepare" (11):
+// - request: {
+//     "action": 11,
+//     "request": <insert, delete, select or update request, its values may be parameters>,
+// }
+// - success response: {
+//     "statement": <statement id: number>,
+//     "parameters": <amount of parameters, the greatest of their numbers: number>
+// }
+// - statement is kept by connection until it is deallocated or connection is closed,
+//   its tables and columns are resolved by prepare and again only after schema changes
+//
+// action "execute" (12):
+// - request: {
+//     "action": 12,
+//     "statement": <statement id: number>,
+//     ["parameters": <values of parameters by their numbers: <string/number/null>[]>,]
+// }
+// - success response: response of the prepared request
+//
+// action "deallocate" (13):
+// - request: {
+//     "action": 13,
+//     "statement": <statement id: number>,
+// }
+// - success response: {}
+//
+// parameter of prepared request is in place of value: { "parameter": <number of parameter from 1: number> },
+// the same parameter may be in several places
+//
 // where expression object: { "op": <operator: 0/1/2/3/4/5/6/7 - eq/ne/lt/gt/le/ge/and/or>, ... }
 //
 // where operators "eq"/"ne"/"lt"/"gt"/"le"/"ge" (0/1/2/3/4/5): {
@@ -100,6 +211,25 @@ enum json_api_action {
     JSON_API_TYPE_DELETE = 3,
     JSON_API_TYPE_SELECT = 4,
     JSON_API_TYPE_UPDATE = 5,
+    JSON_API_TYPE_VACUUM = 6,
+    JSON_API_TYPE_CREATE_INDEX = 7,
+    JSON_API_TYPE_FETCH = 8,
+    JSON_API_TYPE_CLOSE_CURSOR = 9,
+    JSON_API_TYPE_STATS = 10,
+    JSON_API_TYPE_PREPARE = 11,
+    JSON_API_TYPE_EXECUTE = 12,
+    JSON_API_TYPE_DEALLOCATE = 13,
+};
+
+// places of parameters in prepared request, values of its parameters are put there by execute
+struct json_api_parameters {
+    unsigned int amount;
+
+    unsigned int places_amount;
+    struct {
+        unsigned int parameter;
+        struct storage_value ** value;
+    } * places;
 };
 
 struct json_api_create_table_request {
@@ -109,8 +239,11 @@ struct json_api_create_table_request {
         struct {
             char * name;
             enum storage_column_type type;
+            bool dictionary;
         } * columns;
     } columns;
+    bool columnar;
+    bool compressed;
 };
 
 struct json_api_drop_table_request {
@@ -125,8 +258,11 @@ struct json_api_insert_request {
     } columns;
     struct {
         unsigned int amount;
-        struct storage_value ** values;
-    } values;
+        struct json_api_insert_request_row {
+            unsigned int amount;
+            struct storage_value ** values;
+        } * rows;
+    } rows;
 };
 
 enum json_api_operator {
@@ -156,6 +292,25 @@ struct json_api_where {
     };
 };
 
+enum json_api_function {
+    JSON_API_FUNCTION_COUNT = 0,
+    JSON_API_FUNCTION_SUM = 1,
+    JSON_API_FUNCTION_MIN = 2,
+    JSON_API_FUNCTION_MAX = 3,
+    JSON_API_FUNCTION_AVG = 4,
+};
+
+struct json_api_aggregate {
+    enum json_api_function function;
+    char * column;
+};
+
+struct json_api_order {
+    char * column;
+    struct json_api_aggregate * aggregate;
+    bool descending;
+};
+
 struct json_api_delete_request {
     char * table_name;
     struct json_api_where * where;
@@ -170,6 +325,7 @@ struct json_api_select_request {
     struct json_api_where * where;
     unsigned int offset;
     unsigned int limit;
+    bool has_limit;
     struct {
         unsigned int amount;
         struct {
@@ -178,6 +334,19 @@ struct json_api_select_request {
             char * s_column;
         } * joins;
     } joins;
+    bool cursor;
+    struct {
+        unsigned int amount;
+        struct json_api_aggregate * aggregates;
+    } aggregates;
+    struct {
+        unsigned int amount;
+        char ** columns;
+    } group_by;
+    struct {
+        unsigned int amount;
+        struct json_api_order * orders;
+    } order_by;
 };
 
 struct json_api_update_request {
@@ -193,14 +362,66 @@ struct json_api_update_request {
     struct json_api_where * where;
 };
 
+struct json_api_vacuum_request {
+    char * table_name;
+};
+
+struct json_api_create_index_request {
+    char * table_name;
+    char * column;
+};
+
+struct json_api_fetch_request {
+    uint64_t cursor;
+    unsigned int amount;
+};
+
+struct json_api_close_cursor_request {
+    uint64_t cursor;
+};
+
+struct json_api_prepare_request {
+    struct json_object * request;
+};
+
+struct json_api_execute_request {
+    uint64_t statement;
+    struct {
+        unsigned int amount;
+        struct storage_value ** values;
+    } parameters;
+};
+
+struct json_api_deallocate_request {
+    uint64_t statement;
+};
+
 enum json_api_action json_api_get_action(struct json_object * object);
+// statement of execute or deallocate request, 0 when it is absent
+uint64_t json_api_get_statement(struct json_object * object);
 
 struct json_api_create_table_request json_api_to_create_table_request(struct json_object * object);
 struct json_api_drop_table_request json_api_to_drop_table_request(struct json_object * object);
-struct json_api_insert_request json_api_to_insert_request(struct json_object * object);
-struct json_api_delete_request json_api_to_delete_request(struct json_object * object);
-struct json_api_select_request json_api_to_select_request(struct json_object * object);
-struct json_api_update_request json_api_to_update_request(struct json_object * object);
+// parameters of prepared request are added to places, NULL for request that is not prepared
+struct json_api_insert_request json_api_to_insert_request(struct json_object * object, struct json_api_parameters * parameters);
+struct json_api_delete_request json_api_to_delete_request(struct json_object * object, struct json_api_parameters * parameters);
+struct json_api_select_request json_api_to_select_request(struct json_object * object, struct json_api_parameters * parameters);
+struct json_api_update_request json_api_to_update_request(struct json_object * object, struct json_api_parameters * parameters);
+struct json_api_vacuum_request json_api_to_vacuum_request(struct json_object * object);
+struct json_api_create_index_request json_api_to_create_index_request(struct json_object * object);
+struct json_api_fetch_request json_api_to_fetch_request(struct json_object * object);
+struct json_api_close_cursor_request json_api_to_close_cursor_request(struct json_object * object);
+struct json_api_prepare_request json_api_to_prepare_request(struct json_object * object);
+struct json_api_execute_request json_api_to_execute_request(struct json_object * object);
+struct json_api_deallocate_request json_api_to_deallocate_request(struct json_object * object);
+
+// prepared requests are kept by server, so they are freed unlike the others;
+// places of their parameters must be NULL
+void json_api_free_insert_request(struct json_api_insert_request request);
+void json_api_free_delete_request(struct json_api_delete_request request);
+void json_api_free_select_request(struct json_api_select_request request);
+void json_api_free_update_request(struct json_api_update_request request);
+void json_api_free_parameters(struct json_api_parameters parameters);
 
 struct json_object * json_api_make_success(struct json_object * answer);
 struct json_object * json_api_make_error(const char * msg);
@@ -7,13 +7,28 @@
 
 int yylex(void);
 void yyerror(struct json_object ** result, char ** error, const char * str);
+
+// puts column name or aggregate object into columns or aggregates of select list
+static void select_list_add(struct json_object * list, struct json_object * item) {
+    const char * const key = json_object_is_type(item, json_type_string) ? "columns" : "aggregates";
+    struct json_object * items;
+
+    if (!json_object_object_get_ex(list, key, &items)) {
+        items = json_object_new_array();
+        json_object_object_add(list, key, items);
+    }
+
+    json_object_array_add(items, item);
+}
 %}
 
 %define api.value.type {struct json_object *}
 
-%token T_CREATE T_TABLE T_IDENTIFIER T_DBL_QUOTED T_INT T_UINT T_NUM T_STR T_DROP T_INSERT T_VALUES T_INTO
+%token T_CREATE T_TABLE T_COLUMNAR T_COMPRESSED T_DICTIONARY T_VACUUM T_INDEX T_IDENTIFIER T_DBL_QUOTED T_INT T_UINT T_NUM T_STR T_DROP T_INSERT T_VALUES T_INTO
     T_INT_LITERAL T_UINT_LITERAL T_NUM_LITERAL T_STR_LITERAL T_NULL T_DELETE T_FROM T_WHERE T_JOIN T_ON
     T_EQ_OP T_NE_OP T_LT_OP T_GT_OP T_LE_OP T_GE_OP T_SELECT T_ASTERISK T_OFFSET T_LIMIT T_UPDATE T_SET
+    T_DECLARE T_CURSOR T_FOR T_FETCH T_CLOSE T_COUNT T_SUM T_MIN T_MAX T_AVG T_GROUP T_BY T_ORDER T_ASC T_DESC T_STATS
+    T_PREPARE T_EXECUTE T_DEALLOCATE T_PARAMETER
 
 %left T_OR_OP
 %left T_AND_OP
@@ -37,26 +52,85 @@ command
     | delete_command        { $$ = $1; }
     | select_command        { $$ = $1; }
     | update_command        { $$ = $1; }
+    | vacuum_command        { $$ = $1; }
+    | create_index_command  { $$ = $1; }
+    | declare_cursor_command    { $$ = $1; }
+    | fetch_command         { $$ = $1; }
+    | close_cursor_command  { $$ = $1; }
+    | stats_command         { $$ = $1; }
+    | prepare_command       { $$ = $1; }
+    | execute_command       { $$ = $1; }
+    | deallocate_command    { $$ = $1; }
     ;
 
 create_table_command
-    : T_CREATE t_table_non_req name '(' columns_declaration_list ')'    {
+    : T_CREATE table_name '(' columns_declaration_list ')'    {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(0));
+        json_object_object_add($$, "table", $2);
+        json_object_object_add($$, "columns", $4);
+    }
+    | T_CREATE T_COLUMNAR table_name '(' columns_declaration_list ')'    {
         $$ = json_object_new_object();
 
         json_object_object_add($$, "action", json_object_new_int(0));
         json_object_object_add($$, "table", $3);
         json_object_object_add($$, "columns", $5);
+        json_object_object_add($$, "columnar", json_object_new_boolean(1));
+    }
+    | T_CREATE T_COLUMNAR T_COMPRESSED table_name '(' columns_declaration_list ')'    {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(0));
+        json_object_object_add($$, "table", $4);
+        json_object_object_add($$, "columns", $6);
+        json_object_object_add($$, "columnar", json_object_new_boolean(1));
+        json_object_object_add($$, "compressed", json_object_new_boolean(1));
     }
     ;
 
-t_table_non_req
-    : /* empty */
-    | T_TABLE
+// optional TABLE is a part of table name, so create of table named index
+// is told apart from CREATE INDEX by the next token
+table_name
+    : name          { $$ = $1; }
+    | T_TABLE name  { $$ = $2; }
     ;
 
+// index is a keyword only in CREATE INDEX, it is a name everywhere else
 name
     : T_IDENTIFIER  { $$ = $1; }
     | T_DBL_QUOTED  { $$ = $1; }
+    | T_INDEX       { $$ = $1; }
+    | keyword_name  { $$ = $1; }
+    ;
+
+// words that became keywords after tables and columns could be named by them,
+// they are names wherever a keyword can not be there
+keyword_name
+    : T_COLUMNAR    { $$ = json_object_new_string("columnar"); }
+    | T_COMPRESSED  { $$ = json_object_new_string("compressed"); }
+    | T_DICTIONARY  { $$ = json_object_new_string("dictionary"); }
+    | T_VACUUM      { $$ = json_object_new_string("vacuum"); }
+    | T_COUNT       { $$ = json_object_new_string("count"); }
+    | T_SUM         { $$ = json_object_new_string("sum"); }
+    | T_MIN         { $$ = json_object_new_string("min"); }
+    | T_MAX         { $$ = json_object_new_string("max"); }
+    | T_AVG         { $$ = json_object_new_string("avg"); }
+    | T_GROUP       { $$ = json_object_new_string("group"); }
+    | T_BY          { $$ = json_object_new_string("by"); }
+    | T_ORDER       { $$ = json_object_new_string("order"); }
+    | T_ASC         { $$ = json_object_new_string("asc"); }
+    | T_DESC        { $$ = json_object_new_string("desc"); }
+    | T_DECLARE     { $$ = json_object_new_string("declare"); }
+    | T_CURSOR      { $$ = json_object_new_string("cursor"); }
+    | T_FOR         { $$ = json_object_new_string("for"); }
+    | T_FETCH       { $$ = json_object_new_string("fetch"); }
+    | T_CLOSE       { $$ = json_object_new_string("close"); }
+    | T_STATS       { $$ = json_object_new_string("stats"); }
+    | T_PREPARE     { $$ = json_object_new_string("prepare"); }
+    | T_EXECUTE     { $$ = json_object_new_string("execute"); }
+    | T_DEALLOCATE  { $$ = json_object_new_string("deallocate"); }
     ;
 
 columns_declaration_list
@@ -75,6 +149,12 @@ column_declaration
         json_object_object_add($$, "name", $1);
         json_object_object_add($$, "type", $2);
     }
+    | name type T_DICTIONARY    {
+        $$ = json_object_new_object();
+        json_object_object_add($$, "name", $1);
+        json_object_object_add($$, "type", $2);
+        json_object_object_add($$, "dictionary", json_object_new_boolean(1));
+    }
     ;
 
 type
@@ -85,15 +165,15 @@ type
     ;
 
 drop_table_command
-    : T_DROP t_table_non_req name   {
+    : T_DROP table_name   {
         $$ = json_object_new_object();
         json_object_object_add($$, "action", json_object_new_int(1));
-        json_object_object_add($$, "table", $3);
+        json_object_object_add($$, "table", $2);
     }
     ;
 
 insert_command
-    : T_INSERT t_into_non_req name braced_names_list_non_req T_VALUES '(' values_list ')'   {
+    : T_INSERT t_into_non_req name braced_names_list_non_req T_VALUES rows_list_req   {
         $$ = json_object_new_object();
 
         json_object_object_add($$, "action", json_object_new_int(2));
@@ -103,7 +183,18 @@ insert_command
             json_object_object_add($$, "columns", $4);
         }
 
-        json_object_object_add($$, "values", $7);
+        json_object_object_add($$, "rows", $6);
+    }
+    ;
+
+rows_list_req
+    : '(' values_list ')'                   {
+        $$ = json_object_new_array();
+        json_object_array_add($$, $2 ? $2 : json_object_new_array());
+    }
+    | rows_list_req ',' '(' values_list ')' {
+        $$ = $1;
+        json_object_array_add($$, $4 ? $4 : json_object_new_array());
     }
     ;
 
@@ -142,6 +233,10 @@ value
     | T_NUM_LITERAL     { $$ = $1; }
     | T_STR_LITERAL     { $$ = $1; }
     | T_NULL            { $$ = NULL; }
+    | T_PARAMETER       {
+        $$ = json_object_new_object();
+        json_object_object_add($$, "parameter", $1);
+    }
     ;
 
 delete_command
@@ -198,14 +293,19 @@ where_value_op
     ;
 
 select_command
-    : T_SELECT names_list_or_asterisk T_FROM name join_stmts where_stmt_non_req offset_stmt_non_req limit_stmt_non_req {
+    : T_SELECT select_list T_FROM name join_stmts where_stmt_non_req group_by_stmt_non_req order_by_stmt_non_req
+            offset_stmt_non_req limit_stmt_non_req {
         $$ = json_object_new_object();
 
         json_object_object_add($$, "action", json_object_new_int(4));
         json_object_object_add($$, "table", $4);
 
         if ($2) {
-            json_object_object_add($$, "columns", $2);
+            json_object_object_foreach($2, key, val) {
+                json_object_object_add($$, key, json_object_get(val));
+            }
+
+            json_object_put($2);
         }
 
         if ($5) {
@@ -217,20 +317,96 @@ select_command
         }
 
         if ($7) {
-            json_object_object_add($$, "offset", $7);
+            json_object_object_add($$, "group_by", $7);
         }
 
         if ($8) {
-            json_object_object_add($$, "limit", $8);
+            json_object_object_add($$, "order_by", $8);
+        }
+
+        if ($9) {
+            json_object_object_add($$, "offset", $9);
+        }
+
+        if ($10) {
+            json_object_object_add($$, "limit", $10);
         }
     }
     ;
 
-names_list_or_asterisk
-    : names_list_req    { $$ = $1; }
+select_list
+    : select_list_req   { $$ = $1; }
     | T_ASTERISK        { $$ = NULL; }
     ;
 
+select_list_req
+    : select_list_item                      { $$ = json_object_new_object(); select_list_add($$, $1); }
+    | select_list_req ',' select_list_item  { $$ = $1; select_list_add($$, $3); }
+    ;
+
+select_list_item
+    : name      { $$ = $1; }
+    | aggregate { $$ = $1; }
+    ;
+
+aggregate
+    : aggregate_function '(' name ')'   {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "function", $1);
+        json_object_object_add($$, "column", $3);
+    }
+    | aggregate_function '(' T_ASTERISK ')' {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "function", $1);
+    }
+    ;
+
+aggregate_function
+    : T_COUNT   { $$ = json_object_new_int(JSON_API_FUNCTION_COUNT); }
+    | T_SUM     { $$ = json_object_new_int(JSON_API_FUNCTION_SUM); }
+    | T_MIN     { $$ = json_object_new_int(JSON_API_FUNCTION_MIN); }
+    | T_MAX     { $$ = json_object_new_int(JSON_API_FUNCTION_MAX); }
+    | T_AVG     { $$ = json_object_new_int(JSON_API_FUNCTION_AVG); }
+    ;
+
+group_by_stmt_non_req
+    : /* empty */                   { $$ = NULL; }
+    | T_GROUP T_BY names_list_req   { $$ = $3; }
+    ;
+
+order_by_stmt_non_req
+    : /* empty */                   { $$ = NULL; }
+    | T_ORDER T_BY orders_list_req  { $$ = $3; }
+    ;
+
+orders_list_req
+    : order                     { $$ = json_object_new_array(); json_object_array_add($$, $1); }
+    | orders_list_req ',' order { $$ = $1; json_object_array_add($$, $3); }
+    ;
+
+order
+    : name order_direction  {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "column", $1);
+        json_object_object_add($$, "descending", $2);
+    }
+    | aggregate order_direction {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "aggregate", $1);
+        json_object_object_add($$, "descending", $2);
+    }
+    ;
+
+order_direction
+    : /* empty */   { $$ = json_object_new_boolean(false); }
+    | T_ASC         { $$ = json_object_new_boolean(false); }
+    | T_DESC        { $$ = json_object_new_boolean(true); }
+    ;
+
 join_stmts
     : /* empty */           { $$ = NULL; }
     | join_stmts_non_null   { $$ = $1; }
@@ -304,6 +480,111 @@ update_value
     : name T_EQ_OP value    { $$ = json_object_new_array(); json_object_array_add($$, $1); json_object_array_add($$, $3); }
     ;
 
+vacuum_command
+    : T_VACUUM  {
+        $$ = json_object_new_object();
+        json_object_object_add($$, "action", json_object_new_int(6));
+    }
+    | T_VACUUM table_name {
+        $$ = json_object_new_object();
+        json_object_object_add($$, "action", json_object_new_int(6));
+        json_object_object_add($$, "table", $2);
+    }
+    ;
+
+create_index_command
+    : T_CREATE T_INDEX T_ON name '(' name ')'  {
+        $$ = json_object_new_object();
+
+        json_object_put($2);
+
+        json_object_object_add($$, "action", json_object_new_int(7));
+        json_object_object_add($$, "table", $4);
+        json_object_object_add($$, "column", $6);
+    }
+    ;
+
+declare_cursor_command
+    : T_DECLARE T_CURSOR T_FOR select_command  {
+        $$ = $4;
+        json_object_object_add($$, "cursor", json_object_new_boolean(1));
+    }
+    ;
+
+fetch_command
+    : T_FETCH T_FROM T_UINT_LITERAL  {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(8));
+        json_object_object_add($$, "cursor", $3);
+    }
+    | T_FETCH T_UINT_LITERAL T_FROM T_UINT_LITERAL  {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(8));
+        json_object_object_add($$, "cursor", $4);
+        json_object_object_add($$, "amount", $2);
+    }
+    ;
+
+close_cursor_command
+    : T_CLOSE T_UINT_LITERAL  {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(9));
+        json_object_object_add($$, "cursor", $2);
+    }
+    ;
+
+stats_command
+    : T_STATS   {
+        $$ = json_object_new_object();
+        json_object_object_add($$, "action", json_object_new_int(10));
+    }
+    ;
+
+prepare_command
+    : T_PREPARE prepared_command    {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(11));
+        json_object_object_add($$, "request", $2);
+    }
+    ;
+
+prepared_command
+    : insert_command        { $$ = $1; }
+    | delete_command        { $$ = $1; }
+    | select_command        { $$ = $1; }
+    | update_command        { $$ = $1; }
+    | declare_cursor_command    { $$ = $1; }
+    ;
+
+execute_command
+    : T_EXECUTE T_UINT_LITERAL  {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(12));
+        json_object_object_add($$, "statement", $2);
+    }
+    | T_EXECUTE T_UINT_LITERAL '(' values_list ')'  {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(12));
+        json_object_object_add($$, "statement", $2);
+        json_object_object_add($$, "parameters", $4 ? $4 : json_object_new_array());
+    }
+    ;
+
+deallocate_command
+    : T_DEALLOCATE T_UINT_LITERAL   {
+        $$ = json_object_new_object();
+
+        json_object_object_add($$, "action", json_object_new_int(13));
+        json_object_object_add($$, "statement", $2);
+    }
+    ;
+
 %%
 
 void yyerror(struct json_object ** result, char ** error, const char * str) {
@@ -8,11 +8,30 @@
 #include <netinet/in.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <stdatomic.h>
 
 #include "storage.h"
+#include "workers.h"
+#include "cursors.h"
+#include "aggregate.h"
+#include "sort.h"
 #include "json_api.h"
 
-static volatile bool closing = false;
+
+#define CURSOR_TIMEOUT (300)
+#define MEMORY_BUDGET (64)
+
+
+static atomic_bool closing = false;
+
+// memory of aggregation and sort of every select before they spill rows to temporary files
+static size_t memory_budget;
+
+// cursors of selects by their ids
+static struct cursors * cursors;
+
+// incremented by every request that changes schema, plans of prepared statements are resolved again after that
+static atomic_uint_fast64_t schema_generation = 0;
 
 static void close_handler(int sig, siginfo_t * info, void * context) {
     closing = true;
@@ -25,6 +44,8 @@ static struct json_object * handle_request_create_table(struct json_api_create_t
     table->position = 0;
     table->next = 0;
     table->first_row = 0;
+    table->format = request.columnar ? STORAGE_TABLE_FORMAT_COLUMNAR : STORAGE_TABLE_FORMAT_INLINE;
+    table->compressed = request.compressed;
     table->name = strdup(request.table_name);
     table->columns.amount = request.columns.amount;
     table->columns.columns = malloc(sizeof(*table->columns.columns) * request.columns.amount);
@@ -32,6 +53,19 @@ static struct json_object * handle_request_create_table(struct json_api_create_t
     for (int i = 0; i < request.columns.amount; ++i) {
         table->columns.columns[i].name = strdup(request.columns.columns[i].name);
         table->columns.columns[i].type = request.columns.columns[i].type;
+        table->columns.columns[i].dictionary = request.columns.columns[i].dictionary;
+
+        if (table->columns.columns[i].dictionary && table->columns.columns[i].type != STORAGE_COLUMN_TYPE_STR) {
+            // names of the next columns are not set yet
+            table->columns.amount = i + 1;
+            storage_table_delete(table);
+            return json_api_make_error("only str columns can have dictionary");
+        }
+    }
+
+    if (table->compressed && table->format != STORAGE_TABLE_FORMAT_COLUMNAR) {
+        storage_table_delete(table);
+        return json_api_make_error("only columnar tables can be compressed");
     }
 
     errno = 0;
@@ -76,17 +110,9 @@ static struct json_object * map_columns_to_indexes(unsigned int request_columns_
         }
     } else {
         for (unsigned int i = 0; i < columns_count; ++i) {
-            bool found = false;
-
-            for (unsigned int j = 0; j < table_columns_amount; ++j) {
-                if (strcmp(request_columns_names[i], storage_joined_table_get_column(table, j).name) == 0) {
-                    (*columns_indexes)[i] = j;
-                    found = true;
-                    break;
-                }
-            }
+            const int index = storage_joined_table_find_column(table, request_columns_names[i]);
 
-            if (!found) {
+            if (index < 0) {
                 size_t msg_length = 41 + strlen(request_columns_names[i]);
 
                 char msg[msg_length];
@@ -94,6 +120,8 @@ static struct json_object * map_columns_to_indexes(unsigned int request_columns_
 
                 return json_api_make_error(msg);
             }
+
+            (*columns_indexes)[i] = index;
         }
     }
 
@@ -158,621 +186,1897 @@ static struct json_object * check_values(unsigned int request_values_amount, str
     return NULL;
 }
 
-static struct json_object * handle_request_insert(struct json_api_insert_request request, struct storage * storage) {
-    struct storage_table * table = storage_find_table(storage, request.table_name);
+// targets of jumps that terminate where program
+#define WHERE_ACCEPT (-1)
+#define WHERE_REJECT (-2)
 
-    if (!table) {
-        return json_api_make_error("table with the specified name is not exists");
-    }
+typedef uint8_t (* where_comparator)(const struct storage_value * left, const struct storage_value * right);
 
-    unsigned int columns_amount;
-    unsigned int * columns_indexes;
-    struct storage_joined_table * joined_table = storage_joined_table_wrap(table);
+// where expression compiled against the columns of joined table,
+// leaves are laid out left to right and "and"/"or" are turned into jumps
+struct where_program {
+    unsigned int amount;
 
-    {
-        struct json_object * error = map_columns_to_indexes(request.columns.amount, request.columns.columns,
-            joined_table, &columns_amount, &columns_indexes);
+    struct where_instruction {
+        uint16_t table;
+        uint16_t column;
 
-        if (error) {
-            storage_joined_table_delete(joined_table);
-            return error;
-        }
-    }
+        where_comparator compare;
+        struct storage_value value;
 
-    {
-        struct json_object * error = check_values(request.values.amount, request.values.values, table, columns_amount, columns_indexes);
+        uint8_t null_outcome;
+        uint8_t accepted;
 
-        if (error) {
-            free(columns_indexes);
-            storage_joined_table_delete(joined_table);
-            return error;
-        }
+        int on_true;
+        int on_false;
+    } * instructions;
+};
+
+static uint8_t where_compare_int(int64_t left, int64_t right) {
+    return left < right ? STORAGE_OUTCOME_LESS : left > right ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+}
+
+static uint8_t where_compare_uint(uint64_t left, uint64_t right) {
+    return left < right ? STORAGE_OUTCOME_LESS : left > right ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+}
+
+static uint8_t where_compare_num(double left, double right) {
+    if (left < right) {
+        return STORAGE_OUTCOME_LESS;
     }
 
-    struct storage_row * row = storage_table_add_row(table);
-    for (unsigned int i = 0; i < columns_amount; ++i) {
-        storage_row_set_value(row, columns_indexes[i], request.values.values[i]);
+    if (left > right) {
+        return STORAGE_OUTCOME_GREATER;
     }
 
-    free(columns_indexes);
-    storage_row_delete(row);
-    storage_joined_table_delete(joined_table);
-    return json_api_make_success(json_object_new_object());
+    return left == right ? STORAGE_OUTCOME_EQUAL : STORAGE_OUTCOME_UNORDERED;
 }
 
-static struct json_object * is_where_correct(struct storage_joined_table * table, struct json_api_where * where) {
-    uint16_t table_columns_amount = storage_joined_table_get_columns_amount(table);
+static uint8_t where_compare_int_int(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_int(left->value._int, right->value._int);
+}
 
-    switch (where->op) {
-        case JSON_API_OPERATOR_EQ:
-        case JSON_API_OPERATOR_NE:
-            if (where->value == NULL) {
-                return NULL;
-            }
+static uint8_t where_compare_int_uint(const struct storage_value * left, const struct storage_value * right) {
+    if (left->value._int < 0) {
+        return STORAGE_OUTCOME_LESS;
+    }
 
-        case JSON_API_OPERATOR_LT:
-        case JSON_API_OPERATOR_GT:
-        case JSON_API_OPERATOR_LE:
-        case JSON_API_OPERATOR_GE:
-            if (where->value == NULL) {
-                return json_api_make_error("NULL value is not comparable");
-            }
+    return where_compare_uint((uint64_t) left->value._int, right->value.uint);
+}
 
-            for (unsigned int i = 0; i < table_columns_amount; ++i) {
-                struct storage_column column = storage_joined_table_get_column(table, i);
+static uint8_t where_compare_int_num(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num((double) left->value._int, right->value.num);
+}
 
-                if (strcmp(column.name, where->column) == 0) {
-                    switch (column.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                        case STORAGE_COLUMN_TYPE_UINT:
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            switch (where->value->type) {
-                                case STORAGE_COLUMN_TYPE_INT:
-                                case STORAGE_COLUMN_TYPE_UINT:
-                                case STORAGE_COLUMN_TYPE_NUM:
-                                    return NULL;
+static uint8_t where_compare_uint_int(const struct storage_value * left, const struct storage_value * right) {
+    if (right->value._int < 0) {
+        return STORAGE_OUTCOME_GREATER;
+    }
 
-                                case STORAGE_COLUMN_TYPE_STR:
-                                    break;
-                            }
+    return where_compare_uint(left->value.uint, (uint64_t) right->value._int);
+}
 
-                            break;
+static uint8_t where_compare_uint_uint(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_uint(left->value.uint, right->value.uint);
+}
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            if (where->value->type == STORAGE_COLUMN_TYPE_STR) {
-                                return NULL;
-                            }
+static uint8_t where_compare_uint_num(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num((double) left->value.uint, right->value.num);
+}
 
-                            break;
-                    }
+static uint8_t where_compare_num_int(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num(left->value.num, (double) right->value._int);
+}
 
-                    const char * column_type = storage_column_type_to_string(column.type);
-                    const char * value_type = storage_column_type_to_string(where->value->type);
-                    size_t msg_length = 31 + strlen(column_type) + strlen(value_type);
-                    char msg[msg_length];
+static uint8_t where_compare_num_uint(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num(left->value.num, (double) right->value.uint);
+}
 
-                    snprintf(msg, msg_length, "types %s and %s are not comparable", column_type, value_type);
-                    return json_api_make_error(msg);
-                }
-            }
+static uint8_t where_compare_num_num(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num(left->value.num, right->value.num);
+}
 
-            {
-                size_t msg_length = 41 + strlen(where->column);
+static uint8_t where_compare_str_str(const struct storage_value * left, const struct storage_value * right) {
+    const int result = strcmp(left->value.str, right->value.str);
 
-                char msg[msg_length];
-                snprintf(msg, msg_length, "column with name %s is not exists in table", where->column);
+    return result < 0 ? STORAGE_OUTCOME_LESS : result > 0 ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+}
 
-                return json_api_make_error(msg);
-            }
+// comparison of any not NULL cell with NULL
+static uint8_t where_compare_any_null(const struct storage_value * left, const struct storage_value * right) {
+    return STORAGE_OUTCOME_GREATER;
+}
+
+static where_comparator where_get_comparator(enum storage_column_type left, enum storage_column_type right) {
+    static const where_comparator comparators[4][4] = {
+        [STORAGE_COLUMN_TYPE_INT] = {
+            [STORAGE_COLUMN_TYPE_INT] = where_compare_int_int,
+            [STORAGE_COLUMN_TYPE_UINT] = where_compare_int_uint,
+            [STORAGE_COLUMN_TYPE_NUM] = where_compare_int_num,
+        },
+        [STORAGE_COLUMN_TYPE_UINT] = {
+            [STORAGE_COLUMN_TYPE_INT] = where_compare_uint_int,
+            [STORAGE_COLUMN_TYPE_UINT] = where_compare_uint_uint,
+            [STORAGE_COLUMN_TYPE_NUM] = where_compare_uint_num,
+        },
+        [STORAGE_COLUMN_TYPE_NUM] = {
+            [STORAGE_COLUMN_TYPE_INT] = where_compare_num_int,
+            [STORAGE_COLUMN_TYPE_UINT] = where_compare_num_uint,
+            [STORAGE_COLUMN_TYPE_NUM] = where_compare_num_num,
+        },
+        [STORAGE_COLUMN_TYPE_STR] = {
+            [STORAGE_COLUMN_TYPE_STR] = where_compare_str_str,
+        },
+    };
+
+    return comparators[left][right];
+}
+
+// splits index of joined table column into index of table and index of column in it
+static void where_locate_column(const struct storage_joined_table * table, int index, struct where_instruction * instruction) {
+    uint16_t i = 0;
+
+    while (index >= table->tables.tables[i].table->columns.amount) {
+        index -= table->tables.tables[i].table->columns.amount;
+        ++i;
+    }
 
+    instruction->table = i;
+    instruction->column = (uint16_t) index;
+}
+
+static unsigned int count_where_comparisons(const struct json_api_where * where) {
+    switch (where->op) {
         case JSON_API_OPERATOR_AND:
         case JSON_API_OPERATOR_OR:
-        {
-            struct json_object * left = is_where_correct(table, where->left);
-            if (left != NULL) {
-                return left;
-            }
+            return count_where_comparisons(where->left) + count_where_comparisons(where->right);
 
-            return is_where_correct(table, where->right);
-        }
+        default:
+            return 1;
     }
 }
 
-static bool compare_values_not_null(enum json_api_operator op, struct storage_value left, struct storage_value right) {
-    switch (op) {
-        case JSON_API_OPERATOR_EQ:
-            switch (left.type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            return left.value._int == right.value._int;
+static struct json_object * compile_where_expr(const struct storage_joined_table * table, const struct json_api_where * where,
+        struct where_instruction * instructions, int position, int on_true, int on_false) {
+    switch (where->op) {
+        case JSON_API_OPERATOR_AND:
+            {
+                const int right = position + (int) count_where_comparisons(where->left);
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            if (left.value._int < 0) {
-                                return false;
-                            }
+                struct json_object * error = compile_where_expr(table, where->left, instructions, position, right, on_false);
+                return error ? error : compile_where_expr(table, where->right, instructions, right, on_true, on_false);
+            }
 
-                            return ((uint64_t) left.value._int) == right.value.uint;
+        case JSON_API_OPERATOR_OR:
+            {
+                const int right = position + (int) count_where_comparisons(where->left);
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return ((double) left.value._int) == right.value.num;
+                struct json_object * error = compile_where_expr(table, where->left, instructions, position, on_true, right);
+                return error ? error : compile_where_expr(table, where->right, instructions, right, on_true, on_false);
+            }
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+        default:
+            break;
+    }
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            if (right.value._int < 0) {
-                                return false;
-                            }
+    const int index = storage_joined_table_find_column(table, where->column);
 
-                            return left.value.uint == ((uint64_t) right.value._int);
+    if (index < 0) {
+        size_t msg_length = 41 + strlen(where->column);
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            return left.value.uint == right.value.uint;
+        char msg[msg_length];
+        snprintf(msg, msg_length, "column with name %s is not exists in table", where->column);
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return ((double) left.value.uint) == right.value.num;
+        return json_api_make_error(msg);
+    }
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+    struct where_instruction * const instruction = &instructions[position];
+    where_locate_column(table, index, instruction);
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            return left.value.num == ((double) right.value._int);
+    instruction->on_true = on_true;
+    instruction->on_false = on_false;
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            return left.value.num == ((double) right.value.uint);
+    switch (where->op) {
+        case JSON_API_OPERATOR_EQ:
+            instruction->accepted = STORAGE_OUTCOME_EQUAL;
+            break;
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return left.value.num == right.value.num;
+        case JSON_API_OPERATOR_NE:
+            instruction->accepted = STORAGE_OUTCOME_LESS | STORAGE_OUTCOME_GREATER | STORAGE_OUTCOME_UNORDERED | STORAGE_OUTCOME_NULL;
+            break;
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+        case JSON_API_OPERATOR_LT:
+            instruction->accepted = STORAGE_OUTCOME_LESS;
+            break;
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                        case STORAGE_COLUMN_TYPE_UINT:
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return false;
+        case JSON_API_OPERATOR_GT:
+            instruction->accepted = STORAGE_OUTCOME_GREATER;
+            break;
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return strcmp(left.value.str, right.value.str) == 0;
-                    }
-            }
+        case JSON_API_OPERATOR_LE:
+            instruction->accepted = STORAGE_OUTCOME_LESS | STORAGE_OUTCOME_EQUAL | STORAGE_OUTCOME_UNORDERED;
+            break;
 
-        case JSON_API_OPERATOR_NE:
-            return !compare_values_not_null(JSON_API_OPERATOR_EQ, left, right);
+        case JSON_API_OPERATOR_GE:
+            instruction->accepted = STORAGE_OUTCOME_GREATER | STORAGE_OUTCOME_EQUAL | STORAGE_OUTCOME_UNORDERED;
+            break;
 
-        case JSON_API_OPERATOR_LT:
-            switch (left.type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            return left.value._int < right.value._int;
+        default:
+            break; // unreachable
+    }
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            if (left.value._int < 0) {
-                                return true;
-                            }
+    return NULL;
+}
 
-                            return ((uint64_t) left.value._int) < right.value.uint;
+// compiles where against columns of joined table, values are put into program by bind_where; returns error or NULL
+static struct json_object * compile_where(const struct storage_joined_table * table, const struct json_api_where * where,
+        struct where_program * program) {
+    program->amount = where ? count_where_comparisons(where) : 0;
+    program->instructions = malloc(sizeof(struct where_instruction) * program->amount);
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return ((double) left.value._int) < right.value.num;
+    if (!where) {
+        return NULL;
+    }
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+    return compile_where_expr(table, where, program->instructions, 0, WHERE_ACCEPT, WHERE_REJECT);
+}
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            if (right.value._int < 0) {
-                                return false;
-                            }
+static struct json_object * bind_where_expr(const struct storage_joined_table * table, const struct json_api_where * where,
+        struct where_instruction * instructions, unsigned int * position) {
+    switch (where->op) {
+        case JSON_API_OPERATOR_AND:
+        case JSON_API_OPERATOR_OR:
+            {
+                struct json_object * error = bind_where_expr(table, where->left, instructions, position);
+                return error ? error : bind_where_expr(table, where->right, instructions, position);
+            }
 
-                            return left.value.uint < ((uint64_t) right.value._int);
+        default:
+            break;
+    }
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            return left.value.uint < right.value.uint;
+    struct where_instruction * const instruction = &instructions[(*position)++];
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return ((double) left.value.uint) < right.value.num;
+    if (!where->value) {
+        if (where->op != JSON_API_OPERATOR_EQ && where->op != JSON_API_OPERATOR_NE) {
+            return json_api_make_error("NULL value is not comparable");
+        }
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+        instruction->compare = where_compare_any_null;
+        instruction->null_outcome = STORAGE_OUTCOME_EQUAL;
+        return NULL;
+    }
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            return left.value.num < ((double) right.value._int);
+    const enum storage_column_type type = table->tables.tables[instruction->table].table->columns.columns[instruction->column].type;
+    instruction->compare = where_get_comparator(type, where->value->type);
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            return left.value.num < ((double) right.value.uint);
+    if (!instruction->compare) {
+        const char * column_type = storage_column_type_to_string(type);
+        const char * value_type = storage_column_type_to_string(where->value->type);
+        size_t msg_length = 31 + strlen(column_type) + strlen(value_type);
+        char msg[msg_length];
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return left.value.num < right.value.num;
+        snprintf(msg, msg_length, "types %s and %s are not comparable", column_type, value_type);
+        return json_api_make_error(msg);
+    }
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+    instruction->value = *where->value;
+    instruction->null_outcome = STORAGE_OUTCOME_NULL;
+    return NULL;
+}
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                        case STORAGE_COLUMN_TYPE_UINT:
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return false;
+// puts values of where into its compiled program, they must be comparable with their columns;
+// values point into the request and are valid while it is alive, returns error or NULL
+static struct json_object * bind_where(const struct storage_joined_table * table, const struct json_api_where * where,
+        struct where_program * program) {
+    unsigned int position = 0;
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return strcmp(left.value.str, right.value.str) < 0;
-                    }
-            }
+    return where ? bind_where_expr(table, where, program->instructions, &position) : NULL;
+}
 
-        case JSON_API_OPERATOR_GT:
-            switch (left.type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            return left.value._int > right.value._int;
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            if (left.value._int < 0) {
-                                return false;
-                            }
+static bool eval_where(const struct storage_joined_row * row, const struct where_program * program) {
+    int position = program->amount > 0 ? 0 : WHERE_ACCEPT;
 
-                            return ((uint64_t) left.value._int) > right.value.uint;
+    while (position >= 0) {
+        const struct where_instruction * const instruction = &program->instructions[position];
+        struct storage_value * const value = storage_row_get_value(row->rows[instruction->table], instruction->column);
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return ((double) left.value._int) > right.value.num;
+        const uint8_t outcome = value ? instruction->compare(value, &instruction->value) : instruction->null_outcome;
+        storage_value_delete(value);
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+        position = (outcome & instruction->accepted) ? instruction->on_true : instruction->on_false;
+    }
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            if (right.value._int < 0) {
-                                return true;
-                            }
+    return position == WHERE_ACCEPT;
+}
 
-                            return left.value.uint > ((uint64_t) right.value._int);
+static void destroy_where_program(struct where_program program) {
+    free(program.instructions);
+}
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            return left.value.uint > right.value.uint;
+// iterates rows of joined table where program is true: single table is read
+// by parallel scan of batches filtered by whole vectors, joined tables are read row by row
+struct where_scan {
+    struct storage_joined_table * table;
+    const struct where_program * program;
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return ((double) left.value.uint) > right.value.num;
+    bool started;
+    struct storage_joined_row * row;
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+    // vector of batch compared by every instruction
+    uint16_t * vectors;
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                            return left.value.num > ((double) right.value._int);
+    // rows are taken from job by morsels or selected at once
+    struct storage_scan_job * job;
+    struct storage_index_scan * selection;
+    struct storage_index_scan morsel;
 
-                        case STORAGE_COLUMN_TYPE_UINT:
-                            return left.value.num > ((double) right.value.uint);
+    // the current selected row wrapped into joined row
+    struct storage_row * selected_row;
+    struct storage_joined_row selected_joined_row;
+};
 
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return left.value.num > right.value.num;
+// tells whether rows of row group may satisfy program: comparisons are replaced
+// by outcomes possible for cells bounded by zone maps and jumps are followed for both results
+static bool where_scan_may_match(const struct storage_batch * batch, const struct storage_zone * zones, void * context) {
+    const struct where_scan * const scan = context;
+    const struct where_program * const program = scan->program;
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return false;
-                    }
+    if (program->amount == 0) {
+        return true;
+    }
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    switch (right.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                        case STORAGE_COLUMN_TYPE_UINT:
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            return false;
+    bool reachable[program->amount];
+    memset(reachable, 0, sizeof(reachable));
+    reachable[0] = true;
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            return strcmp(left.value.str, right.value.str) > 0;
-                    }
-            }
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        if (!reachable[i]) {
+            continue;
+        }
 
-        case JSON_API_OPERATOR_LE:
-            return !compare_values_not_null(JSON_API_OPERATOR_GT, left, right);
+        const struct where_instruction * const instruction = &program->instructions[i];
+        const bool is_null = instruction->compare == where_compare_any_null;
+        const uint16_t vector = scan->vectors[i];
 
-        case JSON_API_OPERATOR_GE:
-            return !compare_values_not_null(JSON_API_OPERATOR_LT, left, right);
+        const uint8_t outcomes = storage_zone_get_outcomes(&zones[vector], batch->columns.vectors[vector].type,
+            is_null ? NULL : &instruction->value);
 
-        default:
-            return false;
-    }
-}
+        const int targets[] = {
+            (outcomes & instruction->accepted) ? instruction->on_true : WHERE_REJECT,
+            (outcomes & ~instruction->accepted) ? instruction->on_false : WHERE_REJECT,
+        };
 
-static bool compare_values(enum json_api_operator op, struct storage_value * left, struct storage_value * right) {
-    switch (op) {
-        case JSON_API_OPERATOR_EQ:
-            if (left == NULL || right == NULL) {
-                return left == NULL && right == NULL;
+        for (int j = 0; j < 2; ++j) {
+            if (targets[j] == WHERE_ACCEPT) {
+                return true;
             }
 
-            break;
-
-        case JSON_API_OPERATOR_NE:
-            if (left == NULL || right == NULL) {
-                return (left == NULL) != (right == NULL);
+            if (targets[j] >= 0) {
+                reachable[targets[j]] = true;
             }
+        }
+    }
 
-            break;
+    return false;
+}
 
-        case JSON_API_OPERATOR_LT:
-        case JSON_API_OPERATOR_GT:
-        case JSON_API_OPERATOR_LE:
-        case JSON_API_OPERATOR_GE:
-            if (left == NULL || right == NULL) {
-                return false;
-            }
+// selects rows of batch where program is true: every instruction compares
+// whole vector and moves rows waiting on it by its jumps, which only go forward
+static void eval_where_batch(struct storage_batch * batch, void * context) {
+    const struct where_scan * const scan = context;
+    const struct where_program * const program = scan->program;
 
-            break;
+    int positions[STORAGE_BATCH_ROWS];
+    uint8_t result[STORAGE_BATCH_ROWS];
 
-        default:
-            return false;
+    for (uint32_t j = 0; j < batch->amount; ++j) {
+        positions[j] = program->amount > 0 ? 0 : WHERE_ACCEPT;
     }
 
-    return compare_values_not_null(op, *left, *right);
-}
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        const struct where_instruction * const instruction = &program->instructions[i];
+        const bool is_null = instruction->compare == where_compare_any_null;
 
-static bool eval_where(struct storage_joined_row * row, struct json_api_where * where) {
-    uint16_t table_columns_amount = storage_joined_table_get_columns_amount(row->table);
+        storage_batch_compare(batch, scan->vectors[i], is_null ? NULL : &instruction->value, instruction->accepted, result);
 
-    switch (where->op) {
-        case JSON_API_OPERATOR_EQ:
-        case JSON_API_OPERATOR_NE:
-        case JSON_API_OPERATOR_LT:
-        case JSON_API_OPERATOR_GT:
-        case JSON_API_OPERATOR_LE:
-        case JSON_API_OPERATOR_GE:
-            for (unsigned int i = 0; i < table_columns_amount; ++i) {
-                if (strcmp(storage_joined_table_get_column(row->table, i).name, where->column) == 0) {
-                    return compare_values(where->op, storage_joined_row_get_value(row, i), where->value);
-                }
+        for (uint32_t j = 0; j < batch->amount; ++j) {
+            if (positions[j] == (int) i) {
+                positions[j] = result[j] ? instruction->on_true : instruction->on_false;
             }
+        }
+    }
 
-            errno = EINVAL;
-            return false;
-
-        case JSON_API_OPERATOR_AND:
-            return eval_where(row, where->left) && eval_where(row, where->right);
-
-        case JSON_API_OPERATOR_OR:
-            return eval_where(row, where->left) || eval_where(row, where->right);
+    batch->selected = 0;
+    for (uint32_t j = 0; j < batch->amount; ++j) {
+        if (positions[j] == WHERE_ACCEPT) {
+            batch->selection[batch->selected++] = (uint16_t) j;
+        }
     }
 }
 
-static struct json_object * handle_request_delete(struct json_api_delete_request request, struct storage * storage) {
-    struct storage_table * table = storage_find_table(storage, request.table_name);
-
-    if (!table) {
-        return json_api_make_error("table with the specified name is not exists");
+// scan stops after limit rows (0 for no limit), rows of single table are selected
+// at once for modifying requests, since scan threads must not read them while they are written
+static void init_where_scan(struct where_scan * scan, struct storage_joined_table * table,
+        const struct where_program * program, uint64_t limit, bool modifying) {
+    scan->table = table;
+    scan->program = program;
+    scan->started = false;
+    scan->row = NULL;
+    scan->vectors = NULL;
+    scan->job = NULL;
+    scan->selection = NULL;
+    scan->morsel.table = table->tables.tables[0].table;
+    scan->morsel.amount = 0;
+    scan->morsel.rows = NULL;
+    scan->selected_row = NULL;
+
+    if (table->tables.amount > 1) {
+        return;
     }
 
-    struct storage_joined_table * joined_table = storage_joined_table_wrap(table);
+    uint16_t columns_amount = 0;
+    uint16_t * const columns = malloc(sizeof(uint16_t) * program->amount);
+    scan->vectors = malloc(sizeof(uint16_t) * program->amount);
 
-    if (request.where) {
-        struct json_object * error = is_where_correct(joined_table, request.where);
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        const uint16_t column = program->instructions[i].column;
 
-        if (error) {
-            storage_joined_table_delete(joined_table);
-            return error;
+        uint16_t vector = 0;
+        while (vector < columns_amount && columns[vector] != column) {
+            ++vector;
         }
-    }
 
-    unsigned long long amount = 0;
-    for (struct storage_joined_row * row = storage_joined_table_get_first_row(joined_table); row; row = storage_joined_row_next(row)) {
-        if (request.where == NULL || eval_where(row, request.where)) {
-            storage_row_remove(row->rows[0]);
-            ++amount;
+        if (vector == columns_amount) {
+            columns[columns_amount++] = column;
         }
-    }
-
-    storage_joined_table_delete(joined_table);
-    struct json_object * answer = json_object_new_object();
-    json_object_object_add(answer, "amount", json_object_new_uint64(amount));
-    return json_api_make_success(answer);
-}
 
-static struct json_object * handle_request_select(struct json_api_select_request request, struct storage * storage) {
-    if (request.limit > 1000) {
-        return json_api_make_error("limit is too high");
+        scan->vectors[i] = vector;
     }
 
-    struct storage_table * table = storage_find_table(storage, request.table_name);
+    if (modifying) {
+        scan->selection = storage_table_select(table->tables.tables[0].table, table->tables.tables[0].scan,
+            columns_amount, columns, where_scan_may_match, eval_where_batch, scan, limit);
 
-    if (!table) {
-        return json_api_make_error("table with the specified name is not exists");
+        scan->morsel = *scan->selection;
+    } else {
+        scan->job = storage_table_scan_parallel(table->tables.tables[0].table, table->tables.tables[0].scan,
+            columns_amount, columns, where_scan_may_match, eval_where_batch, scan, limit);
     }
 
-    struct storage_joined_table * joined_table = storage_joined_table_new(request.joins.amount + 1);
-    joined_table->tables.tables[0].table = table;
-    joined_table->tables.tables[0].t_column_index = 0;
-    joined_table->tables.tables[0].s_column_index = 0;
+    free(columns);
 
-    for (int i = 0; i < request.joins.amount; ++i) {
-        joined_table->tables.tables[i + 1].table = storage_find_table(storage, request.joins.joins[i].table);
+    scan->selected_joined_row.table = table;
+    scan->selected_joined_row.rows = &scan->selected_row;
+    scan->selected_joined_row.matches = NULL;
+}
 
-        if (!joined_table->tables.tables[i + 1].table) {
-            storage_joined_table_delete(joined_table);
-            return json_api_make_error("table with the specified name is not exists");
+// returned row is valid until the next call
+static struct storage_joined_row * where_scan_next(struct where_scan * scan) {
+    if (scan->table->tables.amount > 1) {
+        if (!scan->started) {
+            scan->started = true;
+            scan->row = storage_joined_table_get_first_row(scan->table);
+        } else if (scan->row) {
+            scan->row = storage_joined_row_next(scan->row);
         }
 
-        joined_table->tables.tables[i + 1].t_column_index = (uint16_t) -1;
-        for (int j = 0; j < joined_table->tables.tables[i + 1].table->columns.amount; ++j) {
-            if (strcmp(request.joins.joins[i].t_column, joined_table->tables.tables[i + 1].table->columns.columns[j].name) == 0) {
-                joined_table->tables.tables[i + 1].t_column_index = j;
-                break;
-            }
+        while (scan->row && !eval_where(scan->row, scan->program)) {
+            scan->row = storage_joined_row_next(scan->row);
         }
 
-        if (joined_table->tables.tables[i + 1].t_column_index >= joined_table->tables.tables[i + 1].table->columns.amount) {
-            storage_joined_table_delete(joined_table);
-            return json_api_make_error("column with the specified name is not exists in table");
-        }
+        return scan->row;
+    }
 
-        uint16_t slice_columns = 0;
-        joined_table->tables.tables[i + 1].s_column_index = (uint16_t) -1;
-        for (int tbl_index = 0, col_index = 0; tbl_index <= i; ++tbl_index) {
-            for (int tbl_col_index = 0; tbl_col_index < joined_table->tables.tables[tbl_index].table->columns.amount; ++tbl_col_index, ++col_index) {
-                if (strcmp(request.joins.joins[i].s_column, joined_table->tables.tables[tbl_index].table->columns.columns[tbl_col_index].name) == 0) {
-                    joined_table->tables.tables[i + 1].s_column_index = col_index;
-                    break;
+    if (!scan->started) {
+        scan->started = true;
+        scan->selected_row = storage_index_scan_get_first_row(&scan->morsel);
+    } else if (scan->selected_row) {
+        scan->selected_row = storage_row_next(scan->selected_row);
+    }
+
+    while (!scan->selected_row && scan->job && storage_scan_job_next(scan->job, &scan->morsel)) {
+        scan->selected_row = storage_index_scan_get_first_row(&scan->morsel);
+    }
+
+    return scan->selected_row ? &scan->selected_joined_row : NULL;
+}
+
+static void destroy_where_scan(struct where_scan * scan) {
+    storage_joined_row_delete(scan->row);
+    storage_row_delete(scan->selected_row);
+    storage_scan_job_delete(scan->job);
+    storage_index_scan_delete(scan->selection);
+    free(scan->vectors);
+}
+
+// returns indexed column of the first table compared with a value in conjunction of where,
+// position is of the first comparison of where in its compiled program
+static int find_indexed_column(const struct storage_joined_table * table, const struct json_api_where * where,
+    const struct where_program * program, unsigned int position) {
+    switch (where->op) {
+        case JSON_API_OPERATOR_EQ:
+        case JSON_API_OPERATOR_LT:
+        case JSON_API_OPERATOR_GT:
+        case JSON_API_OPERATOR_LE:
+        case JSON_API_OPERATOR_GE:
+            {
+                const struct where_instruction * const instruction = &program->instructions[position];
+
+                if (where->value && instruction->table == 0 && storage_table_has_index(table->tables.tables[0].table, instruction->column)) {
+                    return instruction->column;
                 }
+
+                return -1;
             }
 
-            slice_columns += joined_table->tables.tables[tbl_index].table->columns.amount;
-            if (joined_table->tables.tables[i + 1].s_column_index < slice_columns) {
-                break;
+        case JSON_API_OPERATOR_AND:
+            {
+                const int column = find_indexed_column(table, where->left, program, position);
+
+                return column >= 0 ? column
+                    : find_indexed_column(table, where->right, program, position + count_where_comparisons(where->left));
             }
-        }
 
-        if (joined_table->tables.tables[i + 1].s_column_index >= slice_columns) {
-            storage_joined_table_delete(joined_table);
-            return json_api_make_error("column with the specified name is not exists in the join slice");
-        }
+        default:
+            return -1;
     }
+}
 
-    if (request.where) {
-        struct json_object * error = is_where_correct(joined_table, request.where);
+struct index_bound {
+    const struct storage_value * value;
+    bool inclusive;
+};
 
-        if (error) {
-            storage_joined_table_delete(joined_table);
-            return error;
+// keeps the tighter bound, direction is 1 for low bound and -1 for high bound
+static void set_index_bound(struct index_bound * bound, const struct storage_value * value, bool inclusive, int direction) {
+    if (bound->value) {
+        const int result = storage_value_compare(value, bound->value) * direction;
+
+        if (result < 0 || (result == 0 && inclusive)) {
+            return;
         }
     }
 
+    bound->value = value;
+    bound->inclusive = inclusive;
+}
+
+static void narrow_index_bounds(const struct json_api_where * where, const struct where_program * program, unsigned int position,
+    int column, struct index_bound * low, struct index_bound * high) {
+    if (where->op == JSON_API_OPERATOR_AND) {
+        narrow_index_bounds(where->left, program, position, column, low, high);
+        narrow_index_bounds(where->right, program, position + count_where_comparisons(where->left), column, low, high);
+        return;
+    }
+
+    if (where->op == JSON_API_OPERATOR_OR || !where->value) {
+        return;
+    }
+
+    const struct where_instruction * const instruction = &program->instructions[position];
+
+    if (instruction->table != 0 || instruction->column != column) {
+        return;
+    }
+
+    switch (where->op) {
+        case JSON_API_OPERATOR_EQ:
+            set_index_bound(low, where->value, true, 1);
+            set_index_bound(high, where->value, true, -1);
+            break;
+
+        case JSON_API_OPERATOR_LT:
+            set_index_bound(high, where->value, false, -1);
+            break;
+
+        case JSON_API_OPERATOR_GT:
+            set_index_bound(low, where->value, false, 1);
+            break;
+
+        case JSON_API_OPERATOR_LE:
+            set_index_bound(high, where->value, true, -1);
+            break;
+
+        case JSON_API_OPERATOR_GE:
+            set_index_bound(low, where->value, true, 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// makes the first table iterated by index if where limits its indexed column,
+// where is still evaluated for every found row; columns are taken from its compiled program
+static void use_index(struct storage_joined_table * table, const struct json_api_where * where, const struct where_program * program) {
+    if (!where) {
+        return;
+    }
+
+    const int column = find_indexed_column(table, where, program, 0);
+
+    if (column < 0) {
+        return;
+    }
+
+    struct index_bound low = { NULL, false }, high = { NULL, false };
+    narrow_index_bounds(where, program, 0, column, &low, &high);
+
+    table->tables.tables[0].scan = storage_table_index_scan(table->tables.tables[0].table, column,
+        low.value, low.inclusive, high.value, high.inclusive);
+}
+
+// request resolved against tables of the schema: tables and columns are found by names
+// and where is compiled once, so execute of prepared statement only binds values to it
+struct request_plan {
+    struct storage_joined_table * table;
+
+    // selected or modified columns, keys of selected columns for aggregated select
     unsigned int columns_amount;
     unsigned int * columns_indexes;
 
-    {
-        struct json_object * error = map_columns_to_indexes(request.columns.amount, request.columns.columns,
-            joined_table, &columns_amount, &columns_indexes);
+    struct where_program where;
+
+    // ordered select: columns of orders; orders of sorted rows or groups
+    unsigned int * orders_indexes;
+    struct sort_key * orders;
+
+    // aggregated select: grouped columns, functions of selected aggregates and then of orders,
+    // columns of their arguments (-1 for all rows)
+    unsigned int keys_amount;
+    unsigned int * keys_indexes;
+    unsigned int functions_amount;
+    enum aggregate_function * functions;
+    int * arguments_indexes;
+};
+
+// requests which are resolved into plans, so they can be prepared
+union planned_request {
+    struct json_api_insert_request insert;
+    struct json_api_delete_request delete;
+    struct json_api_select_request select;
+    struct json_api_update_request update;
+};
+
+static void init_request_plan(struct request_plan * plan) {
+    plan->table = NULL;
+    plan->columns_amount = 0;
+    plan->columns_indexes = NULL;
+    plan->where.amount = 0;
+    plan->where.instructions = NULL;
+    plan->orders_indexes = NULL;
+    plan->orders = NULL;
+    plan->keys_amount = 0;
+    plan->keys_indexes = NULL;
+    plan->functions_amount = 0;
+    plan->functions = NULL;
+    plan->arguments_indexes = NULL;
+}
+
+// tables of plan are kept by catalog, plan of prepared statement may outlive them
+static void destroy_request_plan(struct request_plan * plan) {
+    if (plan->table) {
+        for (int i = 0; i < plan->table->tables.amount; ++i) {
+            plan->table->tables.tables[i].table = NULL;
+        }
+    }
+
+    storage_joined_table_delete(plan->table);
+    free(plan->columns_indexes);
+    destroy_where_program(plan->where);
+    free(plan->orders_indexes);
+    free(plan->orders);
+    free(plan->keys_indexes);
+    free(plan->functions);
+    free(plan->arguments_indexes);
+}
+
+static struct json_object * resolve_insert(struct json_api_insert_request request, struct storage * storage, struct request_plan * plan) {
+    struct storage_table * table = storage_find_table(storage, request.table_name);
+
+    if (!table) {
+        return json_api_make_error("table with the specified name is not exists");
+    }
+
+    plan->table = storage_joined_table_wrap(table);
+
+    return map_columns_to_indexes(request.columns.amount, request.columns.columns,
+        plan->table, &plan->columns_amount, &plan->columns_indexes);
+}
+
+static struct json_object * run_insert(struct json_api_insert_request request, struct request_plan * plan) {
+    struct storage_table * const table = plan->table->tables.tables[0].table;
+
+    for (unsigned int i = 0; i < request.rows.amount; ++i) {
+        struct json_object * error = check_values(request.rows.rows[i].amount, request.rows.rows[i].values,
+            table, plan->columns_amount, plan->columns_indexes);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    // cells of columns that are not in request are NULL
+    const struct storage_value ** const cells = calloc((size_t) request.rows.amount * table->columns.amount, sizeof(*cells));
+
+    for (unsigned int i = 0; i < request.rows.amount; ++i) {
+        for (unsigned int j = 0; j < plan->columns_amount; ++j) {
+            cells[(size_t) i * table->columns.amount + plan->columns_indexes[j]] = request.rows.rows[i].values[j];
+        }
+    }
+
+    storage_table_add_rows(table, request.rows.amount, cells);
+
+    free(cells);
+
+    struct json_object * answer = json_object_new_object();
+    json_object_object_add(answer, "amount", json_object_new_uint64(request.rows.amount));
+    return json_api_make_success(answer);
+}
+
+static struct json_object * resolve_delete(struct json_api_delete_request request, struct storage * storage, struct request_plan * plan) {
+    struct storage_table * table = storage_find_table(storage, request.table_name);
+
+    if (!table) {
+        return json_api_make_error("table with the specified name is not exists");
+    }
+
+    plan->table = storage_joined_table_wrap(table);
+    return compile_where(plan->table, request.where, &plan->where);
+}
+
+static struct json_object * run_delete(struct json_api_delete_request request, struct request_plan * plan) {
+    {
+        struct json_object * error = bind_where(plan->table, request.where, &plan->where);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    use_index(plan->table, request.where, &plan->where);
+
+    struct where_scan scan;
+    init_where_scan(&scan, plan->table, &plan->where, 0, true);
+
+    unsigned long long amount = 0;
+    for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+        storage_row_remove(row->rows[0]);
+        ++amount;
+    }
+
+    destroy_where_scan(&scan);
+    struct json_object * answer = json_object_new_object();
+    json_object_object_add(answer, "amount", json_object_new_uint64(amount));
+    return json_api_make_success(answer);
+}
+
+// joins tables of select request, returns error or NULL
+static struct json_object * resolve_select_table(struct json_api_select_request request, struct storage * storage,
+        struct request_plan * plan) {
+    struct storage_table * table = storage_find_table(storage, request.table_name);
+
+    if (!table) {
+        return json_api_make_error("table with the specified name is not exists");
+    }
+
+    struct storage_joined_table * joined_table = storage_joined_table_new(request.joins.amount + 1);
+    joined_table->tables.tables[0].table = table;
+    joined_table->tables.tables[0].t_column_index = 0;
+    joined_table->tables.tables[0].s_column_index = 0;
+
+    plan->table = joined_table;
+
+    for (int i = 0; i < request.joins.amount; ++i) {
+        joined_table->tables.tables[i + 1].table = storage_find_table(storage, request.joins.joins[i].table);
+
+        if (!joined_table->tables.tables[i + 1].table) {
+            return json_api_make_error("table with the specified name is not exists");
+        }
+
+        joined_table->tables.tables[i + 1].t_column_index =
+            (uint16_t) storage_table_find_column(joined_table->tables.tables[i + 1].table, request.joins.joins[i].t_column);
+
+        if (joined_table->tables.tables[i + 1].t_column_index >= joined_table->tables.tables[i + 1].table->columns.amount) {
+            return json_api_make_error("column with the specified name is not exists in table");
+        }
+
+        uint16_t slice_columns = 0;
+        joined_table->tables.tables[i + 1].s_column_index = (uint16_t) -1;
+        for (int tbl_index = 0; tbl_index <= i; ++tbl_index) {
+            const int index = storage_table_find_column(joined_table->tables.tables[tbl_index].table, request.joins.joins[i].s_column);
+
+            if (index >= 0) {
+                joined_table->tables.tables[i + 1].s_column_index = slice_columns + index;
+            }
+
+            slice_columns += joined_table->tables.tables[tbl_index].table->columns.amount;
+            if (joined_table->tables.tables[i + 1].s_column_index < slice_columns) {
+                break;
+            }
+        }
+
+        if (joined_table->tables.tables[i + 1].s_column_index >= slice_columns) {
+            return json_api_make_error("column with the specified name is not exists in the join slice");
+        }
+    }
+
+    return NULL;
+}
+
+
+// makes answer object with names of columns
+static struct json_object * make_select_answer(const struct storage_joined_table * table, unsigned int columns_amount,
+        const unsigned int * columns_indexes) {
+    struct json_object * answer = json_object_new_object();
+    struct json_object * columns = json_object_new_array_ext((int) columns_amount);
+
+    for (unsigned int i = 0; i < columns_amount; ++i) {
+        json_object_array_add(columns, json_object_new_string(storage_joined_table_get_column(table, columns_indexes[i]).name));
+    }
+
+    json_object_object_add(answer, "columns", columns);
+    return answer;
+}
+
+static struct json_object * make_select_row(const struct storage_joined_row * row, unsigned int columns_amount,
+        const unsigned int * columns_indexes) {
+    struct json_object * values_row = json_object_new_array_ext((int) columns_amount);
+
+    for (unsigned int i = 0; i < columns_amount; ++i) {
+        json_object_array_add(values_row, json_api_from_value(storage_joined_row_get_value(row, columns_indexes[i])));
+    }
+
+    return values_row;
+}
+
+// select kept between fetches of its cursor: scan of joined table is resumed by every fetch
+// while rows of its tables are not removed or moved (see storage_table_get_version)
+struct select_cursor {
+    struct storage_joined_table * table;
+    uint64_t * versions;
+
+    unsigned int columns_amount;
+    unsigned int * columns_indexes;
+
+    struct where_program where;
+    struct where_scan scan;
+
+    uint64_t to_skip;
+    uint64_t left;
+};
+
+static void destroy_select_cursor(void * state) {
+    struct select_cursor * const cursor = state;
+
+    for (unsigned int i = 0; i < cursor->where.amount; ++i) {
+        if (cursor->where.instructions[i].compare == where_compare_str_str) {
+            free(cursor->where.instructions[i].value.value.str);
+        }
+    }
+
+    destroy_where_scan(&cursor->scan);
+    destroy_where_program(cursor->where);
+    free(cursor->columns_indexes);
+    free(cursor->versions);
+    storage_joined_table_delete(cursor->table);
+    free(cursor);
+}
+
+// declares cursor of select, its rows are taken by fetches from offset up to limit (no limit by default);
+// cursor takes joined table, columns and where of the plan and copies strings of where, since it outlives the request
+static struct json_object * declare_select_cursor(struct json_api_select_request request, struct request_plan * plan) {
+    struct select_cursor * const cursor = malloc(sizeof(*cursor));
+    cursor->table = plan->table;
+    cursor->versions = malloc(sizeof(uint64_t) * plan->table->tables.amount);
+    cursor->columns_amount = plan->columns_amount;
+    cursor->columns_indexes = plan->columns_indexes;
+    cursor->where = plan->where;
+    cursor->to_skip = request.offset;
+    cursor->left = request.has_limit ? request.limit : UINT64_MAX;
+
+    plan->table = NULL;
+    plan->columns_indexes = NULL;
+    plan->where.amount = 0;
+    plan->where.instructions = NULL;
+
+    for (int i = 0; i < cursor->table->tables.amount; ++i) {
+        cursor->versions[i] = storage_table_get_version(cursor->table->tables.tables[i].table);
+    }
+
+    for (unsigned int i = 0; i < cursor->where.amount; ++i) {
+        if (cursor->where.instructions[i].compare == where_compare_str_str) {
+            cursor->where.instructions[i].value.value.str = strdup(cursor->where.instructions[i].value.value.str);
+        }
+    }
+
+    init_where_scan(&cursor->scan, cursor->table, &cursor->where,
+        cursor->left < UINT64_MAX - cursor->to_skip ? cursor->to_skip + cursor->left : 0, false);
+
+    // scan threads must not read tables after the request
+    if (cursor->scan.job) {
+        storage_scan_job_pause(cursor->scan.job);
+    }
+
+    struct json_object * answer = json_object_new_object();
+    json_object_object_add(answer, "cursor", json_object_new_uint64(cursors_add(cursors, cursor)));
+    return json_api_make_success(answer);
+}
+
+static const char * const aggregate_functions_names[] = {"count", "sum", "min", "max", "avg"};
+
+// checks aggregates, puts indexes of their columns (-1 for all rows), returns error or NULL
+static struct json_object * map_aggregates_to_indexes(unsigned int aggregates_amount, const struct json_api_aggregate * aggregates,
+        const struct storage_joined_table * table, int ** indexes) {
+    *indexes = malloc(sizeof(int) * (aggregates_amount + 1));
+
+    for (unsigned int i = 0; i < aggregates_amount; ++i) {
+        const enum json_api_function function = aggregates[i].function;
+        const char * const column = aggregates[i].column;
+
+        if ((unsigned int) function > JSON_API_FUNCTION_AVG) {
+            return json_api_make_error("bad aggregate function");
+        }
+
+        if (!column) {
+            if (function != JSON_API_FUNCTION_COUNT) {
+                return json_api_make_error("only count can be applied to all rows");
+            }
+
+            (*indexes)[i] = -1;
+            continue;
+        }
+
+        (*indexes)[i] = storage_joined_table_find_column(table, column);
+
+        if ((*indexes)[i] < 0) {
+            return json_api_make_error("column with the specified name is not exists in table");
+        }
+
+        if ((function == JSON_API_FUNCTION_SUM || function == JSON_API_FUNCTION_AVG)
+                && storage_joined_table_get_column(table, (uint16_t) (*indexes)[i]).type == STORAGE_COLUMN_TYPE_STR) {
+            return json_api_make_error("sum and avg can not be applied to strings");
+        }
+    }
+
+    return NULL;
+}
+
+static bool is_same_aggregate(const struct json_api_aggregate * a, const struct json_api_aggregate * b) {
+    if (a->function != b->function || !a->column != !b->column) {
+        return false;
+    }
+
+    return !a->column || strcmp(a->column, b->column) == 0;
+}
+
+// maps orders of select to columns of joined table, returns error or NULL
+static struct json_object * map_orders_to_indexes(struct json_api_select_request request,
+        const struct storage_joined_table * table, unsigned int ** indexes) {
+    *indexes = malloc(sizeof(unsigned int) * (request.order_by.amount + 1));
+
+    for (unsigned int i = 0; i < request.order_by.amount; ++i) {
+        const struct json_api_order * const order = &request.order_by.orders[i];
+
+        if (!order->column == !order->aggregate) {
+            return json_api_make_error("order must have either column or aggregate");
+        }
+
+        if (order->aggregate) {
+            return json_api_make_error("only aggregated rows can be ordered by aggregates");
+        }
+
+        const int index = storage_joined_table_find_column(table, order->column);
+
+        if (index < 0) {
+            return json_api_make_error("column with the specified name is not exists in table");
+        }
+
+        (*indexes)[i] = (unsigned int) index;
+    }
+
+    return NULL;
+}
+
+// maps orders of aggregated select to columns of group (keys and then aggregates),
+// aggregates of orders which are not selected are added to aggregates, returns error or NULL
+static struct json_object * map_aggregated_orders(struct json_api_select_request request, const struct storage_joined_table * table,
+        unsigned int keys_amount, const unsigned int * keys_indexes, unsigned int * aggregates_amount,
+        struct json_api_aggregate * aggregates, struct sort_key * orders) {
+    for (unsigned int i = 0; i < request.order_by.amount; ++i) {
+        const struct json_api_order * const order = &request.order_by.orders[i];
+        orders[i].descending = order->descending;
+
+        if (!order->column == !order->aggregate) {
+            return json_api_make_error("order must have either column or aggregate");
+        }
+
+        if (order->aggregate) {
+            unsigned int index = 0;
+            while (index < *aggregates_amount && !is_same_aggregate(&aggregates[index], order->aggregate)) {
+                ++index;
+            }
+
+            if (index == *aggregates_amount) {
+                aggregates[(*aggregates_amount)++] = *order->aggregate;
+            }
+
+            orders[i].column = keys_amount + index;
+            continue;
+        }
+
+        const int index = storage_joined_table_find_column(table, order->column);
+
+        orders[i].column = keys_amount;
+        for (unsigned int j = 0; j < keys_amount; ++j) {
+            if (keys_indexes[j] == index) {
+                orders[i].column = j;
+                break;
+            }
+        }
+
+        if (orders[i].column == keys_amount) {
+            return json_api_make_error("only grouped columns can order aggregated rows");
+        }
+    }
+
+    return NULL;
+}
+
+// makes answer object with names of selected grouped columns and then names of aggregates, such as sum(price)
+static struct json_object * make_aggregated_answer(struct json_api_select_request request, const struct storage_joined_table * table,
+        unsigned int columns_amount, const unsigned int * columns_keys, const unsigned int * keys_indexes) {
+    struct json_object * answer = json_object_new_object();
+    struct json_object * columns = json_object_new_array_ext((int) (columns_amount + request.aggregates.amount));
+
+    for (unsigned int i = 0; i < columns_amount; ++i) {
+        json_object_array_add(columns, json_object_new_string(storage_joined_table_get_column(table, keys_indexes[columns_keys[i]]).name));
+    }
+
+    for (unsigned int i = 0; i < request.aggregates.amount; ++i) {
+        const char * const function = aggregate_functions_names[request.aggregates.aggregates[i].function];
+        const char * const column = request.aggregates.aggregates[i].column ? request.aggregates.aggregates[i].column : "*";
+
+        const size_t length = strlen(function) + strlen(column) + 3;
+        char name[length];
+        snprintf(name, length, "%s(%s)", function, column);
+
+        json_object_array_add(columns, json_object_new_string(name));
+    }
+
+    json_object_object_add(answer, "columns", columns);
+    return answer;
+}
+
+// maps grouped columns, selected columns, aggregates and orders of aggregated select, returns error or NULL
+static struct json_object * resolve_select_aggregated(struct json_api_select_request request, struct request_plan * plan) {
+    if (request.group_by.amount > 0) {
+        struct json_object * error = map_columns_to_indexes(request.group_by.amount, request.group_by.columns,
+            plan->table, &plan->keys_amount, &plan->keys_indexes);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    plan->columns_amount = request.columns.amount > 0 ? request.columns.amount : plan->keys_amount;
+    plan->columns_indexes = malloc(sizeof(unsigned int) * (plan->columns_amount + 1));
+
+    for (unsigned int i = 0; i < plan->columns_amount; ++i) {
+        const int index = request.columns.amount > 0
+            ? storage_joined_table_find_column(plan->table, request.columns.columns[i]) : (int) plan->keys_indexes[i];
+
+        plan->columns_indexes[i] = plan->keys_amount;
+        for (unsigned int j = 0; j < plan->keys_amount; ++j) {
+            if (plan->keys_indexes[j] == index) {
+                plan->columns_indexes[i] = j;
+                break;
+            }
+        }
+
+        if (plan->columns_indexes[i] == plan->keys_amount) {
+            return json_api_make_error("only grouped columns can be selected with aggregates");
+        }
+    }
+
+    // selected aggregates and then aggregates of orders
+    unsigned int aggregates_amount = request.aggregates.amount;
+    struct json_api_aggregate * const aggregates = malloc(sizeof(struct json_api_aggregate)
+        * (request.aggregates.amount + request.order_by.amount + 1));
+    memcpy(aggregates, request.aggregates.aggregates, sizeof(struct json_api_aggregate) * request.aggregates.amount);
+
+    plan->orders = malloc(sizeof(struct sort_key) * (request.order_by.amount + 1));
+
+    struct json_object * error = map_aggregated_orders(request, plan->table, plan->keys_amount, plan->keys_indexes,
+        &aggregates_amount, aggregates, plan->orders);
+
+    if (!error) {
+        error = map_aggregates_to_indexes(aggregates_amount, aggregates, plan->table, &plan->arguments_indexes);
+    }
+
+    // functions of api have the same values
+    plan->functions_amount = aggregates_amount;
+    plan->functions = malloc(sizeof(enum aggregate_function) * (aggregates_amount + 1));
+    for (unsigned int i = 0; i < aggregates_amount; ++i) {
+        plan->functions[i] = (enum aggregate_function) aggregates[i].function;
+    }
+
+    free(aggregates);
+    return error;
+}
+
+// aggregated select returns a row for each group of rows with the same values of grouped columns
+// (one group of every row without them): selected columns, which must be grouped ones (all of them by default),
+// and then aggregates of the group; groups are aggregated by hash in bounded memory (see aggregate.h)
+// and sorted after that when they are ordered
+static struct json_object * run_select_aggregated(struct json_api_select_request request, struct request_plan * plan) {
+    // count of all rows counts a value that is never NULL
+    static struct storage_value row_argument = { .type = STORAGE_COLUMN_TYPE_UINT };
+
+    const unsigned int keys_amount = plan->keys_amount;
+    const unsigned int functions_amount = plan->functions_amount;
+    const unsigned int group_size = keys_amount + functions_amount;
+
+    struct aggregate * const aggregate = aggregate_new(keys_amount, functions_amount, plan->functions, memory_budget);
+    struct storage_value ** const group = malloc(sizeof(struct storage_value *) * (group_size + 1));
+
+    {
+        struct where_scan scan;
+        init_where_scan(&scan, plan->table, &plan->where, 0, false);
+
+        for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+            for (unsigned int i = 0; i < keys_amount; ++i) {
+                group[i] = storage_joined_row_get_value(row, plan->keys_indexes[i]);
+            }
+
+            for (unsigned int i = 0; i < functions_amount; ++i) {
+                group[keys_amount + i] = plan->arguments_indexes[i] < 0 ? &row_argument
+                    : storage_joined_row_get_value(row, (uint16_t) plan->arguments_indexes[i]);
+            }
+
+            aggregate_add(aggregate, group, group + keys_amount);
+
+            for (unsigned int i = 0; i < group_size; ++i) {
+                if (group[i] != &row_argument) {
+                    storage_value_delete(group[i]);
+                }
+            }
+        }
+
+        destroy_where_scan(&scan);
+    }
+
+    struct sort * sort = NULL;
+
+    if (request.order_by.amount > 0) {
+        sort = sort_new(group_size, request.order_by.amount, plan->orders, (size_t) request.offset + request.limit, memory_budget);
+
+        while (aggregate_next(aggregate, group)) {
+            sort_add(sort, group);
+
+            for (unsigned int i = 0; i < group_size; ++i) {
+                storage_value_delete(group[i]);
+            }
+        }
+    }
+
+    struct json_object * answer = make_aggregated_answer(request, plan->table, plan->columns_amount,
+        plan->columns_indexes, plan->keys_indexes);
+
+    {
+        struct json_object * values = json_object_new_array_ext((int) request.limit);
+
+        unsigned int offset = 0, amount = 0;
+        while (amount < request.limit && (sort ? sort_next(sort, group) : aggregate_next(aggregate, group))) {
+            if (offset < request.offset) {
+                ++offset;
+            } else {
+                struct json_object * values_row = json_object_new_array_ext((int) (plan->columns_amount + request.aggregates.amount));
+
+                for (unsigned int i = 0; i < plan->columns_amount; ++i) {
+                    json_object_array_add(values_row, json_api_from_value(group[plan->columns_indexes[i]]));
+                }
+
+                for (unsigned int i = 0; i < request.aggregates.amount; ++i) {
+                    json_object_array_add(values_row, json_api_from_value(group[keys_amount + i]));
+                }
+
+                json_object_array_add(values, values_row);
+                ++amount;
+            }
+
+            for (unsigned int i = 0; i < group_size; ++i) {
+                storage_value_delete(group[i]);
+            }
+        }
+
+        json_object_object_add(answer, "values", values);
+    }
+
+    if (sort) {
+        sort_delete(sort);
+    }
+
+    free(group);
+    aggregate_delete(aggregate);
+    return json_api_make_success(answer);
+}
+
+// rows of ordered select are values of selected columns and then values of orders, returns error or NULL
+static struct json_object * resolve_select_ordered(struct json_api_select_request request, struct request_plan * plan) {
+    {
+        struct json_object * error = map_orders_to_indexes(request, plan->table, &plan->orders_indexes);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    plan->orders = malloc(sizeof(struct sort_key) * (request.order_by.amount + 1));
+    for (unsigned int i = 0; i < request.order_by.amount; ++i) {
+        plan->orders[i].column = plan->columns_amount + i;
+        plan->orders[i].descending = request.order_by.orders[i].descending;
+    }
+
+    return NULL;
+}
+
+// ordered select sorts all rows of where, only the first rows of offset and limit are kept (see sort.h)
+static struct json_object * run_select_ordered(struct json_api_select_request request, struct request_plan * plan) {
+    const unsigned int columns_amount = plan->columns_amount;
+    const unsigned int orders_amount = request.order_by.amount;
+    const unsigned int row_size = columns_amount + orders_amount;
+
+    struct sort * const sort = sort_new(row_size, orders_amount, plan->orders, (size_t) request.offset + request.limit, memory_budget);
+    struct storage_value ** const values = malloc(sizeof(struct storage_value *) * (row_size + 1));
+
+    {
+        struct where_scan scan;
+        init_where_scan(&scan, plan->table, &plan->where, 0, false);
+
+        for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+            for (unsigned int i = 0; i < columns_amount; ++i) {
+                values[i] = storage_joined_row_get_value(row, plan->columns_indexes[i]);
+            }
+
+            for (unsigned int i = 0; i < orders_amount; ++i) {
+                values[columns_amount + i] = storage_joined_row_get_value(row, plan->orders_indexes[i]);
+            }
+
+            sort_add(sort, values);
+
+            for (unsigned int i = 0; i < row_size; ++i) {
+                storage_value_delete(values[i]);
+            }
+        }
+
+        destroy_where_scan(&scan);
+    }
+
+    struct json_object * answer = make_select_answer(plan->table, columns_amount, plan->columns_indexes);
+
+    {
+        struct json_object * rows = json_object_new_array_ext((int) request.limit);
+
+        unsigned int offset = 0, amount = 0;
+        while (amount < request.limit && sort_next(sort, values)) {
+            if (offset < request.offset) {
+                ++offset;
+            } else {
+                struct json_object * values_row = json_object_new_array_ext((int) columns_amount);
+
+                for (unsigned int i = 0; i < columns_amount; ++i) {
+                    json_object_array_add(values_row, json_api_from_value(values[i]));
+                }
+
+                json_object_array_add(rows, values_row);
+                ++amount;
+            }
+
+            for (unsigned int i = 0; i < row_size; ++i) {
+                storage_value_delete(values[i]);
+            }
+        }
+
+        json_object_object_add(answer, "values", rows);
+    }
+
+    free(values);
+    sort_delete(sort);
+    return json_api_make_success(answer);
+}
+
+static struct json_object * resolve_select(struct json_api_select_request request, struct storage * storage, struct request_plan * plan) {
+    if (!request.cursor && request.limit > 1000) {
+        return json_api_make_error("limit is too high");
+    }
+
+    if (request.cursor && (request.aggregates.amount > 0 || request.group_by.amount > 0)) {
+        return json_api_make_error("aggregated rows can not be fetched by cursor");
+    }
+
+    if (request.cursor && request.order_by.amount > 0) {
+        return json_api_make_error("ordered rows can not be fetched by cursor");
+    }
+
+    {
+        struct json_object * error = resolve_select_table(request, storage, plan);
+
+        if (!error) {
+            error = compile_where(plan->table, request.where, &plan->where);
+        }
+
+        if (error) {
+            return error;
+        }
+    }
+
+    if (request.aggregates.amount > 0 || request.group_by.amount > 0) {
+        return resolve_select_aggregated(request, plan);
+    }
+
+    {
+        struct json_object * error = map_columns_to_indexes(request.columns.amount, request.columns.columns,
+            plan->table, &plan->columns_amount, &plan->columns_indexes);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    if (request.order_by.amount > 0) {
+        return resolve_select_ordered(request, plan);
+    }
+
+    return NULL;
+}
+
+static struct json_object * run_select(struct json_api_select_request request, struct request_plan * plan) {
+    {
+        struct json_object * error = bind_where(plan->table, request.where, &plan->where);
+
+        if (error) {
+            return error;
+        }
+    }
+
+    use_index(plan->table, request.where, &plan->where);
+
+    if (request.aggregates.amount > 0 || request.group_by.amount > 0) {
+        return run_select_aggregated(request, plan);
+    }
+
+    if (request.cursor) {
+        return declare_select_cursor(request, plan);
+    }
+
+    if (request.order_by.amount > 0) {
+        return run_select_ordered(request, plan);
+    }
+
+    struct json_object * answer = make_select_answer(plan->table, plan->columns_amount, plan->columns_indexes);
+
+    {
+        struct json_object * values = json_object_new_array_ext((int) request.limit);
+
+        struct where_scan scan;
+        init_where_scan(&scan, plan->table, &plan->where, (uint64_t) request.offset + request.limit, false);
+
+        unsigned int offset = 0, amount = 0;
+        for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+            if (offset < request.offset) {
+                ++offset;
+                continue;
+            }
+
+            if (amount == request.limit) {
+                break;
+            }
+
+            json_object_array_add(values, make_select_row(row, plan->columns_amount, plan->columns_indexes));
+            ++amount;
+        }
+
+        json_object_object_add(answer, "values", values);
+
+        destroy_where_scan(&scan);
+    }
+
+    return json_api_make_success(answer);
+}
+
+// locks tables of cursor for the request, returns false when their rows are removed or moved since declaration
+static bool lock_select_cursor(struct select_cursor * cursor, struct storage * storage) {
+    bool actual = true;
+
+    for (int i = 0; i < cursor->table->tables.amount; ++i) {
+        struct storage_table * const table = storage_find_table(storage, cursor->table->tables.tables[i].table->name);
+
+        actual = actual && table && storage_table_get_version(table) == cursor->versions[i];
+    }
+
+    return actual;
+}
+
+// fetch resumes scan of cursor where the previous one stopped
+static struct json_object * handle_request_fetch(struct json_api_fetch_request request, struct storage * storage) {
+    if (request.amount > 1000) {
+        return json_api_make_error("amount is too high");
+    }
+
+    struct select_cursor * const cursor = cursors_take(cursors, request.cursor);
+
+    if (!cursor) {
+        return json_api_make_error("cursor with the specified id is not exists");
+    }
+
+    if (!lock_select_cursor(cursor, storage)) {
+        destroy_select_cursor(cursor);
+        return json_api_make_error("rows of cursor tables are removed or moved, cursor is closed");
+    }
+
+    struct json_object * answer = make_select_answer(cursor->table, cursor->columns_amount, cursor->columns_indexes);
+    struct json_object * values = json_object_new_array_ext((int) request.amount);
+
+    unsigned int amount = 0;
+    while (amount < request.amount && cursor->left > 0) {
+        struct storage_joined_row * const row = where_scan_next(&cursor->scan);
+
+        if (!row) {
+            cursor->left = 0;
+            break;
+        }
+
+        if (cursor->to_skip > 0) {
+            --cursor->to_skip;
+            continue;
+        }
+
+        json_object_array_add(values, make_select_row(row, cursor->columns_amount, cursor->columns_indexes));
+        --cursor->left;
+        ++amount;
+    }
+
+    if (cursor->scan.job) {
+        storage_scan_job_pause(cursor->scan.job);
+    }
+
+    cursors_put(cursors, request.cursor, cursor);
+
+    json_object_object_add(answer, "values", values);
+    return json_api_make_success(answer);
+}
+
+static struct json_object * handle_request_close_cursor(struct json_api_close_cursor_request request) {
+    struct select_cursor * const cursor = cursors_take(cursors, request.cursor);
+
+    if (!cursor) {
+        return json_api_make_error("cursor with the specified id is not exists");
+    }
+
+    destroy_select_cursor(cursor);
+    return json_api_make_success(json_object_new_object());
+}
+
+static struct json_object * resolve_update(struct json_api_update_request request, struct storage * storage, struct request_plan * plan) {
+    struct storage_table * table = storage_find_table(storage, request.table_name);
+
+    if (!table) {
+        return json_api_make_error("table with the specified name is not exists");
+    }
+
+    plan->table = storage_joined_table_wrap(table);
+
+    struct json_object * error = compile_where(plan->table, request.where, &plan->where);
+
+    if (error) {
+        return error;
+    }
+
+    return map_columns_to_indexes(request.columns.amount, request.columns.columns,
+        plan->table, &plan->columns_amount, &plan->columns_indexes);
+}
+
+static struct json_object * run_update(struct json_api_update_request request, struct request_plan * plan) {
+    struct storage_table * const table = plan->table->tables.tables[0].table;
+
+    {
+        struct json_object * error = bind_where(plan->table, request.where, &plan->where);
+
+        if (!error) {
+            error = check_values(request.values.amount, request.values.values, table, plan->columns_amount, plan->columns_indexes);
+        }
+
+        if (error) {
+            return error;
+        }
+    }
+
+    use_index(plan->table, request.where, &plan->where);
+
+    struct where_scan scan;
+    init_where_scan(&scan, plan->table, &plan->where, 0, true);
+
+    unsigned long long amount = 0;
+    for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+        for (unsigned int i = 0; i < plan->columns_amount; ++i) {
+            storage_row_set_value(row->rows[0], plan->columns_indexes[i], request.values.values[i]);
+        }
+
+        ++amount;
+    }
+
+    destroy_where_scan(&scan);
+    struct json_object * answer = json_object_new_object();
+    json_object_object_add(answer, "amount", json_object_new_uint64(amount));
+    return json_api_make_success(answer);
+}
+
+// parses request of the action, parameters are NULL for request that is not prepared
+static union planned_request parse_planned_request(enum json_api_action action, struct json_object * object,
+        struct json_api_parameters * parameters) {
+    union planned_request request;
 
-        if (error) {
-            storage_joined_table_delete(joined_table);
-            return error;
-        }
+    switch (action) {
+        case JSON_API_TYPE_INSERT:
+            request.insert = json_api_to_insert_request(object, parameters);
+            break;
+
+        case JSON_API_TYPE_DELETE:
+            request.delete = json_api_to_delete_request(object, parameters);
+            break;
+
+        case JSON_API_TYPE_SELECT:
+            request.select = json_api_to_select_request(object, parameters);
+            break;
+
+        case JSON_API_TYPE_UPDATE:
+            request.update = json_api_to_update_request(object, parameters);
+            break;
+
+        default:
+            break; // unreachable
     }
 
-    struct json_object * answer = json_object_new_object();
-    {
-        struct json_object * columns = json_object_new_array_ext((int) columns_amount);
+    return request;
+}
 
-        for (unsigned int i = 0; i < columns_amount; ++i) {
-            json_object_array_add(columns, json_object_new_string(storage_joined_table_get_column(joined_table, columns_indexes[i]).name));
-        }
+static void free_planned_request(enum json_api_action action, union planned_request request) {
+    switch (action) {
+        case JSON_API_TYPE_INSERT:
+            json_api_free_insert_request(request.insert);
+            break;
+
+        case JSON_API_TYPE_DELETE:
+            json_api_free_delete_request(request.delete);
+            break;
+
+        case JSON_API_TYPE_SELECT:
+            json_api_free_select_request(request.select);
+            break;
+
+        case JSON_API_TYPE_UPDATE:
+            json_api_free_update_request(request.update);
+            break;
 
-        json_object_object_add(answer, "columns", columns);
+        default:
+            break; // unreachable
     }
+}
 
-    {
-        struct json_object * values = json_object_new_array_ext((int) request.limit);
+// resolves request into plan, which must be destroyed even on error; returns error or NULL
+static struct json_object * resolve_request(enum json_api_action action, const union planned_request * request,
+        struct storage * storage, struct request_plan * plan) {
+    init_request_plan(plan);
 
-        unsigned int offset = 0, amount = 0;
-        for (struct storage_joined_row * row = storage_joined_table_get_first_row(joined_table); row; row = storage_joined_row_next(row)) {
-            if (request.where == NULL || eval_where(row, request.where)) {
-                if (offset < request.offset) {
-                    ++offset;
-                    continue;
-                }
+    switch (action) {
+        case JSON_API_TYPE_INSERT:
+            return resolve_insert(request->insert, storage, plan);
 
-                if (amount == request.limit) {
-                    break;
-                }
+        case JSON_API_TYPE_DELETE:
+            return resolve_delete(request->delete, storage, plan);
 
-                struct json_object * values_row = json_object_new_array_ext((int) columns_amount);
+        case JSON_API_TYPE_SELECT:
+            return resolve_select(request->select, storage, plan);
 
-                for (unsigned int i = 0; i < columns_amount; ++i) {
-                    json_object_array_add(values_row, json_api_from_value(storage_joined_row_get_value(row, columns_indexes[i])));
-                }
+        case JSON_API_TYPE_UPDATE:
+            return resolve_update(request->update, storage, plan);
 
-                json_object_array_add(values, values_row);
-                ++amount;
-            }
+        default:
+            return NULL; // unreachable
+    }
+}
+
+// runs request by its plan, cursor of select takes joined table of plan (it is NULL after that)
+static struct json_object * run_request(enum json_api_action action, const union planned_request * request,
+        struct request_plan * plan) {
+    switch (action) {
+        case JSON_API_TYPE_INSERT:
+            return run_insert(request->insert, plan);
+
+        case JSON_API_TYPE_DELETE:
+            return run_delete(request->delete, plan);
+
+        case JSON_API_TYPE_SELECT:
+            return run_select(request->select, plan);
+
+        case JSON_API_TYPE_UPDATE:
+            return run_update(request->update, plan);
+
+        default:
+            return NULL; // unreachable
+    }
+}
+
+static struct json_object * handle_request_planned(enum json_api_action action, struct json_object * object, struct storage * storage) {
+    const union planned_request request = parse_planned_request(action, object, NULL);
+
+    struct request_plan plan;
+    struct json_object * response = resolve_request(action, &request, storage, &plan);
+
+    if (!response) {
+        response = run_request(action, &request, &plan);
+    }
+
+    destroy_request_plan(&plan);
+    return response;
+}
+
+// prepared request of connection, its plan is kept between executes while schema is not changed
+struct statement {
+    uint64_t id;
+
+    enum json_api_action action;
+    union planned_request request;
+    struct json_api_parameters parameters;
+
+    // plan is resolved by schema of the generation
+    bool resolved;
+    uint64_t generation;
+    struct request_plan plan;
+
+    struct statement * next;
+};
+
+// prepared statements of connection
+struct statements {
+    uint64_t last_id;
+    struct statement * first;
+};
+
+static struct statement * find_statement(struct statements * statements, uint64_t id) {
+    for (struct statement * statement = statements->first; statement; statement = statement->next) {
+        if (statement->id == id) {
+            return statement;
         }
+    }
 
-        json_object_object_add(answer, "values", values);
+    return NULL;
+}
+
+static void delete_statement(struct statement * statement) {
+    if (statement->resolved) {
+        destroy_request_plan(&statement->plan);
     }
 
-    free(columns_indexes);
-    storage_joined_table_delete(joined_table);
-    return json_api_make_success(answer);
+    free_planned_request(statement->action, statement->request);
+    json_api_free_parameters(statement->parameters);
+    free(statement);
 }
 
-static struct json_object * handle_request_update(struct json_api_update_request request, struct storage * storage) {
-    struct storage_table * table = storage_find_table(storage, request.table_name);
+static void clear_statements(struct statements * statements) {
+    while (statements->first) {
+        struct statement * const statement = statements->first;
 
-    if (!table) {
-        return json_api_make_error("table with the specified name is not exists");
+        statements->first = statement->next;
+        delete_statement(statement);
     }
+}
 
-    struct storage_joined_table * joined_table = storage_joined_table_wrap(table);
+// prepare parses request and resolves its plan, so errors of names are returned by it
+static struct json_object * handle_request_prepare(struct json_api_prepare_request request, struct statements * statements,
+        struct storage * storage) {
+    if (!request.request) {
+        return json_api_make_error("request to prepare is not specified");
+    }
 
-    if (request.where) {
-        struct json_object * error = is_where_correct(joined_table, request.where);
+    const enum json_api_action action = json_api_get_action(request.request);
 
-        if (error) {
-            storage_joined_table_delete(joined_table);
-            return error;
+    switch (action) {
+        case JSON_API_TYPE_INSERT:
+        case JSON_API_TYPE_DELETE:
+        case JSON_API_TYPE_SELECT:
+        case JSON_API_TYPE_UPDATE:
+            break;
+
+        default:
+            return json_api_make_error("only insert, delete, select and update requests can be prepared");
+    }
+
+    struct statement * const statement = malloc(sizeof(*statement));
+    statement->action = action;
+    statement->parameters.amount = 0;
+    statement->parameters.places_amount = 0;
+    statement->parameters.places = NULL;
+    statement->request = parse_planned_request(action, request.request, &statement->parameters);
+
+    struct json_object * error = resolve_request(action, &statement->request, storage, &statement->plan);
+
+    if (error) {
+        statement->resolved = false;
+        destroy_request_plan(&statement->plan);
+        delete_statement(statement);
+        return error;
+    }
+
+    statement->resolved = true;
+    statement->generation = atomic_load(&schema_generation);
+    statement->id = ++statements->last_id;
+    statement->next = statements->first;
+    statements->first = statement;
+
+    struct json_object * answer = json_object_new_object();
+    json_object_object_add(answer, "statement", json_object_new_uint64(statement->id));
+    json_object_object_add(answer, "parameters", json_object_new_uint64(statement->parameters.amount));
+    return json_api_make_success(answer);
+}
+
+// locks tables of kept plan for the request or resolves plan again after schema changes, returns error or NULL
+static struct json_object * lock_statement_plan(struct statement * statement, struct storage * storage) {
+    const uint64_t generation = atomic_load(&schema_generation);
+
+    if (statement->resolved && statement->generation == generation) {
+        for (int i = 0; i < statement->plan.table->tables.amount; ++i) {
+            storage_find_table(storage, statement->plan.table->tables.tables[i].table->name);
         }
+
+        return NULL;
     }
 
-    unsigned int columns_amount;
-    unsigned int * columns_indexes;
+    if (statement->resolved) {
+        destroy_request_plan(&statement->plan);
+    }
+
+    struct json_object * error = resolve_request(statement->action, &statement->request, storage, &statement->plan);
+
+    if (error) {
+        statement->resolved = false;
+        destroy_request_plan(&statement->plan);
+        return error;
+    }
+
+    statement->resolved = true;
+    statement->generation = generation;
+    return NULL;
+}
+
+// execute puts values of parameters into places of prepared request and runs it by its plan
+static struct json_object * handle_request_execute(struct json_api_execute_request request, struct statements * statements,
+        struct storage * storage) {
+    struct statement * const statement = find_statement(statements, request.statement);
+
+    if (!statement) {
+        return json_api_make_error("statement with the specified id is not exists");
+    }
+
+    if (request.parameters.amount != statement->parameters.amount) {
+        return json_api_make_error("values amount is not equals to parameters amount");
+    }
 
     {
-        struct json_object * error = map_columns_to_indexes(request.columns.amount, request.columns.columns,
-            joined_table, &columns_amount, &columns_indexes);
+        struct json_object * error = lock_statement_plan(statement, storage);
 
         if (error) {
-            storage_joined_table_delete(joined_table);
             return error;
         }
     }
 
-    {
-        struct json_object * error = check_values(request.values.amount, request.values.values, table, columns_amount, columns_indexes);
+    for (unsigned int i = 0; i < statement->parameters.places_amount; ++i) {
+        *statement->parameters.places[i].value = request.parameters.values[statement->parameters.places[i].parameter];
+    }
 
-        if (error) {
-            free(columns_indexes);
-            storage_joined_table_delete(joined_table);
-            return error;
+    struct json_object * response = run_request(statement->action, &statement->request, &statement->plan);
+
+    for (unsigned int i = 0; i < statement->parameters.places_amount; ++i) {
+        *statement->parameters.places[i].value = NULL;
+    }
+
+    if (statement->plan.table) {
+        storage_joined_table_reset(statement->plan.table);
+    } else {
+        destroy_request_plan(&statement->plan);
+        statement->resolved = false;
+    }
+
+    return response;
+}
+
+static struct json_object * handle_request_deallocate(struct json_api_deallocate_request request, struct statements * statements) {
+    for (struct statement ** statement = &statements->first; *statement; statement = &(*statement)->next) {
+        if ((*statement)->id == request.statement) {
+            struct statement * const deallocated = *statement;
+
+            *statement = deallocated->next;
+            delete_statement(deallocated);
+            return json_api_make_success(json_object_new_object());
         }
     }
 
-    unsigned long long amount = 0;
-    for (struct storage_joined_row * row = storage_joined_table_get_first_row(joined_table); row; row = storage_joined_row_next(row)) {
-        if (request.where == NULL || eval_where(row, request.where)) {
-            for (unsigned int i = 0; i < columns_amount; ++i) {
-                storage_row_set_value(row->rows[0], columns_indexes[i], request.values.values[i]);
-            }
+    return json_api_make_error("statement with the specified id is not exists");
+}
 
-            ++amount;
+static struct json_object * handle_request_vacuum(struct json_api_vacuum_request request, struct storage * storage) {
+    uint64_t amount;
+
+    if (request.table_name) {
+        struct storage_table * table = storage_find_table(storage, request.table_name);
+
+        if (!table) {
+            return json_api_make_error("table with the specified name is not exists");
         }
+
+        amount = storage_table_vacuum(table);
+        storage_table_delete(table);
+    } else {
+        amount = storage_vacuum(storage);
     }
 
-    free(columns_indexes);
-    storage_joined_table_delete(joined_table);
     struct json_object * answer = json_object_new_object();
     json_object_object_add(answer, "amount", json_object_new_uint64(amount));
     return json_api_make_success(answer);
 }
 
-static struct json_object * handle_request(struct json_object * request, struct storage * storage) {
+static struct json_object * handle_request_stats(struct storage * storage) {
+    struct storage_stats stats;
+    storage_get_stats(storage, &stats);
+
+    const double ratio = stats.stored_size ? (double) stats.body_size / stats.stored_size : 1;
+
+    struct json_object * answer = json_object_new_object();
+    json_object_object_add(answer, "size", json_object_new_uint64(stats.size));
+    json_object_object_add(answer, "tables", json_object_new_uint64(stats.tables));
+    json_object_object_add(answer, "row_groups", json_object_new_uint64(stats.row_groups));
+    json_object_object_add(answer, "compressed_row_groups", json_object_new_uint64(stats.compressed_row_groups));
+    json_object_object_add(answer, "body_size", json_object_new_uint64(stats.body_size));
+    json_object_object_add(answer, "stored_size", json_object_new_uint64(stats.stored_size));
+    json_object_object_add(answer, "compression_ratio", json_object_new_double(ratio));
+    return json_api_make_success(answer);
+}
+
+static struct json_object * handle_request_create_index(struct json_api_create_index_request request, struct storage * storage) {
+    struct storage_table * table = storage_find_table(storage, request.table_name);
+
+    if (!table) {
+        return json_api_make_error("table with the specified name is not exists");
+    }
+
+    const int column = storage_table_find_column(table, request.column);
+
+    if (column < 0) {
+        storage_table_delete(table);
+        return json_api_make_error("column with the specified name is not exists in table");
+    }
+
+    errno = 0;
+    storage_table_add_index(table, column);
+    const int error = errno;
+
+    storage_table_delete(table);
+
+    if (error == EEXIST) {
+        return json_api_make_error("an index on the column is already exists");
+    }
+
+    if (error) {
+        return json_api_make_error("indexes are not supported by the storage file version");
+    }
+
+    return json_api_make_success(json_object_new_object());
+}
+
+static struct json_object * handle_request(struct json_object * request, struct statements * statements, struct storage * storage) {
     enum json_api_action action = json_api_get_action(request);
 
     switch (action) {
@@ -783,25 +2087,78 @@ static struct json_object * handle_request(struct json_object * request, struct
             return handle_request_drop_table(json_api_to_drop_table_request(request), storage);
 
         case JSON_API_TYPE_INSERT:
-            return handle_request_insert(json_api_to_insert_request(request), storage);
-
         case JSON_API_TYPE_DELETE:
-            return handle_request_delete(json_api_to_delete_request(request), storage);
-
         case JSON_API_TYPE_SELECT:
-            return handle_request_select(json_api_to_select_request(request), storage);
-
         case JSON_API_TYPE_UPDATE:
-            return handle_request_update(json_api_to_update_request(request), storage);
+            return handle_request_planned(action, request, storage);
+
+        case JSON_API_TYPE_VACUUM:
+            return handle_request_vacuum(json_api_to_vacuum_request(request), storage);
+
+        case JSON_API_TYPE_CREATE_INDEX:
+            return handle_request_create_index(json_api_to_create_index_request(request), storage);
+
+        case JSON_API_TYPE_FETCH:
+            return handle_request_fetch(json_api_to_fetch_request(request), storage);
+
+        case JSON_API_TYPE_CLOSE_CURSOR:
+            return handle_request_close_cursor(json_api_to_close_cursor_request(request));
+
+        case JSON_API_TYPE_STATS:
+            return handle_request_stats(storage);
+
+        case JSON_API_TYPE_PREPARE:
+            return handle_request_prepare(json_api_to_prepare_request(request), statements, storage);
+
+        case JSON_API_TYPE_EXECUTE:
+            return handle_request_execute(json_api_to_execute_request(request), statements, storage);
+
+        case JSON_API_TYPE_DEALLOCATE:
+            return handle_request_deallocate(json_api_to_deallocate_request(request), statements);
 
         default:
             return NULL;
     }
 }
 
-static void handle_client(int socket, struct storage * storage) {
+// tables are added and removed alone, modified by one request at a time and read concurrently;
+// execute locks as its prepared request, prepare only reads schema
+static enum storage_lock request_lock(struct json_object * request, struct statements * statements) {
+    enum json_api_action action = json_api_get_action(request);
+
+    if (action == JSON_API_TYPE_EXECUTE) {
+        const struct statement * const statement = find_statement(statements, json_api_get_statement(request));
+
+        if (statement) {
+            action = statement->action;
+        }
+    }
+
+    switch (action) {
+        case JSON_API_TYPE_CREATE_TABLE:
+        case JSON_API_TYPE_DROP_TABLE:
+        case JSON_API_TYPE_VACUUM:
+            return STORAGE_LOCK_SCHEMA;
+
+        case JSON_API_TYPE_INSERT:
+        case JSON_API_TYPE_DELETE:
+        case JSON_API_TYPE_UPDATE:
+        case JSON_API_TYPE_CREATE_INDEX:
+            return STORAGE_LOCK_WRITE;
+
+        default:
+            return STORAGE_LOCK_READ;
+    }
+}
+
+static void handle_client(int socket, void * context) {
+    struct storage * const storage = context;
+
     printf("Connected\n");
 
+    json_tokener * const tokener = json_tokener_new();
+    struct statements statements = { .last_id = 0, .first = NULL };
+
     while (!closing) {
         char buffer[64 * 1024];
 
@@ -810,19 +2167,36 @@ static void handle_client(int socket, struct storage * storage) {
             break;
         }
 
-        if (was_read == sizeof(buffer) / sizeof(*buffer)) {
-            buffer[sizeof(buffer) / sizeof(*buffer) - 1] = '\0';
-        } else {
-            buffer[was_read] = '\0';
+        // big requests (such as inserts of many rows) come by several reads
+        struct json_object * request = json_tokener_parse_ex(tokener, buffer, (int) was_read);
+        if (!request && json_tokener_get_error(tokener) == json_tokener_continue) {
+            continue;
         }
 
-        struct json_object * request = json_tokener_parse(buffer);
+        json_tokener_reset(tokener);
         printf("Request: %s\n", json_object_to_json_string_ext(request, JSON_C_TO_STRING_PRETTY));
 
         struct json_object * response_object = NULL;
 
         if (request) {
-            response_object = handle_request(request, storage);
+            const enum storage_lock lock = request_lock(request, &statements);
+            storage_begin(storage, lock);
+
+            // cursors and plans keep tables, which may be removed or vacuumed by the request
+            if (lock == STORAGE_LOCK_SCHEMA) {
+                cursors_clear(cursors);
+                atomic_fetch_add(&schema_generation, 1);
+            }
+
+            response_object = handle_request(request, &statements, storage);
+
+            // rows read from damaged body are zeros, so result of the request is not sent
+            if (storage_read_failed()) {
+                json_object_put(response_object);
+                response_object = json_api_make_error("data of table is damaged");
+            }
+
+            storage_sync(storage, storage_end(storage));
         }
 
         const char * response = json_object_to_json_string(response_object);
@@ -841,16 +2215,81 @@ static void handle_client(int socket, struct storage * storage) {
         }
     }
 
-    close(socket);
+    clear_statements(&statements);
+    json_tokener_free(tokener);
     printf("Disconnected\n");
 }
 
 int main(int argc, char * argv[]) {
-    if (argc < 2) {
+    unsigned int storage_flags = STORAGE_FLAG_SYNC_BATCH;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long scan_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long budget = MEMORY_BUDGET;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:mp:s:t:")) != -1) {
+        switch (opt) {
+            case 'b':
+                budget = strtol(optarg, NULL, 10);
+
+                if (budget <= 0) {
+                    fprintf(stderr, "Bad memory budget: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            case 'm':
+                storage_flags |= STORAGE_FLAG_MMAP;
+                break;
+
+            case 'p':
+                scan_threads = strtol(optarg, NULL, 10);
+
+                if (scan_threads <= 0) {
+                    fprintf(stderr, "Bad scan threads amount: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            case 's':
+                storage_flags &= ~(STORAGE_FLAG_SYNC_BATCH | STORAGE_FLAG_SYNC_COMMIT);
+
+                if (strcmp(optarg, "batch") == 0) {
+                    storage_flags |= STORAGE_FLAG_SYNC_BATCH;
+                } else if (strcmp(optarg, "commit") == 0) {
+                    storage_flags |= STORAGE_FLAG_SYNC_COMMIT;
+                } else if (strcmp(optarg, "off") != 0) {
+                    fprintf(stderr, "Unknown sync mode: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            case 't':
+                threads = strtol(optarg, NULL, 10);
+
+                if (threads <= 0) {
+                    fprintf(stderr, "Bad threads amount: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-b memory budget MiB] [-m] [-p scan threads] [-s off|batch|commit] [-t threads] <storage file>\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
         return 0;
     }
 
-    int fd = open(argv[1], O_RDWR);
+    memory_budget = (size_t) budget * 1024 * 1024;
+
+    int fd = open(argv[optind], O_RDWR);
     struct storage * storage;
 
     if (fd < 0 && errno != ENOENT) {
@@ -858,11 +2297,29 @@ int main(int argc, char * argv[]) {
         return errno;
     }
 
-    if (fd < 0 && errno == ENOENT) {
-        fd = open(argv[1], O_CREAT | O_RDWR, 0644);
-        storage = storage_init(fd);
+    // write-ahead log is kept next to storage file
+    char * const wal_path = malloc(strlen(argv[optind]) + sizeof(".wal"));
+    strcpy(wal_path, argv[optind]);
+    strcat(wal_path, ".wal");
+
+    const int wal_fd = open(wal_path, O_CREAT | O_RDWR, 0644);
+    free(wal_path);
+
+    if (wal_fd < 0) {
+        perror("Error while opening log file");
+        return errno;
+    }
+
+    if (fd < 0) {
+        fd = open(argv[optind], O_CREAT | O_RDWR, 0644);
+        storage = storage_init(fd, wal_fd, storage_flags);
     } else {
-        storage = storage_open(fd);
+        storage = storage_open(fd, wal_fd, storage_flags);
+    }
+
+    // scans of large tables are split between scan threads
+    if (storage) {
+        storage_set_scan_threads(storage, (unsigned int) scan_threads);
     }
 
     // create the server socket
@@ -882,7 +2339,7 @@ int main(int argc, char * argv[]) {
     }
 
     // second argument is a backlog - how many connections can be waiting for this socket simultaneously
-    listen(server_socket, 1);
+    listen(server_socket, SOMAXCONN);
 
     {
         struct sigaction sa;
@@ -895,6 +2352,12 @@ int main(int argc, char * argv[]) {
         sigaction(SIGTERM, &sa, NULL);
     }
 
+    // cursors that are not fetched for the timeout are closed
+    cursors = cursors_new(CURSOR_TIMEOUT, destroy_select_cursor);
+
+    // clients are served concurrently by pool threads
+    struct workers * const workers = workers_start((unsigned int) threads, handle_client, storage);
+
     while (!closing) {
         int ret = accept(server_socket, NULL, NULL);
 
@@ -902,11 +2365,14 @@ int main(int argc, char * argv[]) {
             break;
         }
 
-        handle_client(ret, storage);
+        workers_submit(workers, ret);
     }
 
     close(server_socket);
+    workers_stop(workers);
+    cursors_delete(cursors);
     storage_delete(storage);
+    close(wal_fd);
     close(fd);
 
     printf("Bye!\n");
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "storage.h"
+
+
+// sort of rows by values of their key columns: with limit the least rows are kept
+// in bounded heap, so memory is proportional to the limit, without it rows are kept
+// in memory while they fit the budget, after that they are sorted and spilled to
+// temporary files as runs, which are merged when rows are taken (by several passes
+// when there are too many of them), rows with equal keys stay in the order of adding
+struct sort;
+
+struct sort_key {
+    unsigned int column;
+    bool descending;
+};
+
+
+// limit is amount of the first rows that are taken (SIZE_MAX for all of them)
+struct sort * sort_new(unsigned int columns_amount, unsigned int keys_amount,
+    const struct sort_key * keys, size_t limit, size_t memory_budget);
+
+// adds row of values (NULL values are NULL pointers, they are less than any other), values are copied
+void sort_add(struct sort * sort, struct storage_value * const * row);
+
+// takes the next row in order: puts its values into the row, they are owned by caller,
+// returns false when there are no rows any more, no rows can be added after it
+bool sort_next(struct sort * sort, struct storage_value ** row);
+
+void sort_delete(struct sort * sort);
@@ -1,380 +1,6243 @@
 #define _LARGEFILE64_SOURCE
 
 #include "storage.h"
+#include "lz.h"
 
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <signal.h>
+
+// batch filters have SSE4.2 and AVX2 kernels selected at runtime
+#if defined(__GNUC__) && defined(__x86_64__)
+#define STORAGE_SIMD
+#include <immintrin.h>
+#endif
 
 #define SIGNATURE ("\xDE\xAD\xBA\xBE")
+#define VERSION_MARKER (UINT64_MAX)
+
+#define HEADER_FIRST_TABLE_V0 (4)
+#define HEADER_FIRST_TABLE (4 + sizeof(uint64_t) + sizeof(uint32_t))
+#define HEADER_FREE_LISTS (HEADER_FIRST_TABLE + sizeof(uint64_t))
+#define HEADER_FIRST_INDEX (HEADER_FREE_LISTS + STORAGE_FREE_CLASSES * sizeof(uint64_t))
+#define HEADER_FIRST_DICTIONARY (HEADER_FIRST_INDEX + sizeof(uint64_t))
+#define HEADER_SIZE (512)
+
+#define WAL_SIGNATURE ("\xDE\xAD\xC0\xDE")
+#define WAL_HEADER_CAPACITY (8)
+#define WAL_HEADER_START (WAL_HEADER_CAPACITY + sizeof(uint64_t))
+#define WAL_HEADER_SIZE (512)
+#define WAL_RECORD_HEADER_SIZE (3 * sizeof(uint64_t))
+#define WAL_RECORD_CHECKSUM (2 * sizeof(uint64_t))
+#define WAL_WRITE_HEADER_SIZE (2 * sizeof(uint64_t))
+
+#define ROW_GROUP_HEADER_SIZE (sizeof(uint64_t) + 2 * sizeof(uint32_t))
+#define ROW_GROUP_BODY_CELL (1ull << 63)
+#define ROW_GROUP_BODY_CHUNK (STORAGE_READAHEAD_PAGES * STORAGE_PAGE_SIZE)
+
+// decompressed body takes virtual offsets by position of its pointer, positions fit under the limit
+#define ROW_GROUP_INFLATED (1ull << 63)
+#define ROW_GROUP_INFLATED_SHIFT (27)
+#define ROW_GROUP_INFLATED_LIMIT (1ull << (63 - ROW_GROUP_INFLATED_SHIFT))
+
+#define TABLE_FORMAT_COMPRESSED (0x80)
+
+#define INDEX_ROOT (2 * sizeof(uint64_t))
+#define INDEX_SIZE (3 * sizeof(uint64_t) + sizeof(uint16_t))
+#define INDEX_NODE_HEADER_SIZE (2 * sizeof(uint64_t))
+#define JOIN_BLOCK_ENTRIES (STORAGE_PAGE_SIZE / sizeof(struct storage_join_entry))
+
+#define INDEX_NODE_ENTRIES ((STORAGE_INDEX_NODE_SIZE - INDEX_NODE_HEADER_SIZE - sizeof(uint64_t)) / (3 * sizeof(uint64_t)))
+
+#define DICTIONARY_COLUMN (2 * sizeof(uint64_t))
+#define DICTIONARY_AMOUNT (DICTIONARY_COLUMN + 2 * sizeof(uint16_t))
+#define DICTIONARY_FIRST_CHUNK (DICTIONARY_AMOUNT + sizeof(uint32_t))
+#define DICTIONARY_SIZE (DICTIONARY_FIRST_CHUNK + sizeof(uint64_t))
+#define DICTIONARY_CHUNK_STRINGS ((STORAGE_DICTIONARY_CHUNK_SIZE - sizeof(uint64_t)) / sizeof(uint64_t))
+
+struct storage_index {
+    struct storage * storage;
+    struct storage_index * next;
+
+    uint64_t position;
+    uint64_t root;
+    uint16_t column;
+    enum storage_column_type type;
+};
+
+// strings of dictionary by codes, loaded from file with its table
+struct storage_dictionary {
+    uint64_t position;
+    uint64_t last_chunk;
+
+    uint32_t amount;
+    uint32_t capacity;
+    char ** strings;
+
+    // hashes of strings as by storage_value_hash, so joins do not hash them again
+    uint64_t * hashes;
+
+    // open addressing map of strings: code + 1, 0 for empty slot
+    uint32_t map_size;
+    uint32_t * map;
+};
+
+struct storage_index_entry {
+    uint64_t key;
+    uint64_t row;
+};
+
+// index node as it is stored in file
+struct storage_index_node {
+    uint8_t leaf;
+    uint8_t reserved;
+    uint16_t amount;
+    uint32_t reserved_2;
+    uint64_t next;
+
+    struct storage_index_entry entries[INDEX_NODE_ENTRIES];
+    uint64_t children[INDEX_NODE_ENTRIES + 1];
+};
+
+struct storage_join_entry {
+    uint64_t hash;
+    uint64_t row;
+};
+
+struct storage_join_run {
+    uint64_t offset;
+    uint64_t amount;
+
+    uint64_t block_index;
+    uint64_t block_amount;
+    struct storage_join_entry block[JOIN_BLOCK_ENTRIES];
+};
+
+// hash table of rows of joining table by joined column, entries of equal hash keep scan order
+struct storage_join_hash {
+    uint64_t amount;
+
+    // in-memory table: chains of entry indexes + 1
+    uint64_t buckets_amount;
+    uint64_t * buckets;
+    uint64_t * next;
+    struct storage_join_entry * entries;
+
+    // spilled table: entries sorted by hash in temp file, hash of the first entry of each block
+    FILE * file;
+    uint64_t file_offset;
+    uint64_t * fences;
+};
+
+struct storage_catalog_entry {
+    struct storage_table * table;
+    struct storage_catalog_entry * next_in_bucket;
+    struct storage_index * indexes;
+
+    // dictionaries of columns, NULL for columns without dictionary
+    struct storage_dictionary ** dictionaries;
+
+    // readers and writer of the table by requests
+    pthread_rwlock_t lock;
+
+    // changed by writer when rows are removed or moved
+    uint64_t version;
+
+    // open addressing map of column names: column index + 1, 0 for empty slot
+    uint32_t columns_map_size;
+    uint16_t * columns_map;
+};
+
+struct storage_page {
+    uint64_t number;
+    unsigned int pins;
+
+    bool valid;
+    bool dirty;
+    bool referenced;
+
+    // page is read from file outside the mutex, it is pinned by the reader
+    bool loading;
+
+    // page has writes of request that is not committed yet or committed writes
+    // of log records from the first one up to the end of the last one
+    bool pending;
+    bool committed;
+    uint64_t first_record;
+    uint64_t last_record_end;
+
+    // committed data of page that has pending writes, so it may be written back
+    uint8_t * committed_data;
+
+    int next_in_bucket;
+    uint8_t data[STORAGE_PAGE_SIZE];
+};
+
+// body of row group of table with bodies as it is stored
+struct storage_row_group_body {
+    uint64_t pointer;
+    uint64_t size;
+    uint64_t stored_size;
+};
+
+// rows selected from morsel of parallel scan
+struct storage_scan_morsel {
+    bool done;
+    uint64_t amount;
+    uint64_t * rows;
+};
+
+// parallel scan of table: its reader takes selected rows of morsels one by one
+// in the order of serial scan, scan threads of storage read morsels ahead of it
+struct storage_scan_job {
+    struct storage_table * table;
+    const struct storage_index_scan * scan;
+    uint16_t columns_amount;
+    uint16_t * columns;
+    storage_zone_filter zone_filter;
+    storage_batch_filter filter;
+    void * context;
+    uint64_t limit;
+
+    // batch of the reader
+    struct storage_batch * batch;
+
+    // guarded by the scans mutex of storage
+    bool queued;
+    unsigned int workers;
+    struct storage_scan_job * next_queued;
+
+    pthread_mutex_t lock;
+    pthread_cond_t morsel_done;
+
+    // start of the next morsel: row or row group position, or index of index scan row
+    uint64_t position;
+    bool exhausted;
+
+    // morsel of damaged body was read, job ends with it
+    bool damaged;
+
+    // claimed morsels in the order of serial scan, morsels are not claimed
+    // further than window ahead of the ones taken by reader
+    uint64_t amount;
+    uint64_t capacity;
+    uint64_t taken;
+    uint64_t window;
+    struct storage_scan_morsel * morsels;
+
+    // morsels done from the first one and amount of their rows
+    uint64_t done;
+    uint64_t done_rows;
+};
+
+static unsigned int storage_pool_bucket(uint64_t number) {
+    return (unsigned int) ((number * 0x9E3779B97F4A7C15ull) >> 32) % STORAGE_POOL_BUCKETS;
+}
 
-struct storage * storage_init(int fd) {
-    lseek64(fd, 0, SEEK_SET);
+// reads up to length bytes at the offset, returns amount of read bytes
+static size_t storage_preadv(int fd, struct iovec * vectors, int amount, uint64_t offset) {
+    size_t done = 0;
 
-    write(fd, SIGNATURE, 4);
+    while (amount > 0) {
+        const ssize_t was_read = preadv(fd, vectors, amount, (off64_t) (offset + done));
 
-    uint64_t p = 0;
-    write(fd, &p, sizeof(p));
+        if (was_read < 0 && errno == EINTR) {
+            continue;
+        }
 
-    struct storage * storage = malloc(sizeof(*storage));
+        if (was_read <= 0) {
+            break;
+        }
 
-    storage->fd = fd;
-    storage->first_table = 0;
-    return storage;
+        done += was_read;
+
+        // skip filled vectors and continue in the partially filled one
+        size_t rest = was_read;
+        while (amount > 0 && rest >= vectors->iov_len) {
+            rest -= vectors->iov_len;
+            ++vectors;
+            --amount;
+        }
+
+        if (amount > 0) {
+            vectors->iov_base = (uint8_t *) vectors->iov_base + rest;
+            vectors->iov_len -= rest;
+        }
+    }
+
+    return done;
 }
 
-struct storage * storage_open(int fd) {
-    lseek64(fd, 0, SEEK_SET);
+static size_t storage_pread(int fd, void * buf, size_t length, uint64_t offset) {
+    struct iovec vector = { .iov_base = buf, .iov_len = length };
 
-    char sign[4];
-    if (read(fd, sign, 4) != 4) {
-        errno = EINVAL;
-        return NULL;
+    return storage_preadv(fd, &vector, 1, offset);
+}
+
+static void storage_pwrite(int fd, const void * buf, size_t length, uint64_t offset) {
+    const uint8_t * ptr = buf;
+
+    while (length > 0) {
+        const ssize_t wrote = pwrite(fd, ptr, length, (off64_t) offset);
+
+        if (wrote < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (wrote <= 0) {
+            return;
+        }
+
+        ptr += wrote;
+        offset += wrote;
+        length -= wrote;
     }
+}
 
-    if (memcmp(sign, SIGNATURE, 4) != 0) {
-        errno = EINVAL;
+static void storage_pool_init(struct storage * storage) {
+    storage->pool.hand = 0;
+    storage->pool.amount = STORAGE_POOL_PAGES;
+    storage->pool.dirty = 0;
+    storage->pool.next_miss = 0;
+    storage->pool.pages = malloc(storage->pool.amount * sizeof(*storage->pool.pages));
+
+    for (unsigned int i = 0; i < storage->pool.amount; ++i) {
+        storage->pool.pages[i] = calloc(1, sizeof(**storage->pool.pages));
+    }
+
+    pthread_cond_init(&storage->pool.loaded, NULL);
+
+    for (unsigned int i = 0; i < STORAGE_POOL_BUCKETS; ++i) {
+        storage->pool.buckets[i] = -1;
+    }
+}
+
+static void storage_page_write_back(struct storage * storage, struct storage_page * page) {
+    const uint64_t offset = page->number * STORAGE_PAGE_SIZE;
+
+    // do not extend file with the tail of the last page
+    size_t length = STORAGE_PAGE_SIZE;
+    if (offset + length > storage->size) {
+        length = storage->size > offset ? storage->size - offset : 0;
+    }
+
+    storage_pwrite(storage->fd, page->committed_data ? page->committed_data : page->data, length, offset);
+
+    page->committed = false;
+
+    // pending writes are left in pool
+    if (page->committed_data) {
+        free(page->committed_data);
+        page->committed_data = NULL;
+        return;
+    }
+
+    page->dirty = false;
+    --storage->pool.dirty;
+}
+
+// position of the end of synced part of log
+static uint64_t storage_wal_get_synced(struct storage * storage) {
+    pthread_mutex_lock(&storage->wal.lock);
+    const uint64_t synced = storage->wal.synced;
+    pthread_mutex_unlock(&storage->wal.lock);
+
+    return synced;
+}
+
+// writes of page get into storage file only after their records are in log,
+// and after they are synced if log is synced by commits
+static bool storage_page_can_write_back(const struct storage * storage, const struct storage_page * page, uint64_t synced) {
+    if (page->pending && !page->committed_data) {
+        return false;
+    }
+
+    if (!page->committed || !(storage->wal.flags & (STORAGE_FLAG_SYNC_BATCH | STORAGE_FLAG_SYNC_COMMIT))) {
+        return true;
+    }
+
+    return page->last_record_end <= synced;
+}
+
+static void storage_pool_unlink(struct storage * storage, int frame) {
+    int * link = &storage->pool.buckets[storage_pool_bucket(storage->pool.pages[frame]->number)];
+
+    while (*link != frame) {
+        link = &storage->pool.pages[*link]->next_in_bucket;
+    }
+
+    *link = storage->pool.pages[frame]->next_in_bucket;
+}
+
+static int storage_pool_find(const struct storage * storage, uint64_t number) {
+    int frame = storage->pool.buckets[storage_pool_bucket(number)];
+
+    while (frame >= 0 && storage->pool.pages[frame]->number != number) {
+        frame = storage->pool.pages[frame]->next_in_bucket;
+    }
+
+    return frame;
+}
+
+// doubles amount of pages in pool and returns the first new frame,
+// pages are allocated one by one, so pinned pages stay in place
+static int storage_pool_grow(struct storage * storage) {
+    const unsigned int amount = storage->pool.amount;
+
+    storage->pool.pages = realloc(storage->pool.pages, 2 * amount * sizeof(*storage->pool.pages));
+    storage->pool.amount = 2 * amount;
+
+    for (unsigned int i = amount; i < 2 * amount; ++i) {
+        storage->pool.pages[i] = calloc(1, sizeof(**storage->pool.pages));
+    }
+
+    return (int) amount;
+}
+
+// clock sweep: the hand clears reference bits until it meets unpinned not referenced page
+static int storage_pool_evict(struct storage * storage) {
+    const uint64_t synced = storage->wal.fd >= 0 ? storage_wal_get_synced(storage) : 0;
+
+    for (unsigned int i = 0; i < 2 * storage->pool.amount; ++i) {
+        const int frame = (int) storage->pool.hand;
+        struct storage_page * const page = storage->pool.pages[frame];
+
+        storage->pool.hand = (storage->pool.hand + 1) % storage->pool.amount;
+
+        if (!page->valid) {
+            return frame;
+        }
+
+        if (page->pins > 0 || page->pending || (page->dirty && !storage_page_can_write_back(storage, page, synced))) {
+            continue;
+        }
+
+        if (page->referenced) {
+            page->referenced = false;
+            continue;
+        }
+
+        if (page->dirty) {
+            storage_page_write_back(storage, page);
+        }
+
+        storage_pool_unlink(storage, frame);
+        page->valid = false;
+        return frame;
+    }
+
+    // all pages are pinned or hold writes that cannot be written back yet
+    return storage_pool_grow(storage);
+}
+
+// puts pages from the number into pool: the following pages are read ahead while misses
+// go one after another and are not in pool. Frames are taken under the mutex,
+// which is released while file is read by one call
+static void storage_pool_load(struct storage * storage, uint64_t number) {
+    struct storage_page * pages[STORAGE_READAHEAD_PAGES];
+    struct iovec vectors[STORAGE_READAHEAD_PAGES];
+
+    const unsigned int limit = number == storage->pool.next_miss ? STORAGE_READAHEAD_PAGES : 1;
+    const uint64_t offset = number * STORAGE_PAGE_SIZE;
+
+    unsigned int amount = 0;
+    while (amount < limit) {
+        const uint64_t page_number = number + amount;
+
+        if (amount > 0 && (page_number * STORAGE_PAGE_SIZE >= storage->size || storage_pool_find(storage, page_number) >= 0)) {
+            break;
+        }
+
+        const int frame = storage_pool_evict(storage);
+        struct storage_page * const page = storage->pool.pages[frame];
+
+        page->number = page_number;
+        page->pins = 1;
+        page->valid = true;
+        page->dirty = false;
+        page->referenced = true;
+        page->loading = true;
+        page->pending = false;
+        page->committed = false;
+        page->committed_data = NULL;
+
+        const unsigned int bucket = storage_pool_bucket(page_number);
+        page->next_in_bucket = storage->pool.buckets[bucket];
+        storage->pool.buckets[bucket] = frame;
+
+        pages[amount] = page;
+        vectors[amount].iov_base = page->data;
+        vectors[amount].iov_len = STORAGE_PAGE_SIZE;
+        ++amount;
+    }
+
+    storage->pool.next_miss = number + amount;
+
+    size_t was_read = 0;
+    if (offset < storage->size) {
+        pthread_mutex_unlock(&storage->lock);
+        was_read = storage_preadv(storage->fd, vectors, (int) amount, offset);
+        pthread_mutex_lock(&storage->lock);
+    }
+
+    for (unsigned int i = 0; i < amount; ++i) {
+        const size_t page_start = (size_t) i * STORAGE_PAGE_SIZE;
+        const size_t filled = was_read <= page_start ? 0 : was_read - page_start < STORAGE_PAGE_SIZE ? was_read - page_start : STORAGE_PAGE_SIZE;
+
+        memset(pages[i]->data + filled, 0, STORAGE_PAGE_SIZE - filled);
+
+        pages[i]->loading = false;
+        --pages[i]->pins;
+    }
+
+    pthread_cond_broadcast(&storage->pool.loaded);
+}
+
+static struct storage_page * storage_page_pin(struct storage * storage, uint64_t number) {
+    int frame = storage_pool_find(storage, number);
+
+    if (frame < 0) {
+        storage_pool_load(storage, number);
+        frame = storage_pool_find(storage, number);
+    }
+
+    struct storage_page * const page = storage->pool.pages[frame];
+
+    ++page->pins;
+    page->referenced = true;
+
+    // page is being read by another thread
+    while (page->loading) {
+        pthread_cond_wait(&storage->pool.loaded, &storage->lock);
+    }
+
+    return page;
+}
+
+static void storage_page_unpin(struct storage * storage, struct storage_page * page, bool dirty) {
+    --page->pins;
+
+    if (dirty && !page->dirty) {
+        page->dirty = true;
+        ++storage->pool.dirty;
+    }
+
+    // page is held in pool until the request is committed
+    if (dirty && storage->wal.fd >= 0) {
+        page->pending = true;
+    }
+}
+
+static void storage_map_init(struct storage * storage) {
+    void * const reserve = mmap(NULL, STORAGE_MAP_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (reserve == MAP_FAILED) {
+        return;
+    }
+
+    storage->map = reserve;
+    storage->map_size = 0;
+}
+
+// maps file tail that was written after the last call into reserved address space,
+// so pointers into the mapping stay valid while file grows
+static void storage_map_grow(struct storage * storage) {
+    if (!storage->map || storage->size <= storage->map_size) {
+        return;
+    }
+
+    uint64_t map_size = (storage->size + STORAGE_MAP_CHUNK - 1) / STORAGE_MAP_CHUNK * STORAGE_MAP_CHUNK;
+    if (map_size > STORAGE_MAP_RESERVE) {
+        map_size = STORAGE_MAP_RESERVE;
+    }
+
+    if (map_size <= storage->map_size) {
+        return;
+    }
+
+    void * const map = mmap(storage->map + storage->map_size, map_size - storage->map_size,
+        PROT_READ, MAP_SHARED | MAP_FIXED, storage->fd, (off64_t) storage->map_size);
+
+    if (map != MAP_FAILED) {
+        storage->map_size = map_size;
+    }
+}
+
+// returns pointer to mapped data or NULL if the data is not mapped;
+// pages modified in buffer pool are newer than the mapping until they are written back
+static const uint8_t * storage_view(const struct storage * storage, uint64_t offset, size_t length) {
+    if (!storage->map || storage->pool.dirty > 0 || offset + length > storage->size || offset + length > storage->map_size) {
         return NULL;
     }
 
-    struct storage * storage = malloc(sizeof(*storage));
-    storage->fd = fd;
+    return storage->map + offset;
+}
 
-    read(fd, &storage->first_table, sizeof(storage->first_table));
-    return storage;
+static uint64_t storage_wal_align(uint64_t length) {
+    return (length + 7) / 8 * 8;
 }
 
-void storage_delete(struct storage * storage) {
-    free(storage);
+static uint64_t storage_wal_checksum(const uint8_t * data, uint64_t size) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+
+    for (uint64_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+
+    return hash;
 }
 
-static char * storage_read_string(int fd) {
-    uint16_t length;
+// log is written by pwrite, because both the log thread and the storage write it
+static void storage_wal_write(int fd, uint64_t capacity, uint64_t position, const void * buf, uint64_t length) {
+    const uint8_t * ptr = buf;
 
-    read(fd, &length, sizeof(length));
+    while (length > 0) {
+        const uint64_t offset = position % capacity;
 
-    char * str = malloc(sizeof(int8_t) * (length + 1));
-    read(fd, str, length);
-    str[length] = '\0';
+        uint64_t chunk = capacity - offset;
+        if (chunk > length) {
+            chunk = length;
+        }
 
-    return str;
+        const ssize_t wrote = pwrite(fd, ptr, chunk, (off64_t) (WAL_HEADER_SIZE + offset));
+        if (wrote <= 0) {
+            return;
+        }
+
+        ptr += wrote;
+        position += wrote;
+        length -= wrote;
+    }
 }
 
-struct storage_table * storage_find_table(struct storage * storage, const char * name) {
-    uint64_t pointer = storage->first_table;
+static bool storage_wal_read(int fd, uint64_t capacity, uint64_t position, void * buf, uint64_t length) {
+    uint8_t * ptr = buf;
 
-    while (pointer) {
-        lseek64(storage->fd, (off64_t) pointer, SEEK_SET);
+    while (length > 0) {
+        const uint64_t offset = position % capacity;
+
+        uint64_t chunk = capacity - offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        const ssize_t was_read = pread(fd, ptr, chunk, (off64_t) (WAL_HEADER_SIZE + offset));
+        if (was_read <= 0) {
+            return false;
+        }
+
+        ptr += was_read;
+        position += was_read;
+        length -= was_read;
+    }
+
+    return true;
+}
+
+static void storage_wal_write_header(int fd, uint64_t capacity, uint64_t start) {
+    uint8_t header[WAL_HEADER_SIZE] = { 0 };
+
+    memcpy(header, WAL_SIGNATURE, 4);
+    memcpy(header + WAL_HEADER_CAPACITY, &capacity, sizeof(capacity));
+    memcpy(header + WAL_HEADER_START, &start, sizeof(start));
+
+    pwrite(fd, header, sizeof(header), 0);
+}
+
+// empties log, so records of older laps are not taken for new ones
+static void storage_wal_reset(int fd) {
+    ftruncate(fd, 0);
+    storage_wal_write_header(fd, STORAGE_WAL_CAPACITY, 0);
+    fdatasync(fd);
+}
+
+// applies writes of committed records from the start of log to storage file
+// until the first record that is torn or not written, then resets the log
+static void storage_wal_recover(int fd, int wal_fd) {
+    uint8_t header[WAL_HEADER_SIZE];
+
+    uint64_t capacity = 0;
+    uint64_t position = 0;
+
+    if (pread(wal_fd, header, sizeof(header), 0) == sizeof(header) && memcmp(header, WAL_SIGNATURE, 4) == 0) {
+        memcpy(&capacity, header + WAL_HEADER_CAPACITY, sizeof(capacity));
+        memcpy(&position, header + WAL_HEADER_START, sizeof(position));
+    }
+
+    uint8_t * record = NULL;
+    bool replayed = false;
+
+    while (capacity > 0) {
+        uint64_t record_header[WAL_RECORD_HEADER_SIZE / sizeof(uint64_t)];
+
+        if (!storage_wal_read(wal_fd, capacity, position, record_header, sizeof(record_header))) {
+            break;
+        }
+
+        const uint64_t size = record_header[1];
+        if (record_header[0] != position || size < WAL_RECORD_HEADER_SIZE || size > capacity || size % sizeof(uint64_t) != 0) {
+            break;
+        }
+
+        record = realloc(record, size);
+        if (!storage_wal_read(wal_fd, capacity, position, record, size)) {
+            break;
+        }
+
+        memset(record + WAL_RECORD_CHECKSUM, 0, sizeof(uint64_t));
+        if (storage_wal_checksum(record, size) != record_header[2]) {
+            break;
+        }
+
+        for (uint64_t offset = WAL_RECORD_HEADER_SIZE; offset + WAL_WRITE_HEADER_SIZE <= size; ) {
+            uint64_t write_header[2];
+            memcpy(write_header, record + offset, sizeof(write_header));
+
+            if (write_header[1] > size - offset - WAL_WRITE_HEADER_SIZE) {
+                break;
+            }
+
+            storage_pwrite(fd, record + offset + WAL_WRITE_HEADER_SIZE, write_header[1], write_header[0]);
+
+            offset += WAL_WRITE_HEADER_SIZE + storage_wal_align(write_header[1]);
+        }
+
+        position += size;
+        replayed = true;
+    }
+
+    free(record);
+
+    if (replayed) {
+        fdatasync(fd);
+    }
+
+    storage_wal_reset(wal_fd);
+}
+
+// adds write to record of current request, write that continues the previous one is merged into it
+static void storage_wal_add_write(struct storage * storage, uint64_t offset, const void * buf, size_t length) {
+    if (storage->wal.record.size == 0) {
+        storage->wal.record.size = WAL_RECORD_HEADER_SIZE;
+        storage->wal.record.last = 0;
+    }
+
+    uint64_t data_offset = 0;
+    uint64_t last_length = 0;
+
+    if (storage->wal.record.last) {
+        uint64_t last_header[2];
+        memcpy(last_header, storage->wal.record.data + storage->wal.record.last, sizeof(last_header));
+
+        if (last_header[0] + last_header[1] == offset) {
+            data_offset = last_header[0];
+            last_length = last_header[1];
+        }
+    }
+
+    if (last_length == 0) {
+        storage->wal.record.last = storage->wal.record.size;
+        data_offset = offset;
+    }
+
+    const uint64_t write_length = last_length + length;
+    const uint64_t size = storage->wal.record.last + WAL_WRITE_HEADER_SIZE + storage_wal_align(write_length);
+
+    if (size > storage->wal.record.capacity) {
+        while (size > storage->wal.record.capacity) {
+            storage->wal.record.capacity = storage->wal.record.capacity ? 2 * storage->wal.record.capacity : STORAGE_PAGE_SIZE;
+        }
+
+        storage->wal.record.data = realloc(storage->wal.record.data, storage->wal.record.capacity);
+    }
 
-        uint64_t next, first_row;
-        read(storage->fd, &next, sizeof(next));
-        read(storage->fd, &first_row, sizeof(first_row));
+    uint8_t * const ptr = storage->wal.record.data + storage->wal.record.last;
+    const uint64_t write_header[2] = { data_offset, write_length };
 
-        char * table_name = storage_read_string(storage->fd);
-        if (strcmp(table_name, name) != 0) {
-            free(table_name);
-            pointer = next;
+    memcpy(ptr, write_header, sizeof(write_header));
+    memcpy(ptr + WAL_WRITE_HEADER_SIZE + last_length, buf, length);
+    memset(ptr + WAL_WRITE_HEADER_SIZE + write_length, 0, storage_wal_align(write_length) - write_length);
+
+    storage->wal.record.size = size;
+}
+
+// the log thread syncs log by requests of commits and checkpoints records
+static void * storage_wal_thread(void * arg) {
+    struct storage * const storage = arg;
+
+    pthread_mutex_lock(&storage->wal.lock);
+
+    while (true) {
+        // single fdatasync covers every record written before it
+        if (storage->wal.synced < storage->wal.sync_requested) {
+            const uint64_t end = storage->wal.end;
+            pthread_mutex_unlock(&storage->wal.lock);
+
+            fdatasync(storage->wal.fd);
+
+            pthread_mutex_lock(&storage->wal.lock);
+            storage->wal.synced = end;
+            pthread_cond_broadcast(&storage->wal.changed);
             continue;
         }
 
-        struct storage_table * table = malloc(sizeof(*table));
-        table->storage = storage;
-        table->position = pointer;
-        table->next = next;
-        table->first_row = first_row;
-        table->name = table_name;
+        // records before the new start may be overwritten only when the header is durable
+        if (storage->wal.start < storage->wal.checkpoint_requested) {
+            const uint64_t start = storage->wal.checkpoint_requested;
+            const uint64_t capacity = storage->wal.capacity;
+            pthread_mutex_unlock(&storage->wal.lock);
 
-        read(storage->fd, &table->columns.amount, sizeof(table->columns.amount));
-        table->columns.columns = malloc(sizeof(*table->columns.columns) * table->columns.amount);
+            fdatasync(storage->fd);
+            storage_wal_write_header(storage->wal.fd, capacity, start);
+            fdatasync(storage->wal.fd);
 
-        for (uint16_t i = 0; i < table->columns.amount; ++i) {
-            table->columns.columns[i].name = storage_read_string(storage->fd);
+            pthread_mutex_lock(&storage->wal.lock);
+            storage->wal.start = start;
+            pthread_cond_broadcast(&storage->wal.changed);
+            continue;
+        }
 
-            uint8_t type;
-            read(storage->fd, &type, sizeof(type));
-            table->columns.columns[i].type = (enum storage_column_type) type;
+        if (storage->wal.stopping) {
+            break;
         }
 
-        return table;
+        pthread_cond_wait(&storage->wal.changed, &storage->wal.lock);
     }
 
+    pthread_mutex_unlock(&storage->wal.lock);
     return NULL;
 }
 
-void storage_table_delete(struct storage_table * table) {
-    if (table) {
-        free(table->name);
+static void storage_wal_start(struct storage * storage) {
+    pthread_mutex_init(&storage->wal.lock, NULL);
+    pthread_cond_init(&storage->wal.changed, NULL);
 
-        for (uint16_t i = 0; i < table->columns.amount; ++i) {
-            free(table->columns.columns[i].name);
-        }
+    // signals are left to threads of storage user
+    sigset_t signals, old_signals;
+    sigfillset(&signals);
 
-        free(table->columns.columns);
+    pthread_sigmask(SIG_SETMASK, &signals, &old_signals);
+    pthread_create(&storage->wal.thread, NULL, storage_wal_thread, storage);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+}
+
+static void storage_wal_stop(struct storage * storage) {
+    pthread_mutex_lock(&storage->wal.lock);
+    storage->wal.stopping = true;
+    pthread_cond_broadcast(&storage->wal.changed);
+    pthread_mutex_unlock(&storage->wal.lock);
+
+    pthread_join(storage->wal.thread, NULL);
+    pthread_cond_destroy(&storage->wal.changed);
+    pthread_mutex_destroy(&storage->wal.lock);
+}
+
+// waits until the log thread syncs log up to the position
+static void storage_wal_wait_synced(struct storage * storage, uint64_t position) {
+    pthread_mutex_lock(&storage->wal.lock);
+
+    if (storage->wal.sync_requested < position) {
+        storage->wal.sync_requested = position;
+        pthread_cond_broadcast(&storage->wal.changed);
     }
 
-    free(table);
+    while (storage->wal.synced < position) {
+        pthread_cond_wait(&storage->wal.changed, &storage->wal.lock);
+    }
+
+    pthread_mutex_unlock(&storage->wal.lock);
 }
 
-static uint64_t storage_write(int fd, void * buf, size_t length) {
-    uint64_t offset = lseek64(fd, 0, SEEK_END);
+// asks the log thread to checkpoint records before the position and waits for it if needed
+static void storage_wal_checkpoint(struct storage * storage, uint64_t position, bool wait) {
+    pthread_mutex_lock(&storage->wal.lock);
+
+    if (storage->wal.checkpoint_requested < position) {
+        storage->wal.checkpoint_requested = position;
+        pthread_cond_broadcast(&storage->wal.changed);
+    }
+
+    while (wait && storage->wal.start < position) {
+        pthread_cond_wait(&storage->wal.changed, &storage->wal.lock);
+    }
+
+    pthread_mutex_unlock(&storage->wal.lock);
+}
+
+// reads data at the offset from mapping or through the pool, the mutex is held
+static void storage_read_locked(struct storage * storage, uint64_t offset, void * buf, size_t length) {
+    uint8_t * ptr = buf;
+
+    if (storage->map && storage->pool.dirty == 0) {
+        const uint8_t * const data = storage_view(storage, offset, length);
+
+        if (data) {
+            memcpy(ptr, data, length);
+        } else {
+            memset(ptr, 0, length);
+            storage_pread(storage->fd, ptr, length, offset);
+        }
+
+        return;
+    }
+
+    while (length > 0) {
+        struct storage_page * const page = storage_page_pin(storage, offset / STORAGE_PAGE_SIZE);
+        const size_t page_offset = offset % STORAGE_PAGE_SIZE;
+
+        size_t chunk = STORAGE_PAGE_SIZE - page_offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        memcpy(ptr, page->data + page_offset, chunk);
+        storage_page_unpin(storage, page, false);
+
+        ptr += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+}
+
+// puts chunk of decompressed row group body with the virtual offset into pool pages,
+// the mutex is released while the chunk is decompressed; returns false with errno EIO
+// when the stored chunk is damaged, nothing is put into pool then
+static bool storage_pool_inflate(struct storage * storage, uint64_t offset) {
+    const uint64_t base = offset & ~((1ull << ROW_GROUP_INFLATED_SHIFT) - 1);
+    const uint64_t start = (offset - base) / ROW_GROUP_BODY_CHUNK * ROW_GROUP_BODY_CHUNK;
+
+    // body pointer, body size and stored size
+    uint64_t body[3];
+    storage_read_locked(storage, (base & ~ROW_GROUP_INFLATED) >> ROW_GROUP_INFLATED_SHIFT, body, sizeof(body));
+
+    // offsets after the body are zeros
+    uint8_t * const data = calloc(1, ROW_GROUP_BODY_CHUNK);
+    const uint64_t length = start >= body[1] ? 0 : body[1] - start < ROW_GROUP_BODY_CHUNK ? body[1] - start : ROW_GROUP_BODY_CHUNK;
+
+    if (length > 0 && body[2] < body[1]) {
+        const uint64_t chunks = (body[1] + ROW_GROUP_BODY_CHUNK - 1) / ROW_GROUP_BODY_CHUNK;
+        const uint64_t offsets_size = (chunks + 1) * sizeof(uint32_t);
+
+        uint32_t bounds[2];
+        storage_read_locked(storage, body[0] + start / ROW_GROUP_BODY_CHUNK * sizeof(uint32_t), bounds, sizeof(bounds));
+
+        // bounds of damaged body may be out of its stored chunks
+        if (bounds[1] < bounds[0] || body[2] < offsets_size || bounds[1] > body[2] - offsets_size) {
+            free(data);
+
+            errno = EIO;
+            return false;
+        }
+
+        uint8_t * const stored = malloc(bounds[1] - bounds[0]);
+        storage_read_locked(storage, body[0] + offsets_size + bounds[0], stored, bounds[1] - bounds[0]);
+
+        pthread_mutex_unlock(&storage->lock);
+        const bool inflated = lz_decompress(stored, bounds[1] - bounds[0], data, length);
+        pthread_mutex_lock(&storage->lock);
+
+        free(stored);
+
+        if (!inflated) {
+            free(data);
+
+            errno = EIO;
+            return false;
+        }
+    } else if (length > 0) {
+        // body was moved to uncompressed block since the offset was taken
+        storage_read_locked(storage, body[0] + start, data, length);
+    }
+
+    for (uint64_t i = 0; i < ROW_GROUP_BODY_CHUNK / STORAGE_PAGE_SIZE; ++i) {
+        const uint64_t number = (base + start) / STORAGE_PAGE_SIZE + i;
+
+        if (storage_pool_find(storage, number) >= 0) {
+            continue;
+        }
+
+        const int frame = storage_pool_evict(storage);
+        struct storage_page * const page = storage->pool.pages[frame];
+
+        page->number = number;
+        page->pins = 0;
+        page->valid = true;
+        page->dirty = false;
+        page->referenced = true;
+        page->loading = false;
+        page->pending = false;
+        page->committed = false;
+        page->committed_data = NULL;
+
+        const unsigned int bucket = storage_pool_bucket(number);
+        page->next_in_bucket = storage->pool.buckets[bucket];
+        storage->pool.buckets[bucket] = frame;
+
+        memcpy(page->data, data + i * STORAGE_PAGE_SIZE, STORAGE_PAGE_SIZE);
+    }
+
+    free(data);
+    return true;
+}
+
+// takes pages of decompressed body out of pool, so another body may take its virtual offsets
+static void storage_pool_drop(struct storage * storage, uint64_t offset, uint64_t size) {
+    const uint64_t end = (offset + size + ROW_GROUP_BODY_CHUNK - 1) / ROW_GROUP_BODY_CHUNK * ROW_GROUP_BODY_CHUNK;
+
+    pthread_mutex_lock(&storage->lock);
+
+    for (uint64_t number = offset / STORAGE_PAGE_SIZE; number < end / STORAGE_PAGE_SIZE; ++number) {
+        const int frame = storage_pool_find(storage, number);
+
+        if (frame >= 0) {
+            storage_pool_unlink(storage, frame);
+            storage->pool.pages[frame]->valid = false;
+        }
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+}
+
+// request of the thread and catalog entries of tables locked by it
+static _Thread_local struct {
+    struct storage * storage;
+    enum storage_lock lock;
+
+    uint32_t amount;
+    uint32_t capacity;
+    struct storage_catalog_entry ** entries;
+
+    // reads of the thread found damaged data, so rows read by it may be zeros
+    bool damaged;
+} storage_request;
+
+// reads of the thread are checked for damaged data from the mark, returns the mark
+static bool storage_read_mark(void) {
+    const bool damaged = storage_request.damaged;
+    storage_request.damaged = false;
+
+    return damaged;
+}
+
+// tells whether reads since the mark found damaged data (errno is EIO then),
+// the thread keeps being damaged after them
+static bool storage_read_damaged(bool mark) {
+    if (storage_request.damaged) {
+        errno = EIO;
+        return true;
+    }
+
+    storage_request.damaged = mark;
+    return false;
+}
+
+// reads data at the offset and moves offset after the data;
+// data at virtual offsets is decompressed row group body, it is kept in pool pages;
+// returns false with errno EIO when the body can not be decompressed, the rest of data is zeros then
+static bool storage_read(struct storage * storage, uint64_t * offset, void * buf, size_t length) {
+    uint8_t * ptr = buf;
+
+    pthread_mutex_lock(&storage->lock);
+
+    if (*offset < ROW_GROUP_INFLATED) {
+        storage_read_locked(storage, *offset, buf, length);
+
+        *offset += length;
+        pthread_mutex_unlock(&storage->lock);
+        return true;
+    }
+
+    while (length > 0) {
+        const int frame = storage_pool_find(storage, *offset / STORAGE_PAGE_SIZE);
+
+        if (frame < 0) {
+            if (storage_pool_inflate(storage, *offset)) {
+                continue;
+            }
+
+            memset(ptr, 0, length);
+            *offset += length;
+            storage_request.damaged = true;
+
+            pthread_mutex_unlock(&storage->lock);
+            return false;
+        }
+
+        struct storage_page * const page = storage->pool.pages[frame];
+        const size_t page_offset = *offset % STORAGE_PAGE_SIZE;
+
+        size_t chunk = STORAGE_PAGE_SIZE - page_offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        page->referenced = true;
+        memcpy(ptr, page->data + page_offset, chunk);
+
+        ptr += chunk;
+        *offset += chunk;
+        length -= chunk;
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+    return true;
+}
+
+// writes data at the offset and moves offset after the data
+static void storage_write_at(struct storage * storage, uint64_t * offset, const void * buf, size_t length) {
+    const uint8_t * ptr = buf;
+
+    if (storage->wal.fd >= 0) {
+        storage_wal_add_write(storage, *offset, buf, length);
+    }
+
+    pthread_mutex_lock(&storage->lock);
+
+    // mapped storage writes through to file, the mapping shares file pages
+    if (storage->map && storage->wal.fd < 0) {
+        storage_pwrite(storage->fd, ptr, length, *offset);
+
+        *offset += length;
+        if (*offset > storage->size) {
+            storage->size = *offset;
+            storage_map_grow(storage);
+        }
+
+        pthread_mutex_unlock(&storage->lock);
+        return;
+    }
+
+    while (length > 0) {
+        struct storage_page * const page = storage_page_pin(storage, *offset / STORAGE_PAGE_SIZE);
+        const size_t page_offset = *offset % STORAGE_PAGE_SIZE;
+
+        size_t chunk = STORAGE_PAGE_SIZE - page_offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        // the first write of request into page with committed writes keeps them
+        if (page->committed && !page->pending) {
+            page->committed_data = malloc(STORAGE_PAGE_SIZE);
+            memcpy(page->committed_data, page->data, STORAGE_PAGE_SIZE);
+        }
+
+        memcpy(page->data + page_offset, ptr, chunk);
+        storage_page_unpin(storage, page, true);
+
+        ptr += chunk;
+        *offset += chunk;
+        length -= chunk;
+
+        if (*offset > storage->size) {
+            storage->size = *offset;
+        }
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+}
+
+// writes zeros at the offset and moves offset after them
+static void storage_write_zeros(struct storage * storage, uint64_t * offset, uint64_t length) {
+    static const uint8_t zeros[STORAGE_PAGE_SIZE] = { 0 };
+
+    while (length > 0) {
+        const size_t chunk = length < sizeof(zeros) ? length : sizeof(zeros);
+
+        storage_write_at(storage, offset, zeros, chunk);
+        length -= chunk;
+    }
+}
+
+// size classes: multiples of 8 bytes up to 128 bytes, then powers of two,
+// returns -1 for blocks that are too big to be reused
+static int storage_free_class(uint64_t length) {
+    if (length <= 128) {
+        return length == 0 ? 0 : (int) ((length - 1) / 8);
+    }
+
+    int class = 16;
+    for (uint64_t size = 256; size < length; size *= 2) {
+        ++class;
+    }
+
+    return class < STORAGE_FREE_CLASSES ? class : -1;
+}
+
+static uint64_t storage_free_class_size(int class) {
+    return class < 16 ? (uint64_t) (class + 1) * 8 : 256ull << (class - 16);
+}
+
+static void storage_free_list_set(struct storage * storage, int class, uint64_t pointer) {
+    uint64_t offset = HEADER_FREE_LISTS + class * sizeof(uint64_t);
+
+    storage->free_lists[class] = pointer;
+    storage_write_at(storage, &offset, &pointer, sizeof(pointer));
+}
+
+// size that block for data of the length takes in file: the whole size class if it can be reused
+static uint64_t storage_block_size(const struct storage * storage, uint64_t length) {
+    const int class = storage->version >= 2 ? storage_free_class(length) : -1;
+
+    return class < 0 ? length : storage_free_class_size(class);
+}
+
+// returns offset of new block for data of the length at the end of file
+static uint64_t storage_extend(struct storage * storage, uint64_t length) {
+    const uint64_t offset = storage->size;
+    const uint64_t size = storage_block_size(storage, length);
+
+    // write the tail of the block, so the whole block is in file when it is reused
+    if (size > length) {
+        uint64_t tail = offset + length;
+        storage_write_zeros(storage, &tail, size - length);
+    }
+
+    return offset;
+}
+
+// returns offset of block for data of the length, reused from free list when possible;
+// files of older versions have no free lists and only grow
+static uint64_t storage_alloc(struct storage * storage, uint64_t length) {
+    const int class = storage->version >= 2 ? storage_free_class(length) : -1;
+
+    if (class < 0) {
+        return storage_extend(storage, length);
+    }
+
+    const uint64_t pointer = storage->free_lists[class];
+    if (pointer) {
+        uint64_t next_offset = pointer;
+
+        uint64_t next;
+        storage_read(storage, &next_offset, &next, sizeof(next));
+        storage_free_list_set(storage, class, next);
+
+        return pointer;
+    }
+
+    return storage_extend(storage, length);
+}
+
+// puts block that was allocated for data of the length into free list
+static void storage_free(struct storage * storage, uint64_t offset, uint64_t length) {
+    const int class = storage->version >= 2 ? storage_free_class(length) : -1;
+
+    if (class < 0 || offset == 0) {
+        return;
+    }
+
+    uint64_t pointer = offset;
+    storage_write_at(storage, &pointer, &storage->free_lists[class], sizeof(uint64_t));
+    storage_free_list_set(storage, class, offset);
+}
+
+// writes data to a new block and returns its offset
+static uint64_t storage_write(struct storage * storage, const void * buf, size_t length) {
+    const uint64_t offset = storage_alloc(storage, length);
+
+    uint64_t end = offset;
+    storage_write_at(storage, &end, buf, length);
+    return offset;
+}
+
+// writes data to a new block at the end of file and returns its offset
+static uint64_t storage_append(struct storage * storage, const void * buf, size_t length) {
+    const uint64_t offset = storage_extend(storage, length);
+
+    uint64_t end = offset;
+    storage_write_at(storage, &end, buf, length);
+    return offset;
+}
+
+static uint64_t storage_string_size(const char * str) {
+    return sizeof(uint16_t) + strlen(str);
+}
+
+// puts string into buffer and returns pointer after it
+static uint8_t * storage_put_string(uint8_t * buf, const char * str) {
+    const uint16_t length = strlen(str);
+
+    memcpy(buf, &length, sizeof(length));
+    memcpy(buf + sizeof(length), str, length);
+    return buf + sizeof(length) + length;
+}
+
+// string cell is string with terminator
+static uint64_t storage_string_cell_size(const char * str) {
+    return storage_string_size(str) + 1;
+}
+
+static uint8_t * storage_make_string_cell(const char * str, uint64_t * size) {
+    *size = storage_string_cell_size(str);
+
+    uint8_t * const buf = malloc(*size);
+    *storage_put_string(buf, str) = '\0';
+
+    return buf;
+}
+
+// out of row cell of value is 8 bytes long for int/uint/num values and string cell for str values
+static uint64_t storage_value_cell_size(const struct storage_value * value) {
+    return value->type == STORAGE_COLUMN_TYPE_STR ? storage_string_cell_size(value->value.str) : sizeof(uint64_t);
+}
+
+static void storage_put_value_cell(uint8_t * buf, const struct storage_value * value) {
+    if (value->type == STORAGE_COLUMN_TYPE_STR) {
+        *storage_put_string(buf, value->value.str) = '\0';
+        return;
+    }
+
+    memcpy(buf, &value->value, sizeof(uint64_t));
+}
+
+static char * storage_read_string(struct storage * storage, uint64_t * offset) {
+    uint16_t length;
+
+    storage_read(storage, offset, &length, sizeof(length));
+
+    char * str = malloc(sizeof(int8_t) * (length + 1));
+    storage_read(storage, offset, str, length);
+    str[length] = '\0';
+
+    return str;
+}
+
+// reads string into value without copying if it is mapped with terminator
+static void storage_read_string_value(struct storage * storage, uint64_t * offset, struct storage_value * value) {
+    pthread_mutex_lock(&storage->lock);
+    const uint8_t * const length_data = storage_view(storage, *offset, sizeof(uint16_t));
+
+    if (length_data) {
+        uint16_t length;
+        memcpy(&length, length_data, sizeof(length));
+
+        const uint8_t * const data = storage_view(storage, *offset + sizeof(length), length + 1);
+        if (data && data[length] == '\0') {
+            pthread_mutex_unlock(&storage->lock);
+
+            value->value.str = (char *) data;
+            value->view = true;
+
+            *offset += sizeof(length) + length;
+            return;
+        }
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+    value->value.str = storage_read_string(storage, offset);
+}
+
+static struct storage_table * storage_read_table(struct storage * storage, uint64_t pointer) {
+    uint64_t offset = pointer;
+
+    struct storage_table * table = malloc(sizeof(*table));
+    table->storage = storage;
+    table->position = pointer;
+
+    storage_read(storage, &offset, &table->next, sizeof(table->next));
+    storage_read(storage, &offset, &table->first_row, sizeof(table->first_row));
+
+    uint8_t format = STORAGE_TABLE_FORMAT_CELL_POINTERS;
+    if (storage->version >= 1) {
+        storage_read(storage, &offset, &format, sizeof(format));
+    }
+
+    table->compressed = storage->version >= 6 && (format & TABLE_FORMAT_COMPRESSED);
+    table->format = (enum storage_table_format) (format & ~TABLE_FORMAT_COMPRESSED);
+    table->name = storage_read_string(storage, &offset);
+
+    storage_read(storage, &offset, &table->columns.amount, sizeof(table->columns.amount));
+    table->columns.columns = malloc(sizeof(*table->columns.columns) * table->columns.amount);
+
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        table->columns.columns[i].name = storage_read_string(storage, &offset);
+
+        uint8_t type;
+        storage_read(storage, &offset, &type, sizeof(type));
+        table->columns.columns[i].type = (enum storage_column_type) type;
+        table->columns.columns[i].dictionary = false;
+    }
+
+    return table;
+}
+
+static uint32_t storage_hash_string(const char * str) {
+    uint32_t hash = 2166136261u;
+
+    for (; *str; ++str) {
+        hash = (hash ^ (uint8_t) *str) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint64_t storage_hash_string_64(const char * str) {
+    uint64_t hash = 14695981039346656037ull;
+
+    for (; *str; ++str) {
+        hash = (hash ^ (uint8_t) *str) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static struct storage_dictionary * storage_dictionary_new(uint64_t position) {
+    struct storage_dictionary * dictionary = malloc(sizeof(*dictionary));
+    dictionary->position = position;
+    dictionary->last_chunk = 0;
+
+    dictionary->amount = 0;
+    dictionary->capacity = 16;
+    dictionary->strings = malloc(sizeof(*dictionary->strings) * dictionary->capacity);
+    dictionary->hashes = malloc(sizeof(*dictionary->hashes) * dictionary->capacity);
+
+    dictionary->map_size = 2 * dictionary->capacity;
+    dictionary->map = calloc(dictionary->map_size, sizeof(*dictionary->map));
+
+    return dictionary;
+}
+
+static void storage_dictionary_delete(struct storage_dictionary * dictionary) {
+    if (dictionary) {
+        for (uint32_t i = 0; i < dictionary->amount; ++i) {
+            free(dictionary->strings[i]);
+        }
+
+        free(dictionary->strings);
+        free(dictionary->hashes);
+        free(dictionary->map);
+    }
+
+    free(dictionary);
+}
+
+static void storage_dictionary_link(struct storage_dictionary * dictionary, uint32_t code) {
+    uint32_t slot = dictionary->hashes[code] & (dictionary->map_size - 1);
+
+    while (dictionary->map[slot]) {
+        slot = (slot + 1) & (dictionary->map_size - 1);
+    }
+
+    dictionary->map[slot] = code + 1;
+}
+
+// gives the next code to the string, which is owned by dictionary since then;
+// map is kept at most half full
+static void storage_dictionary_put(struct storage_dictionary * dictionary, char * str) {
+    if (dictionary->amount == dictionary->capacity) {
+        dictionary->capacity *= 2;
+        dictionary->strings = realloc(dictionary->strings, sizeof(*dictionary->strings) * dictionary->capacity);
+        dictionary->hashes = realloc(dictionary->hashes, sizeof(*dictionary->hashes) * dictionary->capacity);
+    }
+
+    if (2 * (dictionary->amount + 1) > dictionary->map_size) {
+        dictionary->map_size *= 2;
+
+        free(dictionary->map);
+        dictionary->map = calloc(dictionary->map_size, sizeof(*dictionary->map));
+
+        for (uint32_t code = 0; code < dictionary->amount; ++code) {
+            storage_dictionary_link(dictionary, code);
+        }
+    }
+
+    const uint32_t code = dictionary->amount++;
+
+    dictionary->strings[code] = str;
+    dictionary->hashes[code] = storage_hash_string_64(str);
+    storage_dictionary_link(dictionary, code);
+}
+
+// finds code of the string, returns false when dictionary has no such string
+static bool storage_dictionary_find(const struct storage_dictionary * dictionary, const char * str, uint32_t * code) {
+    const uint64_t hash = storage_hash_string_64(str);
+
+    for (uint32_t slot = hash & (dictionary->map_size - 1); dictionary->map[slot]; slot = (slot + 1) & (dictionary->map_size - 1)) {
+        const uint32_t candidate = dictionary->map[slot] - 1;
+
+        if (dictionary->hashes[candidate] == hash && strcmp(dictionary->strings[candidate], str) == 0) {
+            *code = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static struct storage_catalog_entry ** storage_catalog_link(struct storage * storage, const char * name) {
+    struct storage_catalog_entry ** link = &storage->catalog[storage_hash_string(name) % STORAGE_CATALOG_BUCKETS];
+
+    while (*link && strcmp((*link)->table->name, name) != 0) {
+        link = &(*link)->next_in_bucket;
+    }
+
+    return link;
+}
+
+static struct storage_catalog_entry * storage_catalog_find(struct storage * storage, const char * name) {
+    return *storage_catalog_link(storage, name);
+}
+
+// adds table read from file to catalog, catalog owns it since then
+static void storage_catalog_add(struct storage * storage, struct storage_table * table) {
+    struct storage_catalog_entry * entry = malloc(sizeof(*entry));
+    entry->table = table;
+    entry->indexes = NULL;
+    entry->dictionaries = calloc(table->columns.amount, sizeof(*entry->dictionaries));
+    pthread_rwlock_init(&entry->lock, NULL);
+    entry->version = 0;
+
+    entry->columns_map_size = 4;
+    while (entry->columns_map_size < 2u * table->columns.amount) {
+        entry->columns_map_size *= 2;
+    }
+
+    entry->columns_map = calloc(entry->columns_map_size, sizeof(*entry->columns_map));
+
+    // the first column with the name wins as in linear search
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        uint32_t slot = storage_hash_string(table->columns.columns[i].name) & (entry->columns_map_size - 1);
+
+        while (entry->columns_map[slot] && strcmp(table->columns.columns[entry->columns_map[slot] - 1].name, table->columns.columns[i].name) != 0) {
+            slot = (slot + 1) & (entry->columns_map_size - 1);
+        }
+
+        if (!entry->columns_map[slot]) {
+            entry->columns_map[slot] = i + 1;
+        }
+    }
+
+    struct storage_catalog_entry ** link = &storage->catalog[storage_hash_string(table->name) % STORAGE_CATALOG_BUCKETS];
+    entry->next_in_bucket = *link;
+    *link = entry;
+}
+
+// removes table from catalog, the table is owned by caller since then
+static void storage_catalog_remove(struct storage * storage, const char * name) {
+    struct storage_catalog_entry ** link = storage_catalog_link(storage, name);
+    struct storage_catalog_entry * entry = *link;
+
+    if (entry) {
+        *link = entry->next_in_bucket;
+
+        while (entry->indexes) {
+            struct storage_index * const index = entry->indexes;
+
+            entry->indexes = index->next;
+            free(index);
+        }
+
+        for (uint16_t i = 0; i < entry->table->columns.amount; ++i) {
+            storage_dictionary_delete(entry->dictionaries[i]);
+        }
+
+        free(entry->dictionaries);
+
+        pthread_rwlock_destroy(&entry->lock);
+        free(entry->columns_map);
+        free(entry);
+    }
+}
+
+static struct storage_catalog_entry * storage_catalog_find_position(struct storage * storage, uint64_t position) {
+    for (unsigned int i = 0; i < STORAGE_CATALOG_BUCKETS; ++i) {
+        for (struct storage_catalog_entry * entry = storage->catalog[i]; entry; entry = entry->next_in_bucket) {
+            if (entry->table->position == position) {
+                return entry;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// indexes are kept in catalog entries of their tables
+static void storage_catalog_load_indexes(struct storage * storage) {
+    for (uint64_t pointer = storage->first_index; pointer; ) {
+        struct storage_index * index = malloc(sizeof(*index));
+        index->storage = storage;
+        index->position = pointer;
+
+        uint64_t next, table_position;
+        storage_read(storage, &pointer, &next, sizeof(next));
+        storage_read(storage, &pointer, &table_position, sizeof(table_position));
+        storage_read(storage, &pointer, &index->root, sizeof(index->root));
+        storage_read(storage, &pointer, &index->column, sizeof(index->column));
+
+        pointer = next;
+
+        struct storage_catalog_entry * const entry = storage_catalog_find_position(storage, table_position);
+        if (!entry || index->column >= entry->table->columns.amount) {
+            free(index);
+            continue;
+        }
+
+        index->type = entry->table->columns.columns[index->column].type;
+        index->next = entry->indexes;
+        entry->indexes = index;
+    }
+}
+
+// dictionaries are kept in catalog entries of their tables with all their strings
+static void storage_catalog_load_dictionaries(struct storage * storage) {
+    for (uint64_t pointer = storage->first_dictionary; pointer; ) {
+        const uint64_t position = pointer;
+
+        uint64_t next, table_position, chunk;
+        uint16_t column, reserved;
+        uint32_t amount;
+
+        storage_read(storage, &pointer, &next, sizeof(next));
+        storage_read(storage, &pointer, &table_position, sizeof(table_position));
+        storage_read(storage, &pointer, &column, sizeof(column));
+        storage_read(storage, &pointer, &reserved, sizeof(reserved));
+        storage_read(storage, &pointer, &amount, sizeof(amount));
+        storage_read(storage, &pointer, &chunk, sizeof(chunk));
+
+        pointer = next;
+
+        struct storage_catalog_entry * const entry = storage_catalog_find_position(storage, table_position);
+        if (!entry || column >= entry->table->columns.amount || entry->table->columns.columns[column].type != STORAGE_COLUMN_TYPE_STR) {
+            continue;
+        }
+
+        struct storage_dictionary * const dictionary = storage_dictionary_new(position);
+
+        for (uint32_t code = 0; code < amount; ++code) {
+            if (code > 0 && code % DICTIONARY_CHUNK_STRINGS == 0) {
+                uint64_t offset = chunk;
+                storage_read(storage, &offset, &chunk, sizeof(chunk));
+            }
+
+            uint64_t offset = chunk + (1 + code % DICTIONARY_CHUNK_STRINGS) * sizeof(uint64_t);
+
+            uint64_t cell;
+            storage_read(storage, &offset, &cell, sizeof(cell));
+            storage_dictionary_put(dictionary, storage_read_string(storage, &cell));
+        }
+
+        dictionary->last_chunk = amount > 0 ? chunk : 0;
+
+        storage_dictionary_delete(entry->dictionaries[column]);
+        entry->dictionaries[column] = dictionary;
+        entry->table->columns.columns[column].dictionary = true;
+    }
+}
+
+static void storage_catalog_load(struct storage * storage) {
+    for (uint64_t pointer = storage->first_table; pointer; ) {
+        struct storage_table * table = storage_read_table(storage, pointer);
+
+        storage_catalog_add(storage, table);
+        pointer = table->next;
+    }
+
+    storage_catalog_load_indexes(storage);
+    storage_catalog_load_dictionaries(storage);
+}
+
+static void storage_table_free(struct storage_table * table) {
+    if (table) {
+        free(table->name);
+
+        for (uint16_t i = 0; i < table->columns.amount; ++i) {
+            free(table->columns.columns[i].name);
+        }
+
+        free(table->columns.columns);
+    }
+
+    free(table);
+}
+
+static void storage_catalog_clear(struct storage * storage) {
+    for (unsigned int i = 0; i < STORAGE_CATALOG_BUCKETS; ++i) {
+        while (storage->catalog[i]) {
+            struct storage_table * table = storage->catalog[i]->table;
+
+            storage_catalog_remove(storage, table->name);
+            storage_table_free(table);
+        }
+    }
+}
+
+void storage_begin(struct storage * storage, enum storage_lock lock) {
+    if (lock == STORAGE_LOCK_SCHEMA) {
+        pthread_rwlock_wrlock(&storage->schema_lock);
+    } else {
+        pthread_rwlock_rdlock(&storage->schema_lock);
+    }
+
+    if (lock == STORAGE_LOCK_WRITE) {
+        pthread_mutex_lock(&storage->write_lock);
+    }
+
+    storage_request.storage = storage;
+    storage_request.lock = lock;
+    storage_request.amount = 0;
+    storage_request.damaged = false;
+}
+
+bool storage_read_failed(void) {
+    if (storage_request.damaged) {
+        errno = EIO;
+    }
+
+    return storage_request.damaged;
+}
+
+// commits writes of request and unlocks storage, returns commit to sync
+uint64_t storage_end(struct storage * storage) {
+    const enum storage_lock lock = storage_request.lock;
+
+    uint64_t commit = 0;
+    if (lock != STORAGE_LOCK_READ) {
+        commit = storage_commit(storage);
+    }
+
+    for (uint32_t i = 0; i < storage_request.amount; ++i) {
+        pthread_rwlock_unlock(&storage_request.entries[i]->lock);
+    }
+
+    free(storage_request.entries);
+    storage_request.storage = NULL;
+    storage_request.amount = 0;
+    storage_request.capacity = 0;
+    storage_request.entries = NULL;
+
+    if (lock == STORAGE_LOCK_WRITE) {
+        pthread_mutex_unlock(&storage->write_lock);
+    }
+
+    pthread_rwlock_unlock(&storage->schema_lock);
+    return commit;
+}
+
+// locks table for request of the thread once
+static void storage_request_lock(struct storage_catalog_entry * entry) {
+    if (storage_request.lock == STORAGE_LOCK_SCHEMA) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < storage_request.amount; ++i) {
+        if (storage_request.entries[i] == entry) {
+            return;
+        }
+    }
+
+    if (storage_request.amount == storage_request.capacity) {
+        storage_request.capacity = storage_request.capacity ? 2 * storage_request.capacity : 4;
+        storage_request.entries = realloc(storage_request.entries, storage_request.capacity * sizeof(*storage_request.entries));
+    }
+
+    if (storage_request.lock == STORAGE_LOCK_WRITE) {
+        pthread_rwlock_wrlock(&entry->lock);
+    } else {
+        pthread_rwlock_rdlock(&entry->lock);
+    }
+
+    storage_request.entries[storage_request.amount++] = entry;
+}
+
+// returns table from catalog, the table must not be modified besides by storage functions;
+// the table is locked until the end of request of the thread
+struct storage_table * storage_find_table(struct storage * storage, const char * name) {
+    struct storage_catalog_entry * entry = storage_catalog_find(storage, name);
+
+    if (entry && storage_request.storage == storage) {
+        storage_request_lock(entry);
+    }
+
+    return entry ? entry->table : NULL;
+}
+
+uint64_t storage_vacuum(struct storage * storage) {
+    uint64_t amount = 0;
+
+    for (unsigned int i = 0; i < STORAGE_CATALOG_BUCKETS; ++i) {
+        for (struct storage_catalog_entry * entry = storage->catalog[i]; entry; entry = entry->next_in_bucket) {
+            amount += storage_table_vacuum(entry->table);
+        }
+    }
+
+    return amount;
+}
+
+// tables from catalog are deleted with storage
+void storage_table_delete(struct storage_table * table) {
+    if (table) {
+        struct storage_catalog_entry * entry = storage_catalog_find(table->storage, table->name);
+
+        if (entry && entry->table == table) {
+            return;
+        }
+    }
+
+    storage_table_free(table);
+}
+
+int storage_table_find_column(const struct storage_table * table, const char * name) {
+    struct storage_catalog_entry * entry = storage_catalog_find(table->storage, table->name);
+
+    if (entry && entry->table == table) {
+        uint32_t slot = storage_hash_string(name) & (entry->columns_map_size - 1);
+
+        for (; entry->columns_map[slot]; slot = (slot + 1) & (entry->columns_map_size - 1)) {
+            if (strcmp(table->columns.columns[entry->columns_map[slot] - 1].name, name) == 0) {
+                return entry->columns_map[slot] - 1;
+            }
+        }
+
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        if (strcmp(table->columns.columns[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+uint64_t storage_table_get_version(const struct storage_table * table) {
+    struct storage_catalog_entry * entry = storage_catalog_find(table->storage, table->name);
+
+    return entry && entry->table == table ? entry->version : 0;
+}
+
+static struct storage * storage_new(int fd, int wal_fd, unsigned int flags) {
+    struct storage * storage = malloc(sizeof(*storage));
+
+    storage->fd = fd;
+    storage->version = 0;
+    storage->first_table = 0;
+    memset(storage->free_lists, 0, sizeof(storage->free_lists));
+    storage->first_index = 0;
+    storage->first_dictionary = 0;
+    memset(storage->catalog, 0, sizeof(storage->catalog));
+    storage->size = (uint64_t) lseek64(fd, 0, SEEK_END);
+    pthread_rwlock_init(&storage->schema_lock, NULL);
+    pthread_mutex_init(&storage->write_lock, NULL);
+    pthread_mutex_init(&storage->lock, NULL);
+    storage->map = NULL;
+    storage->map_size = 0;
+
+    storage_pool_init(storage);
+
+    storage->scans.amount = 0;
+    storage->scans.threads = NULL;
+    pthread_mutex_init(&storage->scans.lock, NULL);
+    pthread_cond_init(&storage->scans.queued, NULL);
+    pthread_cond_init(&storage->scans.finished, NULL);
+    storage->scans.jobs = NULL;
+    storage->scans.stopping = false;
+
+    if (flags & STORAGE_FLAG_MMAP) {
+        storage_map_init(storage);
+        storage_map_grow(storage);
+    }
+
+    storage->wal.fd = wal_fd;
+    storage->wal.flags = flags;
+    storage->wal.capacity = STORAGE_WAL_CAPACITY;
+    storage->wal.record.size = 0;
+    storage->wal.record.capacity = 0;
+    storage->wal.record.last = 0;
+    storage->wal.record.data = NULL;
+    storage->wal.start = 0;
+    storage->wal.end = 0;
+    storage->wal.synced = 0;
+    storage->wal.sync_requested = 0;
+    storage->wal.checkpoint_requested = 0;
+    storage->wal.stopping = false;
+
+    if (wal_fd >= 0) {
+        storage_wal_start(storage);
+    }
+
+    return storage;
+}
+
+static uint64_t storage_first_table_offset(const struct storage * storage) {
+    return storage->version == 0 ? HEADER_FIRST_TABLE_V0 : HEADER_FIRST_TABLE;
+}
+
+struct storage * storage_init(int fd, int wal_fd, unsigned int flags) {
+    if (wal_fd >= 0) {
+        storage_wal_reset(wal_fd);
+    }
+
+    struct storage * storage = storage_new(fd, wal_fd, flags);
+    storage->version = STORAGE_VERSION;
+
+    uint8_t header[HEADER_SIZE] = { 0 };
+    const uint64_t marker = VERSION_MARKER;
+
+    memcpy(header, SIGNATURE, 4);
+    memcpy(header + 4, &marker, sizeof(marker));
+    memcpy(header + 4 + sizeof(marker), &storage->version, sizeof(storage->version));
+
+    uint64_t offset = 0;
+    storage_write_at(storage, &offset, header, sizeof(header));
+
+    storage_sync(storage, storage_commit(storage));
+    return storage;
+}
+
+struct storage * storage_open(int fd, int wal_fd, unsigned int flags) {
+    if (wal_fd >= 0) {
+        storage_wal_recover(fd, wal_fd);
+    }
+
+    struct storage * storage = storage_new(fd, wal_fd, flags);
+
+    char sign[4];
+    if (storage->size < 4 + sizeof(storage->first_table)) {
+        storage_delete(storage);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    uint64_t offset = 0;
+    storage_read(storage, &offset, sign, 4);
+
+    if (memcmp(sign, SIGNATURE, 4) != 0) {
+        storage_delete(storage);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    uint64_t first_table;
+    storage_read(storage, &offset, &first_table, sizeof(first_table));
+
+    if (first_table != VERSION_MARKER) {
+        storage->version = 0;
+        storage->first_table = first_table;
+
+        storage_catalog_load(storage);
+        return storage;
+    }
+
+    storage_read(storage, &offset, &storage->version, sizeof(storage->version));
+
+    if (storage->version > STORAGE_VERSION || storage->size < HEADER_SIZE) {
+        storage_delete(storage);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    storage_read(storage, &offset, &storage->first_table, sizeof(storage->first_table));
+
+    if (storage->version >= 2) {
+        storage_read(storage, &offset, storage->free_lists, sizeof(storage->free_lists));
+    }
+
+    if (storage->version >= 3) {
+        storage_read(storage, &offset, &storage->first_index, sizeof(storage->first_index));
+    }
+
+    if (storage->version >= 5) {
+        storage_read(storage, &offset, &storage->first_dictionary, sizeof(storage->first_dictionary));
+    }
+
+    storage_catalog_load(storage);
+    return storage;
+}
+
+// writes back every page whose writes may get into storage file
+void storage_flush(struct storage * storage) {
+    const uint64_t synced = storage->wal.fd >= 0 ? storage_wal_get_synced(storage) : 0;
+
+    pthread_mutex_lock(&storage->lock);
+
+    for (unsigned int i = 0; i < storage->pool.amount; ++i) {
+        struct storage_page * const page = storage->pool.pages[i];
+
+        if (page->valid && page->dirty && storage_page_can_write_back(storage, page, synced)) {
+            storage_page_write_back(storage, page);
+        }
+    }
+
+    // mapping may be read again when file has every write
+    if (storage->pool.dirty == 0) {
+        storage_map_grow(storage);
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+}
+
+// position of the first record whose writes are not written back
+static uint64_t storage_wal_applied(struct storage * storage) {
+    uint64_t applied = storage->wal.end;
+
+    pthread_mutex_lock(&storage->lock);
+
+    for (unsigned int i = 0; i < storage->pool.amount; ++i) {
+        const struct storage_page * const page = storage->pool.pages[i];
+
+        if (page->valid && page->dirty && page->committed && page->first_record < applied) {
+            applied = page->first_record;
+        }
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+    return applied;
+}
+
+// makes room for record of the size in log: checkpoints the whole log
+// and grows it if the record is still bigger than the log
+static void storage_wal_reserve(struct storage * storage, uint64_t size) {
+    pthread_mutex_lock(&storage->wal.lock);
+    const bool fits = storage->wal.end + size - storage->wal.start <= storage->wal.capacity;
+    pthread_mutex_unlock(&storage->wal.lock);
+
+    if (fits) {
+        return;
+    }
+
+    storage_wal_wait_synced(storage, storage->wal.end);
+    storage_flush(storage);
+    storage_wal_checkpoint(storage, storage->wal.end, true);
+
+    if (size <= storage->wal.capacity) {
+        return;
+    }
+
+    uint64_t capacity = storage->wal.capacity;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    pthread_mutex_lock(&storage->wal.lock);
+    storage->wal.capacity = capacity;
+    pthread_mutex_unlock(&storage->wal.lock);
+
+    storage_wal_write_header(storage->wal.fd, capacity, storage->wal.end);
+    fdatasync(storage->wal.fd);
+}
+
+// writes writes of request into log by one record and returns the end of the record,
+// storage without log writes them into storage file
+uint64_t storage_commit(struct storage * storage) {
+    if (storage->wal.fd < 0) {
+        storage_flush(storage);
+        return 0;
+    }
+
+    if (storage->wal.record.size == 0) {
+        return storage->wal.end;
+    }
+
+    const uint64_t size = storage->wal.record.size;
+    storage_wal_reserve(storage, size);
+
+    const uint64_t position = storage->wal.end;
+    const uint64_t record_header[3] = { position, size, 0 };
+
+    uint8_t * const record = storage->wal.record.data;
+    memcpy(record, record_header, sizeof(record_header));
+
+    const uint64_t checksum = storage_wal_checksum(record, size);
+    memcpy(record + WAL_RECORD_CHECKSUM, &checksum, sizeof(checksum));
+
+    storage_wal_write(storage->wal.fd, storage->wal.capacity, position, record, size);
+    storage->wal.record.size = 0;
+
+    pthread_mutex_lock(&storage->wal.lock);
+    storage->wal.end = position + size;
+
+    if (storage->wal.flags & STORAGE_FLAG_SYNC_BATCH && storage->wal.sync_requested < storage->wal.end) {
+        storage->wal.sync_requested = storage->wal.end;
+        pthread_cond_broadcast(&storage->wal.changed);
+    }
+
+    const bool checkpoint = storage->wal.end - storage->wal.start > storage->wal.capacity / 2;
+    pthread_mutex_unlock(&storage->wal.lock);
+
+    pthread_mutex_lock(&storage->lock);
+
+    for (unsigned int i = 0; i < storage->pool.amount; ++i) {
+        struct storage_page * const page = storage->pool.pages[i];
+
+        if (!page->valid || !page->pending) {
+            continue;
+        }
+
+        if (!page->committed) {
+            page->committed = true;
+            page->first_record = position;
+        }
+
+        page->pending = false;
+        page->last_record_end = storage->wal.end;
+
+        free(page->committed_data);
+        page->committed_data = NULL;
+    }
+
+    pthread_mutex_unlock(&storage->lock);
+    storage_flush(storage);
+
+    if (checkpoint) {
+        storage_wal_checkpoint(storage, storage_wal_applied(storage), false);
+    }
+
+    return storage->wal.end;
+}
+
+// waits until the commit is durable if log is synced by commits
+void storage_sync(struct storage * storage, uint64_t commit) {
+    if (storage->wal.fd < 0 || !(storage->wal.flags & STORAGE_FLAG_SYNC_COMMIT)) {
+        return;
+    }
+
+    storage_wal_wait_synced(storage, commit);
+    storage_flush(storage);
+}
+
+static void storage_scan_threads_stop(struct storage * storage) {
+    pthread_mutex_lock(&storage->scans.lock);
+    storage->scans.stopping = true;
+    pthread_cond_broadcast(&storage->scans.queued);
+    pthread_mutex_unlock(&storage->scans.lock);
+
+    for (unsigned int i = 0; i < storage->scans.amount; ++i) {
+        pthread_join(storage->scans.threads[i], NULL);
+    }
+
+    storage->scans.amount = 0;
+    storage->scans.stopping = false;
+}
+
+void storage_delete(struct storage * storage) {
+    if (storage) {
+        storage_scan_threads_stop(storage);
+
+        if (storage->wal.fd >= 0) {
+            storage_commit(storage);
+            storage_wal_wait_synced(storage, storage->wal.end);
+        }
+
+        storage_flush(storage);
+
+        if (storage->wal.fd >= 0) {
+            fdatasync(storage->fd);
+            storage_wal_stop(storage);
+            storage_wal_reset(storage->wal.fd);
+            free(storage->wal.record.data);
+        }
+
+        for (unsigned int i = 0; i < storage->pool.amount; ++i) {
+            free(storage->pool.pages[i]->committed_data);
+            free(storage->pool.pages[i]);
+        }
+
+        free(storage->pool.pages);
+        pthread_cond_destroy(&storage->pool.loaded);
+
+        free(storage->scans.threads);
+        pthread_cond_destroy(&storage->scans.finished);
+        pthread_cond_destroy(&storage->scans.queued);
+        pthread_mutex_destroy(&storage->scans.lock);
+
+        storage_catalog_clear(storage);
+
+        if (storage->map) {
+            munmap(storage->map, STORAGE_MAP_RESERVE);
+        }
+
+        pthread_mutex_destroy(&storage->lock);
+        pthread_mutex_destroy(&storage->write_lock);
+        pthread_rwlock_destroy(&storage->schema_lock);
+    }
+
+    free(storage);
+}
+
+// dictionaries are made for str columns of tables with inline cells in files with zone maps,
+// other columns keep their strings in cells
+static void storage_table_add_dictionary(struct storage_catalog_entry * entry, uint16_t column) {
+    struct storage_table * const table = entry->table;
+    struct storage * const storage = table->storage;
+
+    if (table->format == STORAGE_TABLE_FORMAT_CELL_POINTERS || table->columns.columns[column].type != STORAGE_COLUMN_TYPE_STR
+        || storage->version < 4) {
+        return;
+    }
+
+    // older versions know nothing about dictionaries and must not open the file
+    if (storage->version < 5) {
+        uint64_t offset = 4 + sizeof(uint64_t);
+
+        storage->version = 5;
+        storage_write_at(storage, &offset, &storage->version, sizeof(storage->version));
+    }
+
+    uint8_t data[DICTIONARY_SIZE] = { 0 };
+    memcpy(data, &storage->first_dictionary, sizeof(uint64_t));
+    memcpy(data + sizeof(uint64_t), &table->position, sizeof(uint64_t));
+    memcpy(data + DICTIONARY_COLUMN, &column, sizeof(column));
+
+    storage->first_dictionary = storage_write(storage, data, sizeof(data));
+
+    uint64_t offset = HEADER_FIRST_DICTIONARY;
+    storage_write_at(storage, &offset, &storage->first_dictionary, sizeof(storage->first_dictionary));
+
+    entry->dictionaries[column] = storage_dictionary_new(storage->first_dictionary);
+    table->columns.columns[column].dictionary = true;
+}
+
+// unlinks dictionaries of the table from file and frees them with their chunks and strings
+static void storage_table_remove_dictionaries(struct storage_table * table) {
+    struct storage * const storage = table->storage;
+    struct storage_catalog_entry * const entry = storage_catalog_find(storage, table->name);
+
+    if (!entry || entry->table->position != table->position) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        struct storage_dictionary * const dictionary = entry->dictionaries[i];
+
+        if (!dictionary) {
+            continue;
+        }
+
+        uint64_t offset = dictionary->position;
+
+        uint64_t next;
+        storage_read(storage, &offset, &next, sizeof(next));
+
+        uint64_t pointer = storage->first_dictionary;
+        while (pointer) {
+            offset = pointer;
+
+            uint64_t pointer_next;
+            storage_read(storage, &offset, &pointer_next, sizeof(pointer_next));
+
+            if (pointer_next == dictionary->position) {
+                break;
+            }
+
+            pointer = pointer_next;
+        }
+
+        if (pointer == 0) {
+            pointer = HEADER_FIRST_DICTIONARY;
+            storage->first_dictionary = next;
+        }
+
+        storage_write_at(storage, &pointer, &next, sizeof(next));
+
+        offset = dictionary->position + DICTIONARY_FIRST_CHUNK;
+
+        uint64_t chunk;
+        storage_read(storage, &offset, &chunk, sizeof(chunk));
+
+        for (uint32_t code = 0; code < dictionary->amount; ++code) {
+            if (code > 0 && code % DICTIONARY_CHUNK_STRINGS == 0) {
+                const uint64_t previous = chunk;
+
+                offset = chunk;
+                storage_read(storage, &offset, &chunk, sizeof(chunk));
+                storage_free(storage, previous, STORAGE_DICTIONARY_CHUNK_SIZE);
+            }
+
+            offset = chunk + (1 + code % DICTIONARY_CHUNK_STRINGS) * sizeof(uint64_t);
+
+            uint64_t cell;
+            storage_read(storage, &offset, &cell, sizeof(cell));
+            storage_free(storage, cell, storage_string_cell_size(dictionary->strings[code]));
+        }
+
+        storage_free(storage, chunk, STORAGE_DICTIONARY_CHUNK_SIZE);
+        storage_free(storage, dictionary->position, DICTIONARY_SIZE);
+    }
+}
+
+// returns code of the string, it is added to dictionary and its chunks when it is new
+static uint32_t storage_dictionary_encode(struct storage * storage, struct storage_dictionary * dictionary, const char * str) {
+    uint32_t code;
+
+    if (storage_dictionary_find(dictionary, str, &code)) {
+        return code;
+    }
+
+    code = dictionary->amount;
+
+    uint64_t size;
+    uint8_t * const cell = storage_make_string_cell(str, &size);
+
+    const uint64_t pointer = storage_write(storage, cell, size);
+    free(cell);
+
+    uint64_t offset;
+    if (code % DICTIONARY_CHUNK_STRINGS == 0) {
+        const uint64_t chunk = storage_alloc(storage, STORAGE_DICTIONARY_CHUNK_SIZE);
+
+        offset = chunk;
+        storage_write_zeros(storage, &offset, STORAGE_DICTIONARY_CHUNK_SIZE);
+
+        offset = dictionary->last_chunk ? dictionary->last_chunk : dictionary->position + DICTIONARY_FIRST_CHUNK;
+        storage_write_at(storage, &offset, &chunk, sizeof(chunk));
+
+        dictionary->last_chunk = chunk;
+    }
+
+    offset = dictionary->last_chunk + (1 + code % DICTIONARY_CHUNK_STRINGS) * sizeof(uint64_t);
+    storage_write_at(storage, &offset, &pointer, sizeof(pointer));
+
+    // the string is in its chunk before it is counted
+    const uint32_t amount = code + 1;
+    offset = dictionary->position + DICTIONARY_AMOUNT;
+    storage_write_at(storage, &offset, &amount, sizeof(amount));
+
+    storage_dictionary_put(dictionary, strdup(str));
+    return code;
+}
+
+static struct storage_dictionary * storage_table_get_dictionary(const struct storage_table * table, uint16_t column) {
+    if (!table->columns.columns[column].dictionary) {
+        return NULL;
+    }
+
+    struct storage_catalog_entry * entry = storage_catalog_find(table->storage, table->name);
+
+    return entry && entry->table->position == table->position ? entry->dictionaries[column] : NULL;
+}
+
+static uint64_t storage_table_header_size(const struct storage_table * table) {
+    uint64_t size = 2 * sizeof(uint64_t) + storage_string_size(table->name) + sizeof(table->columns.amount);
+
+    if (table->storage->version >= 1) {
+        size += sizeof(uint8_t);
+    }
+
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        size += storage_string_size(table->columns.columns[i].name) + sizeof(uint8_t);
+    }
+
+    return size;
+}
+
+void storage_table_add(struct storage_table * table) {
+    struct storage * const storage = table->storage;
+    struct storage_table * another_table = storage_find_table(storage, table->name);
+
+    if (another_table != NULL) {
+        storage_table_delete(another_table);
+        errno = EINVAL;
+        return;
+    }
+
+    // tables of old files have no format field
+    if (storage->version == 0) {
+        table->format = STORAGE_TABLE_FORMAT_CELL_POINTERS;
+    }
+
+    // bodies are made for columnar tables of files with zone maps, other tables are not compressed
+    if (table->format != STORAGE_TABLE_FORMAT_COLUMNAR || storage->version < 4) {
+        table->compressed = false;
+    }
+
+    // older versions know nothing about bodies and must not open the file
+    if (table->compressed && storage->version < 6) {
+        uint64_t offset = 4 + sizeof(uint64_t);
+
+        storage->version = 6;
+        storage_write_at(storage, &offset, &storage->version, sizeof(storage->version));
+    }
+
+    table->next = storage->first_table;
+
+    const uint64_t header_size = storage_table_header_size(table);
+    uint8_t * const header = malloc(header_size);
+    uint8_t * ptr = header;
+
+    memcpy(ptr, &table->next, sizeof(table->next));
+    ptr += sizeof(table->next);
+
+    memcpy(ptr, &table->first_row, sizeof(table->first_row));
+    ptr += sizeof(table->first_row);
+
+    if (storage->version >= 1) {
+        *ptr++ = (uint8_t) table->format | (table->compressed ? TABLE_FORMAT_COMPRESSED : 0);
+    }
+
+    ptr = storage_put_string(ptr, table->name);
+
+    memcpy(ptr, &table->columns.amount, sizeof(table->columns.amount));
+    ptr += sizeof(table->columns.amount);
+
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        ptr = storage_put_string(ptr, table->columns.columns[i].name);
+        *ptr++ = (uint8_t) table->columns.columns[i].type;
+    }
+
+    table->position = storage_write(storage, header, header_size);
+    storage->first_table = table->position;
+    free(header);
+
+    uint64_t offset = storage_first_table_offset(storage);
+    storage_write_at(storage, &offset, &table->position, sizeof(table->position));
+
+    storage_catalog_add(storage, storage_read_table(storage, table->position));
+
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        if (table->columns.columns[i].dictionary) {
+            storage_table_add_dictionary(storage_catalog_find(storage, table->name), i);
+        }
+    }
+}
+
+static uint16_t storage_row_bitmap_size(const struct storage_table * table) {
+    return (table->columns.amount + 7) / 8;
+}
+
+// offset of cell pointer or inline cell of column from row start
+static uint64_t storage_row_cell_offset(const struct storage_table * table, uint16_t index) {
+    switch (table->format) {
+        case STORAGE_TABLE_FORMAT_INLINE:
+            return sizeof(uint64_t) + storage_row_bitmap_size(table) + index * sizeof(uint64_t);
+
+        default:
+            return (1 + index) * sizeof(uint64_t);
+    }
+}
+
+static uint64_t storage_row_size(const struct storage_table * table) {
+    return storage_row_cell_offset(table, table->columns.amount);
+}
+
+static uint64_t storage_row_group_column_size(uint32_t capacity) {
+    return capacity / 8 + capacity * sizeof(uint64_t);
+}
+
+static bool storage_table_has_zone_maps(const struct storage_table * table) {
+    return table->format == STORAGE_TABLE_FORMAT_COLUMNAR && table->storage->version >= 4;
+}
+
+static uint64_t storage_row_group_zone_maps_size(const struct storage_table * table) {
+    return storage_table_has_zone_maps(table) ? table->columns.amount * sizeof(struct storage_zone) : 0;
+}
+
+// offset of columns or of body pointer from row group start
+static uint64_t storage_row_group_columns_offset(const struct storage_table * table, uint32_t capacity) {
+    return ROW_GROUP_HEADER_SIZE + capacity / 8 + storage_row_group_zone_maps_size(table);
+}
+
+// size of columns without strings of body
+static uint64_t storage_row_group_columns_size(const struct storage_table * table, uint32_t capacity) {
+    return table->columns.amount * storage_row_group_column_size(capacity);
+}
+
+static uint64_t storage_row_group_size(const struct storage_table * table, uint32_t capacity) {
+    if (table->compressed) {
+        return storage_row_group_columns_offset(table, capacity) + sizeof(struct storage_row_group_body);
+    }
+
+    return storage_row_group_columns_offset(table, capacity) + storage_row_group_columns_size(table, capacity);
+}
+
+// offset of zone map of column from row group start
+static uint64_t storage_row_group_zone_offset(uint32_t capacity, uint16_t index) {
+    return ROW_GROUP_HEADER_SIZE + capacity / 8 + index * sizeof(struct storage_zone);
+}
+
+// position of validity bitmap of column of row group, cells follow it
+static uint64_t storage_row_group_validity(const struct storage_row * row, uint16_t index) {
+    return row->columns + index * storage_row_group_column_size(row->slot.capacity);
+}
+
+// compressed body is read from virtual offsets
+static bool storage_row_group_is_compressed(const struct storage_row * row) {
+    return row->columns >= ROW_GROUP_INFLATED;
+}
+
+// position of string cell by pointer of cell, pointers into body are offsets from its start
+static uint64_t storage_row_cell_pointer(const struct storage_row * row, uint64_t pointer) {
+    return pointer & ROW_GROUP_BODY_CELL ? row->columns + (pointer & ~ROW_GROUP_BODY_CELL) : pointer;
+}
+
+static bool storage_row_group_get_bit(struct storage * storage, uint64_t bitmap, uint32_t index) {
+    uint64_t offset = bitmap + index / 8;
+
+    uint8_t bits;
+    storage_read(storage, &offset, &bits, sizeof(bits));
+
+    return (bits >> (index % 8)) & 1;
+}
+
+static void storage_row_group_set_bit(struct storage * storage, uint64_t bitmap, uint32_t index, bool bit) {
+    uint64_t offset = bitmap + index / 8;
+
+    uint8_t bits;
+    storage_read(storage, &offset, &bits, sizeof(bits));
+
+    if (bit) {
+        bits |= 1 << (index % 8);
+    } else {
+        bits &= ~(1 << (index % 8));
+    }
+
+    offset -= sizeof(bits);
+    storage_write_at(storage, &offset, &bits, sizeof(bits));
+}
+
+static void storage_row_group_read_header(struct storage * storage, struct storage_row * row) {
+    uint64_t offset = row->position;
+
+    storage_read(storage, &offset, &row->next, sizeof(row->next));
+    storage_read(storage, &offset, &row->slot.capacity, sizeof(row->slot.capacity));
+    storage_read(storage, &offset, &row->slot.index, sizeof(row->slot.index));
+
+    row->columns = row->position + storage_row_group_columns_offset(row->table, row->slot.capacity);
+
+    if (row->table->compressed) {
+        const uint64_t pointer = row->columns;
+
+        struct storage_row_group_body body;
+        storage_read(storage, &row->columns, &body, sizeof(body));
+
+        row->columns = body.stored_size < body.size ? ROW_GROUP_INFLATED | pointer << ROW_GROUP_INFLATED_SHIFT : body.pointer;
+    }
+}
+
+static uint64_t storage_zone_string_key(const char * str, size_t length) {
+    uint64_t key = 0;
+
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        key = key << 8 | (i < length ? (uint8_t) str[i] : 0);
+    }
+
+    return key;
+}
+
+// key of value in zone map: value itself or first bytes of string
+static uint64_t storage_zone_key(const struct storage_value * value) {
+    if (value->type == STORAGE_COLUMN_TYPE_STR) {
+        return storage_zone_string_key(value->value.str, strnlen(value->value.str, sizeof(uint64_t)));
+    }
+
+    return value->value.uint;
+}
+
+// key of inline cell, strings are read from their cells or taken from dictionary by codes
+static uint64_t storage_zone_cell_key(struct storage * storage, enum storage_column_type type,
+    const struct storage_dictionary * dictionary, uint64_t cell) {
+    if (type != STORAGE_COLUMN_TYPE_STR) {
+        return cell;
+    }
+
+    if (dictionary) {
+        const char * const str = dictionary->strings[cell];
+
+        return storage_zone_string_key(str, strnlen(str, sizeof(uint64_t)));
+    }
+
+    uint16_t length;
+    storage_read(storage, &cell, &length, sizeof(length));
+
+    char prefix[sizeof(uint64_t)];
+    if (length > sizeof(prefix)) {
+        length = sizeof(prefix);
+    }
+
+    storage_read(storage, &cell, prefix, length);
+    return storage_zone_string_key(prefix, length);
+}
+
+static int storage_zone_compare_keys(enum storage_column_type type, uint64_t a, uint64_t b) {
+    switch (type) {
+        case STORAGE_COLUMN_TYPE_INT:
+            return ((int64_t) a > (int64_t) b) - ((int64_t) a < (int64_t) b);
+
+        case STORAGE_COLUMN_TYPE_NUM: {
+            double x, y;
+            memcpy(&x, &a, sizeof(x));
+            memcpy(&y, &b, sizeof(y));
+
+            return (x > y) - (x < y);
+        }
+
+        default:
+            return (a > b) - (a < b);
+    }
+}
+
+static void storage_zone_widen(struct storage_zone * zone, enum storage_column_type type, uint64_t key) {
+    if (type == STORAGE_COLUMN_TYPE_NUM) {
+        double value;
+        memcpy(&value, &key, sizeof(value));
+
+        // NaN is not ordered with bounds
+        if (value != value) {
+            zone->flags |= STORAGE_ZONE_FLAG_NAN;
+            return;
+        }
+    }
+
+    if (!(zone->flags & STORAGE_ZONE_FLAG_BOUNDS)) {
+        zone->min = key;
+        zone->max = key;
+        zone->flags |= STORAGE_ZONE_FLAG_BOUNDS;
+        return;
+    }
+
+    if (storage_zone_compare_keys(type, key, zone->min) < 0) {
+        zone->min = key;
+    }
+
+    if (storage_zone_compare_keys(type, key, zone->max) > 0) {
+        zone->max = key;
+    }
+}
+
+static void storage_row_group_read_zones(struct storage * storage, const struct storage_row * row, struct storage_zone * zones) {
+    uint64_t offset = row->position + storage_row_group_zone_offset(row->slot.capacity, 0);
+
+    storage_read(storage, &offset, zones, row->table->columns.amount * sizeof(*zones));
+}
+
+static void storage_row_group_write_zones(struct storage * storage, const struct storage_row * row, const struct storage_zone * zones) {
+    uint64_t offset = row->position + storage_row_group_zone_offset(row->slot.capacity, 0);
+
+    storage_write_at(storage, &offset, zones, row->table->columns.amount * sizeof(*zones));
+}
+
+static bool storage_row_is_null(struct storage_row * row, uint16_t index) {
+    struct storage * const storage = row->table->storage;
+
+    // columnar tables keep validity bitmaps, so zeroed row group has only NULLs
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        return !storage_row_group_get_bit(storage, storage_row_group_validity(row, index), row->slot.index);
+    }
+
+    return storage_row_group_get_bit(storage, row->position + sizeof(uint64_t), index);
+}
+
+// adds NULL cells of row to amounts of NULL cells of zone maps or takes them away
+static void storage_row_count_zone_nulls(struct storage_row * row, int delta) {
+    struct storage_zone * const zones = malloc(sizeof(*zones) * row->table->columns.amount);
+    storage_row_group_read_zones(row->table->storage, row, zones);
+
+    for (uint16_t i = 0; i < row->table->columns.amount; ++i) {
+        if (storage_row_is_null(row, i)) {
+            zones[i].nulls += delta;
+        }
+    }
+
+    storage_row_group_write_zones(row->table->storage, row, zones);
+    free(zones);
+}
+
+// widens zone map of column by value written into the row and counts change of NULL cell
+static void storage_row_update_zone(struct storage_row * row, uint16_t index, const struct storage_value * value) {
+    struct storage * const storage = row->table->storage;
+    const bool was_null = storage_row_is_null(row, index);
+
+    struct storage_zone zone;
+    uint64_t offset = row->position + storage_row_group_zone_offset(row->slot.capacity, index);
+    storage_read(storage, &offset, &zone, sizeof(zone));
+
+    if (value) {
+        storage_zone_widen(&zone, value->type, storage_zone_key(value));
+
+        if (was_null) {
+            --zone.nulls;
+        }
+    } else if (!was_null) {
+        ++zone.nulls;
+    }
+
+    offset -= sizeof(zone);
+    storage_write_at(storage, &offset, &zone, sizeof(zone));
+}
+
+// moves row to the previous not deleted slot, going to the next row groups if needed;
+// slots are walked backwards, so the newest rows go first as in row tables
+static struct storage_row * storage_row_group_seek(struct storage_row * row) {
+    struct storage * const storage = row->table->storage;
+
+    while (true) {
+        while (row->slot.index > 0) {
+            --row->slot.index;
+
+            if (!storage_row_group_get_bit(storage, row->position + ROW_GROUP_HEADER_SIZE, row->slot.index)) {
+                return row;
+            }
+        }
+
+        if (row->next == 0) {
+            free(row);
+            return NULL;
+        }
+
+        row->position = row->next;
+        storage_row_group_read_header(storage, row);
+    }
+}
+
+// reference to row in index: row position or row group position with slot
+static uint64_t storage_row_get_reference(const struct storage_row * row) {
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        return row->position << 16 | row->slot.index;
+    }
+
+    return row->position;
+}
+
+static void storage_row_seek_reference(struct storage_row * row, uint64_t reference) {
+    struct storage * const storage = row->table->storage;
+
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        row->position = reference >> 16;
+        storage_row_group_read_header(storage, row);
+
+        row->slot.index = reference & 0xFFFF;
+        return;
+    }
+
+    row->position = reference;
+
+    uint64_t offset = row->position;
+    storage_read(storage, &offset, &row->next, sizeof(row->next));
+}
+
+struct storage_row * storage_table_get_first_row(struct storage_table * table) {
+    if (table->first_row == 0) {
+        return NULL;
+    }
+
+    struct storage_row * row = malloc(sizeof(*row));
+    row->position = table->first_row;
+    row->table = table;
+    row->scan = NULL;
+
+    if (table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        storage_row_group_read_header(table->storage, row);
+        return storage_row_group_seek(row);
+    }
+
+    uint64_t offset = row->position;
+    storage_read(table->storage, &offset, &row->next, sizeof(row->next));
+
+    return row;
+}
+
+// reserves up to wanted slots after the last used slot of the first row group, adds new row group
+// when it is full; row is moved to the first reserved slot, returns amount of reserved slots
+static uint32_t storage_row_group_reserve(struct storage_table * table, struct storage_row * row, uint64_t wanted) {
+    struct storage * const storage = table->storage;
+
+    row->position = table->first_row;
+
+    uint32_t amount = 0;
+    if (row->position) {
+        storage_row_group_read_header(storage, row);
+        amount = row->slot.index;
+    }
+
+    // new row group is twice bigger than previous one, compressed body is not appended to
+    if (row->position == 0 || amount == row->slot.capacity || storage_row_group_is_compressed(row)) {
+        uint32_t capacity = STORAGE_ROW_GROUP_MIN_ROWS;
+        if (row->position != 0) {
+            capacity = row->slot.capacity * 2 > STORAGE_ROW_GROUP_MAX_ROWS ? STORAGE_ROW_GROUP_MAX_ROWS : row->slot.capacity * 2;
+        }
+
+        row->next = table->first_row;
+        row->slot.capacity = capacity;
+        row->position = storage_alloc(storage, storage_row_group_size(table, capacity));
+        amount = 0;
+
+        // reused block is not zeroed
+        uint64_t offset = row->position;
+        storage_write_zeros(storage, &offset, storage_row_group_size(table, capacity));
+
+        offset = row->position;
+        storage_write_at(storage, &offset, &row->next, sizeof(row->next));
+        storage_write_at(storage, &offset, &row->slot.capacity, sizeof(row->slot.capacity));
+
+        row->columns = row->position + storage_row_group_columns_offset(table, capacity);
+
+        // new body is not compressed until vacuum
+        if (table->compressed) {
+            struct storage_row_group_body body = { .size = storage_row_group_columns_size(table, capacity) };
+            body.stored_size = body.size;
+            body.pointer = storage_alloc(storage, body.size);
+
+            offset = body.pointer;
+            storage_write_zeros(storage, &offset, body.size);
+
+            offset = row->columns;
+            storage_write_at(storage, &offset, &body, sizeof(body));
+
+            row->columns = body.pointer;
+        }
+
+        table->first_row = row->position;
+
+        offset = table->position + sizeof(uint64_t);
+        storage_write_at(storage, &offset, &table->first_row, sizeof(table->first_row));
+    }
+
+    const uint32_t reserved = wanted < row->slot.capacity - amount ? (uint32_t) wanted : row->slot.capacity - amount;
+
+    row->slot.index = amount;
+    amount += reserved;
+
+    uint64_t offset = row->position + sizeof(uint64_t) + sizeof(uint32_t);
+    storage_write_at(storage, &offset, &amount, sizeof(amount));
+
+    return reserved;
+}
+
+static struct storage_row * storage_table_add_row_columnar(struct storage_table * table) {
+    struct storage_row * row = malloc(sizeof(*row));
+
+    row->table = table;
+    row->scan = NULL;
+
+    storage_row_group_reserve(table, row, 1);
+
+    // cells of new row are NULL
+    if (storage_table_has_zone_maps(table)) {
+        storage_row_count_zone_nulls(row, 1);
+    }
+
+    return row;
+}
+
+struct storage_row * storage_table_add_row(struct storage_table * table) {
+    if (table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        return storage_table_add_row_columnar(table);
+    }
+
+    struct storage * const storage = table->storage;
+    struct storage_row * row = malloc(sizeof(*row));
+
+    row->table = table;
+    row->next = table->first_row;
+    row->scan = NULL;
+
+    // new row has all cells NULL: zero pointers or set bits of null bitmap
+    const uint64_t row_size = storage_row_size(table);
+    uint8_t * const data = calloc(1, row_size);
+
+    memcpy(data, &row->next, sizeof(row->next));
+    if (table->format == STORAGE_TABLE_FORMAT_INLINE) {
+        memset(data + sizeof(row->next), 0xFF, storage_row_bitmap_size(table));
+    }
+
+    row->position = storage_write(storage, data, row_size);
+    table->first_row = row->position;
+    free(data);
+
+    uint64_t offset = table->position + sizeof(uint64_t);
+    storage_write_at(storage, &offset, &table->first_row, sizeof(table->first_row));
+    return row;
+}
+
+void storage_row_delete(struct storage_row * row) {
+    free(row);
+}
+
+struct storage_row * storage_row_next(struct storage_row * row) {
+    if (row->scan) {
+        if (++row->scan_index == row->scan->amount) {
+            free(row);
+            return NULL;
+        }
+
+        storage_row_seek_reference(row, row->scan->rows[row->scan_index]);
+        return row;
+    }
+
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        return storage_row_group_seek(row);
+    }
+
+    row->position = row->next;
+
+    if (row->next == 0) {
+        free(row);
+        return NULL;
+    }
+
+    uint64_t offset = row->position;
+    storage_read(row->table->storage, &offset, &row->next, sizeof(row->next));
+    return row;
+}
+
+static struct storage_index * storage_table_get_indexes(const struct storage_table * table) {
+    struct storage_catalog_entry * entry = storage_catalog_find(table->storage, table->name);
+
+    return entry && entry->table->position == table->position ? entry->indexes : NULL;
+}
+
+// rows kept by positions since the previous version may be gone
+static void storage_table_change_version(const struct storage_table * table) {
+    struct storage_catalog_entry * entry = storage_catalog_find(table->storage, table->name);
+
+    if (entry && entry->table->position == table->position) {
+        ++entry->version;
+    }
+}
+
+static struct storage_index * storage_table_find_index(const struct storage_table * table, uint16_t column) {
+    for (struct storage_index * index = storage_table_get_indexes(table); index; index = index->next) {
+        if (index->column == column) {
+            return index;
+        }
+    }
+
+    return NULL;
+}
+
+static void storage_index_read_node(struct storage * storage, uint64_t position, struct storage_index_node * node) {
+    storage_read(storage, &position, node, sizeof(*node));
+}
+
+static void storage_index_write_node(struct storage * storage, uint64_t position, const struct storage_index_node * node) {
+    storage_write_at(storage, &position, node, sizeof(*node));
+}
+
+static void storage_index_set_root(struct storage_index * index, uint64_t root) {
+    uint64_t offset = index->position + INDEX_ROOT;
+
+    index->root = root;
+    storage_write_at(index->storage, &offset, &root, sizeof(root));
+}
+
+static uint64_t storage_index_make_key(struct storage_index * index, const struct storage_value * value) {
+    if (index->type == STORAGE_COLUMN_TYPE_STR) {
+        uint64_t size;
+        uint8_t * const cell = storage_make_string_cell(value->value.str, &size);
+
+        const uint64_t pointer = storage_write(index->storage, cell, size);
+        free(cell);
+
+        return pointer;
+    }
+
+    // all fixed-width values are 8 bytes long
+    uint64_t key;
+    memcpy(&key, &value->value, sizeof(key));
+    return key;
+}
+
+static void storage_index_read_key(struct storage_index * index, uint64_t key, struct storage_value * value) {
+    value->type = index->type;
+    value->view = false;
+
+    if (index->type == STORAGE_COLUMN_TYPE_STR) {
+        storage_read_string_value(index->storage, &key, value);
+        return;
+    }
+
+    memcpy(&value->value, &key, sizeof(key));
+}
+
+static void storage_index_free_key(struct storage_index * index, uint64_t key) {
+    if (index->type == STORAGE_COLUMN_TYPE_STR) {
+        uint64_t offset = key;
+
+        uint16_t length;
+        storage_read(index->storage, &offset, &length, sizeof(length));
+
+        storage_free(index->storage, key, sizeof(length) + length + 1);
+    }
+}
+
+// string keys are owned by entries, so separators get their own copies
+static uint64_t storage_index_copy_key(struct storage_index * index, uint64_t key) {
+    if (index->type != STORAGE_COLUMN_TYPE_STR) {
+        return key;
+    }
+
+    struct storage_value value;
+    storage_index_read_key(index, key, &value);
+
+    key = storage_index_make_key(index, &value);
+    storage_value_destroy(value);
+
+    return key;
+}
+
+// string key is compared as by storage_value_compare by chunks of its cell, so it is not copied
+static int storage_index_compare_key(struct storage_index * index, uint64_t key, const struct storage_value * value) {
+    if (index->type != STORAGE_COLUMN_TYPE_STR) {
+        struct storage_value key_value;
+        storage_index_read_key(index, key, &key_value);
+
+        return storage_value_compare(&key_value, value);
+    }
+
+    // numbers go before strings
+    if (value->type != STORAGE_COLUMN_TYPE_STR) {
+        return 1;
+    }
+
+    const unsigned char * const str = (const unsigned char *) value->value.str;
+
+    uint16_t length;
+    storage_read(index->storage, &key, &length, sizeof(length));
+
+    unsigned char chunk[256];
+    for (uint16_t done = 0; done < length; ) {
+        const uint16_t size = length - done < sizeof(chunk) ? length - done : sizeof(chunk);
+        storage_read(index->storage, &key, chunk, size);
+
+        // the value ends with its terminator, which differs from bytes of the key
+        for (uint16_t i = 0; i < size; ++i) {
+            if (chunk[i] != str[done + i]) {
+                return chunk[i] < str[done + i] ? -1 : 1;
+            }
+        }
+
+        done += size;
+    }
+
+    return str[length] == '\0' ? 0 : -1;
+}
+
+static int storage_index_compare_entry(struct storage_index * index,
+    const struct storage_index_entry * entry, const struct storage_value * value, uint64_t row) {
+    const int result = storage_index_compare_key(index, entry->key, value);
+
+    if (result != 0) {
+        return result;
+    }
+
+    return entry->row < row ? -1 : entry->row > row;
+}
+
+// amount of node entries that are less or equal to (value, row)
+static uint16_t storage_index_upper_bound(struct storage_index * index,
+    const struct storage_index_node * node, const struct storage_value * value, uint64_t row) {
+    uint16_t low = 0, high = node->amount;
+
+    while (low < high) {
+        const uint16_t middle = (low + high) / 2;
+
+        if (storage_index_compare_entry(index, &node->entries[middle], value, row) <= 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static bool storage_index_is_above(struct storage_index * index, uint64_t key, const struct storage_value * low, bool inclusive) {
+    if (!low) {
+        return true;
+    }
+
+    const int result = storage_index_compare_key(index, key, low);
+    return result > 0 || (inclusive && result == 0);
+}
+
+static bool storage_index_is_below(struct storage_index * index, uint64_t key, const struct storage_value * high, bool inclusive) {
+    if (!high) {
+        return true;
+    }
+
+    const int result = storage_index_compare_key(index, key, high);
+    return result < 0 || (inclusive && result == 0);
+}
+
+// splits full child of not full inner node, right half goes to a new node after the child
+static void storage_index_split_child(struct storage_index * index, struct storage_index_node * node,
+    uint64_t position, uint16_t i, struct storage_index_node * child) {
+    struct storage_index_node * const right = calloc(1, sizeof(*right));
+    const uint16_t half = child->amount / 2;
+
+    struct storage_index_entry separator;
+    right->leaf = child->leaf;
+
+    if (child->leaf) {
+        // leaves keep all entries, separator is the first entry of the right leaf
+        right->amount = child->amount - half;
+        right->next = child->next;
+        memcpy(right->entries, child->entries + half, right->amount * sizeof(*right->entries));
+
+        separator = right->entries[0];
+        separator.key = storage_index_copy_key(index, separator.key);
+    } else {
+        right->amount = child->amount - half - 1;
+        memcpy(right->entries, child->entries + half + 1, right->amount * sizeof(*right->entries));
+        memcpy(right->children, child->children + half + 1, (right->amount + 1) * sizeof(*right->children));
+
+        separator = child->entries[half];
+    }
+
+    child->amount = half;
+
+    const uint64_t right_position = storage_write(index->storage, right, sizeof(*right));
+    free(right);
+
+    if (child->leaf) {
+        child->next = right_position;
+    }
+
+    storage_index_write_node(index->storage, node->children[i], child);
+
+    memmove(node->entries + i + 1, node->entries + i, (node->amount - i) * sizeof(*node->entries));
+    memmove(node->children + i + 2, node->children + i + 1, (node->amount - i) * sizeof(*node->children));
+
+    node->entries[i] = separator;
+    node->children[i + 1] = right_position;
+    ++node->amount;
+
+    storage_index_write_node(index->storage, position, node);
+}
+
+// inserts entry splitting full nodes on the way down, so parent of split node always has space
+static void storage_index_insert(struct storage_index * index, const struct storage_value * value, uint64_t row) {
+    struct storage * const storage = index->storage;
+
+    struct storage_index_node * node = malloc(sizeof(*node));
+    struct storage_index_node * child = malloc(sizeof(*child));
+
+    uint64_t position = index->root;
+    storage_index_read_node(storage, position, node);
+
+    if (node->amount == INDEX_NODE_ENTRIES) {
+        memcpy(child, node, sizeof(*node));
+        memset(node, 0, sizeof(*node));
+
+        node->children[0] = index->root;
+        position = storage_write(storage, node, sizeof(*node));
+
+        storage_index_split_child(index, node, position, 0, child);
+        storage_index_set_root(index, position);
+    }
+
+    while (!node->leaf) {
+        uint16_t i = storage_index_upper_bound(index, node, value, row);
+        storage_index_read_node(storage, node->children[i], child);
+
+        if (child->amount == INDEX_NODE_ENTRIES) {
+            storage_index_split_child(index, node, position, i, child);
+
+            if (storage_index_compare_entry(index, &node->entries[i], value, row) <= 0) {
+                storage_index_read_node(storage, node->children[++i], child);
+            }
+        }
+
+        position = node->children[i];
+
+        struct storage_index_node * const parent = node;
+        node = child;
+        child = parent;
+    }
+
+    const uint16_t i = storage_index_upper_bound(index, node, value, row);
+    memmove(node->entries + i + 1, node->entries + i, (node->amount - i) * sizeof(*node->entries));
+
+    node->entries[i].key = storage_index_make_key(index, value);
+    node->entries[i].row = row;
+    ++node->amount;
+
+    storage_index_write_node(storage, position, node);
+
+    free(child);
+    free(node);
+}
+
+static void storage_index_remove(struct storage_index * index, const struct storage_value * value, uint64_t row) {
+    struct storage * const storage = index->storage;
+    struct storage_index_node * node = malloc(sizeof(*node));
+
+    uint64_t position = index->root;
+    storage_index_read_node(storage, position, node);
+
+    while (!node->leaf) {
+        position = node->children[storage_index_upper_bound(index, node, value, row)];
+        storage_index_read_node(storage, position, node);
+    }
+
+    const uint16_t i = storage_index_upper_bound(index, node, value, row);
+
+    if (i > 0 && storage_index_compare_entry(index, &node->entries[i - 1], value, row) == 0) {
+        storage_index_free_key(index, node->entries[i - 1].key);
+
+        memmove(node->entries + i - 1, node->entries + i, (node->amount - i) * sizeof(*node->entries));
+        --node->amount;
+
+        storage_index_write_node(storage, position, node);
+    }
+
+    free(node);
+}
+
+static void storage_index_insert_row(struct storage_index * index, struct storage_row * row) {
+    struct storage_value * const value = storage_row_get_value(row, index->column);
+
+    if (value) {
+        storage_index_insert(index, value, storage_row_get_reference(row));
+    }
+
+    storage_value_delete(value);
+}
+
+static void storage_index_remove_row(struct storage_index * index, struct storage_row * row) {
+    struct storage_value * const value = storage_row_get_value(row, index->column);
+
+    if (value) {
+        storage_index_remove(index, value, storage_row_get_reference(row));
+    }
+
+    storage_value_delete(value);
+}
+
+static void storage_index_free_node(struct storage_index * index, uint64_t position) {
+    struct storage_index_node * node = malloc(sizeof(*node));
+    storage_index_read_node(index->storage, position, node);
+
+    for (uint16_t i = 0; i < node->amount; ++i) {
+        storage_index_free_key(index, node->entries[i].key);
+    }
+
+    if (!node->leaf) {
+        for (uint16_t i = 0; i <= node->amount; ++i) {
+            storage_index_free_node(index, node->children[i]);
+        }
+    }
+
+    storage_free(index->storage, position, sizeof(*node));
+    free(node);
+}
+
+// builds index from scratch by all rows of the table
+static void storage_index_build(struct storage_index * index, struct storage_table * table) {
+    struct storage_index_node * node = calloc(1, sizeof(*node));
+    node->leaf = true;
+
+    storage_index_set_root(index, storage_write(index->storage, node, sizeof(*node)));
+    free(node);
+
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        storage_index_insert_row(index, row);
+    }
+}
+
+// frees indexes of the table with their nodes and takes them out of index list
+static void storage_table_remove_indexes(struct storage_table * table) {
+    struct storage * const storage = table->storage;
+
+    for (struct storage_index * index = storage_table_get_indexes(table); index; index = index->next) {
+        uint64_t offset = index->position;
+
+        uint64_t next;
+        storage_read(storage, &offset, &next, sizeof(next));
+
+        uint64_t pointer = storage->first_index;
+        while (pointer) {
+            offset = pointer;
+
+            uint64_t pointer_next;
+            storage_read(storage, &offset, &pointer_next, sizeof(pointer_next));
+
+            if (pointer_next == index->position) {
+                break;
+            }
+
+            pointer = pointer_next;
+        }
+
+        if (pointer == 0) {
+            pointer = HEADER_FIRST_INDEX;
+            storage->first_index = next;
+        }
+
+        storage_write_at(storage, &pointer, &next, sizeof(next));
+
+        storage_index_free_node(index, index->root);
+        storage_free(storage, index->position, INDEX_SIZE);
+    }
+}
+
+void storage_table_add_index(struct storage_table * table, uint16_t column) {
+    struct storage * const storage = table->storage;
+    struct storage_catalog_entry * entry = storage_catalog_find(storage, table->name);
+
+    // indexes need free lists to keep nodes reusable, files before version 2 have none
+    if (!entry || entry->table->position != table->position || column >= table->columns.amount || storage->version < 2) {
+        errno = EINVAL;
+        return;
+    }
+
+    if (storage_table_find_index(table, column)) {
+        errno = EEXIST;
+        return;
+    }
+
+    // older versions know nothing about indexes and must not open the file
+    if (storage->version < 3) {
+        uint64_t offset = 4 + sizeof(uint64_t);
+
+        storage->version = 3;
+        storage_write_at(storage, &offset, &storage->version, sizeof(storage->version));
+    }
+
+    struct storage_index * index = malloc(sizeof(*index));
+    index->storage = storage;
+    index->root = 0;
+    index->column = column;
+    index->type = table->columns.columns[column].type;
+
+    uint8_t data[INDEX_SIZE];
+    memcpy(data, &storage->first_index, sizeof(uint64_t));
+    memcpy(data + sizeof(uint64_t), &table->position, sizeof(uint64_t));
+    memcpy(data + INDEX_ROOT, &index->root, sizeof(uint64_t));
+    memcpy(data + INDEX_ROOT + sizeof(uint64_t), &index->column, sizeof(index->column));
+
+    index->position = storage_write(storage, data, sizeof(data));
+    storage->first_index = index->position;
+
+    uint64_t offset = HEADER_FIRST_INDEX;
+    storage_write_at(storage, &offset, &storage->first_index, sizeof(storage->first_index));
+
+    index->next = entry->indexes;
+    entry->indexes = index;
+
+    storage_index_build(index, entry->table);
+}
+
+bool storage_table_has_index(const struct storage_table * table, uint16_t column) {
+    return storage_table_find_index(table, column) != NULL;
+}
+
+// finds rows with not NULL values of the column between bounds, NULL bound is not limited
+struct storage_index_scan * storage_table_index_scan(struct storage_table * table, uint16_t column,
+    const struct storage_value * low, bool low_inclusive, const struct storage_value * high, bool high_inclusive) {
+    struct storage_index * const index = storage_table_find_index(table, column);
+
+    if (!index) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct storage_index_scan * scan = malloc(sizeof(*scan));
+    scan->table = table;
+    scan->amount = 0;
+    scan->rows = NULL;
+
+    struct storage_index_node * node = malloc(sizeof(*node));
+    storage_index_read_node(index->storage, index->root, node);
+
+    // goes down to the leftmost leaf which could have entries above low bound
+    while (!node->leaf) {
+        uint16_t first = 0, last = node->amount;
+
+        while (first < last) {
+            const uint16_t middle = (first + last) / 2;
+
+            if (storage_index_is_above(index, node->entries[middle].key, low, low_inclusive)) {
+                last = middle;
+            } else {
+                first = middle + 1;
+            }
+        }
+
+        storage_index_read_node(index->storage, node->children[first], node);
+    }
+
+    uint64_t capacity = 0;
+    bool is_above = false;
+
+    while (true) {
+        for (uint16_t i = 0; i < node->amount; ++i) {
+            const uint64_t key = node->entries[i].key;
+
+            if (!is_above && !(is_above = storage_index_is_above(index, key, low, low_inclusive))) {
+                continue;
+            }
+
+            if (!storage_index_is_below(index, key, high, high_inclusive)) {
+                free(node);
+                return scan;
+            }
+
+            if (scan->amount == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                scan->rows = realloc(scan->rows, capacity * sizeof(*scan->rows));
+            }
+
+            scan->rows[scan->amount++] = node->entries[i].row;
+        }
+
+        if (node->next == 0) {
+            break;
+        }
+
+        storage_index_read_node(index->storage, node->next, node);
+    }
+
+    free(node);
+    return scan;
+}
+
+void storage_index_scan_delete(struct storage_index_scan * scan) {
+    if (scan) {
+        free(scan->rows);
+    }
+
+    free(scan);
+}
+
+struct storage_row * storage_index_scan_get_first_row(const struct storage_index_scan * scan) {
+    if (scan->amount == 0) {
+        return NULL;
+    }
+
+    struct storage_row * row = malloc(sizeof(*row));
+    row->table = scan->table;
+    row->scan = scan;
+    row->scan_index = 0;
+
+    storage_row_seek_reference(row, scan->rows[0]);
+    return row;
+}
+
+// position of cell pointer or inline cell in file
+static uint64_t storage_row_cell_position(const struct storage_row * row, uint16_t index) {
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        return storage_row_group_validity(row, index) + row->slot.capacity / 8 + row->slot.index * sizeof(uint64_t);
+    }
+
+    return row->position + storage_row_cell_offset(row->table, index);
+}
+
+// cells of strings without dictionary and cells of old row format are out of row
+static bool storage_table_is_cell_pointer(const struct storage_table * table, uint16_t index) {
+    const struct storage_column * const column = &table->columns.columns[index];
+
+    return table->format == STORAGE_TABLE_FORMAT_CELL_POINTERS || (column->type == STORAGE_COLUMN_TYPE_STR && !column->dictionary);
+}
+
+// frees out of row cell of column, its pointer is left as is
+static void storage_row_free_cell(struct storage_row * row, uint16_t index) {
+    struct storage * const storage = row->table->storage;
+    const enum storage_column_type type = row->table->columns.columns[index].type;
+
+    if (!storage_table_is_cell_pointer(row->table, index)) {
+        return;
+    }
+
+    uint64_t offset = storage_row_cell_position(row, index);
+
+    uint64_t pointer;
+    storage_read(storage, &offset, &pointer, sizeof(pointer));
+
+    // cells in body go with it
+    if (pointer == 0 || (pointer & ROW_GROUP_BODY_CELL)) {
+        return;
+    }
+
+    uint64_t size = sizeof(uint64_t);
+    if (type == STORAGE_COLUMN_TYPE_STR) {
+        uint16_t length;
+
+        offset = pointer;
+        storage_read(storage, &offset, &length, sizeof(length));
+        size = sizeof(length) + length + 1;
+    }
+
+    storage_free(storage, pointer, size);
+}
+
+static void storage_row_free_cells(struct storage_row * row) {
+    for (uint16_t i = 0; i < row->table->columns.amount; ++i) {
+        storage_row_free_cell(row, i);
+    }
+}
+
+void storage_row_remove(struct storage_row * row) {
+    struct storage * const storage = row->table->storage;
+
+    storage_table_change_version(row->table);
+
+    for (struct storage_index * index = storage_table_get_indexes(row->table); index; index = index->next) {
+        storage_index_remove_row(index, row);
+    }
+
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        const uint64_t deleted = row->position + ROW_GROUP_HEADER_SIZE;
+
+        if (storage_table_has_zone_maps(row->table)) {
+            storage_row_count_zone_nulls(row, -1);
+        }
+
+        storage_row_group_set_bit(storage, deleted, row->slot.index, true);
+        storage_row_free_cells(row);
+        return;
+    }
+
+    uint64_t pointer = row->table->first_row;
+
+    while (pointer) {
+        uint64_t offset = pointer;
+
+        uint64_t next;
+        storage_read(storage, &offset, &next, sizeof(next));
+
+        if (next == row->position) {
+            break;
+        }
+
+        pointer = next;
+    }
+
+    if (pointer == 0) {
+        pointer = row->table->position + sizeof(uint64_t);
+        row->table->first_row = row->next;
+    }
+
+    storage_write_at(storage, &pointer, &row->next, sizeof(row->next));
+
+    storage_row_free_cells(row);
+    storage_free(storage, row->position, storage_row_size(row->table));
+}
+
+// frees body of row group by position of its pointer, pages of decompressed body leave pool
+static void storage_row_group_free_body(struct storage_table * table, uint64_t pointer) {
+    struct storage * const storage = table->storage;
+
+    struct storage_row_group_body body;
+    uint64_t offset = pointer;
+    storage_read(storage, &offset, &body, sizeof(body));
+
+    if (body.stored_size < body.size) {
+        storage_pool_drop(storage, ROW_GROUP_INFLATED | pointer << ROW_GROUP_INFLATED_SHIFT, body.size);
+    }
+
+    storage_free(storage, body.pointer, body.stored_size);
+}
+
+// frees rows or row groups of the table with their cells
+static void storage_table_free_rows(struct storage_table * table) {
+    struct storage * const storage = table->storage;
+
+    if (storage->version < 2) {
+        return;
+    }
+
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        storage_row_free_cells(row);
+    }
+
+    // rows or row groups are freed after cells, freeing overwrites their next pointers
+    uint64_t pointer = table->first_row;
+    while (pointer) {
+        uint64_t offset = pointer;
+
+        uint64_t next;
+        storage_read(storage, &offset, &next, sizeof(next));
+
+        uint64_t size = storage_row_size(table);
+        if (table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+            uint32_t capacity;
+            storage_read(storage, &offset, &capacity, sizeof(capacity));
+
+            size = storage_row_group_size(table, capacity);
+
+            if (table->compressed) {
+                storage_row_group_free_body(table, pointer + storage_row_group_columns_offset(table, capacity));
+            }
+        }
+
+        storage_free(storage, pointer, size);
+        pointer = next;
+    }
+}
+
+void storage_table_remove(struct storage_table * table) {
+    struct storage * const storage = table->storage;
+    uint64_t pointer = storage->first_table;
+
+    // next table of cached table could be removed since the table was read
+    uint64_t offset = table->position;
+    storage_read(storage, &offset, &table->next, sizeof(table->next));
+
+    while (pointer) {
+        uint64_t offset = pointer;
+
+        uint64_t next;
+        storage_read(storage, &offset, &next, sizeof(next));
+
+        if (next == table->position) {
+            break;
+        }
+
+        pointer = next;
+    }
+
+    if (pointer == 0) {
+        pointer = storage_first_table_offset(storage);
+        storage->first_table = table->next;
+    }
+
+    storage_write_at(storage, &pointer, &table->next, sizeof(table->next));
+
+    storage_table_remove_indexes(table);
+    storage_table_remove_dictionaries(table);
+    storage_catalog_remove(storage, table->name);
+
+    storage_table_free_rows(table);
+    storage_free(storage, table->position, storage_table_header_size(table));
+}
+
+static void storage_row_set_null(struct storage_row * row, uint16_t index, bool null) {
+    struct storage * const storage = row->table->storage;
+
+    if (row->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        storage_row_group_set_bit(storage, storage_row_group_validity(row, index), row->slot.index, !null);
+        return;
+    }
+
+    storage_row_group_set_bit(storage, row->position + sizeof(uint64_t), index, null);
+}
+
+// copies out of row cell of column to the end of file and returns pointer to the copy
+static uint64_t storage_row_copy_cell(struct storage_row * row, uint16_t index) {
+    struct storage * const storage = row->table->storage;
+    uint64_t offset = storage_row_cell_position(row, index);
+
+    uint64_t pointer;
+    storage_read(storage, &offset, &pointer, sizeof(pointer));
+
+    if (pointer == 0) {
+        return 0;
+    }
+
+    pointer = storage_row_cell_pointer(row, pointer);
+
+    // string cells of old files get terminator
+    if (row->table->columns.columns[index].type == STORAGE_COLUMN_TYPE_STR) {
+        char * const str = storage_read_string(storage, &pointer);
+
+        uint64_t size;
+        uint8_t * const cell = storage_make_string_cell(str, &size);
+
+        pointer = storage_append(storage, cell, size);
+        free(cell);
+        free(str);
+
+        return pointer;
+    }
+
+    uint64_t value;
+    storage_read(storage, &pointer, &value, sizeof(value));
+    return storage_append(storage, &value, sizeof(value));
+}
+
+// rewrites rows of row table one after another with their cells in scan order
+static uint64_t storage_table_rewrite_rows(struct storage_table * table, uint64_t * first_row) {
+    struct storage * const storage = table->storage;
+
+    const uint64_t row_size = storage_row_size(table);
+    uint8_t * const data = malloc(row_size);
+
+    uint64_t amount = 0, previous = 0;
+    *first_row = 0;
+
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        uint64_t offset = row->position;
+        storage_read(storage, &offset, data, row_size);
+
+        // cells are written before the row, so the row is written once
+        memset(data, 0, sizeof(uint64_t));
+        for (uint16_t i = 0; i < table->columns.amount; ++i) {
+            if (storage_table_is_cell_pointer(table, i)) {
+                const uint64_t pointer = storage_row_copy_cell(row, i);
+                memcpy(data + storage_row_cell_offset(table, i), &pointer, sizeof(pointer));
+            }
+        }
+
+        const uint64_t position = storage_append(storage, data, row_size);
+
+        if (previous) {
+            storage_write_at(storage, &previous, &position, sizeof(position));
+        } else {
+            *first_row = position;
+        }
+
+        previous = position;
+        ++amount;
+    }
+
+    free(data);
+    return amount;
+}
+
+// rewrites live rows of columnar table into full row groups followed by their string cells
+static uint64_t storage_table_rewrite_row_groups(struct storage_table * table, uint64_t * first_row) {
+    struct storage * const storage = table->storage;
+
+    uint64_t amount = 0;
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        ++amount;
+    }
+
+    struct storage_row group = { .table = table, .position = 0, .next = 0 };
+    uint64_t left = amount;
+    *first_row = 0;
+
+    // zone maps of the group being filled are exact
+    const bool has_zone_maps = storage_table_has_zone_maps(table);
+    struct storage_zone * const zones = calloc(table->columns.amount, sizeof(*zones));
+
+    const struct storage_dictionary ** const dictionaries = malloc(sizeof(*dictionaries) * table->columns.amount);
+    for (uint16_t i = 0; i < table->columns.amount; ++i) {
+        dictionaries[i] = storage_table_get_dictionary(table, i);
+    }
+
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        if (group.position == 0 || group.slot.index == 0) {
+            if (group.position && has_zone_maps) {
+                storage_row_group_write_zones(storage, &group, zones);
+                memset(zones, 0, table->columns.amount * sizeof(*zones));
+            }
+
+            const uint32_t capacity = left < STORAGE_ROW_GROUP_MAX_ROWS ? (left + 7) / 8 * 8 : STORAGE_ROW_GROUP_MAX_ROWS;
+            const uint32_t rows = left < capacity ? left : capacity;
+            const uint64_t size = storage_row_group_size(table, capacity);
+
+            const uint64_t position = storage_extend(storage, size);
+
+            uint64_t offset = position;
+            storage_write_zeros(storage, &offset, size);
+
+            offset = position + sizeof(uint64_t);
+            storage_write_at(storage, &offset, &capacity, sizeof(capacity));
+            storage_write_at(storage, &offset, &rows, sizeof(rows));
+
+            if (group.position) {
+                storage_write_at(storage, &group.position, &position, sizeof(position));
+            } else {
+                *first_row = position;
+            }
+
+            group.position = position;
+            group.slot.capacity = capacity;
+            group.slot.index = rows;
+            group.columns = position + storage_row_group_columns_offset(table, capacity);
+        }
+
+        // slots are filled from last to first to keep scan order
+        --group.slot.index;
+        --left;
+
+        for (uint16_t i = 0; i < table->columns.amount; ++i) {
+            if (storage_row_is_null(row, i)) {
+                ++zones[i].nulls;
+                continue;
+            }
+
+            uint64_t offset = storage_row_cell_position(row, i);
+
+            uint64_t cell;
+            if (storage_table_is_cell_pointer(table, i)) {
+                cell = storage_row_copy_cell(row, i);
+            } else {
+                storage_read(storage, &offset, &cell, sizeof(cell));
+            }
+
+            offset = storage_row_cell_position(&group, i);
+            storage_write_at(storage, &offset, &cell, sizeof(cell));
+            storage_row_set_null(&group, i, false);
+
+            if (has_zone_maps) {
+                storage_zone_widen(&zones[i], table->columns.columns[i].type,
+                    storage_zone_cell_key(storage, table->columns.columns[i].type, dictionaries[i], cell));
+            }
+        }
+    }
+
+    if (group.position && has_zone_maps) {
+        storage_row_group_write_zones(storage, &group, zones);
+    }
+
+    free(dictionaries);
+    free(zones);
+    return amount;
+}
+
+// compresses body by chunks of ROW_GROUP_BODY_CHUNK bytes, so pages of each chunk
+// are decompressed alone, returns offsets of chunks followed by the chunks
+static uint8_t * storage_row_group_compress_body(const uint8_t * body, uint64_t size, uint64_t * stored_size) {
+    const uint64_t chunks = (size + ROW_GROUP_BODY_CHUNK - 1) / ROW_GROUP_BODY_CHUNK;
+    const uint64_t offsets_size = (chunks + 1) * sizeof(uint32_t);
+
+    uint8_t * const stored = malloc(offsets_size + chunks * lz_bound(ROW_GROUP_BODY_CHUNK));
+    uint32_t used = 0;
+
+    for (uint64_t i = 0; i < chunks; ++i) {
+        const uint64_t start = i * ROW_GROUP_BODY_CHUNK;
+        const uint64_t length = size - start < ROW_GROUP_BODY_CHUNK ? size - start : ROW_GROUP_BODY_CHUNK;
+
+        memcpy(stored + i * sizeof(uint32_t), &used, sizeof(used));
+        used += lz_compress(body + start, length, stored + offsets_size + used);
+    }
+
+    memcpy(stored + chunks * sizeof(uint32_t), &used, sizeof(used));
+
+    *stored_size = offsets_size + used;
+    return stored;
+}
+
+// appends row group with zone maps and its body after it, the body is compressed when it gets smaller
+static uint64_t storage_row_group_append_body(struct storage_table * table, uint32_t capacity, uint32_t rows,
+    const struct storage_zone * zones, const uint8_t * body, uint64_t body_size) {
+
+    struct storage * const storage = table->storage;
+    const uint64_t size = storage_row_group_size(table, capacity);
+
+    uint8_t * const header = calloc(1, size);
+    memcpy(header + sizeof(uint64_t), &capacity, sizeof(capacity));
+    memcpy(header + sizeof(uint64_t) + sizeof(capacity), &rows, sizeof(rows));
+    memcpy(header + storage_row_group_zone_offset(capacity, 0), zones, storage_row_group_zone_maps_size(table));
+
+    const uint64_t position = storage_append(storage, header, size);
+    const uint64_t pointer = position + storage_row_group_columns_offset(table, capacity);
+    free(header);
+
+    struct storage_row_group_body descriptor = { .size = body_size, .stored_size = body_size };
+    uint8_t * stored = NULL;
+
+    if (body_size <= STORAGE_COMPRESSED_BODY_MAX && pointer < ROW_GROUP_INFLATED_LIMIT) {
+        stored = storage_row_group_compress_body(body, body_size, &descriptor.stored_size);
+    }
+
+    if (stored && descriptor.stored_size < body_size) {
+        descriptor.pointer = storage_append(storage, stored, descriptor.stored_size);
+    } else {
+        descriptor.stored_size = body_size;
+        descriptor.pointer = storage_append(storage, body, body_size);
+    }
+
+    uint64_t offset = pointer;
+    storage_write_at(storage, &offset, &descriptor, sizeof(descriptor));
+
+    free(stored);
+    return position;
+}
+
+// rewrites live rows of table with bodies into full row groups, each body is assembled
+// in memory with strings of its rows and written compressed when it gets smaller
+static uint64_t storage_table_rewrite_row_group_bodies(struct storage_table * table, uint64_t * first_row) {
+    struct storage * const storage = table->storage;
+    const uint16_t columns_amount = table->columns.amount;
+
+    uint64_t amount = 0;
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        ++amount;
+    }
+
+    struct storage_zone * const zones = calloc(columns_amount, sizeof(*zones));
+
+    const struct storage_dictionary ** const dictionaries = malloc(sizeof(*dictionaries) * columns_amount);
+    for (uint16_t i = 0; i < columns_amount; ++i) {
+        dictionaries[i] = storage_table_get_dictionary(table, i);
+    }
+
+    uint8_t * body = NULL;
+    uint64_t body_size = 0;
+    uint64_t body_capacity = 0;
+
+    uint32_t capacity = 0, rows = 0, slot = 0;
+    uint64_t left = amount, previous = 0;
+    *first_row = 0;
+
+    struct storage_row * row = storage_table_get_first_row(table);
+    while (row || (rows > 0 && slot == 0)) {
+        // the group is full or rows are over
+        if (rows > 0 && slot == 0) {
+            const uint64_t position = storage_row_group_append_body(table, capacity, rows, zones, body, body_size);
+
+            if (previous) {
+                storage_write_at(storage, &previous, &position, sizeof(position));
+            } else {
+                *first_row = position;
+            }
+
+            previous = position;
+            rows = 0;
+
+            memset(zones, 0, columns_amount * sizeof(*zones));
+            continue;
+        }
+
+        if (rows == 0) {
+            capacity = left < STORAGE_ROW_GROUP_MAX_ROWS ? (left + 7) / 8 * 8 : STORAGE_ROW_GROUP_MAX_ROWS;
+            rows = left < capacity ? left : capacity;
+            slot = rows;
+
+            body_size = storage_row_group_columns_size(table, capacity);
+            if (body_size > body_capacity) {
+                body_capacity = body_size;
+                body = realloc(body, body_capacity);
+            }
+
+            memset(body, 0, body_size);
+        }
+
+        // slots are filled from last to first to keep scan order
+        --slot;
+        --left;
+
+        for (uint16_t i = 0; i < columns_amount; ++i) {
+            const enum storage_column_type type = table->columns.columns[i].type;
+            const uint64_t validity = i * storage_row_group_column_size(capacity);
+
+            if (storage_row_is_null(row, i)) {
+                ++zones[i].nulls;
+                continue;
+            }
+
+            uint64_t offset = storage_row_cell_position(row, i);
+
+            // cell of damaged body is left NULL, vacuum drops the new rows then
+            uint64_t cell;
+            if (!storage_read(storage, &offset, &cell, sizeof(cell))) {
+                ++zones[i].nulls;
+                continue;
+            }
+
+            if (storage_table_is_cell_pointer(table, i)) {
+                if (cell == 0) {
+                    ++zones[i].nulls;
+                    continue;
+                }
+
+                offset = storage_row_cell_pointer(row, cell);
+                char * const str = storage_read_string(storage, &offset);
+                const uint64_t size = storage_string_cell_size(str);
+
+                if (body_size + size > body_capacity) {
+                    while (body_size + size > body_capacity) {
+                        body_capacity *= 2;
+                    }
+
+                    body = realloc(body, body_capacity);
+                }
+
+                *storage_put_string(body + body_size, str) = '\0';
+                cell = ROW_GROUP_BODY_CELL | body_size;
+                body_size += size;
+
+                storage_zone_widen(&zones[i], type, storage_zone_string_key(str, strnlen(str, sizeof(uint64_t))));
+                free(str);
+            } else {
+                storage_zone_widen(&zones[i], type, storage_zone_cell_key(storage, type, dictionaries[i], cell));
+            }
+
+            body[validity + slot / 8] |= 1 << (slot % 8);
+            memcpy(body + validity + capacity / 8 + slot * sizeof(uint64_t), &cell, sizeof(cell));
+        }
+
+        row = storage_row_next(row);
+    }
+
+    free(body);
+    free(dictionaries);
+    free(zones);
+    return amount;
+}
+
+uint64_t storage_table_vacuum(struct storage_table * table) {
+    struct storage * const storage = table->storage;
+    const bool mark = storage_read_mark();
+
+    uint64_t first_row;
+    uint64_t amount;
+
+    if (table->compressed) {
+        amount = storage_table_rewrite_row_group_bodies(table, &first_row);
+    } else if (table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        amount = storage_table_rewrite_row_groups(table, &first_row);
+    } else {
+        amount = storage_table_rewrite_rows(table, &first_row);
+    }
+
+    // table with damaged body keeps its rows, new rows are freed as they are not complete
+    if (storage_read_damaged(mark)) {
+        const uint64_t old_first_row = table->first_row;
+
+        table->first_row = first_row;
+        storage_table_free_rows(table);
+        table->first_row = old_first_row;
+
+        errno = EIO;
+        return 0;
+    }
+
+    storage_table_change_version(table);
+
+    // old rows stay valid until the table is switched to the new ones by single write
+    uint64_t offset = table->position + sizeof(uint64_t);
+    storage_write_at(storage, &offset, &first_row, sizeof(first_row));
+
+    storage_table_free_rows(table);
+    table->first_row = first_row;
+
+    for (struct storage_index * index = storage_table_get_indexes(table); index; index = index->next) {
+        storage_index_free_node(index, index->root);
+        storage_index_build(index, table);
+    }
+
+    return amount;
+}
+
+void storage_get_stats(struct storage * storage, struct storage_stats * stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&storage->lock);
+    stats->size = storage->size;
+    pthread_mutex_unlock(&storage->lock);
+
+    for (unsigned int i = 0; i < STORAGE_CATALOG_BUCKETS; ++i) {
+        for (struct storage_catalog_entry * entry = storage->catalog[i]; entry; entry = entry->next_in_bucket) {
+            const struct storage_table * const table = entry->table;
+            ++stats->tables;
+
+            if (!table->compressed) {
+                continue;
+            }
+
+            // row groups are read as by request that reads the table
+            if (storage_request.storage == storage) {
+                storage_request_lock(entry);
+            }
+
+            uint64_t pointer = table->first_row;
+            while (pointer) {
+                uint64_t offset = pointer;
+
+                uint64_t next;
+                storage_read(storage, &offset, &next, sizeof(next));
+
+                uint32_t capacity;
+                storage_read(storage, &offset, &capacity, sizeof(capacity));
+
+                struct storage_row_group_body body;
+                offset = pointer + storage_row_group_columns_offset(table, capacity);
+                storage_read(storage, &offset, &body, sizeof(body));
+
+                ++stats->row_groups;
+                stats->body_size += body.size;
+                stats->stored_size += body.stored_size;
+
+                if (body.stored_size < body.size) {
+                    ++stats->compressed_row_groups;
+                    stats->compressed_body_size += body.size;
+                    stats->compressed_stored_size += body.stored_size;
+                }
+
+                pointer = next;
+            }
+        }
+    }
+}
+
+struct storage_value * storage_row_get_value(struct storage_row * row, uint16_t index) {
+    if (index >= row->table->columns.amount) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct storage * const storage = row->table->storage;
+    const bool is_inline = row->table->format != STORAGE_TABLE_FORMAT_CELL_POINTERS;
+    // value read from damaged body is NULL with errno EIO
+    const bool mark = storage_read_mark();
+
+    if (is_inline && storage_row_is_null(row, index)) {
+        storage_read_damaged(mark);
+        return NULL;
+    }
+
+    uint64_t offset = storage_row_cell_position(row, index);
+    uint64_t pointer = offset;
+
+    if (storage_table_is_cell_pointer(row->table, index)) {
+        storage_read(storage, &offset, &pointer, sizeof(pointer));
+
+        if (pointer == 0 || storage_read_damaged(mark)) {
+            return NULL;
+        }
+
+        pointer = storage_row_cell_pointer(row, pointer);
+    }
+
+    const struct storage_dictionary * const dictionary = storage_table_get_dictionary(row->table, index);
+    if (dictionary) {
+        uint64_t code;
+        storage_read(storage, &pointer, &code, sizeof(code));
+
+        if (storage_read_damaged(mark)) {
+            return NULL;
+        }
+
+        struct storage_value * const value = malloc(sizeof(*value));
+        value->type = STORAGE_COLUMN_TYPE_STR;
+        value->value.str = dictionary->strings[code];
+        value->view = true;
+        return value;
+    }
+
+    struct storage_value * value = malloc(sizeof(*value));
+    value->type = row->table->columns.columns[index].type;
+    value->view = false;
+
+    switch (value->type) {
+        case STORAGE_COLUMN_TYPE_INT:
+            storage_read(storage, &pointer, &value->value._int, sizeof(value->value._int));
+            break;
+
+        case STORAGE_COLUMN_TYPE_UINT:
+            storage_read(storage, &pointer, &value->value.uint, sizeof(value->value.uint));
+            break;
+
+        case STORAGE_COLUMN_TYPE_NUM:
+            storage_read(storage, &pointer, &value->value.num, sizeof(value->value.num));
+            break;
+
+        case STORAGE_COLUMN_TYPE_STR:
+            storage_read_string_value(storage, &pointer, value);
+            break;
+    }
+
+    if (storage_read_damaged(mark)) {
+        storage_value_delete(value);
+        return NULL;
+    }
+
+    return value;
+}
+
+// reads code of string of column with dictionary, returns false for NULL cell
+// and for cell of damaged body (errno EIO)
+static bool storage_row_get_code(struct storage_row * row, uint16_t index, uint64_t * code) {
+    const bool mark = storage_read_mark();
+
+    if (storage_row_is_null(row, index)) {
+        storage_read_damaged(mark);
+        return false;
+    }
+
+    uint64_t offset = storage_row_cell_position(row, index);
+    storage_read(row->table->storage, &offset, code, sizeof(*code));
+
+    return !storage_read_damaged(mark);
+}
+
+// moves compressed body of row group to new uncompressed block, so its cells can be written;
+// returns false with errno EIO when the body is damaged, it is kept then
+static bool storage_row_group_unpack(struct storage_row * row) {
+    struct storage * const storage = row->table->storage;
+    const uint64_t pointer = row->position + storage_row_group_columns_offset(row->table, row->slot.capacity);
+
+    struct storage_row_group_body body;
+    uint64_t offset = pointer;
+    storage_read(storage, &offset, &body, sizeof(body));
+
+    uint8_t * const data = malloc(body.size);
+    offset = row->columns;
+
+    if (!storage_read(storage, &offset, data, body.size)) {
+        free(data);
+        return false;
+    }
+
+    const uint64_t position = storage_write(storage, data, body.size);
+    free(data);
+
+    storage_row_group_free_body(row->table, pointer);
+
+    body.pointer = position;
+    body.stored_size = body.size;
+
+    offset = pointer;
+    storage_write_at(storage, &offset, &body, sizeof(body));
+
+    row->columns = position;
+    return true;
+}
+
+static void storage_row_write_value(struct storage_row * row, uint16_t index, const struct storage_value * value) {
+    struct storage * const storage = row->table->storage;
+    const bool is_inline = row->table->format != STORAGE_TABLE_FORMAT_CELL_POINTERS;
+
+    uint64_t offset = storage_row_cell_position(row, index);
+
+    if (storage_table_has_zone_maps(row->table)) {
+        storage_row_update_zone(row, index, value);
+    }
+
+    storage_row_free_cell(row, index);
+
+    if (is_inline) {
+        storage_row_set_null(row, index, value == NULL);
+
+        if (value && value->type != STORAGE_COLUMN_TYPE_STR) {
+            // all fixed-width values are 8 bytes long
+            storage_write_at(storage, &offset, &value->value, sizeof(uint64_t));
+            return;
+        }
+
+        struct storage_dictionary * const dictionary = storage_table_get_dictionary(row->table, index);
+        if (dictionary) {
+            const uint64_t code = value ? storage_dictionary_encode(storage, dictionary, value->value.str) : 0;
+
+            storage_write_at(storage, &offset, &code, sizeof(code));
+            return;
+        }
+    }
+
+    uint64_t pointer = 0;
+
+    if (value) {
+        switch (value->type) {
+            case STORAGE_COLUMN_TYPE_INT:
+                pointer = storage_write(storage, &value->value._int, sizeof(value->value._int));
+                break;
+
+            case STORAGE_COLUMN_TYPE_UINT:
+                pointer = storage_write(storage, &value->value.uint, sizeof(value->value.uint));
+                break;
+
+            case STORAGE_COLUMN_TYPE_NUM:
+                pointer = storage_write(storage, &value->value.num, sizeof(value->value.num));
+                break;
+
+            case STORAGE_COLUMN_TYPE_STR: {
+                uint64_t size;
+                uint8_t * const cell = storage_make_string_cell(value->value.str, &size);
+
+                pointer = storage_write(storage, cell, size);
+                free(cell);
+                break;
+            }
+        }
+    }
+
+    storage_write_at(storage, &offset, &pointer, sizeof(pointer));
+}
+
+void storage_row_set_value(struct storage_row * row, uint16_t index, const struct storage_value * value) {
+    if (index >= row->table->columns.amount) {
+        errno = EINVAL;
+        return;
+    }
+
+    if (value && row->table->columns.columns[index].type != value->type) {
+        errno = EINVAL;
+        return;
+    }
+
+    // row of damaged body is not written, so its cells and index entries stay
+    if (row->table->compressed && storage_row_group_is_compressed(row) && !storage_row_group_unpack(row)) {
+        return;
+    }
+
+    // entry of old value is removed before its cell is freed
+    struct storage_index * const column_index = storage_table_find_index(row->table, index);
+    if (column_index) {
+        storage_index_remove_row(column_index, row);
+    }
+
+    storage_row_write_value(row, index, value);
+
+    if (column_index && value) {
+        storage_index_insert(column_index, value, storage_row_get_reference(row));
+    }
+}
+
+// appends rows assembled in memory with their cells to the end of file by one write;
+// rows are linked in order of values before the first row, so the last of them goes first
+static void storage_table_append_rows(struct storage_table * table, uint64_t amount,
+    const struct storage_value * const * values, const uint64_t * codes, uint64_t * references) {
+
+    struct storage * const storage = table->storage;
+    const uint16_t columns_amount = table->columns.amount;
+
+    const uint64_t row_size = storage_row_size(table);
+    const uint64_t row_block_size = storage_block_size(storage, row_size);
+
+    uint64_t size = amount * row_block_size;
+    for (uint64_t i = 0; i < amount * columns_amount; ++i) {
+        if (values[i] && storage_table_is_cell_pointer(table, i % columns_amount)) {
+            size += storage_block_size(storage, storage_value_cell_size(values[i]));
+        }
+    }
+
+    // blocks are zeroed up to their size classes as if they were extended one by one
+    uint8_t * const data = calloc(1, size);
+    const uint64_t position = storage->size;
+
+    uint64_t next = table->first_row;
+    uint64_t used = 0;
+
+    for (uint64_t i = 0; i < amount; ++i) {
+        const struct storage_value * const * const row_values = values + i * columns_amount;
+        uint8_t * const row = data + used;
+
+        references[i] = position + used;
+        used += row_block_size;
+
+        memcpy(row, &next, sizeof(next));
+        next = references[i];
+
+        if (table->format == STORAGE_TABLE_FORMAT_INLINE) {
+            memset(row + sizeof(next), 0xFF, storage_row_bitmap_size(table));
+        }
+
+        for (uint16_t j = 0; j < columns_amount; ++j) {
+            const struct storage_value * const value = row_values[j];
+
+            if (!value) {
+                continue;
+            }
+
+            if (table->format == STORAGE_TABLE_FORMAT_INLINE) {
+                row[sizeof(next) + j / 8] &= ~(1 << (j % 8));
+            }
+
+            uint64_t cell = 0;
+            if (storage_table_is_cell_pointer(table, j)) {
+                cell = position + used;
+
+                storage_put_value_cell(data + used, value);
+                used += storage_block_size(storage, storage_value_cell_size(value));
+            } else if (value->type == STORAGE_COLUMN_TYPE_STR) {
+                cell = codes[i * columns_amount + j];
+            } else {
+                memcpy(&cell, &value->value, sizeof(cell));
+            }
+
+            memcpy(row + storage_row_cell_offset(table, j), &cell, sizeof(cell));
+        }
+    }
+
+    uint64_t offset = position;
+    storage_write_at(storage, &offset, data, size);
+    free(data);
+
+    table->first_row = next;
+
+    offset = table->position + sizeof(uint64_t);
+    storage_write_at(storage, &offset, &table->first_row, sizeof(table->first_row));
+}
+
+// fills reserved runs of slots of row groups column by column, string cells of each run
+// are appended to the end of file by one write
+static void storage_table_append_row_groups(struct storage_table * table, uint64_t amount,
+    const struct storage_value * const * values, const uint64_t * codes, uint64_t * references) {
+
+    struct storage * const storage = table->storage;
+    const uint16_t columns_amount = table->columns.amount;
+    const bool has_zone_maps = storage_table_has_zone_maps(table);
+
+    struct storage_row group = { .table = table, .scan = NULL };
+    struct storage_zone * const zones = malloc(sizeof(*zones) * columns_amount);
+
+    for (uint64_t done = 0; done < amount; ) {
+        const uint32_t reserved = storage_row_group_reserve(table, &group, amount - done);
+        const uint32_t first = group.slot.index;
+        const struct storage_value * const * const group_values = values + done * columns_amount;
+        const uint64_t * const group_codes = codes ? codes + done * columns_amount : NULL;
+
+        uint64_t strings_size = 0;
+        for (uint64_t i = 0; i < (uint64_t) reserved * columns_amount; ++i) {
+            if (group_values[i] && storage_table_is_cell_pointer(table, i % columns_amount)) {
+                strings_size += storage_block_size(storage, storage_value_cell_size(group_values[i]));
+            }
+        }
+
+        uint8_t * const strings = calloc(1, strings_size);
+        const uint64_t strings_position = storage->size;
+        uint64_t strings_used = 0;
+
+        // bitmap bytes of the run may be shared with slots before and after it
+        const uint32_t bits_first = first / 8;
+        const uint32_t bits_size = (first + reserved + 7) / 8 - bits_first;
+
+        uint8_t * const bits = malloc(bits_size);
+        uint64_t * const cells = malloc(sizeof(*cells) * reserved);
+
+        if (has_zone_maps) {
+            storage_row_group_read_zones(storage, &group, zones);
+        }
+
+        for (uint16_t i = 0; i < columns_amount; ++i) {
+            const enum storage_column_type type = table->columns.columns[i].type;
+            const bool is_cell_pointer = storage_table_is_cell_pointer(table, i);
+            const uint64_t validity = storage_row_group_validity(&group, i);
+
+            uint64_t offset = validity + bits_first;
+            storage_read(storage, &offset, bits, bits_size);
+
+            for (uint32_t j = 0; j < reserved; ++j) {
+                const struct storage_value * const value = group_values[(uint64_t) j * columns_amount + i];
+                const uint32_t slot = first + j;
+
+                cells[j] = 0;
+
+                if (!value) {
+                    bits[slot / 8 - bits_first] &= ~(1 << (slot % 8));
+
+                    if (has_zone_maps) {
+                        ++zones[i].nulls;
+                    }
+
+                    continue;
+                }
+
+                bits[slot / 8 - bits_first] |= 1 << (slot % 8);
+
+                if (is_cell_pointer) {
+                    cells[j] = strings_position + strings_used;
+
+                    storage_put_value_cell(strings + strings_used, value);
+                    strings_used += storage_block_size(storage, storage_value_cell_size(value));
+                } else if (type == STORAGE_COLUMN_TYPE_STR) {
+                    cells[j] = group_codes[(uint64_t) j * columns_amount + i];
+                } else {
+                    memcpy(&cells[j], &value->value, sizeof(cells[j]));
+                }
+
+                if (has_zone_maps) {
+                    storage_zone_widen(&zones[i], type, storage_zone_key(value));
+                }
+            }
+
+            offset = validity + bits_first;
+            storage_write_at(storage, &offset, bits, bits_size);
+
+            offset = validity + group.slot.capacity / 8 + first * sizeof(uint64_t);
+            storage_write_at(storage, &offset, cells, sizeof(*cells) * reserved);
+        }
+
+        uint64_t offset = strings_position;
+        storage_write_at(storage, &offset, strings, strings_size);
+
+        if (has_zone_maps) {
+            storage_row_group_write_zones(storage, &group, zones);
+        }
+
+        for (uint32_t j = 0; j < reserved; ++j) {
+            group.slot.index = first + j;
+            references[done + j] = storage_row_get_reference(&group);
+        }
+
+        free(cells);
+        free(bits);
+        free(strings);
+
+        done += reserved;
+    }
+
+    free(zones);
+}
+
+void storage_table_add_rows(struct storage_table * table, uint64_t amount, const struct storage_value * const * values) {
+    const uint16_t columns_amount = table->columns.amount;
+
+    for (uint64_t i = 0; i < amount * columns_amount; ++i) {
+        if (values[i] && values[i]->type != table->columns.columns[i % columns_amount].type) {
+            errno = EINVAL;
+            return;
+        }
+    }
+
+    if (amount == 0) {
+        return;
+    }
+
+    uint64_t * const references = malloc(sizeof(*references) * amount);
+
+    // strings are put into dictionaries before rows are assembled at the end of file
+    uint64_t * codes = NULL;
+    for (uint16_t j = 0; j < columns_amount; ++j) {
+        struct storage_dictionary * const dictionary = storage_table_get_dictionary(table, j);
+
+        if (!dictionary) {
+            continue;
+        }
+
+        if (!codes) {
+            codes = malloc(sizeof(*codes) * amount * columns_amount);
+        }
+
+        for (uint64_t i = 0; i < amount; ++i) {
+            const struct storage_value * const value = values[i * columns_amount + j];
+
+            if (value) {
+                codes[i * columns_amount + j] = storage_dictionary_encode(table->storage, dictionary, value->value.str);
+            }
+        }
+    }
+
+    if (table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        storage_table_append_row_groups(table, amount, values, codes, references);
+    } else {
+        storage_table_append_rows(table, amount, values, codes, references);
+    }
+
+    for (struct storage_index * index = storage_table_get_indexes(table); index; index = index->next) {
+        for (uint64_t i = 0; i < amount; ++i) {
+            const struct storage_value * const value = values[i * columns_amount + index->column];
+
+            if (value) {
+                storage_index_insert(index, value, references[i]);
+            }
+        }
+    }
+
+    free(codes);
+    free(references);
+}
+
+// storage_batch
+
+enum storage_simd_level {
+    STORAGE_SIMD_SCALAR,
+    STORAGE_SIMD_SSE42,
+    STORAGE_SIMD_AVX2,
+};
+
+// results of outcomes accepted by filter
+struct storage_filter {
+    uint8_t less;
+    uint8_t equal;
+    uint8_t greater;
+    uint8_t unordered;
+};
+
+#ifdef STORAGE_SIMD
+static enum storage_simd_level storage_simd_detected_level;
+static pthread_once_t storage_simd_detected = PTHREAD_ONCE_INIT;
+
+static void storage_simd_detect(void) {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        storage_simd_detected_level = STORAGE_SIMD_AVX2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        storage_simd_detected_level = STORAGE_SIMD_SSE42;
+    } else {
+        storage_simd_detected_level = STORAGE_SIMD_SCALAR;
+    }
+}
+#endif
+
+// filters of batches may run in several threads at once, so level is detected once
+static enum storage_simd_level storage_simd_level(void) {
+#ifdef STORAGE_SIMD
+    pthread_once(&storage_simd_detected, storage_simd_detect);
+    return storage_simd_detected_level;
+#else
+    return STORAGE_SIMD_SCALAR;
+#endif
+}
+
+static struct storage_filter storage_filter_make(uint8_t accepted) {
+    return (struct storage_filter) {
+        .less = (accepted & STORAGE_OUTCOME_LESS) != 0,
+        .equal = (accepted & STORAGE_OUTCOME_EQUAL) != 0,
+        .greater = (accepted & STORAGE_OUTCOME_GREATER) != 0,
+        .unordered = (accepted & STORAGE_OUTCOME_UNORDERED) != 0,
+    };
+}
+
+// compares values as signed integers after flipping bias bits, so uint64_t values are compared with sign bias
+static void storage_filter_bits_scalar(const uint64_t * values, uint32_t amount, uint64_t value, uint64_t bias,
+        struct storage_filter filter, uint8_t * result) {
+    const int64_t right = (int64_t) (value ^ bias);
+
+    for (uint32_t i = 0; i < amount; ++i) {
+        const int64_t left = (int64_t) (values[i] ^ bias);
+
+        result[i] = left < right ? filter.less : left > right ? filter.greater : filter.equal;
+    }
+}
+
+static uint8_t storage_filter_num_cell(double left, double right, struct storage_filter filter) {
+    if (left < right) {
+        return filter.less;
+    }
+
+    if (left > right) {
+        return filter.greater;
+    }
+
+    return left == right ? filter.equal : filter.unordered;
+}
+
+static void storage_filter_num_scalar(const double * values, uint32_t amount, double value,
+        struct storage_filter filter, uint8_t * result) {
+    for (uint32_t i = 0; i < amount; ++i) {
+        result[i] = storage_filter_num_cell(values[i], value, filter);
+    }
+}
+
+#ifdef STORAGE_SIMD
+__attribute__((target("avx2")))
+static void storage_filter_bits_avx2(const uint64_t * values, uint32_t amount, uint64_t value, uint64_t bias,
+        struct storage_filter filter, uint8_t * result) {
+    const __m256i bias_bits = _mm256_set1_epi64x((int64_t) bias);
+    const __m256i right = _mm256_set1_epi64x((int64_t) (value ^ bias));
+    const __m256i less = _mm256_set1_epi64x(-(int64_t) filter.less);
+    const __m256i equal = _mm256_set1_epi64x(-(int64_t) filter.equal);
+    const __m256i greater = _mm256_set1_epi64x(-(int64_t) filter.greater);
+
+    uint32_t i = 0;
+    for (; i + 4 <= amount; i += 4) {
+        const __m256i left = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (values + i)), bias_bits);
+
+        const __m256i accepted = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_and_si256(_mm256_cmpgt_epi64(right, left), less),
+                _mm256_and_si256(_mm256_cmpgt_epi64(left, right), greater)),
+            _mm256_and_si256(_mm256_cmpeq_epi64(left, right), equal));
+
+        const int bits = _mm256_movemask_pd(_mm256_castsi256_pd(accepted));
+        for (int j = 0; j < 4; ++j) {
+            result[i + j] = (bits >> j) & 1;
+        }
+    }
+
+    storage_filter_bits_scalar(values + i, amount - i, value, bias, filter, result + i);
+}
+
+__attribute__((target("avx2")))
+static void storage_filter_num_avx2(const double * values, uint32_t amount, double value,
+        struct storage_filter filter, uint8_t * result) {
+    const __m256d right = _mm256_set1_pd(value);
+    const __m256d less = _mm256_castsi256_pd(_mm256_set1_epi64x(-(int64_t) filter.less));
+    const __m256d equal = _mm256_castsi256_pd(_mm256_set1_epi64x(-(int64_t) filter.equal));
+    const __m256d greater = _mm256_castsi256_pd(_mm256_set1_epi64x(-(int64_t) filter.greater));
+    const __m256d unordered = _mm256_castsi256_pd(_mm256_set1_epi64x(-(int64_t) filter.unordered));
+
+    uint32_t i = 0;
+    for (; i + 4 <= amount; i += 4) {
+        const __m256d left = _mm256_loadu_pd(values + i);
+
+        const __m256d accepted = _mm256_or_pd(
+            _mm256_or_pd(
+                _mm256_and_pd(_mm256_cmp_pd(left, right, _CMP_LT_OQ), less),
+                _mm256_and_pd(_mm256_cmp_pd(left, right, _CMP_GT_OQ), greater)),
+            _mm256_or_pd(
+                _mm256_and_pd(_mm256_cmp_pd(left, right, _CMP_EQ_OQ), equal),
+                _mm256_and_pd(_mm256_cmp_pd(left, right, _CMP_UNORD_Q), unordered)));
+
+        const int bits = _mm256_movemask_pd(accepted);
+        for (int j = 0; j < 4; ++j) {
+            result[i + j] = (bits >> j) & 1;
+        }
+    }
+
+    storage_filter_num_scalar(values + i, amount - i, value, filter, result + i);
+}
+
+__attribute__((target("sse4.2")))
+static void storage_filter_bits_sse42(const uint64_t * values, uint32_t amount, uint64_t value, uint64_t bias,
+        struct storage_filter filter, uint8_t * result) {
+    const __m128i bias_bits = _mm_set1_epi64x((int64_t) bias);
+    const __m128i right = _mm_set1_epi64x((int64_t) (value ^ bias));
+    const __m128i less = _mm_set1_epi64x(-(int64_t) filter.less);
+    const __m128i equal = _mm_set1_epi64x(-(int64_t) filter.equal);
+    const __m128i greater = _mm_set1_epi64x(-(int64_t) filter.greater);
+
+    uint32_t i = 0;
+    for (; i + 2 <= amount; i += 2) {
+        const __m128i left = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (values + i)), bias_bits);
+
+        const __m128i accepted = _mm_or_si128(
+            _mm_or_si128(
+                _mm_and_si128(_mm_cmpgt_epi64(right, left), less),
+                _mm_and_si128(_mm_cmpgt_epi64(left, right), greater)),
+            _mm_and_si128(_mm_cmpeq_epi64(left, right), equal));
+
+        const int bits = _mm_movemask_pd(_mm_castsi128_pd(accepted));
+        result[i] = bits & 1;
+        result[i + 1] = (bits >> 1) & 1;
+    }
+
+    storage_filter_bits_scalar(values + i, amount - i, value, bias, filter, result + i);
+}
+
+__attribute__((target("sse4.2")))
+static void storage_filter_num_sse42(const double * values, uint32_t amount, double value,
+        struct storage_filter filter, uint8_t * result) {
+    const __m128d right = _mm_set1_pd(value);
+    const __m128d less = _mm_castsi128_pd(_mm_set1_epi64x(-(int64_t) filter.less));
+    const __m128d equal = _mm_castsi128_pd(_mm_set1_epi64x(-(int64_t) filter.equal));
+    const __m128d greater = _mm_castsi128_pd(_mm_set1_epi64x(-(int64_t) filter.greater));
+    const __m128d unordered = _mm_castsi128_pd(_mm_set1_epi64x(-(int64_t) filter.unordered));
+
+    uint32_t i = 0;
+    for (; i + 2 <= amount; i += 2) {
+        const __m128d left = _mm_loadu_pd(values + i);
+
+        const __m128d accepted = _mm_or_pd(
+            _mm_or_pd(
+                _mm_and_pd(_mm_cmplt_pd(left, right), less),
+                _mm_and_pd(_mm_cmpgt_pd(left, right), greater)),
+            _mm_or_pd(
+                _mm_and_pd(_mm_cmpeq_pd(left, right), equal),
+                _mm_and_pd(_mm_cmpunord_pd(left, right), unordered)));
+
+        const int bits = _mm_movemask_pd(accepted);
+        result[i] = bits & 1;
+        result[i + 1] = (bits >> 1) & 1;
+    }
+
+    storage_filter_num_scalar(values + i, amount - i, value, filter, result + i);
+}
+#endif
+
+static void storage_filter_bits(const uint64_t * values, uint32_t amount, uint64_t value, uint64_t bias,
+        struct storage_filter filter, uint8_t * result) {
+    switch (storage_simd_level()) {
+#ifdef STORAGE_SIMD
+        case STORAGE_SIMD_AVX2:
+            storage_filter_bits_avx2(values, amount, value, bias, filter, result);
+            return;
+
+        case STORAGE_SIMD_SSE42:
+            storage_filter_bits_sse42(values, amount, value, bias, filter, result);
+            return;
+#endif
+
+        default:
+            storage_filter_bits_scalar(values, amount, value, bias, filter, result);
+            return;
+    }
+}
+
+static void storage_filter_num(const double * values, uint32_t amount, double value,
+        struct storage_filter filter, uint8_t * result) {
+    switch (storage_simd_level()) {
+#ifdef STORAGE_SIMD
+        case STORAGE_SIMD_AVX2:
+            storage_filter_num_avx2(values, amount, value, filter, result);
+            return;
+
+        case STORAGE_SIMD_SSE42:
+            storage_filter_num_sse42(values, amount, value, filter, result);
+            return;
+#endif
+
+        default:
+            storage_filter_num_scalar(values, amount, value, filter, result);
+            return;
+    }
+}
+
+// integer cells compared with number are converted to double as by storage_value_compare
+static void storage_filter_int_as_num(const int64_t * values, uint32_t amount, double value,
+        struct storage_filter filter, uint8_t * result) {
+    for (uint32_t i = 0; i < amount; ++i) {
+        result[i] = storage_filter_num_cell((double) values[i], value, filter);
+    }
+}
+
+static void storage_filter_uint_as_num(const uint64_t * values, uint32_t amount, double value,
+        struct storage_filter filter, uint8_t * result) {
+    for (uint32_t i = 0; i < amount; ++i) {
+        result[i] = storage_filter_num_cell((double) values[i], value, filter);
+    }
+}
+
+// NULL cells have no strings, their results are left as is
+static void storage_filter_str(const struct storage_vector * vector, const char * strings, uint32_t amount, const char * value,
+        struct storage_filter filter, uint8_t * result) {
+    for (uint32_t i = 0; i < amount; ++i) {
+        if (vector->nulls[i]) {
+            continue;
+        }
+
+        const int compare = strcmp(strings + vector->values.str[i], value);
+
+        result[i] = compare < 0 ? filter.less : compare > 0 ? filter.greater : filter.equal;
+    }
+}
+
+// codes are compared with code of the value when only equality matters,
+// otherwise strings of codes are compared with it as by storage_filter_str
+static void storage_filter_codes(const struct storage_vector * vector, uint32_t amount, const char * value,
+        struct storage_filter filter, uint8_t * result) {
+    const struct storage_dictionary * const dictionary = vector->dictionary;
+
+    if (filter.less == filter.greater) {
+        uint32_t code;
+
+        if (!storage_dictionary_find(dictionary, value, &code)) {
+            memset(result, filter.less, amount);
+            return;
+        }
+
+        for (uint32_t i = 0; i < amount; ++i) {
+            result[i] = vector->values.uint[i] == code ? filter.equal : filter.less;
+        }
+
+        return;
+    }
+
+    for (uint32_t i = 0; i < amount; ++i) {
+        if (vector->nulls[i]) {
+            continue;
+        }
+
+        const int compare = strcmp(dictionary->strings[vector->values.uint[i]], value);
+
+        result[i] = compare < 0 ? filter.less : compare > 0 ? filter.greater : filter.equal;
+    }
+}
+
+// appends string of cell to batch strings and returns its offset there
+static uint64_t storage_batch_read_string(struct storage_batch * batch, uint64_t pointer) {
+    struct storage * const storage = batch->table->storage;
+
+    uint16_t length;
+    storage_read(storage, &pointer, &length, sizeof(length));
+
+    if (batch->strings.size + length + 1 > batch->strings.capacity) {
+        while (batch->strings.size + length + 1 > batch->strings.capacity) {
+            batch->strings.capacity *= 2;
+        }
+
+        batch->strings.data = realloc(batch->strings.data, batch->strings.capacity);
+    }
+
+    const uint64_t offset = batch->strings.size;
+    storage_read(storage, &pointer, batch->strings.data + offset, length);
+    batch->strings.data[offset + length] = '\0';
+
+    batch->strings.size += length + 1;
+    return offset;
+}
+
+// reads cell of row into the next slot of vector
+static void storage_batch_read_cell(struct storage_batch * batch, struct storage_vector * vector, struct storage_row * row) {
+    struct storage * const storage = batch->table->storage;
+    const uint32_t index = batch->amount;
+
+    vector->nulls[index] = row->table->format != STORAGE_TABLE_FORMAT_CELL_POINTERS && storage_row_is_null(row, vector->column);
+    vector->values.uint[index] = 0;
+
+    if (vector->nulls[index]) {
+        return;
+    }
+
+    uint64_t offset = storage_row_cell_position(row, vector->column);
+    uint64_t pointer = offset;
+
+    if (storage_table_is_cell_pointer(row->table, vector->column)) {
+        storage_read(storage, &offset, &pointer, sizeof(pointer));
+
+        if (pointer == 0) {
+            vector->nulls[index] = true;
+            return;
+        }
+
+        pointer = storage_row_cell_pointer(row, pointer);
+    }
+
+    if (vector->type == STORAGE_COLUMN_TYPE_STR && !vector->dictionary) {
+        vector->values.str[index] = storage_batch_read_string(batch, pointer);
+    } else {
+        storage_read(storage, &pointer, &vector->values.uint[index], sizeof(vector->values.uint[index]));
+    }
+}
+
+// reads run of slots of row group under cursor down to the slot that fits into batch;
+// slots are walked backwards and deleted ones are skipped as by storage_row_group_seek
+static void storage_batch_read_slots(struct storage_batch * batch) {
+    struct storage * const storage = batch->table->storage;
+    struct storage_row * const row = batch->cursor;
+
+    const uint32_t high = row->slot.index;
+    const uint32_t free_slots = STORAGE_BATCH_ROWS - batch->amount;
+    const uint32_t low = high > free_slots ? high - free_slots : 0;
+
+    // bitmaps are read from the byte of low slot, so bits are shifted by base
+    const uint32_t base = low / 8 * 8;
+    const uint32_t bitmap_size = (high + 7) / 8 - low / 8;
+
+    uint8_t bitmap[STORAGE_BATCH_ROWS / 8 + 1];
+    uint64_t cells[STORAGE_BATCH_ROWS];
+    uint32_t slots[STORAGE_BATCH_ROWS];
+
+    uint64_t offset = row->position + ROW_GROUP_HEADER_SIZE + low / 8;
+    storage_read(storage, &offset, bitmap, bitmap_size);
+
+    uint32_t amount = 0;
+    for (uint32_t slot = high; slot-- > low; ) {
+        if (!((bitmap[(slot - base) / 8] >> (slot % 8)) & 1)) {
+            batch->rows[batch->amount + amount] = row->position << 16 | slot;
+            slots[amount++] = slot;
+        }
+    }
+
+    for (uint16_t i = 0; i < batch->columns.amount; ++i) {
+        struct storage_vector * const vector = &batch->columns.vectors[i];
+        const uint64_t validity = storage_row_group_validity(row, vector->column);
+
+        offset = validity + low / 8;
+        storage_read(storage, &offset, bitmap, bitmap_size);
+
+        offset = validity + row->slot.capacity / 8 + low * sizeof(uint64_t);
+        storage_read(storage, &offset, cells, (high - low) * sizeof(uint64_t));
+
+        for (uint32_t j = 0; j < amount; ++j) {
+            const uint32_t slot = slots[j];
+            const uint32_t index = batch->amount + j;
+            const uint64_t cell = cells[slot - low];
+
+            vector->nulls[index] = !((bitmap[(slot - base) / 8] >> (slot % 8)) & 1);
+            vector->values.uint[index] = 0;
+
+            if (vector->nulls[index]) {
+                continue;
+            }
+
+            if (vector->type != STORAGE_COLUMN_TYPE_STR || vector->dictionary) {
+                vector->values.uint[index] = cell;
+            } else if (cell == 0) {
+                vector->nulls[index] = true;
+            } else {
+                vector->values.str[index] = storage_batch_read_string(batch, storage_row_cell_pointer(row, cell));
+            }
+        }
+    }
+
+    batch->amount += amount;
+    row->slot.index = low;
+}
+
+// tells whether row group under cursor can have rows passing zone filter
+static bool storage_batch_check_zones(struct storage_batch * batch) {
+    if (!batch->zones.filter || !storage_table_has_zone_maps(batch->table)) {
+        return true;
+    }
+
+    const struct storage_row * const row = batch->cursor;
+
+    for (uint16_t i = 0; i < batch->columns.amount; ++i) {
+        uint64_t offset = row->position + storage_row_group_zone_offset(row->slot.capacity, batch->columns.vectors[i].column);
+
+        storage_read(batch->table->storage, &offset, &batch->zones.maps[i], sizeof(batch->zones.maps[i]));
+    }
+
+    return batch->zones.filter(batch, batch->zones.maps, batch->zones.context);
+}
+
+static bool storage_table_check_columns(const struct storage_table * table, uint16_t columns_amount, const uint16_t * columns) {
+    for (uint16_t i = 0; i < columns_amount; ++i) {
+        if (columns[i] >= table->columns.amount) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// makes batch without cursor
+static struct storage_batch * storage_batch_new(struct storage_table * table, uint16_t columns_amount, const uint16_t * columns) {
+    struct storage_batch * batch = malloc(sizeof(*batch));
+    batch->table = table;
+    batch->cursor = NULL;
+    batch->bound = UINT64_MAX;
+    batch->amount = 0;
+    batch->selected = 0;
+
+    batch->columns.amount = columns_amount;
+    batch->columns.vectors = malloc(sizeof(struct storage_vector) * columns_amount);
+
+    for (uint16_t i = 0; i < columns_amount; ++i) {
+        batch->columns.vectors[i].column = columns[i];
+        batch->columns.vectors[i].type = table->columns.columns[columns[i]].type;
+        batch->columns.vectors[i].dictionary = storage_table_get_dictionary(table, columns[i]);
+    }
+
+    batch->strings.size = 0;
+    batch->strings.capacity = STORAGE_PAGE_SIZE;
+    batch->strings.data = malloc(batch->strings.capacity);
+
+    batch->zones.filter = NULL;
+    batch->zones.context = NULL;
+    batch->zones.checked = false;
+    batch->zones.maps = malloc(sizeof(struct storage_zone) * columns_amount);
+
+    return batch;
+}
+
+struct storage_batch * storage_table_scan(struct storage_table * table, const struct storage_index_scan * scan,
+        uint16_t columns_amount, const uint16_t * columns) {
+    if (!storage_table_check_columns(table, columns_amount, columns)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct storage_batch * batch = storage_batch_new(table, columns_amount, columns);
+
+    if (scan) {
+        batch->cursor = storage_index_scan_get_first_row(scan);
+    } else if (table->format == STORAGE_TABLE_FORMAT_COLUMNAR && table->first_row) {
+        // cursor stays on row group with slot index of the last read slot
+        batch->cursor = malloc(sizeof(*batch->cursor));
+        batch->cursor->table = table;
+        batch->cursor->position = table->first_row;
+        batch->cursor->scan = NULL;
+
+        storage_row_group_read_header(table->storage, batch->cursor);
+    } else {
+        batch->cursor = storage_table_get_first_row(table);
+    }
+
+    return batch;
+}
+
+// claims the next morsel of job: puts cursor of batch on its first row
+// and bounds batch by it, returns index of morsel or -1 when there is none
+static int64_t storage_scan_job_claim(struct storage_scan_job * job, struct storage_batch * batch) {
+    struct storage * const storage = job->table->storage;
+
+    pthread_mutex_lock(&job->lock);
+
+    const bool satisfied = job->limit > 0 && job->done_rows >= job->limit;
+    if (job->exhausted || satisfied || job->amount - job->taken >= job->window) {
+        pthread_mutex_unlock(&job->lock);
+        return -1;
+    }
+
+    struct storage_row * row = malloc(sizeof(*row));
+    row->table = job->table;
+    row->scan = NULL;
+
+    if (job->scan) {
+        row->scan = job->scan;
+        row->scan_index = job->position;
+        storage_row_seek_reference(row, job->scan->rows[job->position]);
+
+        const uint64_t left = job->scan->amount - job->position;
+        batch->bound = left < STORAGE_MORSEL_ROWS ? left : STORAGE_MORSEL_ROWS;
+
+        job->position += batch->bound;
+        job->exhausted = job->position == job->scan->amount;
+    } else if (job->table->format == STORAGE_TABLE_FORMAT_COLUMNAR) {
+        row->position = job->position;
+        storage_row_group_read_header(storage, row);
+        batch->bound = 1;
+
+        job->position = row->next;
+        job->exhausted = row->next == 0;
+    } else {
+        row->position = job->position;
+
+        uint64_t offset = row->position;
+        storage_read(storage, &offset, &row->next, sizeof(row->next));
+
+        // only pointers of morsel rows are read to find the next morsel
+        uint64_t position = row->next;
+        for (batch->bound = 1; batch->bound < STORAGE_MORSEL_ROWS && position; ++batch->bound) {
+            offset = position;
+            storage_read(storage, &offset, &position, sizeof(position));
+        }
+
+        job->position = position;
+        job->exhausted = position == 0;
+    }
+
+    if (job->amount == job->capacity) {
+        job->capacity = job->capacity ? 2 * job->capacity : 16;
+        job->morsels = realloc(job->morsels, sizeof(struct storage_scan_morsel) * job->capacity);
+    }
+
+    const uint64_t index = job->amount++;
+    job->morsels[index].done = false;
+    job->morsels[index].amount = 0;
+    job->morsels[index].rows = NULL;
+
+    pthread_mutex_unlock(&job->lock);
+
+    batch->cursor = row;
+    batch->zones.checked = false;
+    return (int64_t) index;
+}
+
+// tells whether rows selected by morsel so far make the rest of job useless
+static bool storage_scan_job_is_satisfied(struct storage_scan_job * job, uint64_t index, uint64_t amount) {
+    if (job->limit == 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&job->lock);
+
+    const bool satisfied = job->done_rows >= job->limit || (index == job->done && job->done_rows + amount >= job->limit);
+
+    pthread_mutex_unlock(&job->lock);
+    return satisfied;
+}
+
+static void storage_scan_job_finish(struct storage_scan_job * job, uint64_t index, uint64_t amount, uint64_t * rows, bool damaged) {
+    pthread_mutex_lock(&job->lock);
+
+    if (damaged) {
+        job->damaged = true;
+        job->exhausted = true;
+    }
+
+    job->morsels[index].done = true;
+    job->morsels[index].amount = amount;
+    job->morsels[index].rows = rows;
+
+    while (job->done < job->amount && job->morsels[job->done].done) {
+        job->done_rows += job->morsels[job->done].amount;
+        ++job->done;
+    }
+
+    pthread_cond_broadcast(&job->morsel_done);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// reads and filters morsel claimed by batch
+static void storage_scan_job_read(struct storage_scan_job * job, struct storage_batch * batch, uint64_t index) {
+    uint64_t amount = 0, capacity = 0;
+    uint64_t * rows = NULL;
+
+    const bool mark = storage_read_mark();
+
+    while (storage_batch_next(batch)) {
+        job->filter(batch, job->context);
+
+        if (amount + batch->selected > capacity) {
+            capacity = amount + batch->selected > 2 * capacity ? amount + batch->selected : 2 * capacity;
+            rows = realloc(rows, sizeof(uint64_t) * capacity);
+        }
+
+        for (uint32_t i = 0; i < batch->selected; ++i) {
+            rows[amount++] = batch->rows[batch->selection[i]];
+        }
+
+        if (batch->cursor && storage_scan_job_is_satisfied(job, index, amount)) {
+            storage_row_delete(batch->cursor);
+            batch->cursor = NULL;
+        }
+    }
+
+    storage_scan_job_finish(job, index, amount, rows, storage_read_damaged(mark));
+}
+
+// offers job to idle scan threads
+static void storage_scan_job_queue(struct storage_scan_job * job) {
+    struct storage * const storage = job->table->storage;
+
+    pthread_mutex_lock(&storage->scans.lock);
+
+    if (storage->scans.amount > 0 && !job->queued) {
+        struct storage_scan_job ** link = &storage->scans.jobs;
+        while (*link) {
+            link = &(*link)->next_queued;
+        }
+
+        *link = job;
+        job->next_queued = NULL;
+        job->queued = true;
+
+        pthread_cond_broadcast(&storage->scans.queued);
+    }
+
+    pthread_mutex_unlock(&storage->scans.lock);
+}
+
+static void storage_scan_job_dequeue(struct storage * storage, struct storage_scan_job * job) {
+    if (!job->queued) {
+        return;
+    }
+
+    for (struct storage_scan_job ** link = &storage->scans.jobs; *link; link = &(*link)->next_queued) {
+        if (*link == job) {
+            *link = job->next_queued;
+            break;
+        }
+    }
+
+    job->queued = false;
+}
+
+// starts parallel scan of table (rows of index scan if it is not NULL) whose batches
+// are passed to filter, it stops after limit of selected rows (0 for no limit)
+struct storage_scan_job * storage_table_scan_parallel(struct storage_table * table, const struct storage_index_scan * scan,
+        uint16_t columns_amount, const uint16_t * columns, storage_zone_filter zone_filter, storage_batch_filter filter,
+        void * context, uint64_t limit) {
+    if (!storage_table_check_columns(table, columns_amount, columns)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct storage * const storage = table->storage;
+
+    struct storage_scan_job * job = malloc(sizeof(*job));
+    job->table = table;
+    job->scan = scan;
+    job->columns_amount = columns_amount;
+    job->columns = malloc(sizeof(uint16_t) * columns_amount);
+    memcpy(job->columns, columns, sizeof(uint16_t) * columns_amount);
+    job->zone_filter = zone_filter;
+    job->filter = filter;
+    job->context = context;
+    job->limit = limit;
+
+    job->batch = storage_batch_new(table, columns_amount, columns);
+    job->batch->zones.filter = zone_filter;
+    job->batch->zones.context = context;
+
+    job->queued = false;
+    job->workers = 0;
+    job->next_queued = NULL;
+
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->morsel_done, NULL);
+
+    job->position = scan ? 0 : table->first_row;
+    job->exhausted = scan ? scan->amount == 0 : table->first_row == 0;
+    job->damaged = false;
+
+    job->amount = 0;
+    job->capacity = 0;
+    job->taken = 0;
+    job->morsels = NULL;
+
+    pthread_mutex_lock(&storage->scans.lock);
+    job->window = 2 * (storage->scans.amount + 1);
+    pthread_mutex_unlock(&storage->scans.lock);
+
+    job->done = 0;
+    job->done_rows = 0;
+
+    if (!job->exhausted) {
+        storage_scan_job_queue(job);
+    }
+
+    return job;
+}
+
+// sets rows to rows selected from the next morsel, they are valid until the next call;
+// returns false after the last morsel, morsels may have more rows than limit;
+// returns false with errno EIO when morsel of damaged body was read, the request is damaged then
+bool storage_scan_job_next(struct storage_scan_job * job, struct storage_index_scan * rows) {
+    pthread_mutex_lock(&job->lock);
+
+    if (job->taken > 0) {
+        free(job->morsels[job->taken - 1].rows);
+        job->morsels[job->taken - 1].rows = NULL;
+    }
+
+    while (!job->damaged && (job->taken == job->amount || !job->morsels[job->taken].done)) {
+        // the next morsel is read by scan thread
+        if (job->taken < job->amount) {
+            pthread_cond_wait(&job->morsel_done, &job->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&job->lock);
+
+        const int64_t index = storage_scan_job_claim(job, job->batch);
+        if (index >= 0) {
+            storage_scan_job_read(job, job->batch, (uint64_t) index);
+        }
+
+        pthread_mutex_lock(&job->lock);
+
+        // job is over unless its last morsel was claimed meanwhile by scan thread
+        if (index < 0 && job->taken == job->amount) {
+            break;
+        }
+    }
+
+    // morsels after damaged one are not passed, scan threads may still read them
+    if (job->damaged) {
+        pthread_mutex_unlock(&job->lock);
+
+        storage_request.damaged = true;
+        errno = EIO;
+        return false;
+    }
+
+    if (job->taken == job->amount) {
+        pthread_mutex_unlock(&job->lock);
+        return false;
+    }
+
+    const struct storage_scan_morsel * const morsel = &job->morsels[job->taken++];
+    rows->table = job->table;
+    rows->amount = morsel->amount;
+    rows->rows = morsel->rows;
+
+    const bool exhausted = job->exhausted;
+    pthread_mutex_unlock(&job->lock);
+
+    // scan threads leave job when they are window ahead of reader
+    if (!exhausted) {
+        storage_scan_job_queue(job);
+    }
+
+    return true;
+}
+
+// takes job from scan threads until the next storage_scan_job_next,
+// so it can be kept after tables are unlocked
+void storage_scan_job_pause(struct storage_scan_job * job) {
+    struct storage * const storage = job->table->storage;
+
+    pthread_mutex_lock(&storage->scans.lock);
+    storage_scan_job_dequeue(storage, job);
+
+    while (job->workers > 0) {
+        pthread_cond_wait(&storage->scans.finished, &storage->scans.lock);
+    }
+
+    pthread_mutex_unlock(&storage->scans.lock);
+}
+
+void storage_scan_job_delete(struct storage_scan_job * job) {
+    if (!job) {
+        return;
+    }
+
+    storage_scan_job_pause(job);
+
+    for (uint64_t i = 0; i < job->amount; ++i) {
+        free(job->morsels[i].rows);
+    }
+
+    storage_batch_delete(job->batch);
+    pthread_cond_destroy(&job->morsel_done);
+    pthread_mutex_destroy(&job->lock);
+
+    free(job->morsels);
+    free(job->columns);
+    free(job);
+}
+
+// selects every row of parallel scan before returning them, up to limit of them (0 for no limit)
+struct storage_index_scan * storage_table_select(struct storage_table * table, const struct storage_index_scan * scan,
+        uint16_t columns_amount, const uint16_t * columns, storage_zone_filter zone_filter, storage_batch_filter filter,
+        void * context, uint64_t limit) {
+    struct storage_scan_job * const job = storage_table_scan_parallel(table, scan, columns_amount, columns,
+        zone_filter, filter, context, limit);
+
+    if (!job) {
+        return NULL;
+    }
+
+    struct storage_index_scan * result = malloc(sizeof(*result));
+    result->table = table;
+    result->amount = 0;
+    result->rows = NULL;
+
+    uint64_t capacity = 0;
+    struct storage_index_scan rows;
+
+    while ((limit == 0 || result->amount < limit) && storage_scan_job_next(job, &rows)) {
+        const uint64_t amount = limit == 0 || rows.amount < limit - result->amount ? rows.amount : limit - result->amount;
+
+        if (result->amount + amount > capacity) {
+            capacity = result->amount + amount > 2 * capacity ? result->amount + amount : 2 * capacity;
+            result->rows = realloc(result->rows, sizeof(uint64_t) * capacity);
+        }
+
+        memcpy(result->rows + result->amount, rows.rows, sizeof(uint64_t) * amount);
+        result->amount += amount;
+    }
+
+    storage_scan_job_delete(job);
+    return result;
+}
+
+static void * storage_scan_thread(void * arg) {
+    struct storage * const storage = arg;
+
+    pthread_mutex_lock(&storage->scans.lock);
+
+    while (!storage->scans.stopping) {
+        struct storage_scan_job * const job = storage->scans.jobs;
+
+        if (!job) {
+            pthread_cond_wait(&storage->scans.queued, &storage->scans.lock);
+            continue;
+        }
+
+        ++job->workers;
+        pthread_mutex_unlock(&storage->scans.lock);
+
+        struct storage_batch * const batch = storage_batch_new(job->table, job->columns_amount, job->columns);
+        batch->zones.filter = job->zone_filter;
+        batch->zones.context = job->context;
+
+        for (int64_t index = storage_scan_job_claim(job, batch); index >= 0; index = storage_scan_job_claim(job, batch)) {
+            storage_scan_job_read(job, batch, (uint64_t) index);
+        }
+
+        storage_batch_delete(batch);
+
+        // the job is offered again when its reader takes morsels
+        pthread_mutex_lock(&storage->scans.lock);
+        storage_scan_job_dequeue(storage, job);
+
+        if (--job->workers == 0) {
+            pthread_cond_broadcast(&storage->scans.finished);
+        }
+    }
+
+    pthread_mutex_unlock(&storage->scans.lock);
+    return NULL;
+}
+
+// scans are run by the request thread and threads - 1 scan threads
+void storage_set_scan_threads(struct storage * storage, unsigned int threads) {
+    storage_scan_threads_stop(storage);
+
+    const unsigned int amount = threads > 1 ? threads - 1 : 0;
+    storage->scans.threads = realloc(storage->scans.threads, sizeof(pthread_t) * (amount > 0 ? amount : 1));
+
+    // signals are left to threads of storage user
+    sigset_t signals, old_signals;
+    sigfillset(&signals);
+
+    pthread_sigmask(SIG_SETMASK, &signals, &old_signals);
+
+    for (unsigned int i = 0; i < amount; ++i) {
+        pthread_create(&storage->scans.threads[i], NULL, storage_scan_thread, storage);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+    pthread_mutex_lock(&storage->scans.lock);
+    storage->scans.amount = amount;
+    pthread_mutex_unlock(&storage->scans.lock);
+}
+
+void storage_batch_delete(struct storage_batch * batch) {
+    storage_row_delete(batch->cursor);
+
+    free(batch->columns.vectors);
+    free(batch->strings.data);
+    free(batch->zones.maps);
+    free(batch);
+}
+
+// reads rows of the next batch, returns false when rows are over
+// or with errno EIO when they are in damaged body
+bool storage_batch_next(struct storage_batch * batch) {
+    batch->amount = 0;
+    batch->selected = 0;
+    batch->strings.size = 0;
+
+    const bool mark = storage_read_mark();
+
+    while (batch->cursor && batch->amount < STORAGE_BATCH_ROWS) {
+        struct storage_row * const row = batch->cursor;
+
+        if (row->scan || row->table->format != STORAGE_TABLE_FORMAT_COLUMNAR) {
+            for (uint16_t i = 0; i < batch->columns.amount; ++i) {
+                storage_batch_read_cell(batch, &batch->columns.vectors[i], row);
+            }
+
+            batch->rows[batch->amount++] = storage_row_get_reference(row);
+
+            if (--batch->bound == 0) {
+                storage_row_delete(row);
+                batch->cursor = NULL;
+            } else {
+                batch->cursor = storage_row_next(row);
+            }
+
+            continue;
+        }
+
+        if (row->slot.index > 0 && !batch->zones.checked) {
+            batch->zones.checked = true;
+
+            if (!storage_batch_check_zones(batch)) {
+                row->slot.index = 0;
+            }
+        }
+
+        if (row->slot.index > 0) {
+            storage_batch_read_slots(batch);
+            continue;
+        }
+
+        if (row->next == 0 || --batch->bound == 0) {
+            free(row);
+            batch->cursor = NULL;
+            break;
+        }
+
+        row->position = row->next;
+        storage_row_group_read_header(batch->table->storage, row);
+        batch->zones.checked = false;
+    }
+
+    // rows of damaged body are not passed, so batch ends
+    if (storage_read_damaged(mark)) {
+        batch->amount = 0;
+
+        storage_row_delete(batch->cursor);
+        batch->cursor = NULL;
+        return false;
+    }
+
+    return batch->amount > 0;
+}
+
+struct storage_row * storage_batch_get_row(const struct storage_batch * batch, uint32_t index) {
+    if (index >= batch->amount) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct storage_row * row = malloc(sizeof(*row));
+    row->table = batch->table;
+    row->scan = NULL;
+
+    storage_row_seek_reference(row, batch->rows[index]);
+    return row;
+}
+
+// compares cells of vector with value (NULL is also a value here) and sets result bytes of accepted outcomes
+void storage_batch_compare(const struct storage_batch * batch, uint16_t vector,
+        const struct storage_value * value, uint8_t accepted, uint8_t * result) {
+    const struct storage_vector * const cells = &batch->columns.vectors[vector];
+    const struct storage_filter filter = storage_filter_make(accepted);
+    const uint32_t amount = batch->amount;
+
+    uint8_t null_result = (accepted & STORAGE_OUTCOME_NULL) != 0;
+
+    // every not NULL cell is greater than NULL
+    if (!value) {
+        memset(result, filter.greater, amount);
+        null_result = filter.equal;
+    } else {
+        switch (cells->type) {
+            case STORAGE_COLUMN_TYPE_INT:
+                switch (value->type) {
+                    case STORAGE_COLUMN_TYPE_INT:
+                        storage_filter_bits(cells->values.uint, amount, value->value.uint, 0, filter, result);
+                        break;
+
+                    case STORAGE_COLUMN_TYPE_UINT:
+                        if (value->value.uint > INT64_MAX) {
+                            memset(result, filter.less, amount);
+                        } else {
+                            storage_filter_bits(cells->values.uint, amount, value->value.uint, 0, filter, result);
+                        }
+
+                        break;
+
+                    case STORAGE_COLUMN_TYPE_NUM:
+                        storage_filter_int_as_num(cells->values._int, amount, value->value.num, filter, result);
+                        break;
+
+                    default:
+                        memset(result, 0, amount);
+                        break;
+                }
+
+                break;
+
+            case STORAGE_COLUMN_TYPE_UINT:
+                switch (value->type) {
+                    case STORAGE_COLUMN_TYPE_INT:
+                        if (value->value._int < 0) {
+                            memset(result, filter.greater, amount);
+                        } else {
+                            storage_filter_bits(cells->values.uint, amount, value->value.uint, 1ull << 63, filter, result);
+                        }
+
+                        break;
+
+                    case STORAGE_COLUMN_TYPE_UINT:
+                        storage_filter_bits(cells->values.uint, amount, value->value.uint, 1ull << 63, filter, result);
+                        break;
+
+                    case STORAGE_COLUMN_TYPE_NUM:
+                        storage_filter_uint_as_num(cells->values.uint, amount, value->value.num, filter, result);
+                        break;
+
+                    default:
+                        memset(result, 0, amount);
+                        break;
+                }
+
+                break;
+
+            case STORAGE_COLUMN_TYPE_NUM:
+                switch (value->type) {
+                    case STORAGE_COLUMN_TYPE_INT:
+                        storage_filter_num(cells->values.num, amount, (double) value->value._int, filter, result);
+                        break;
+
+                    case STORAGE_COLUMN_TYPE_UINT:
+                        storage_filter_num(cells->values.num, amount, (double) value->value.uint, filter, result);
+                        break;
+
+                    case STORAGE_COLUMN_TYPE_NUM:
+                        storage_filter_num(cells->values.num, amount, value->value.num, filter, result);
+                        break;
+
+                    default:
+                        memset(result, 0, amount);
+                        break;
+                }
+
+                break;
+
+            case STORAGE_COLUMN_TYPE_STR:
+                if (value->type == STORAGE_COLUMN_TYPE_STR && cells->dictionary) {
+                    storage_filter_codes(cells, amount, value->value.str, filter, result);
+                } else if (value->type == STORAGE_COLUMN_TYPE_STR) {
+                    storage_filter_str(cells, batch->strings.data, amount, value->value.str, filter, result);
+                } else {
+                    memset(result, 0, amount);
+                }
+
+                break;
+        }
+    }
+
+    for (uint32_t i = 0; i < amount; ++i) {
+        if (cells->nulls[i]) {
+            result[i] = null_result;
+        }
+    }
+}
+
+static uint8_t storage_zone_compare_num(double left, double right) {
+    if (left < right) {
+        return STORAGE_OUTCOME_LESS;
+    }
+
+    if (left > right) {
+        return STORAGE_OUTCOME_GREATER;
+    }
+
+    return left == right ? STORAGE_OUTCOME_EQUAL : STORAGE_OUTCOME_UNORDERED;
+}
+
+// outcome of comparison of zone bound with value as of batch filters,
+// string bounds are prefixes, so equal prefix is taken as the farthest outcome
+static uint8_t storage_zone_compare_bound(uint64_t bound, enum storage_column_type type,
+        const struct storage_value * value, uint8_t equal_prefix) {
+    switch (type) {
+        case STORAGE_COLUMN_TYPE_INT:
+            switch (value->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                    return (int64_t) bound < value->value._int ? STORAGE_OUTCOME_LESS
+                        : (int64_t) bound > value->value._int ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+
+                case STORAGE_COLUMN_TYPE_UINT:
+                    if ((int64_t) bound < 0) {
+                        return STORAGE_OUTCOME_LESS;
+                    }
+
+                    return bound < value->value.uint ? STORAGE_OUTCOME_LESS
+                        : bound > value->value.uint ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+
+                default:
+                    return storage_zone_compare_num((double) (int64_t) bound, value->value.num);
+            }
+
+        case STORAGE_COLUMN_TYPE_UINT:
+            switch (value->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                    if (value->value._int < 0) {
+                        return STORAGE_OUTCOME_GREATER;
+                    }
+
+                case STORAGE_COLUMN_TYPE_UINT:
+                    return bound < value->value.uint ? STORAGE_OUTCOME_LESS
+                        : bound > value->value.uint ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+
+                default:
+                    return storage_zone_compare_num((double) bound, value->value.num);
+            }
+
+        case STORAGE_COLUMN_TYPE_NUM: {
+            double left;
+            memcpy(&left, &bound, sizeof(left));
+
+            double right = value->value.num;
+            if (value->type == STORAGE_COLUMN_TYPE_INT) {
+                right = (double) value->value._int;
+            } else if (value->type == STORAGE_COLUMN_TYPE_UINT) {
+                right = (double) value->value.uint;
+            }
+
+            return storage_zone_compare_num(left, right);
+        }
+
+        case STORAGE_COLUMN_TYPE_STR: {
+            const uint64_t key = storage_zone_key(value);
+
+            return bound < key ? STORAGE_OUTCOME_LESS : bound > key ? STORAGE_OUTCOME_GREATER : equal_prefix;
+        }
+    }
+
+    return 0; // unreachable
+}
+
+// outcomes that cells bounded by zone map may have in comparison with value (or NULL) as of batch filters
+uint8_t storage_zone_get_outcomes(const struct storage_zone * zone, enum storage_column_type type, const struct storage_value * value) {
+    uint8_t outcomes = 0;
+
+    if (zone->nulls > 0) {
+        outcomes |= value ? STORAGE_OUTCOME_NULL : STORAGE_OUTCOME_EQUAL;
+    }
+
+    if (!value) {
+        if (zone->flags & (STORAGE_ZONE_FLAG_BOUNDS | STORAGE_ZONE_FLAG_NAN)) {
+            outcomes |= STORAGE_OUTCOME_GREATER;
+        }
+
+        return outcomes;
+    }
+
+    if (zone->flags & STORAGE_ZONE_FLAG_NAN) {
+        outcomes |= STORAGE_OUTCOME_UNORDERED;
+    }
+
+    if (zone->flags & STORAGE_ZONE_FLAG_BOUNDS) {
+        const uint8_t low = storage_zone_compare_bound(zone->min, type, value, STORAGE_OUTCOME_LESS);
+        const uint8_t high = storage_zone_compare_bound(zone->max, type, value, STORAGE_OUTCOME_GREATER);
+
+        // comparisons are monotonic, so cells between bounds have outcomes between outcomes of bounds
+        outcomes |= low | high;
+        if (low == STORAGE_OUTCOME_LESS && high == STORAGE_OUTCOME_GREATER) {
+            outcomes |= STORAGE_OUTCOME_EQUAL;
+        }
+    }
+
+    return outcomes;
+}
+
+void storage_value_destroy(struct storage_value value) {
+    switch (value.type) {
+        case STORAGE_COLUMN_TYPE_STR:
+            if (!value.view) {
+                free(value.value.str);
+            }
+
+        default:
+            break;
+    }
+}
+
+void storage_value_delete(struct storage_value * value) {
+    if (value) {
+        storage_value_destroy(*value);
+    }
+
+    free(value);
+}
+
+// compares not NULL values, numbers of any type are compared by value and go before strings;
+// NaN is equal to NaN and greater than other numbers, so values have one order in indexes and sorts
+int storage_value_compare(const struct storage_value * a, const struct storage_value * b) {
+    if ((a->type == STORAGE_COLUMN_TYPE_STR) != (b->type == STORAGE_COLUMN_TYPE_STR)) {
+        return a->type == STORAGE_COLUMN_TYPE_STR ? 1 : -1;
+    }
+
+    if (a->type == STORAGE_COLUMN_TYPE_STR) {
+        return strcmp(a->value.str, b->value.str);
+    }
+
+    if (a->type == STORAGE_COLUMN_TYPE_NUM || b->type == STORAGE_COLUMN_TYPE_NUM) {
+        const double a_num = a->type == STORAGE_COLUMN_TYPE_NUM ? a->value.num
+            : a->type == STORAGE_COLUMN_TYPE_INT ? (double) a->value._int : (double) a->value.uint;
+        const double b_num = b->type == STORAGE_COLUMN_TYPE_NUM ? b->value.num
+            : b->type == STORAGE_COLUMN_TYPE_INT ? (double) b->value._int : (double) b->value.uint;
+
+        if (isnan(a_num) || isnan(b_num)) {
+            return (isnan(a_num) != 0) - (isnan(b_num) != 0);
+        }
+
+        return a_num < b_num ? -1 : a_num > b_num;
+    }
+
+    if (a->type == STORAGE_COLUMN_TYPE_INT && b->type == STORAGE_COLUMN_TYPE_INT) {
+        return a->value._int < b->value._int ? -1 : a->value._int > b->value._int;
+    }
+
+    // negative int is less than any uint
+    if (a->type == STORAGE_COLUMN_TYPE_INT && a->value._int < 0) {
+        return -1;
+    }
+
+    if (b->type == STORAGE_COLUMN_TYPE_INT && b->value._int < 0) {
+        return 1;
+    }
+
+    return a->value.uint < b->value.uint ? -1 : a->value.uint > b->value.uint;
+}
+
+const char * storage_column_type_to_string(enum storage_column_type type) {
+    switch (type) {
+        case STORAGE_COLUMN_TYPE_INT:
+            return "int";
+
+        case STORAGE_COLUMN_TYPE_UINT:
+            return "uint";
+
+        case STORAGE_COLUMN_TYPE_NUM:
+            return "num";
+
+        case STORAGE_COLUMN_TYPE_STR:
+            return "str";
+
+        default:
+            return NULL;
+    }
+}
+
+static bool storage_value_is_equals(struct storage_value * a, struct storage_value * b) {
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    switch (a->type) {
+        case STORAGE_COLUMN_TYPE_INT:
+            switch (b->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                    return a->value._int == b->value._int;
+
+                case STORAGE_COLUMN_TYPE_UINT:
+                    if (a->value._int < 0) {
+                        return false;
+                    }
+
+                    return ((uint64_t) a->value._int) == b->value.uint;
+
+                case STORAGE_COLUMN_TYPE_NUM:
+                    return ((double) a->value._int) == b->value.num;
+
+                case STORAGE_COLUMN_TYPE_STR:
+                    return false;
+            }
+
+        case STORAGE_COLUMN_TYPE_UINT:
+            switch (b->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                    if (b->value._int < 0) {
+                        return false;
+                    }
+
+                    return a->value.uint == ((uint64_t) b->value._int);
+
+                case STORAGE_COLUMN_TYPE_UINT:
+                    return a->value.uint == b->value.uint;
+
+                case STORAGE_COLUMN_TYPE_NUM:
+                    return ((double) a->value.uint) == b->value.num;
+
+                case STORAGE_COLUMN_TYPE_STR:
+                    return false;
+            }
+
+        case STORAGE_COLUMN_TYPE_NUM:
+            switch (b->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                    return a->value.num == ((double) b->value._int);
+
+                case STORAGE_COLUMN_TYPE_UINT:
+                    return a->value.num == ((double) b->value.uint);
+
+                case STORAGE_COLUMN_TYPE_NUM:
+                    return a->value.num == b->value.num;
+
+                case STORAGE_COLUMN_TYPE_STR:
+                    return false;
+            }
+
+        case STORAGE_COLUMN_TYPE_STR:
+            switch (b->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                case STORAGE_COLUMN_TYPE_UINT:
+                case STORAGE_COLUMN_TYPE_NUM:
+                    return false;
+
+                // strings of the same dictionary are the same pointers
+                case STORAGE_COLUMN_TYPE_STR:
+                    return a->value.str == b->value.str || strcmp(a->value.str, b->value.str) == 0;
+            }
+    }
+}
+
+// equal numbers of different types have equal hashes as they are equal in joins
+static uint64_t storage_value_hash(const struct storage_value * value) {
+    uint64_t hash = 0;
+
+    if (value == NULL) {
+        return hash;
+    }
+
+    if (value->type == STORAGE_COLUMN_TYPE_STR) {
+        return storage_hash_string_64(value->value.str);
+    }
+
+    double num;
+    switch (value->type) {
+        case STORAGE_COLUMN_TYPE_INT:
+            num = (double) value->value._int;
+            break;
+
+        case STORAGE_COLUMN_TYPE_UINT:
+            num = (double) value->value.uint;
+            break;
+
+        default:
+            num = value->value.num;
+            break;
+    }
 
-    write(fd, buf, length);
-    return offset;
-}
+    // negative zero is equal to zero
+    if (num == 0) {
+        num = 0;
+    }
 
-static uint64_t storage_write_string(int fd, const char * str) {
-    uint16_t length = strlen(str);
+    memcpy(&hash, &num, sizeof(hash));
 
-    uint64_t ret = storage_write(fd, &length, sizeof(length));
-    write(fd, str, length);
-    return ret;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
 }
 
-void storage_table_add(struct storage_table * table) {
-    struct storage_table * another_table = storage_find_table(table->storage, table->name);
+// stable sort of entries by hash, entries of equal hash keep scan order
+static void storage_join_sort(struct storage_join_entry * entries, uint64_t amount) {
+    struct storage_join_entry * const buffer = malloc(sizeof(*buffer) * amount);
 
-    if (another_table != NULL) {
-        storage_table_delete(another_table);
-        errno = EINVAL;
-        return;
-    }
+    for (uint64_t width = 1; width < amount; width *= 2) {
+        for (uint64_t left = 0; left < amount; left += 2 * width) {
+            const uint64_t middle = left + width < amount ? left + width : amount;
+            const uint64_t right = left + 2 * width < amount ? left + 2 * width : amount;
 
-    table->next = table->storage->first_table;
-    table->position = storage_write(table->storage->fd, &table->next, sizeof(table->next));
-    table->storage->first_table = table->position;
+            uint64_t i = left, j = middle, k = left;
+            while (i < middle && j < right) {
+                buffer[k++] = entries[j].hash < entries[i].hash ? entries[j++] : entries[i++];
+            }
 
-    write(table->storage->fd, &table->first_row, sizeof(table->first_row));
-    storage_write_string(table->storage->fd, table->name);
-    write(table->storage->fd, &table->columns.amount, sizeof(table->columns.amount));
+            while (i < middle) {
+                buffer[k++] = entries[i++];
+            }
 
-    for (uint16_t i = 0; i < table->columns.amount; ++i) {
-        storage_write_string(table->storage->fd, table->columns.columns[i].name);
+            while (j < right) {
+                buffer[k++] = entries[j++];
+            }
+        }
 
-        uint8_t type = table->columns.columns[i].type;
-        write(table->storage->fd, &type, sizeof(type));
+        memcpy(entries, buffer, sizeof(*entries) * amount);
     }
 
-    lseek64(table->storage->fd, 4, SEEK_SET);
-    write(table->storage->fd, &table->position, sizeof(table->position));
+    free(buffer);
 }
 
-void storage_table_remove(struct storage_table * table) {
-    uint64_t pointer = table->storage->first_table;
+static void storage_join_hash_link(struct storage_join_hash * hash) {
+    hash->buckets_amount = 16;
+    while (hash->buckets_amount < hash->amount) {
+        hash->buckets_amount *= 2;
+    }
 
-    while (pointer) {
-        lseek64(table->storage->fd, (off64_t) pointer, SEEK_SET);
+    hash->buckets = calloc(hash->buckets_amount, sizeof(*hash->buckets));
+    hash->next = malloc(sizeof(*hash->next) * (hash->amount ? hash->amount : 1));
 
-        uint64_t next;
-        read(table->storage->fd, &next, sizeof(next));
+    // entries are linked from the last one, so chains keep scan order
+    for (uint64_t i = hash->amount; i-- > 0; ) {
+        const uint64_t bucket = hash->entries[i].hash & (hash->buckets_amount - 1);
 
-        if (next == table->position) {
-            break;
-        }
+        hash->next[i] = hash->buckets[bucket];
+        hash->buckets[bucket] = i + 1;
+    }
+}
 
-        pointer = next;
+// reads up to a block of entries of the spilled run or table
+static uint64_t storage_join_read_block(FILE * file, uint64_t offset, uint64_t amount, struct storage_join_entry * block) {
+    if (amount > JOIN_BLOCK_ENTRIES) {
+        amount = JOIN_BLOCK_ENTRIES;
     }
 
-    if (pointer == 0) {
-        pointer = 4;
-        table->storage->first_table = table->next;
+    if (pread(fileno(file), block, sizeof(*block) * amount, (off_t) offset) != (ssize_t) (sizeof(*block) * amount)) {
+        return 0;
     }
 
-    lseek64(table->storage->fd, (off64_t) pointer, SEEK_SET);
-    write(table->storage->fd, &table->next, sizeof(table->next));
+    return amount;
 }
 
-struct storage_row * storage_table_get_first_row(struct storage_table * table) {
-    if (table->first_row == 0) {
-        return NULL;
-    }
+// merges sorted runs into the sorted table after them, runs are taken in scan order on equal hashes
+static void storage_join_hash_merge(struct storage_join_hash * hash, struct storage_join_run * runs, unsigned int runs_amount) {
+    struct storage_join_entry * const output = malloc(sizeof(*output) * JOIN_BLOCK_ENTRIES);
+    uint64_t output_amount = 0, offset = hash->file_offset;
 
-    struct storage_row * row = malloc(sizeof(*row));
-    row->position = table->first_row;
-    row->table = table;
+    hash->fences = malloc(sizeof(*hash->fences) * ((hash->amount + JOIN_BLOCK_ENTRIES - 1) / JOIN_BLOCK_ENTRIES));
+    uint64_t fences_amount = 0;
 
-    lseek64(table->storage->fd, (off64_t) row->position, SEEK_SET);
-    read(table->storage->fd, &row->next, sizeof(row->next));
+    for (unsigned int i = 0; i < runs_amount; ++i) {
+        runs[i].block_amount = storage_join_read_block(hash->file, runs[i].offset, runs[i].amount, runs[i].block);
+        runs[i].block_index = 0;
+    }
 
-    return row;
-}
+    while (true) {
+        int min = -1;
 
-struct storage_row * storage_table_add_row(struct storage_table * table) {
-    struct storage_row * row = malloc(sizeof(*row));
+        for (unsigned int i = 0; i < runs_amount; ++i) {
+            if (runs[i].block_index < runs[i].block_amount && (min < 0
+                || runs[i].block[runs[i].block_index].hash < runs[min].block[runs[min].block_index].hash)) {
+                min = (int) i;
+            }
+        }
 
-    row->table = table;
-    row->next = table->first_row;
-    row->position = storage_write(table->storage->fd, &row->next, sizeof(row->next));
-    table->first_row = row->position;
+        if (min >= 0) {
+            struct storage_join_run * const run = &runs[min];
+            output[output_amount++] = run->block[run->block_index++];
 
-    uint64_t null = 0;
-    for (uint16_t i = 0; i < table->columns.amount; ++i) {
-        write(table->storage->fd, &null, sizeof(null));
-    }
+            if (run->block_index == run->block_amount) {
+                run->offset += sizeof(*run->block) * run->block_amount;
+                run->amount -= run->block_amount;
 
-    lseek64(table->storage->fd, (off64_t) (table->position + sizeof(uint64_t)), SEEK_SET);
-    write(table->storage->fd, &table->first_row, sizeof(table->first_row));
-    return row;
-}
+                run->block_amount = storage_join_read_block(hash->file, run->offset, run->amount, run->block);
+                run->block_index = 0;
+            }
+        }
 
-void storage_row_delete(struct storage_row * row) {
-    free(row);
-}
+        if (output_amount > 0 && (output_amount == JOIN_BLOCK_ENTRIES || min < 0)) {
+            hash->fences[fences_amount++] = output[0].hash;
 
-struct storage_row * storage_row_next(struct storage_row * row) {
-    row->position = row->next;
+            pwrite(fileno(hash->file), output, sizeof(*output) * output_amount, (off_t) offset);
+            offset += sizeof(*output) * output_amount;
+            output_amount = 0;
+        }
 
-    if (row->next == 0) {
-        free(row);
-        return NULL;
+        if (min < 0) {
+            break;
+        }
     }
 
-    lseek64(row->table->storage->fd, (off64_t) row->position, SEEK_SET);
-    read(row->table->storage->fd, &row->next, sizeof(row->next));
-    return row;
+    free(output);
 }
 
-void storage_row_remove(struct storage_row * row) {
-    uint64_t pointer = row->table->first_row;
+// builds hash table of rows of the table by the column; when entries exceed STORAGE_JOIN_MEMORY
+// they are written to temp file in sorted runs, which are merged into a sorted table
+static struct storage_join_hash * storage_join_hash_new(struct storage_table * table, uint16_t column) {
+    const uint64_t capacity = STORAGE_JOIN_MEMORY / (2 * sizeof(struct storage_join_entry));
+    const struct storage_dictionary * const dictionary = storage_table_get_dictionary(table, column);
 
-    while (pointer) {
-        lseek64(row->table->storage->fd, (off64_t) pointer, SEEK_SET);
+    struct storage_join_hash * hash = calloc(1, sizeof(*hash));
+    hash->entries = malloc(sizeof(*hash->entries) * capacity);
 
-        uint64_t next;
-        read(row->table->storage->fd, &next, sizeof(next));
+    struct storage_join_run * runs = NULL;
+    unsigned int runs_amount = 0;
+    uint64_t buffered = 0;
 
-        if (next == row->position) {
-            break;
+    for (struct storage_row * row = storage_table_get_first_row(table); row; row = storage_row_next(row)) {
+        if (buffered == capacity && !hash->file) {
+            hash->file = tmpfile();
+
+            // nowhere to spill, the table is kept in memory
+            if (!hash->file) {
+                hash->entries = realloc(hash->entries, sizeof(*hash->entries) * (hash->amount + capacity));
+                buffered = 0;
+            }
         }
 
-        pointer = next;
-    }
+        if (buffered == capacity) {
+            storage_join_sort(hash->entries, buffered);
 
-    if (pointer == 0) {
-        pointer = row->table->position + sizeof(uint64_t);
-        row->table->first_row = row->next;
-    }
+            runs = realloc(runs, sizeof(*runs) * (runs_amount + 1));
+            runs[runs_amount].offset = hash->file_offset;
+            runs[runs_amount].amount = buffered;
+            ++runs_amount;
 
-    lseek64(row->table->storage->fd, (off64_t) pointer, SEEK_SET);
-    write(row->table->storage->fd, &row->next, sizeof(row->next));
-}
+            pwrite(fileno(hash->file), hash->entries, sizeof(*hash->entries) * buffered, (off_t) hash->file_offset);
+            hash->file_offset += sizeof(*hash->entries) * buffered;
+            buffered = 0;
+        }
 
-struct storage_value * storage_row_get_value(struct storage_row * row, uint16_t index) {
-    if (index >= row->table->columns.amount) {
-        errno = EINVAL;
-        return NULL;
-    }
+        struct storage_join_entry * const entry = &hash->entries[hash->file ? buffered : hash->amount];
+        entry->row = storage_row_get_reference(row);
 
-    lseek64(row->table->storage->fd, (off64_t) (row->position + (1 + index) * sizeof(uint64_t)), SEEK_SET);
+        // strings of dictionary are hashed once
+        uint64_t code;
+        if (dictionary && storage_row_get_code(row, column, &code)) {
+            entry->hash = dictionary->hashes[code];
+        } else {
+            struct storage_value * const value = storage_row_get_value(row, column);
 
-    uint64_t pointer;
-    read(row->table->storage->fd, &pointer, sizeof(pointer));
+            entry->hash = storage_value_hash(value);
+            storage_value_delete(value);
+        }
 
-    if (pointer == 0) {
-        return NULL;
+        ++hash->amount;
+        ++buffered;
     }
 
-    lseek64(row->table->storage->fd, (off64_t) pointer, SEEK_SET);
+    if (!hash->file) {
+        storage_join_hash_link(hash);
+        return hash;
+    }
 
-    struct storage_value * value = malloc(sizeof(*value));
-    value->type = row->table->columns.columns[index].type;
+    if (buffered > 0) {
+        storage_join_sort(hash->entries, buffered);
 
-    switch (value->type) {
-        case STORAGE_COLUMN_TYPE_INT:
-            read(row->table->storage->fd, &value->value._int, sizeof(value->value._int));
-            break;
+        runs = realloc(runs, sizeof(*runs) * (runs_amount + 1));
+        runs[runs_amount].offset = hash->file_offset;
+        runs[runs_amount].amount = buffered;
+        ++runs_amount;
 
-        case STORAGE_COLUMN_TYPE_UINT:
-            read(row->table->storage->fd, &value->value.uint, sizeof(value->value.uint));
-            break;
+        pwrite(fileno(hash->file), hash->entries, sizeof(*hash->entries) * buffered, (off_t) hash->file_offset);
+        hash->file_offset += sizeof(*hash->entries) * buffered;
+    }
 
-        case STORAGE_COLUMN_TYPE_NUM:
-            read(row->table->storage->fd, &value->value.num, sizeof(value->value.num));
-            break;
+    free(hash->entries);
+    hash->entries = NULL;
 
-        case STORAGE_COLUMN_TYPE_STR:
-            value->value.str = storage_read_string(row->table->storage->fd);
-            break;
-    }
+    storage_join_hash_merge(hash, runs, runs_amount);
+    free(runs);
 
-    return value;
+    return hash;
 }
 
-void storage_row_set_value(struct storage_row * row, uint16_t index, struct storage_value * value) {
-    if (index >= row->table->columns.amount) {
-        errno = EINVAL;
-        return;
+static void storage_join_hash_delete(struct storage_join_hash * hash) {
+    if (hash) {
+        if (hash->file) {
+            fclose(hash->file);
+        }
+
+        free(hash->entries);
+        free(hash->buckets);
+        free(hash->next);
+        free(hash->fences);
     }
 
-    uint64_t pointer = 0;
+    free(hash);
+}
 
-    if (value) {
-        if (row->table->columns.columns[index].type != value->type) {
-            errno = EINVAL;
-            return;
-        }
+// adds the row to matches if its value of the column is equal to the value,
+// cells of column with dictionary are compared with code of the value
+static void storage_join_match(struct storage_table * table, uint16_t column, struct storage_value * value,
+    const uint64_t * value_code, uint64_t reference, struct storage_index_scan * matches) {
+    struct storage_row row = { .table = table, .scan = NULL };
+    storage_row_seek_reference(&row, reference);
 
-        switch (value->type) {
-            case STORAGE_COLUMN_TYPE_INT:
-                pointer = storage_write(row->table->storage->fd, &value->value._int, sizeof(value->value._int));
-                break;
+    bool is_equals;
+    if (value_code) {
+        uint64_t code;
 
-            case STORAGE_COLUMN_TYPE_UINT:
-                pointer = storage_write(row->table->storage->fd, &value->value.uint, sizeof(value->value.uint));
-                break;
+        is_equals = storage_row_get_code(&row, column, &code) && code == *value_code;
+    } else {
+        struct storage_value * const row_value = storage_row_get_value(&row, column);
 
-            case STORAGE_COLUMN_TYPE_NUM:
-                pointer = storage_write(row->table->storage->fd, &value->value.num, sizeof(value->value.num));
-                break;
+        is_equals = storage_value_is_equals(value, row_value);
+        storage_value_delete(row_value);
+    }
 
-            case STORAGE_COLUMN_TYPE_STR:
-                pointer = storage_write_string(row->table->storage->fd, value->value.str);
-                break;
+    if (is_equals) {
+        if ((matches->amount & (matches->amount - 1)) == 0) {
+            matches->rows = realloc(matches->rows, sizeof(*matches->rows) * (matches->amount ? matches->amount * 2 : 1));
         }
-    }
 
-    lseek64(row->table->storage->fd, (off64_t) (row->position + (1 + index) * sizeof(uint64_t)), SEEK_SET);
-    write(row->table->storage->fd, &pointer, sizeof(pointer));
+        matches->rows[matches->amount++] = reference;
+    }
 }
 
-void storage_value_destroy(struct storage_value value) {
-    switch (value.type) {
-        case STORAGE_COLUMN_TYPE_STR:
-            free(value.value.str);
+static void storage_join_hash_probe(struct storage_join_hash * hash, struct storage_table * table, uint16_t column,
+    struct storage_value * value, struct storage_index_scan * matches) {
+    const uint64_t value_hash = storage_value_hash(value);
 
-        default:
-            break;
+    free(matches->rows);
+    matches->rows = NULL;
+    matches->amount = 0;
+
+    // string that is not in dictionary of the column matches no rows
+    const struct storage_dictionary * const dictionary = storage_table_get_dictionary(table, column);
+    uint64_t code = 0;
+    const uint64_t * value_code = NULL;
+
+    if (dictionary && value && value->type == STORAGE_COLUMN_TYPE_STR) {
+        uint32_t found;
+
+        if (!storage_dictionary_find(dictionary, value->value.str, &found)) {
+            return;
+        }
+
+        code = found;
+        value_code = &code;
     }
-}
 
-void storage_value_delete(struct storage_value * value) {
-    if (value) {
-        storage_value_destroy(*value);
+    if (!hash->file) {
+        for (uint64_t entry = hash->buckets[value_hash & (hash->buckets_amount - 1)]; entry; entry = hash->next[entry - 1]) {
+            if (hash->entries[entry - 1].hash == value_hash) {
+                storage_join_match(table, column, value, value_code, hash->entries[entry - 1].row, matches);
+            }
+        }
+
+        return;
     }
 
-    free(value);
-}
+    const uint64_t blocks_amount = (hash->amount + JOIN_BLOCK_ENTRIES - 1) / JOIN_BLOCK_ENTRIES;
+    uint64_t first = 0, last = blocks_amount;
 
-const char * storage_column_type_to_string(enum storage_column_type type) {
-    switch (type) {
-        case STORAGE_COLUMN_TYPE_INT:
-            return "int";
+    while (first < last) {
+        const uint64_t middle = (first + last) / 2;
 
-        case STORAGE_COLUMN_TYPE_UINT:
-            return "uint";
+        if (hash->fences[middle] < value_hash) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
 
-        case STORAGE_COLUMN_TYPE_NUM:
-            return "num";
+    // entries with the hash could start at the end of the previous block
+    struct storage_join_entry block[JOIN_BLOCK_ENTRIES];
 
-        case STORAGE_COLUMN_TYPE_STR:
-            return "str";
+    for (uint64_t i = first > 0 ? first - 1 : 0; i < blocks_amount; ++i) {
+        const uint64_t offset = i * JOIN_BLOCK_ENTRIES;
+        const uint64_t amount = storage_join_read_block(hash->file,
+            hash->file_offset + offset * sizeof(*block), hash->amount - offset, block);
 
-        default:
-            return NULL;
+        for (uint64_t j = 0; j < amount; ++j) {
+            if (block[j].hash > value_hash) {
+                return;
+            }
+
+            if (block[j].hash == value_hash) {
+                storage_join_match(table, column, value, value_code, block[j].row, matches);
+            }
+        }
     }
 }
 
+// finds rows of joining table matching the slice of previous tables
 struct storage_joined_table * storage_joined_table_new(unsigned int amount) {
     struct storage_joined_table * table = malloc(sizeof(*table));
 
@@ -401,6 +6264,8 @@ void storage_joined_table_delete(struct storage_joined_table * table) {
     if (table) {
         for (int i = 0; i < table->tables.amount; ++i) {
             storage_table_delete(table->tables.tables[i].table);
+            storage_index_scan_delete(table->tables.tables[i].scan);
+            storage_join_hash_delete(table->tables.tables[i].hash);
         }
 
         free(table->tables.tables);
@@ -409,7 +6274,17 @@ void storage_joined_table_delete(struct storage_joined_table * table) {
     free(table);
 }
 
-uint16_t storage_joined_table_get_columns_amount(struct storage_joined_table * table) {
+void storage_joined_table_reset(struct storage_joined_table * table) {
+    for (int i = 0; i < table->tables.amount; ++i) {
+        storage_index_scan_delete(table->tables.tables[i].scan);
+        storage_join_hash_delete(table->tables.tables[i].hash);
+
+        table->tables.tables[i].scan = NULL;
+        table->tables.tables[i].hash = NULL;
+    }
+}
+
+uint16_t storage_joined_table_get_columns_amount(const struct storage_joined_table * table) {
     uint16_t amount = 0;
 
     for (int i = 0; i < table->tables.amount; ++i) {
@@ -419,7 +6294,7 @@ uint16_t storage_joined_table_get_columns_amount(struct storage_joined_table * t
     return amount;
 }
 
-struct storage_column storage_joined_table_get_column(struct storage_joined_table * table, uint16_t index) {
+struct storage_column storage_joined_table_get_column(const struct storage_joined_table * table, uint16_t index) {
     for (int i = 0; i < table->tables.amount; ++i) {
         if (index < table->tables.tables[i].table->columns.amount) {
             return table->tables.tables[i].table->columns.columns[index];
@@ -431,107 +6306,59 @@ struct storage_column storage_joined_table_get_column(struct storage_joined_tabl
     abort();
 }
 
-static bool storage_value_is_equals(struct storage_value * a, struct storage_value * b) {
-    if (a == NULL || b == NULL) {
-        return a == b;
-    }
-
-    switch (a->type) {
-        case STORAGE_COLUMN_TYPE_INT:
-            switch (b->type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    return a->value._int == b->value._int;
-
-                case STORAGE_COLUMN_TYPE_UINT:
-                    if (a->value._int < 0) {
-                        return false;
-                    }
-
-                    return ((uint64_t) a->value._int) == b->value.uint;
-
-                case STORAGE_COLUMN_TYPE_NUM:
-                    return ((double) a->value._int) == b->value.num;
-
-                case STORAGE_COLUMN_TYPE_STR:
-                    return false;
-            }
-
-        case STORAGE_COLUMN_TYPE_UINT:
-            switch (b->type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    if (b->value._int < 0) {
-                        return false;
-                    }
-
-                    return a->value.uint == ((uint64_t) b->value._int);
-
-                case STORAGE_COLUMN_TYPE_UINT:
-                    return a->value.uint == b->value.uint;
+int storage_joined_table_find_column(const struct storage_joined_table * table, const char * name) {
+    int offset = 0;
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    return ((double) a->value.uint) == b->value.num;
+    for (int i = 0; i < table->tables.amount; ++i) {
+        const int index = storage_table_find_column(table->tables.tables[i].table, name);
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    return false;
-            }
+        if (index >= 0) {
+            return offset + index;
+        }
 
-        case STORAGE_COLUMN_TYPE_NUM:
-            switch (b->type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    return a->value.num == ((double) b->value._int);
+        offset += table->tables.tables[i].table->columns.amount;
+    }
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    return a->value.num == ((double) b->value.uint);
+    return -1;
+}
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    return a->value.num == b->value.num;
+static struct storage_row * storage_joined_row_probe(struct storage_joined_row * row, unsigned int index) {
+    struct storage_joined_table * const table = row->table;
+    struct storage_table * const joining_table = table->tables.tables[index].table;
+    const uint16_t column = table->tables.tables[index].t_column_index;
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    return false;
-            }
+    if (!table->tables.tables[index].hash) {
+        table->tables.tables[index].hash = storage_join_hash_new(joining_table, column);
+    }
 
-        case STORAGE_COLUMN_TYPE_STR:
-            switch (b->type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                case STORAGE_COLUMN_TYPE_UINT:
-                case STORAGE_COLUMN_TYPE_NUM:
-                    return false;
+    struct storage_value * const value = storage_joined_row_get_value(row, table->tables.tables[index].s_column_index);
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    return strcmp(a->value.str, b->value.str) == 0;
-            }
-    }
-}
+    storage_join_hash_probe(table->tables.tables[index].hash, joining_table, column, value, &row->matches[index]);
+    storage_value_delete(value);
 
-static bool storage_joined_row_is_on(struct storage_joined_row * row, uint16_t index) {
-    return storage_value_is_equals(
-        storage_joined_row_get_value(row, row->table->tables.tables[index].s_column_index),
-        storage_row_get_value(row->rows[index], row->table->tables.tables[index].t_column_index)
-    );
+    return storage_index_scan_get_first_row(&row->matches[index]);
 }
 
-static void storage_joined_row_roll(struct storage_joined_row * row) {
-    for (int i = 1; i < row->table->tables.amount; ++i) {
-        if (!storage_joined_row_is_on(row, i)) {
-            row->rows[i] = storage_row_next(row->rows[i]);
+// probes tables after the index one for the current rows, moving rows of previous
+// tables when there is no match; returns false when rows of the first table are over
+static bool storage_joined_row_fill(struct storage_joined_row * row, unsigned int index) {
+    const unsigned int amount = row->table->tables.amount;
 
-            for (int j = i + 1; j < row->table->tables.amount; ++j) {
-                storage_row_delete(row->rows[j]);
-                row->rows[j] = storage_table_get_first_row(row->table->tables.tables[j].table);
-            }
+    while (true) {
+        while (index + 1 < amount && (row->rows[index + 1] = storage_joined_row_probe(row, index + 1))) {
+            ++index;
+        }
 
-            for (int j = i; j > 0; --j) {
-                if (row->rows[j] == NULL) {
-                    row->rows[j] = storage_table_get_first_row(row->table->tables.tables[j].table);
-                    row->rows[j - 1] = storage_row_next(row->rows[j - 1]);
-                }
-            }
+        if (index + 1 == amount) {
+            return true;
+        }
 
-            if (row->rows[0] == NULL) {
-                return;
+        while (!(row->rows[index] = storage_row_next(row->rows[index]))) {
+            if (index == 0) {
+                return false;
             }
 
-            i = 0;
+            --index;
         }
     }
 }
@@ -540,22 +6367,20 @@ struct storage_joined_row * storage_joined_table_get_first_row(struct storage_jo
     struct storage_joined_row * row = malloc(sizeof(*row));
 
     row->table = table;
-    row->rows = malloc(sizeof(struct storage_row *) * table->tables.amount);
-    for (int i = 0; i < table->tables.amount; ++i) {
-        row->rows[i] = NULL;
-    }
+    row->rows = calloc(table->tables.amount, sizeof(struct storage_row *));
+    row->matches = calloc(table->tables.amount, sizeof(*row->matches));
 
     for (int i = 0; i < table->tables.amount; ++i) {
-        row->rows[i] = storage_table_get_first_row(table->tables.tables[i].table);
+        row->matches[i].table = table->tables.tables[i].table;
+    }
 
-        if (row->rows[i] == NULL) {
-            storage_joined_row_delete(row);
-            return NULL;
-        }
+    if (table->tables.tables[0].scan) {
+        row->rows[0] = storage_index_scan_get_first_row(table->tables.tables[0].scan);
+    } else {
+        row->rows[0] = storage_table_get_first_row(table->tables.tables[0].table);
     }
 
-    storage_joined_row_roll(row);
-    if (row->rows[0] == NULL) {
+    if (row->rows[0] == NULL || !storage_joined_row_fill(row, 0)) {
         storage_joined_row_delete(row);
         return NULL;
     }
@@ -567,32 +6392,29 @@ void storage_joined_row_delete(struct storage_joined_row * row) {
     if (row) {
         for (int i = 0; i < row->table->tables.amount; ++i) {
             storage_row_delete(row->rows[i]);
+            free(row->matches[i].rows);
         }
 
         free(row->rows);
+        free(row->matches);
     }
 
     free(row);
 }
 
 struct storage_joined_row * storage_joined_row_next(struct storage_joined_row * row) {
-    uint16_t last_index = row->table->tables.amount - 1;
+    unsigned int index = row->table->tables.amount - 1;
 
-    row->rows[last_index] = storage_row_next(row->rows[last_index]);
-    for (int i = (int) last_index; i > 0; --i) {
-        if (row->rows[i] == NULL) {
-            row->rows[i] = storage_table_get_first_row(row->table->tables.tables[i].table);
-            row->rows[i - 1] = storage_row_next(row->rows[i - 1]);
+    while (!(row->rows[index] = storage_row_next(row->rows[index]))) {
+        if (index == 0) {
+            storage_joined_row_delete(row);
+            return NULL;
         }
-    }
 
-    if (row->rows[0] == NULL) {
-        storage_joined_row_delete(row);
-        return NULL;
+        --index;
     }
 
-    storage_joined_row_roll(row);
-    if (row->rows[0] == NULL) {
+    if (!storage_joined_row_fill(row, index)) {
         storage_joined_row_delete(row);
         return NULL;
     }
@@ -600,7 +6422,7 @@ struct storage_joined_row * storage_joined_row_next(struct storage_joined_row *
     return row;
 }
 
-struct storage_value * storage_joined_row_get_value(struct storage_joined_row * row, uint16_t index) {
+struct storage_value * storage_joined_row_get_value(const struct storage_joined_row * row, uint16_t index) {
     for (int i = 0; i < row->table->tables.amount; ++i) {
         if (index < row->table->tables.tables[i].table->columns.amount) {
             return storage_row_get_value(row->rows[i], index);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
 
 // Pointer structure:
 // - Offset from start of file: <uint64_t>
@@ -15,11 +17,26 @@
 //
 // Storage file header structure:
 // - Signature: 0xdeadbabe
+// - Version marker: <uint64_t> 0xffffffffffffffff
+// - Format version: <uint32_t>
+// - First table: <pointer>
+// - Free lists: <pointer[STORAGE_FREE_CLASSES]> (zeros in version 1)
+// - First index: <pointer> (zero before version 3)
+// - First dictionary: <pointer> (zero before version 5)
+// - Reserved: zeros up to 512 bytes
+//
+// Storage file header structure of version 0 (files without version marker):
+// - Signature: 0xdeadbabe
 // - First table: <pointer>
 //
 // Table header structure:
 // - Next table: <pointer>
 // - First row: <pointer>
+// - Table format: <uint8_t> (absent in version 0, where it is always 0)
+//   - 0 - rows with cell pointers
+//   - 1 - rows with inline cells
+//   - 2 - columnar row groups (first row points to first row group)
+//   - flag 0x80 - row groups have bodies (since version 6, only with format 2)
 // - Table name: <string>
 // - Amount of table columns: <uint16_t>
 // - Table columns
@@ -32,15 +49,304 @@
 //   - 2 - <double>
 //   - 3 - <string>
 //
-// Table row structure:
+// Table row structure (format 0):
 // - Next row: <pointer>
 // - Cells: <pointer[]>
 //
+// Table row structure (format 1):
+// - Next row: <pointer>
+// - Null bitmap: <uint8_t[(amount of columns + 7) / 8]>, bit is set for NULL cell
+// - Inline cells: <uint64_t[]>, value for int/uint/num columns, pointer to cell for str columns,
+//   code of string for str columns with dictionary
+//
+// Row group structure (format 2):
+// - Next row group: <pointer>
+// - Capacity: <uint32_t>, multiple of 8
+// - Amount of rows: <uint32_t>
+// - Deleted bitmap: <uint8_t[capacity / 8]>, bit is set for removed row
+// - Zone maps: <zone map[amount of columns]> (absent before version 4)
+// - Columns: for each table column
+//   - Validity bitmap: <uint8_t[capacity / 8]>, bit is set for not NULL cell
+//   - Inline cells: <uint64_t[capacity]>, same as inline cells of format 1
+//
+// Row group structure of table with bodies:
+// - Next row group, capacity, amount of rows, deleted bitmap and zone maps as above
+// - Body: <pointer>
+// - Body size: <uint64_t>
+// - Stored size: <uint64_t>, less than body size when body is compressed
+//
+// Body structure:
+// - Columns: same as columns of row group
+// - Strings: string cells of str columns without dictionary written by vacuum,
+//   pointers to them are offsets from body start with the highest bit set
+//
+// Compressed body structure:
+// - Chunk offsets: <uint32_t[amount of chunks + 1]>, from the end of offsets
+// - Chunks: LZ blocks of body by STORAGE_READAHEAD_PAGES pages, the last one may be shorter
+//
+// Zone map structure:
+// - Min: <uint64_t>
+// - Max: <uint64_t>
+// - Amount of NULL cells: <uint32_t>
+// - Flags: <uint32_t>
+//   - 1 - min and max are set
+//   - 2 - NaN was written
+//
+// Min and max of zone map bound every value written into the column
+// of row group, they are widened by writes and never narrowed, so they
+// may be looser than the live values until vacuum rewrites the group.
+// Bounds are values for int/uint/num columns and first 8 bytes of strings
+// as big-endian numbers for str columns. Amount of NULL cells is exact
+// for live rows. Batch scans skip row groups by zone maps (see storage_batch).
+//
+// Row groups are allocated zeroed with capacity from STORAGE_ROW_GROUP_MIN_ROWS
+// doubling up to STORAGE_ROW_GROUP_MAX_ROWS, new group is linked first.
+// Rows of a group are iterated from last to first, so rows of any table
+// format come newest first.
+//
+// Free block structure:
+// - Next free block of the same size class: <pointer>
+//
+// Since version 2 every block (table header, row, row group or cell) takes
+// a whole block of its size class: multiples of 8 bytes up to 128 bytes,
+// then powers of two up to 8 MiB (bigger blocks are never reused).
+// Removed rows, dropped tables and overwritten cells are put into free
+// list of their size class and reused before file is extended.
+//
+// Vacuum rewrites live rows of a table at the end of file in scan order,
+// each row (or full row group) next to its cells, switches first row
+// of the table to them and frees old rows with their cells. Files
+// of older versions keep old blocks as garbage.
+//
+// Vacuum of table with bodies writes each row group with its strings in body
+// and compresses the body by LZ codec (see lz.h) when it gets smaller, fits
+// STORAGE_COMPRESSED_BODY_MAX and its pointer is in the first 64 GiB of file.
+// Header, deleted bitmap and zone maps are not compressed, so removes and zone
+// map checks do not touch the body. Compressed bodies are read through the buffer
+// pool: chunk of body is decompressed into pages at virtual offsets from 2^63
+// by position of body pointer shifted by 27 bits, so it is decompressed once
+// while its pages stay in pool. Write into row of compressed body moves the body
+// to new uncompressed block first, new row groups get uncompressed bodies,
+// so they are compressed by the next vacuum. Damaged body is read as zeros:
+// row values of it are NULL, batches and scan jobs end, writes into it and vacuum
+// of its table are skipped, and storage_read_failed tells the request its
+// result is not to be used (errno EIO).
+//
+// Index structure:
+// - Next index: <pointer>
+// - Table: <pointer> (table header)
+// - Root node: <pointer>
+// - Column index: <uint16_t>
+//
+// Index node structure:
+// - Is leaf: <uint8_t>
+// - Reserved: <uint8_t>
+// - Amount of entries: <uint16_t>
+// - Reserved: <uint32_t>
+// - Next leaf: <pointer> (zero for inner nodes and the last leaf)
+// - Entries: <(key: <uint64_t>, row: <uint64_t>)[]>
+// - Children: <pointer[]> (only for inner nodes, one more than entries)
+//
+// Indexes are B+trees of STORAGE_INDEX_NODE_SIZE nodes ordered by (key, row).
+// Key is value for int/uint/num columns and pointer to string cell owned
+// by index for str columns, NULL cells are not indexed. Row is row position,
+// or row group position shifted left by 16 bits with slot for columnar tables.
+// Entries of inner nodes separate children: entries of left child are less,
+// entries of right child are greater or equal. Removed entries are taken
+// out of their leaf without merging nodes. Vacuum moves rows, so indexes
+// of vacuumed table are rebuilt.
+//
+// Dictionary structure:
+// - Next dictionary: <pointer>
+// - Table: <pointer> (table header)
+// - Column index: <uint16_t>
+// - Reserved: <uint16_t>
+// - Amount of strings: <uint32_t>
+// - First chunk: <pointer>
+//
+// Dictionary chunk structure:
+// - Next chunk: <pointer>
+// - Strings: <pointer[]>, to string cells owned by dictionary
+//
+// Str column of inline or columnar table may have dictionary (since version 5,
+// files of version 4 are upgraded by the first dictionary, older ones get none):
+// each distinct string of the column is written once and cells keep its code,
+// which is its number in chunks of STORAGE_DICTIONARY_CHUNK_SIZE bytes. Codes are
+// 32-bit and never reused, so strings stay in dictionary until its table is removed.
+// Dictionaries are kept in memory by catalog with hash map of strings to codes,
+// so values of cells are read without file access, equality of cells with value
+// is checked by codes in batches and joined rows are matched by codes.
+//
 // Cell structure:
 // - Value: value of type that noticed in table header column
+// - Terminator: '\0' for string cells (absent in files written by older versions)
+//
+// File is accessed through the buffer pool of STORAGE_POOL_PAGES pages
+// of STORAGE_PAGE_SIZE bytes, modified pages are written back on eviction
+// or by storage_flush. File is read and written by offsets (pread, pwrite),
+// pages missed one after another are read ahead by one preadv call
+// of STORAGE_READAHEAD_PAGES pages.
+//
+// Storage opened with STORAGE_FLAG_MMAP maps file into reserved address space
+// instead: reads are served from the mapping, writes go to file directly
+// (or through the buffer pool when storage has log, see below) and mapping
+// grows with file. Strings read from such storage point into
+// the mapping (see storage_value.view).
+//
+// Joined tables are iterated by hash join: rows of each joining table are put
+// into hash table by joined column once and probed by the slice of previous
+// tables. Hash tables bigger than STORAGE_JOIN_MEMORY are spilled into temp
+// file as sorted runs merged into one sorted table, which is probed by block.
+//
+// Rows can be added by batches: storage_table_add_rows takes values of all
+// table columns of each row (NULL pointer for NULL cell), assembles rows
+// with their cells in memory and appends them to the end of file by one write,
+// first row of the table is written once per batch. Batch of columnar table
+// fills row groups by whole runs of slots, column by column.
+//
+// Tables can be scanned by batches of up to STORAGE_BATCH_ROWS rows: cells
+// of requested columns are read into vectors without allocating values,
+// row groups of columnar tables are read by whole runs of slots. Batch
+// comparisons use AVX2 or SSE4.2 kernels when processor supports them.
+// Row groups with zone maps are passed to zone filter of batch before
+// they are read, storage_zone_get_outcomes tells outcomes that cells
+// bounded by zone map may have in comparison with value.
+//
+// Tables can be scanned in parallel by storage_table_scan_parallel: table
+// is split into morsels (row groups of columnar tables, runs of
+// STORAGE_MORSEL_ROWS rows of other tables or of index scan), which
+// the request thread and scan threads of storage claim one by one while
+// there are any, so threads that read faster take more of them. Each thread
+// reads its morsels by its own batch and passes them to filter. The request
+// thread takes selected rows of morsels in the order of storage_table_scan
+// and claims the next morsel itself when scan threads have not, they stay
+// up to two morsels per thread ahead of it, so memory of scan is bounded.
+// Morsels are not read any more when the first ones already have enough rows
+// for the limit. Storage_table_select takes every row at once, so they can be
+// modified afterwards. Scan threads read table under locks taken by
+// the request thread. Scan paused by storage_scan_job_pause is left alone
+// by scan threads, so it can be kept between requests and resumed
+// by a request that locks the table again (see storage_table_get_version).
+//
+// Write-ahead log structure (file next to storage file, -1 is passed
+// to storage_init or storage_open instead of its descriptor to work without it):
+// - Signature: 0xdeadc0de
+// - Reserved: <uint32_t>
+// - Capacity: <uint64_t>, size of records area
+// - Start: <uint64_t>, position of the first record that is not checkpointed
+// - Reserved: zeros up to 512 bytes
+// - Records area: <uint8_t[capacity]>, used as ring buffer
+//
+// Log record structure (one record for each commit):
+// - Position: <uint64_t>, position of the record in log
+// - Size: <uint64_t>, size of the record, multiple of 8 bytes
+// - Checksum: <uint64_t>, of the position, the size and the writes
+// - Writes: for each write of committed request
+//   - Offset in storage file: <uint64_t>
+//   - Length: <uint64_t>
+//   - Data: <uint8_t[length]>, padded with zeros to multiple of 8 bytes
+//
+// Positions grow from zero after the log is reset, record at position
+// is stored at offset 512 + position % capacity, so it may wrap around
+// the end of the area. Records that are overwritten, torn or left from
+// older laps of the ring have wrong position or checksum and end the log.
+//
+// Storage opened with log does not write into storage file in place:
+// writes of request are collected as redo record and kept in buffer pool
+// pages that cannot be evicted until storage_commit writes the record
+// into the log by one write. When the log is synced by commits, committed
+// pages are written back only after it is synced up to their last record,
+// so storage file never gets writes that are not in durable log (the pool
+// grows if every page is held). Page that gets writes of the next request
+// before it is written back keeps copy of its committed data for write-back.
+// The log is synced by its own thread, concurrent commits are covered
+// by a single fdatasync (group commit):
+// - STORAGE_FLAG_SYNC_COMMIT - storage_sync waits until record is synced
+// - STORAGE_FLAG_SYNC_BATCH - records are synced in background right after commits
+// - without both flags the log is synced only by checkpoints
+//
+// Checkpoint runs in the log thread when half of the log is used:
+// it syncs storage file, whose pages are written back up to some record,
+// and moves start of the log to that record. Storage_open replays
+// committed records from the start of the log into storage file and
+// resets the log, so does storage_delete after writing every page back.
+//
+// Tables are read into in-memory catalog on open and kept there until they
+// are removed: storage_find_table returns catalog tables without file access,
+// storage_table_delete ignores them. Catalog keeps version of each table,
+// which is changed when rows of the table are removed or moved by vacuum:
+// positions of rows kept since the same version still point to the rows.
+//
+// Storage may be used by several threads, each request is enclosed
+// by storage_begin and storage_end of the thread:
+// - STORAGE_LOCK_READ - request reads tables, storage_find_table locks them for reading
+// - STORAGE_LOCK_WRITE - request modifies tables, storage_find_table locks them for writing;
+//   modifying requests are serialized because they share allocation and log record
+// - STORAGE_LOCK_SCHEMA - request adds or removes tables or vacuums them, it runs alone
+// Storage_end commits writes of request and unlocks its tables, so readers of
+// a table wait only for its writer. Buffer pool is guarded by the storage
+// mutex, which is released while missed pages are read, so threads read file
+// at once; storage used without storage_begin is not locked.
+
+#define STORAGE_VERSION (6)
+
+#define STORAGE_FREE_CLASSES (32)
+
+#define STORAGE_CATALOG_BUCKETS (64)
+
+#define STORAGE_PAGE_SIZE (4096)
+#define STORAGE_POOL_PAGES (256)
+#define STORAGE_POOL_BUCKETS (2 * STORAGE_POOL_PAGES)
+#define STORAGE_READAHEAD_PAGES (16)
+
+#define STORAGE_MAP_CHUNK (1024 * 1024)
+#define STORAGE_MAP_RESERVE (64ull * 1024 * 1024 * 1024)
+
+#define STORAGE_ROW_GROUP_MIN_ROWS (64)
+#define STORAGE_ROW_GROUP_MAX_ROWS (65536)
+
+#define STORAGE_INDEX_NODE_SIZE (4096)
+
+#define STORAGE_DICTIONARY_CHUNK_SIZE (2048)
+
+#define STORAGE_COMPRESSED_BODY_MAX (128 * 1024 * 1024)
+
+#define STORAGE_JOIN_MEMORY (64 * 1024 * 1024)
+
+#define STORAGE_BATCH_ROWS (1024)
+#define STORAGE_MORSEL_ROWS (4096)
+
+#define STORAGE_WAL_CAPACITY (64 * 1024 * 1024)
 
 static const char * const JOINED_TABLE_NAME = "joined table";
 
+enum storage_lock {
+    STORAGE_LOCK_READ,
+    STORAGE_LOCK_WRITE,
+    STORAGE_LOCK_SCHEMA,
+};
+
+enum storage_flags {
+    STORAGE_FLAG_MMAP = 1 << 0,
+    STORAGE_FLAG_SYNC_BATCH = 1 << 1,
+    STORAGE_FLAG_SYNC_COMMIT = 1 << 2,
+};
+
+enum storage_table_format {
+    STORAGE_TABLE_FORMAT_CELL_POINTERS = 0,
+    STORAGE_TABLE_FORMAT_INLINE = 1,
+    STORAGE_TABLE_FORMAT_COLUMNAR = 2,
+};
+
+// outcomes of comparison of cell with value, filters accept a set of them
+enum storage_outcome {
+    STORAGE_OUTCOME_LESS = 1 << 0,
+    STORAGE_OUTCOME_EQUAL = 1 << 1,
+    STORAGE_OUTCOME_GREATER = 1 << 2,
+    STORAGE_OUTCOME_UNORDERED = 1 << 3,
+    STORAGE_OUTCOME_NULL = 1 << 4,
+};
+
 enum storage_column_type {
     STORAGE_COLUMN_TYPE_INT = 0,
     STORAGE_COLUMN_TYPE_UINT = 1,
@@ -48,14 +354,87 @@ enum storage_column_type {
     STORAGE_COLUMN_TYPE_STR = 3,
 };
 
+struct storage_page;
+struct storage_catalog_entry;
+struct storage_index_scan;
+struct storage_dictionary;
+struct storage_join_hash;
+struct storage_scan_job;
+
 struct storage {
     int fd;
+    uint32_t version;
     uint64_t first_table;
+    uint64_t free_lists[STORAGE_FREE_CLASSES];
+    uint64_t first_index;
+    uint64_t first_dictionary;
+    uint64_t size;
+
+    pthread_rwlock_t schema_lock;
+    pthread_mutex_t write_lock;
+    pthread_mutex_t lock;
+
+    uint8_t * map;
+    uint64_t map_size;
+
+    struct storage_catalog_entry * catalog[STORAGE_CATALOG_BUCKETS];
+
+    struct {
+        unsigned int hand;
+        unsigned int amount;
+        unsigned int dirty;
+        struct storage_page ** pages;
+        int buckets[STORAGE_POOL_BUCKETS];
+
+        // page after the last read ones, misses on it are read ahead
+        uint64_t next_miss;
+        pthread_cond_t loaded;
+    } pool;
+
+    // threads that help requests to scan tables, jobs wait for them in queue
+    struct {
+        unsigned int amount;
+        pthread_t * threads;
+        pthread_mutex_t lock;
+        pthread_cond_t queued;
+        pthread_cond_t finished;
+        struct storage_scan_job * jobs;
+        bool stopping;
+    } scans;
+
+    // fields after the lock are shared with the log thread
+    struct {
+        int fd;
+        unsigned int flags;
+        uint64_t capacity;
+
+        // record of current request, last is offset of its last write
+        struct {
+            uint64_t size;
+            uint64_t capacity;
+            uint64_t last;
+            uint8_t * data;
+        } record;
+
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+
+        uint64_t start;
+        uint64_t end;
+        uint64_t synced;
+        uint64_t sync_requested;
+        uint64_t checkpoint_requested;
+        bool stopping;
+    } wal;
 };
 
 struct storage_column {
     char * name;
     enum storage_column_type type;
+
+    // strings of str column are kept in its dictionary, ignored by older files
+    bool dictionary;
 };
 
 struct storage_table {
@@ -65,8 +444,12 @@ struct storage_table {
     uint64_t next;
 
     uint64_t first_row;
+    enum storage_table_format format;
     char * name;
 
+    // row groups keep columns in bodies compressed by vacuum, ignored by older files
+    bool compressed;
+
     struct {
         uint16_t amount;
         struct storage_column * columns;
@@ -78,11 +461,30 @@ struct storage_row {
 
     uint64_t position;
     uint64_t next;
+
+    // row slot in row group of columnar table
+    struct {
+        uint32_t index;
+        uint32_t capacity;
+    } slot;
+
+    // position of the first column of row group: in the group, in its body
+    // or at virtual offset of decompressed body
+    uint64_t columns;
+
+    // rows of index scan are iterated instead of table rows when set
+    const struct storage_index_scan * scan;
+    uint64_t scan_index;
 };
 
 struct storage_value {
     enum storage_column_type type;
 
+    // string is not owned by value, it points into storage mapping
+    // and is valid until the cell is rewritten or storage is deleted,
+    // or into dictionary of the column and is valid until its table is removed
+    bool view;
+
     union {
         int64_t _int;
         uint64_t uint;
@@ -91,11 +493,21 @@ struct storage_value {
     } value;
 };
 
+// rows found by index in the order of index keys
+struct storage_index_scan {
+    struct storage_table * table;
+
+    uint64_t amount;
+    uint64_t * rows;
+};
+
 struct storage_joined_table {
     struct {
         unsigned int amount;
         struct {
             struct storage_table * table;
+            struct storage_index_scan * scan;
+            struct storage_join_hash * hash;
             uint16_t t_column_index;
             uint16_t s_column_index;
         } * tables;
@@ -105,24 +517,159 @@ struct storage_joined_table {
 struct storage_joined_row {
     struct storage_joined_table * table;
     struct storage_row ** rows;
+
+    // rows of joining tables matching the current slice
+    struct storage_index_scan * matches;
+};
+
+enum storage_zone_flags {
+    STORAGE_ZONE_FLAG_BOUNDS = 1 << 0,
+    STORAGE_ZONE_FLAG_NAN = 1 << 1,
+};
+
+// zone map of column in row group as it is stored
+struct storage_zone {
+    uint64_t min;
+    uint64_t max;
+    uint32_t nulls;
+    uint32_t flags;
+};
+
+// sizes of storage file and of row group bodies of tables with bodies,
+// compression ratio is body size divided by stored size of compressed bodies
+struct storage_stats {
+    uint64_t size;
+    uint64_t tables;
+    uint64_t row_groups;
+    uint64_t compressed_row_groups;
+    uint64_t body_size;
+    uint64_t stored_size;
+    uint64_t compressed_body_size;
+    uint64_t compressed_stored_size;
+};
+
+struct storage_batch;
+
+// row group is skipped when filter returns false for zone maps of batch vectors
+typedef bool (* storage_zone_filter)(const struct storage_batch * batch, const struct storage_zone * zones, void * context);
+
+// sets selection of batch, may be called by several threads at once
+typedef void (* storage_batch_filter)(struct storage_batch * batch, void * context);
+
+// cells of one column of batch
+struct storage_vector {
+    uint16_t column;
+    enum storage_column_type type;
+
+    // strings of column with dictionary are not read, vector keeps their codes
+    const struct storage_dictionary * dictionary;
+
+    // byte is set for NULL cell
+    uint8_t nulls[STORAGE_BATCH_ROWS];
+
+    // offsets of strings in batch strings for str columns (codes for ones with dictionary)
+    union {
+        int64_t _int[STORAGE_BATCH_ROWS];
+        uint64_t uint[STORAGE_BATCH_ROWS];
+        double num[STORAGE_BATCH_ROWS];
+        uint64_t str[STORAGE_BATCH_ROWS];
+    } values;
+};
+
+struct storage_batch {
+    struct storage_table * table;
+
+    // next row to read, NULL after the last row
+    struct storage_row * cursor;
+
+    // rows (row groups of columnar table) left to read before cursor stops
+    uint64_t bound;
+
+    // references of rows in batch
+    uint32_t amount;
+    uint64_t rows[STORAGE_BATCH_ROWS];
+
+    struct {
+        uint16_t amount;
+        struct storage_vector * vectors;
+    } columns;
+
+    struct {
+        uint64_t size;
+        uint64_t capacity;
+        char * data;
+    } strings;
+
+    struct {
+        storage_zone_filter filter;
+        void * context;
+
+        // zone maps of the current row group are checked
+        bool checked;
+        struct storage_zone * maps;
+    } zones;
+
+    // rows of batch selected by its user
+    uint32_t selected;
+    uint16_t selection[STORAGE_BATCH_ROWS];
 };
 
 // storage
 
-struct storage * storage_init(int fd);
-struct storage * storage_open(int fd);
+struct storage * storage_init(int fd, int wal_fd, unsigned int flags);
+struct storage * storage_open(int fd, int wal_fd, unsigned int flags);
+void storage_flush(struct storage * storage);
+uint64_t storage_commit(struct storage * storage);
+void storage_sync(struct storage * storage, uint64_t commit);
+void storage_begin(struct storage * storage, enum storage_lock lock);
+uint64_t storage_end(struct storage * storage);
+bool storage_read_failed(void);
 void storage_delete(struct storage * storage);
+void storage_set_scan_threads(struct storage * storage, unsigned int threads);
+uint64_t storage_vacuum(struct storage * storage);
+void storage_get_stats(struct storage * storage, struct storage_stats * stats);
 
 struct storage_table * storage_find_table(struct storage * storage, const char * name);
 
 // storage_table
 
 void storage_table_delete(struct storage_table * table);
+int storage_table_find_column(const struct storage_table * table, const char * name);
+uint64_t storage_table_get_version(const struct storage_table * table);
 
 void storage_table_add(struct storage_table * table);
 void storage_table_remove(struct storage_table * table);
+uint64_t storage_table_vacuum(struct storage_table * table);
 struct storage_row * storage_table_get_first_row(struct storage_table * table);
 struct storage_row * storage_table_add_row(struct storage_table * table);
+void storage_table_add_rows(struct storage_table * table, uint64_t amount, const struct storage_value * const * values);
+
+void storage_table_add_index(struct storage_table * table, uint16_t column);
+bool storage_table_has_index(const struct storage_table * table, uint16_t column);
+struct storage_index_scan * storage_table_index_scan(struct storage_table * table, uint16_t column,
+    const struct storage_value * low, bool low_inclusive, const struct storage_value * high, bool high_inclusive);
+
+struct storage_batch * storage_table_scan(struct storage_table * table, const struct storage_index_scan * scan,
+    uint16_t columns_amount, const uint16_t * columns);
+struct storage_scan_job * storage_table_scan_parallel(struct storage_table * table, const struct storage_index_scan * scan,
+    uint16_t columns_amount, const uint16_t * columns, storage_zone_filter zone_filter, storage_batch_filter filter,
+    void * context, uint64_t limit);
+struct storage_index_scan * storage_table_select(struct storage_table * table, const struct storage_index_scan * scan,
+    uint16_t columns_amount, const uint16_t * columns, storage_zone_filter zone_filter, storage_batch_filter filter,
+    void * context, uint64_t limit);
+
+// storage_index_scan
+
+void storage_index_scan_delete(struct storage_index_scan * scan);
+
+struct storage_row * storage_index_scan_get_first_row(const struct storage_index_scan * scan);
+
+// storage_scan_job
+
+void storage_scan_job_delete(struct storage_scan_job * job);
+void storage_scan_job_pause(struct storage_scan_job * job);
+
+bool storage_scan_job_next(struct storage_scan_job * job, struct storage_index_scan * rows);
 
 // storage_row
 
@@ -131,13 +678,28 @@ void storage_row_delete(struct storage_row * row);
 struct storage_row * storage_row_next(struct storage_row * row);
 void storage_row_remove(struct storage_row * row);
 struct storage_value * storage_row_get_value(struct storage_row * row, uint16_t index);
-void storage_row_set_value(struct storage_row * row, uint16_t index, struct storage_value * value);
+void storage_row_set_value(struct storage_row * row, uint16_t index, const struct storage_value * value);
+
+// storage_batch
+
+void storage_batch_delete(struct storage_batch * batch);
+
+bool storage_batch_next(struct storage_batch * batch);
+struct storage_row * storage_batch_get_row(const struct storage_batch * batch, uint32_t index);
+void storage_batch_compare(const struct storage_batch * batch, uint16_t vector,
+    const struct storage_value * value, uint8_t accepted, uint8_t * result);
+
+// storage_zone
+
+uint8_t storage_zone_get_outcomes(const struct storage_zone * zone, enum storage_column_type type, const struct storage_value * value);
 
 // storage_value
 
 void storage_value_destroy(struct storage_value value);
 void storage_value_delete(struct storage_value * value);
 
+int storage_value_compare(const struct storage_value * a, const struct storage_value * b);
+
 // storage_column_type
 
 const char * storage_column_type_to_string(enum storage_column_type type);
@@ -148,8 +710,12 @@ struct storage_joined_table * storage_joined_table_new(unsigned int amount);
 struct storage_joined_table * storage_joined_table_wrap(struct storage_table * table);
 void storage_joined_table_delete(struct storage_joined_table * table);
 
-uint16_t storage_joined_table_get_columns_amount(struct storage_joined_table * table);
-struct storage_column storage_joined_table_get_column(struct storage_joined_table * table, uint16_t index);
+// drops index scans and join hashes, so joined table kept between requests reads changed rows
+void storage_joined_table_reset(struct storage_joined_table * table);
+
+uint16_t storage_joined_table_get_columns_amount(const struct storage_joined_table * table);
+struct storage_column storage_joined_table_get_column(const struct storage_joined_table * table, uint16_t index);
+int storage_joined_table_find_column(const struct storage_joined_table * table, const char * name);
 struct storage_joined_row * storage_joined_table_get_first_row(struct storage_joined_table * table);
 
 // storage_json_row
@@ -157,4 +723,4 @@ struct storage_joined_row * storage_joined_table_get_first_row(struct storage_jo
 void storage_joined_row_delete(struct storage_joined_row * row);
 
 struct storage_joined_row * storage_joined_row_next(struct storage_joined_row * row);
-struct storage_value * storage_joined_row_get_value(struct storage_joined_row * row, uint16_t index);
+struct storage_value * storage_joined_row_get_value(const struct storage_joined_row * row, uint16_t index);
@@ -0,0 +1,165 @@
+#include "workers.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+
+struct workers {
+    workers_handler handler;
+    void * context;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool stopping;
+
+    // ring of accepted connections waiting for thread
+    struct {
+        size_t head;
+        size_t size;
+        size_t capacity;
+        int * sockets;
+    } queue;
+
+    // connection served by each thread or -1
+    int * serving;
+
+    unsigned int amount;
+    pthread_t threads[];
+};
+
+struct workers_thread {
+    struct workers * workers;
+    unsigned int index;
+};
+
+
+static void * workers_thread(void * arg) {
+    struct workers_thread * const thread = arg;
+    struct workers * const workers = thread->workers;
+    const unsigned int index = thread->index;
+
+    free(thread);
+
+    pthread_mutex_lock(&workers->lock);
+
+    while (true) {
+        while (!workers->stopping && workers->queue.size == 0) {
+            pthread_cond_wait(&workers->changed, &workers->lock);
+        }
+
+        if (workers->stopping) {
+            break;
+        }
+
+        const int socket = workers->queue.sockets[workers->queue.head];
+        workers->queue.head = (workers->queue.head + 1) % workers->queue.capacity;
+        --workers->queue.size;
+
+        workers->serving[index] = socket;
+        pthread_mutex_unlock(&workers->lock);
+
+        workers->handler(socket, workers->context);
+
+        pthread_mutex_lock(&workers->lock);
+        workers->serving[index] = -1;
+        close(socket);
+    }
+
+    pthread_mutex_unlock(&workers->lock);
+    return NULL;
+}
+
+struct workers * workers_start(unsigned int amount, workers_handler handler, void * context) {
+    struct workers * workers = malloc(sizeof(*workers) + amount * sizeof(*workers->threads));
+
+    workers->handler = handler;
+    workers->context = context;
+
+    pthread_mutex_init(&workers->lock, NULL);
+    pthread_cond_init(&workers->changed, NULL);
+    workers->stopping = false;
+
+    workers->queue.head = 0;
+    workers->queue.size = 0;
+    workers->queue.capacity = 16;
+    workers->queue.sockets = malloc(workers->queue.capacity * sizeof(*workers->queue.sockets));
+
+    workers->serving = malloc(amount * sizeof(*workers->serving));
+    workers->amount = amount;
+
+    // signals are handled by the accepting thread
+    sigset_t signals, old_signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_SETMASK, &signals, &old_signals);
+
+    for (unsigned int i = 0; i < amount; ++i) {
+        struct workers_thread * const thread = malloc(sizeof(*thread));
+
+        thread->workers = workers;
+        thread->index = i;
+
+        workers->serving[i] = -1;
+        pthread_create(&workers->threads[i], NULL, workers_thread, thread);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    return workers;
+}
+
+void workers_submit(struct workers * workers, int socket) {
+    pthread_mutex_lock(&workers->lock);
+
+    if (workers->queue.size == workers->queue.capacity) {
+        const size_t capacity = 2 * workers->queue.capacity;
+        int * const sockets = malloc(capacity * sizeof(*sockets));
+
+        for (size_t i = 0; i < workers->queue.size; ++i) {
+            sockets[i] = workers->queue.sockets[(workers->queue.head + i) % workers->queue.capacity];
+        }
+
+        free(workers->queue.sockets);
+        workers->queue.head = 0;
+        workers->queue.capacity = capacity;
+        workers->queue.sockets = sockets;
+    }
+
+    workers->queue.sockets[(workers->queue.head + workers->queue.size) % workers->queue.capacity] = socket;
+    ++workers->queue.size;
+
+    pthread_cond_signal(&workers->changed);
+    pthread_mutex_unlock(&workers->lock);
+}
+
+void workers_stop(struct workers * workers) {
+    pthread_mutex_lock(&workers->lock);
+    workers->stopping = true;
+
+    // blocked reads of served connections return end of file
+    for (unsigned int i = 0; i < workers->amount; ++i) {
+        if (workers->serving[i] >= 0) {
+            shutdown(workers->serving[i], SHUT_RDWR);
+        }
+    }
+
+    pthread_cond_broadcast(&workers->changed);
+    pthread_mutex_unlock(&workers->lock);
+
+    for (unsigned int i = 0; i < workers->amount; ++i) {
+        pthread_join(workers->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < workers->queue.size; ++i) {
+        close(workers->queue.sockets[(workers->queue.head + i) % workers->queue.capacity]);
+    }
+
+    pthread_cond_destroy(&workers->changed);
+    pthread_mutex_destroy(&workers->lock);
+
+    free(workers->queue.sockets);
+    free(workers->serving);
+    free(workers);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+
+// pool of threads that serve accepted connections: connection is served
+// by one thread until it is closed, connections that come when every
+// thread is busy wait in queue
+struct workers;
+
+typedef void (* workers_handler)(int socket, void * context);
+
+
+struct workers * workers_start(unsigned int amount, workers_handler handler, void * context);
+
+// passes connection to pool, pool closes it after handler returns
+void workers_submit(struct workers * workers, int socket);
+
+// shuts served connections down, waits for threads and closes queued connections
+void workers_stop(struct workers * workers);
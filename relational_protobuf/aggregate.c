@@ -0,0 +1,595 @@
+#include "aggregate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define AGGREGATE_PARTITION_BITS (4)
+#define AGGREGATE_PARTITIONS (1 << AGGREGATE_PARTITION_BITS)
+#define AGGREGATE_MIN_BUCKET_BITS (6)
+
+
+// function state of group, value is kept while count is not zero:
+// sum of arguments (sum of numbers for avg) or the least or the greatest of them
+struct aggregate_state {
+    uint64_t count;
+    struct storage_value value;
+};
+
+struct aggregate_group {
+    uint64_t hash;
+    struct storage_value ** keys;
+
+    struct aggregate_group * next_in_bucket;
+    struct aggregate_group * next;
+
+    struct aggregate_state states[];
+};
+
+// spilled rows of groups that did not fit memory by partitions of level hash bits
+struct aggregate_spill {
+    unsigned int level;
+    FILE * partitions[AGGREGATE_PARTITIONS];
+    unsigned int next_partition;
+
+    struct aggregate_spill * next;
+};
+
+struct aggregate {
+    unsigned int keys_amount;
+    unsigned int functions_amount;
+    enum aggregate_function * functions;
+    size_t memory_budget;
+
+    // groups of memory, their hashes have the same bits of lower levels
+    unsigned int level;
+    size_t memory;
+    size_t groups_amount;
+    unsigned int bucket_bits;
+    struct aggregate_group ** buckets;
+    struct aggregate_group * first;
+    struct aggregate_group * last;
+
+    // rows of new groups of memory level are spilled since the first spilled one, so groups
+    // of spilled keys are not created in memory again when memory is freed by min or max
+    bool spilling;
+
+    // spill of rows of memory level, and spills whose partitions are not aggregated yet
+    struct aggregate_spill * overflow;
+    struct aggregate_spill * pending;
+};
+
+
+static uint64_t aggregate_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t aggregate_hash_value(const struct storage_value * value) {
+    if (!value) {
+        return 0x9e3779b97f4a7c15ULL;
+    }
+
+    uint64_t bits = 0;
+
+    switch (value->type) {
+        case STORAGE_COLUMN_TYPE_INT:
+        case STORAGE_COLUMN_TYPE_UINT:
+            bits = value->value.uint;
+            break;
+
+        case STORAGE_COLUMN_TYPE_NUM: {
+            // zeros of both signs are equal
+            const double num = value->value.num == 0 ? 0 : value->value.num;
+            memcpy(&bits, &num, sizeof(bits));
+            break;
+        }
+
+        case STORAGE_COLUMN_TYPE_STR:
+            bits = 0xcbf29ce484222325ULL;
+
+            for (const char * c = value->value.str; *c; ++c) {
+                bits = (bits ^ (uint8_t) *c) * 0x100000001b3ULL;
+            }
+
+            break;
+    }
+
+    return aggregate_mix(bits);
+}
+
+static uint64_t aggregate_hash_keys(const struct aggregate * aggregate, struct storage_value * const * keys) {
+    uint64_t hash = 0;
+
+    for (unsigned int i = 0; i < aggregate->keys_amount; ++i) {
+        hash = aggregate_mix(hash ^ aggregate_hash_value(keys[i]));
+    }
+
+    return hash;
+}
+
+static bool aggregate_keys_equal(const struct aggregate * aggregate, struct storage_value * const * a, struct storage_value * const * b) {
+    for (unsigned int i = 0; i < aggregate->keys_amount; ++i) {
+        if (!a[i] || !b[i]) {
+            if (a[i] != b[i]) {
+                return false;
+            }
+
+            continue;
+        }
+
+        if (storage_value_compare(a[i], b[i]) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// copies value with its own string, returns memory of the string
+static size_t aggregate_copy_value(const struct storage_value * value, struct storage_value * copy) {
+    *copy = *value;
+    copy->view = false;
+
+    if (value->type != STORAGE_COLUMN_TYPE_STR) {
+        return 0;
+    }
+
+    copy->value.str = strdup(value->value.str);
+    return strlen(copy->value.str) + 1;
+}
+
+static size_t aggregate_group_size(const struct aggregate * aggregate) {
+    return sizeof(struct aggregate_group) + sizeof(struct aggregate_state) * aggregate->functions_amount;
+}
+
+static void aggregate_resize(struct aggregate * aggregate, unsigned int bucket_bits) {
+    struct aggregate_group ** const buckets = calloc((size_t) 1 << bucket_bits, sizeof(*buckets));
+
+    // buckets are chosen by upper bits, lower ones are the same in partition
+    for (struct aggregate_group * group = aggregate->first; group; group = group->next) {
+        struct aggregate_group ** const bucket = &buckets[group->hash >> (64 - bucket_bits)];
+
+        group->next_in_bucket = *bucket;
+        *bucket = group;
+    }
+
+    free(aggregate->buckets);
+    aggregate->buckets = buckets;
+    aggregate->bucket_bits = bucket_bits;
+}
+
+static struct aggregate_group * aggregate_create_group(struct aggregate * aggregate, uint64_t hash, struct storage_value * const * keys) {
+    struct aggregate_group * const group = malloc(aggregate_group_size(aggregate));
+
+    group->hash = hash;
+    group->keys = malloc(sizeof(*group->keys) * aggregate->keys_amount);
+    group->next = NULL;
+
+    size_t memory = aggregate_group_size(aggregate) + sizeof(*group->keys) * aggregate->keys_amount;
+
+    for (unsigned int i = 0; i < aggregate->keys_amount; ++i) {
+        group->keys[i] = NULL;
+
+        if (keys[i]) {
+            group->keys[i] = malloc(sizeof(*group->keys[i]));
+            memory += sizeof(*group->keys[i]) + aggregate_copy_value(keys[i], group->keys[i]);
+        }
+    }
+
+    for (unsigned int i = 0; i < aggregate->functions_amount; ++i) {
+        group->states[i].count = 0;
+    }
+
+    if (aggregate->last) {
+        aggregate->last->next = group;
+    } else {
+        aggregate->first = group;
+    }
+
+    aggregate->last = group;
+    aggregate->memory += memory;
+
+    if (++aggregate->groups_amount > ((size_t) 1 << aggregate->bucket_bits)) {
+        aggregate_resize(aggregate, aggregate->bucket_bits + 1);
+    } else {
+        struct aggregate_group ** const bucket = &aggregate->buckets[hash >> (64 - aggregate->bucket_bits)];
+
+        group->next_in_bucket = *bucket;
+        *bucket = group;
+    }
+
+    return group;
+}
+
+static void aggregate_update(struct aggregate * aggregate, enum aggregate_function function,
+        struct aggregate_state * state, const struct storage_value * argument) {
+    if (!argument) {
+        return;
+    }
+
+    switch (function) {
+        case AGGREGATE_FUNCTION_COUNT:
+            break;
+
+        case AGGREGATE_FUNCTION_SUM:
+            if (state->count == 0) {
+                state->value = *argument;
+                state->value.view = false;
+                break;
+            }
+
+            switch (argument->type) {
+                case STORAGE_COLUMN_TYPE_INT:
+                    state->value.value._int += argument->value._int;
+                    break;
+
+                case STORAGE_COLUMN_TYPE_UINT:
+                    state->value.value.uint += argument->value.uint;
+                    break;
+
+                case STORAGE_COLUMN_TYPE_NUM:
+                    state->value.value.num += argument->value.num;
+                    break;
+
+                default:
+                    break;
+            }
+
+            break;
+
+        case AGGREGATE_FUNCTION_AVG: {
+            const double num = argument->type == STORAGE_COLUMN_TYPE_NUM ? argument->value.num
+                : argument->type == STORAGE_COLUMN_TYPE_INT ? (double) argument->value._int : (double) argument->value.uint;
+
+            if (state->count == 0) {
+                state->value.type = STORAGE_COLUMN_TYPE_NUM;
+                state->value.view = false;
+                state->value.value.num = 0;
+            }
+
+            state->value.value.num += num;
+            break;
+        }
+
+        case AGGREGATE_FUNCTION_MIN:
+        case AGGREGATE_FUNCTION_MAX: {
+            if (state->count > 0) {
+                const int order = storage_value_compare(argument, &state->value);
+
+                if (function == AGGREGATE_FUNCTION_MIN ? order >= 0 : order <= 0) {
+                    break;
+                }
+
+                if (state->value.type == STORAGE_COLUMN_TYPE_STR) {
+                    aggregate->memory -= strlen(state->value.value.str) + 1;
+                }
+
+                storage_value_destroy(state->value);
+            }
+
+            aggregate->memory += aggregate_copy_value(argument, &state->value);
+            break;
+        }
+    }
+
+    ++state->count;
+}
+
+static void aggregate_write_value(FILE * file, const struct storage_value * value) {
+    const uint8_t tag = value ? (uint8_t) (value->type + 1) : 0;
+    fwrite(&tag, sizeof(tag), 1, file);
+
+    if (!value) {
+        return;
+    }
+
+    if (value->type != STORAGE_COLUMN_TYPE_STR) {
+        fwrite(&value->value, sizeof(value->value.uint), 1, file);
+        return;
+    }
+
+    const uint32_t length = (uint32_t) strlen(value->value.str);
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(value->value.str, 1, length, file);
+}
+
+// reads value written by aggregate_write_value, returns false at the end of file
+static bool aggregate_read_value(FILE * file, struct storage_value ** value) {
+    uint8_t tag;
+    if (fread(&tag, sizeof(tag), 1, file) != 1) {
+        return false;
+    }
+
+    *value = NULL;
+    if (tag == 0) {
+        return true;
+    }
+
+    struct storage_value * const result = malloc(sizeof(*result));
+    result->type = (enum storage_column_type) (tag - 1);
+    result->view = false;
+
+    if (result->type != STORAGE_COLUMN_TYPE_STR) {
+        if (fread(&result->value, sizeof(result->value.uint), 1, file) != 1) {
+            free(result);
+            return false;
+        }
+
+        *value = result;
+        return true;
+    }
+
+    uint32_t length;
+    if (fread(&length, sizeof(length), 1, file) != 1) {
+        free(result);
+        return false;
+    }
+
+    result->value.str = malloc(length + 1);
+    if (fread(result->value.str, 1, length, file) != length) {
+        storage_value_delete(result);
+        return false;
+    }
+
+    result->value.str[length] = '\0';
+    *value = result;
+    return true;
+}
+
+// spills row to partition of overflow by the bits of memory level, returns false when it can not
+static bool aggregate_spill_row(struct aggregate * aggregate, uint64_t hash,
+        struct storage_value * const * keys, struct storage_value * const * arguments) {
+    if (aggregate->level * AGGREGATE_PARTITION_BITS >= 64) {
+        return false;
+    }
+
+    if (!aggregate->overflow) {
+        struct aggregate_spill * const spill = malloc(sizeof(*spill));
+
+        spill->level = aggregate->level;
+        spill->next_partition = 0;
+        spill->next = NULL;
+
+        for (unsigned int i = 0; i < AGGREGATE_PARTITIONS; ++i) {
+            spill->partitions[i] = NULL;
+        }
+
+        aggregate->overflow = spill;
+    }
+
+    const unsigned int partition = (hash >> (aggregate->level * AGGREGATE_PARTITION_BITS)) & (AGGREGATE_PARTITIONS - 1);
+    FILE ** const file = &aggregate->overflow->partitions[partition];
+
+    if (!*file && !(*file = tmpfile())) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < aggregate->keys_amount; ++i) {
+        aggregate_write_value(*file, keys[i]);
+    }
+
+    for (unsigned int i = 0; i < aggregate->functions_amount; ++i) {
+        aggregate_write_value(*file, arguments[i]);
+    }
+
+    return true;
+}
+
+static void aggregate_add_row(struct aggregate * aggregate, uint64_t hash,
+        struct storage_value * const * keys, struct storage_value * const * arguments) {
+    struct aggregate_group * group = aggregate->buckets[hash >> (64 - aggregate->bucket_bits)];
+
+    while (group && (group->hash != hash || !aggregate_keys_equal(aggregate, group->keys, keys))) {
+        group = group->next_in_bucket;
+    }
+
+    if (!group) {
+        // groups that do not fit are aggregated in memory only when they can not be spilled
+        if ((aggregate->spilling || aggregate->memory >= aggregate->memory_budget)
+                && aggregate_spill_row(aggregate, hash, keys, arguments)) {
+            aggregate->spilling = true;
+            return;
+        }
+
+        group = aggregate_create_group(aggregate, hash, keys);
+    }
+
+    for (unsigned int i = 0; i < aggregate->functions_amount; ++i) {
+        aggregate_update(aggregate, aggregate->functions[i], &group->states[i], arguments[i]);
+    }
+}
+
+// aggregates spilled partition in empty memory, rows of its groups that do not fit are spilled again
+static void aggregate_load_partition(struct aggregate * aggregate, FILE * file, unsigned int level) {
+    const unsigned int amount = aggregate->keys_amount + aggregate->functions_amount;
+    struct storage_value ** const row = calloc(amount, sizeof(*row));
+
+    aggregate->level = level;
+    aggregate->spilling = false;
+    rewind(file);
+
+    for (bool read = true; read; ) {
+        unsigned int i = 0;
+
+        while (i < amount && aggregate_read_value(file, &row[i])) {
+            ++i;
+        }
+
+        read = i == amount;
+        if (read) {
+            aggregate_add_row(aggregate, aggregate_hash_keys(aggregate, row), row, row + aggregate->keys_amount);
+        }
+
+        for (unsigned int j = 0; j < i; ++j) {
+            storage_value_delete(row[j]);
+        }
+    }
+
+    free(row);
+    fclose(file);
+}
+
+static void aggregate_delete_spill(struct aggregate_spill * spill) {
+    for (unsigned int i = 0; i < AGGREGATE_PARTITIONS; ++i) {
+        if (spill->partitions[i]) {
+            fclose(spill->partitions[i]);
+        }
+    }
+
+    free(spill);
+}
+
+// takes the next spilled partition into memory, returns false when there are no partitions any more
+static bool aggregate_next_partition(struct aggregate * aggregate) {
+    if (aggregate->overflow) {
+        aggregate->overflow->next = aggregate->pending;
+        aggregate->pending = aggregate->overflow;
+        aggregate->overflow = NULL;
+    }
+
+    while (aggregate->pending) {
+        struct aggregate_spill * const spill = aggregate->pending;
+
+        while (spill->next_partition < AGGREGATE_PARTITIONS) {
+            FILE * const file = spill->partitions[spill->next_partition];
+            spill->partitions[spill->next_partition++] = NULL;
+
+            if (file) {
+                aggregate_load_partition(aggregate, file, spill->level + 1);
+                return true;
+            }
+        }
+
+        aggregate->pending = spill->next;
+        aggregate_delete_spill(spill);
+    }
+
+    return false;
+}
+
+struct aggregate * aggregate_new(unsigned int keys_amount, unsigned int functions_amount,
+        const enum aggregate_function * functions, size_t memory_budget) {
+    struct aggregate * const aggregate = malloc(sizeof(*aggregate));
+
+    aggregate->keys_amount = keys_amount;
+    aggregate->functions_amount = functions_amount;
+    aggregate->functions = malloc(sizeof(*functions) * functions_amount);
+    memcpy(aggregate->functions, functions, sizeof(*functions) * functions_amount);
+    aggregate->memory_budget = memory_budget;
+
+    aggregate->level = 0;
+    aggregate->memory = 0;
+    aggregate->groups_amount = 0;
+    aggregate->bucket_bits = AGGREGATE_MIN_BUCKET_BITS;
+    aggregate->buckets = calloc((size_t) 1 << aggregate->bucket_bits, sizeof(*aggregate->buckets));
+    aggregate->first = NULL;
+    aggregate->last = NULL;
+
+    aggregate->spilling = false;
+    aggregate->overflow = NULL;
+    aggregate->pending = NULL;
+
+    if (keys_amount == 0) {
+        aggregate_create_group(aggregate, aggregate_hash_keys(aggregate, NULL), NULL);
+    }
+
+    return aggregate;
+}
+
+void aggregate_add(struct aggregate * aggregate, struct storage_value * const * keys, struct storage_value * const * arguments) {
+    aggregate_add_row(aggregate, aggregate_hash_keys(aggregate, keys), keys, arguments);
+}
+
+static struct storage_value * aggregate_result(enum aggregate_function function, struct aggregate_state * state) {
+    struct storage_value * const result = malloc(sizeof(*result));
+    result->view = false;
+
+    if (function == AGGREGATE_FUNCTION_COUNT) {
+        result->type = STORAGE_COLUMN_TYPE_UINT;
+        result->value.uint = state->count;
+        return result;
+    }
+
+    if (state->count == 0) {
+        free(result);
+        return NULL;
+    }
+
+    *result = state->value;
+
+    if (function == AGGREGATE_FUNCTION_AVG) {
+        result->value.num /= (double) state->count;
+    }
+
+    return result;
+}
+
+bool aggregate_next(struct aggregate * aggregate, struct storage_value ** row) {
+    // every row of partition may be spilled again by the next bits
+    while (!aggregate->first) {
+        if (!aggregate_next_partition(aggregate)) {
+            return false;
+        }
+    }
+
+    struct aggregate_group * const group = aggregate->first;
+
+    for (unsigned int i = 0; i < aggregate->keys_amount; ++i) {
+        row[i] = group->keys[i];
+    }
+
+    for (unsigned int i = 0; i < aggregate->functions_amount; ++i) {
+        row[aggregate->keys_amount + i] = aggregate_result(aggregate->functions[i], &group->states[i]);
+    }
+
+    // groups are taken in order, so buckets are cleared when memory is empty
+    aggregate->first = group->next;
+
+    if (!aggregate->first) {
+        aggregate->last = NULL;
+        aggregate->memory = 0;
+        aggregate->groups_amount = 0;
+
+        aggregate_resize(aggregate, AGGREGATE_MIN_BUCKET_BITS);
+    }
+
+    free(group->keys);
+    free(group);
+    return true;
+}
+
+void aggregate_delete(struct aggregate * aggregate) {
+    const unsigned int amount = aggregate->keys_amount + aggregate->functions_amount;
+    struct storage_value ** const row = malloc(sizeof(*row) * amount);
+
+    // groups of memory are taken and dropped, spilled ones are not aggregated
+    while (aggregate->first && aggregate_next(aggregate, row)) {
+        for (unsigned int i = 0; i < amount; ++i) {
+            storage_value_delete(row[i]);
+        }
+    }
+
+    free(row);
+
+    if (aggregate->overflow) {
+        aggregate_delete_spill(aggregate->overflow);
+    }
+
+    while (aggregate->pending) {
+        struct aggregate_spill * const spill = aggregate->pending;
+
+        aggregate->pending = spill->next;
+        aggregate_delete_spill(spill);
+    }
+
+    free(aggregate->buckets);
+    free(aggregate->functions);
+    free(aggregate);
+}
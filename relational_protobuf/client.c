@@ -14,6 +14,28 @@
 
 void scan_string(const char * str);
 
+// prepared requests by ids of their statements, responses of executes are printed as of these requests
+static struct {
+    uint64_t amount;
+    struct prepared_request {
+        Request__ActionCase action;
+        bool stream;
+    } * requests;
+} statements = { 0, NULL };
+
+static struct prepared_request get_prepared_request(const Request * request) {
+    if (request->action_case == REQUEST__ACTION_EXECUTE && request->execute->statement < statements.amount) {
+        return statements.requests[request->execute->statement];
+    }
+
+    const struct prepared_request prepared = {
+        .action = request->action_case,
+        .stream = request->action_case == REQUEST__ACTION_SELECT && request->select->has_stream && request->select->stream,
+    };
+
+    return prepared;
+}
+
 static bool is_error_response(const Response * response) {
     if (response->payload_case == RESPONSE__PAYLOAD_ERROR) {
         printf("Error: %s.\n", response->error);
@@ -135,7 +157,45 @@ static void print_table_response(const SuccessResponse * response) {
     free(cell_strings);
 }
 
-static void print_response(Request__ActionCase action, const Response * response) {
+static void print_stats_response(const SuccessResponse * response) {
+    if (response->value_case != SUCCESS_RESPONSE__VALUE_STATS) {
+        printf("Bad answer.\n");
+        return;
+    }
+
+    const Stats * const stats = response->stats;
+
+    printf("Storage file: %"PRIu64" bytes, %"PRIu64" tables.\n", stats->size, stats->tables);
+    printf("Row groups with bodies: %"PRIu64", compressed: %"PRIu64".\n", stats->row_groups, stats->compressed_row_groups);
+    printf("Bodies: %"PRIu64" bytes stored in %"PRIu64" bytes, compression ratio %.2f.\n",
+        stats->body_size, stats->stored_size, stats->compression_ratio);
+}
+
+// remembers prepared request by id of its statement
+static void print_prepare_response(const SuccessResponse * response, const Request * prepared) {
+    if (response->value_case != SUCCESS_RESPONSE__VALUE_PREPARED) {
+        printf("Bad answer.\n");
+        return;
+    }
+
+    const uint64_t id = response->prepared->statement;
+
+    if (id >= statements.amount) {
+        statements.requests = realloc(statements.requests, sizeof(*statements.requests) * (id + 1));
+
+        for (uint64_t i = statements.amount; i < id; ++i) {
+            statements.requests[i].action = REQUEST__ACTION_EXECUTE;
+            statements.requests[i].stream = false;
+        }
+
+        statements.amount = id + 1;
+    }
+
+    statements.requests[id] = get_prepared_request(prepared);
+    printf("Statement %"PRIu64" was prepared with %"PRIu32" parameters.\n", id, response->prepared->parameters);
+}
+
+static void print_response(const Request * request, const Response * response) {
     if (is_error_response(response)) {
         return;
     }
@@ -145,7 +205,7 @@ static void print_response(Request__ActionCase action, const Response * response
         return;
     }
 
-    switch (action) {
+    switch (get_prepared_request(request).action) {
         case REQUEST__ACTION_CREATE_TABLE:
             printf("Table was created.\n");
             break;
@@ -155,7 +215,7 @@ static void print_response(Request__ActionCase action, const Response * response
             break;
 
         case REQUEST__ACTION_INSERT:
-            printf("Row was inserted.\n");
+            print_amount_response(success_response, "inserted");
             break;
 
         case REQUEST__ACTION_DELETE:
@@ -163,18 +223,85 @@ static void print_response(Request__ActionCase action, const Response * response
             break;
 
         case REQUEST__ACTION_SELECT:
-            print_table_response(success_response);
+            // streamed select ends with amount of rows, select of cursor returns its id
+            if (success_response->value_case == SUCCESS_RESPONSE__VALUE_AMOUNT) {
+                print_amount_response(success_response, "selected");
+            } else if (success_response->value_case == SUCCESS_RESPONSE__VALUE_CURSOR) {
+                printf("Cursor %"PRIu64" was declared.\n", success_response->cursor);
+            } else {
+                print_table_response(success_response);
+            }
+
             break;
 
         case REQUEST__ACTION_UPDATE:
             print_amount_response(success_response, "updated");
             break;
 
+        case REQUEST__ACTION_VACUUM:
+            print_amount_response(success_response, "vacuumed");
+            break;
+
+        case REQUEST__ACTION_CREATE_INDEX:
+            printf("Index was created.\n");
+            break;
+
+        case REQUEST__ACTION_FETCH:
+            print_table_response(success_response);
+            break;
+
+        case REQUEST__ACTION_CLOSE_CURSOR:
+            printf("Cursor was closed.\n");
+            break;
+
+        case REQUEST__ACTION_STATS:
+            print_stats_response(success_response);
+            break;
+
+        case REQUEST__ACTION_PREPARE:
+            print_prepare_response(success_response, request->prepare->request);
+            break;
+
+        case REQUEST__ACTION_DEALLOCATE:
+            printf("Statement was deallocated.\n");
+            break;
+
         default:
             return;
     }
 }
 
+// reads response frame, response is set to NULL for empty or broken one; returns false when connection is lost
+static bool read_response(int socket, Response ** response) {
+    *response = NULL;
+
+    uint32_t response_size;
+    if (!read_full(socket, &response_size, sizeof(response_size))) {
+        return false;
+    }
+
+    response_size = ntohl(response_size);
+    if (response_size == 0) {
+        printf("Empty answer.\n");
+        return true;
+    }
+
+    uint8_t * const response_buffer = malloc(response_size);
+    if (!read_full(socket, response_buffer, response_size)) {
+        free(response_buffer);
+        return false;
+    }
+
+    *response = response__unpack(NULL, response_size, response_buffer);
+    free(response_buffer);
+
+    if (!*response) {
+        printf("Server didn't understand request.\n");
+    }
+
+    return true;
+}
+
 static bool handle_request(int socket, const Request * request) {
     size_t request_size = request__get_packed_size(request);
 
@@ -203,29 +330,29 @@ static bool handle_request(int socket, const Request * request) {
 
     free(request_buffer);
 
-    uint32_t response_size;
-    if (!read_full(socket, &response_size, sizeof(response_size))) {
+    const bool stream = get_prepared_request(request).stream;
+
+    Response * response;
+    if (!read_response(socket, &response)) {
         return false;
     }
 
-    response_size = ntohl(response_size);
-    if (response_size == 0) {
-        printf("Empty answer.\n");
-        return true;
-    }
+    // rows of streamed select are printed by chunks as they come
+    while (stream && response && response->payload_case == RESPONSE__PAYLOAD_SUCCESS
+            && response->success->value_case == SUCCESS_RESPONSE__VALUE_TABLE) {
+        print_response(request, response);
+        response__free_unpacked(response, NULL);
 
-    uint8_t * const response_buffer = malloc(response_size);
-    if (!read_full(socket, response_buffer, response_size)) {
-        return false;
+        if (!read_response(socket, &response)) {
+            return false;
+        }
     }
 
-    Response * const response = response__unpack(NULL, response_size, response_buffer);
-    if (!response) {
-        printf("Server didn't understand request.\n");
-        return true;
+    if (response) {
+        print_response(request, response);
+        response__free_unpacked(response, NULL);
     }
 
-    print_response(request->action_case, response);
     return true;
 }
 
@@ -0,0 +1,199 @@
+#include "cursors.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+
+#define CURSORS_BUCKETS (64)
+
+
+struct cursors_entry {
+    uint64_t id;
+    void * state;
+    time_t used;
+
+    struct cursors_entry * next_in_bucket;
+
+    // idle cursors from the least recently used one
+    struct cursors_entry * prev;
+    struct cursors_entry * next;
+};
+
+struct cursors {
+    unsigned int timeout;
+    cursors_destroyer destroy;
+
+    pthread_mutex_t lock;
+    uint64_t next_id;
+
+    struct cursors_entry * buckets[CURSORS_BUCKETS];
+    struct cursors_entry * oldest;
+    struct cursors_entry * newest;
+};
+
+
+static time_t cursors_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec;
+}
+
+static struct cursors_entry ** cursors_link(struct cursors * cursors, uint64_t id) {
+    struct cursors_entry ** link = &cursors->buckets[id % CURSORS_BUCKETS];
+
+    while (*link && (*link)->id != id) {
+        link = &(*link)->next_in_bucket;
+    }
+
+    return link;
+}
+
+static void cursors_append(struct cursors * cursors, uint64_t id, void * state) {
+    struct cursors_entry * const entry = malloc(sizeof(*entry));
+    entry->id = id;
+    entry->state = state;
+    entry->used = cursors_now();
+
+    struct cursors_entry ** const link = &cursors->buckets[id % CURSORS_BUCKETS];
+    entry->next_in_bucket = *link;
+    *link = entry;
+
+    entry->prev = cursors->newest;
+    entry->next = NULL;
+
+    if (cursors->newest) {
+        cursors->newest->next = entry;
+    } else {
+        cursors->oldest = entry;
+    }
+
+    cursors->newest = entry;
+}
+
+static void cursors_unlink(struct cursors * cursors, struct cursors_entry * entry) {
+    struct cursors_entry ** const link = cursors_link(cursors, entry->id);
+    *link = entry->next_in_bucket;
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cursors->oldest = entry->next;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cursors->newest = entry->prev;
+    }
+}
+
+// unlinks idle cursors that are used before the time, returns them linked by next
+static struct cursors_entry * cursors_unlink_used_before(struct cursors * cursors, time_t time) {
+    struct cursors_entry * unlinked = NULL;
+
+    while (cursors->oldest && cursors->oldest->used < time) {
+        struct cursors_entry * const entry = cursors->oldest;
+
+        cursors_unlink(cursors, entry);
+        entry->next = unlinked;
+        unlinked = entry;
+    }
+
+    return unlinked;
+}
+
+// states are destroyed outside the mutex, so requests do not wait for it
+static void cursors_destroy(struct cursors * cursors, struct cursors_entry * entries) {
+    while (entries) {
+        struct cursors_entry * const entry = entries;
+
+        entries = entry->next;
+        cursors->destroy(entry->state);
+        free(entry);
+    }
+}
+
+struct cursors * cursors_new(unsigned int timeout, cursors_destroyer destroy) {
+    struct cursors * const cursors = malloc(sizeof(*cursors));
+
+    cursors->timeout = timeout;
+    cursors->destroy = destroy;
+
+    pthread_mutex_init(&cursors->lock, NULL);
+    cursors->next_id = 1;
+
+    for (unsigned int i = 0; i < CURSORS_BUCKETS; ++i) {
+        cursors->buckets[i] = NULL;
+    }
+
+    cursors->oldest = NULL;
+    cursors->newest = NULL;
+    return cursors;
+}
+
+uint64_t cursors_add(struct cursors * cursors, void * state) {
+    pthread_mutex_lock(&cursors->lock);
+
+    struct cursors_entry * const expired = cursors_unlink_used_before(cursors, cursors_now() - cursors->timeout);
+
+    const uint64_t id = cursors->next_id++;
+    cursors_append(cursors, id, state);
+
+    pthread_mutex_unlock(&cursors->lock);
+
+    cursors_destroy(cursors, expired);
+    return id;
+}
+
+void * cursors_take(struct cursors * cursors, uint64_t id) {
+    pthread_mutex_lock(&cursors->lock);
+
+    struct cursors_entry * const expired = cursors_unlink_used_before(cursors, cursors_now() - cursors->timeout);
+    struct cursors_entry * const entry = *cursors_link(cursors, id);
+
+    void * state = NULL;
+    if (entry) {
+        cursors_unlink(cursors, entry);
+
+        state = entry->state;
+        free(entry);
+    }
+
+    pthread_mutex_unlock(&cursors->lock);
+
+    cursors_destroy(cursors, expired);
+    return state;
+}
+
+void cursors_put(struct cursors * cursors, uint64_t id, void * state) {
+    pthread_mutex_lock(&cursors->lock);
+    cursors_append(cursors, id, state);
+    pthread_mutex_unlock(&cursors->lock);
+}
+
+void cursors_clear(struct cursors * cursors) {
+    pthread_mutex_lock(&cursors->lock);
+
+    struct cursors_entry * entries = NULL;
+    while (cursors->newest) {
+        struct cursors_entry * const entry = cursors->newest;
+
+        cursors_unlink(cursors, entry);
+        entry->next = entries;
+        entries = entry;
+    }
+
+    pthread_mutex_unlock(&cursors->lock);
+
+    cursors_destroy(cursors, entries);
+}
+
+void cursors_delete(struct cursors * cursors) {
+    cursors_clear(cursors);
+
+    pthread_mutex_destroy(&cursors->lock);
+    free(cursors);
+}
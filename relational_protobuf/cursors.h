@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+
+// states of scans kept by server between requests under cursor ids:
+// cursor is taken by request that uses it and put back after that,
+// so it is used by one request at a time, idle cursors that are not
+// taken for timeout seconds are destroyed by the next add or take
+struct cursors;
+
+typedef void (* cursors_destroyer)(void * state);
+
+
+struct cursors * cursors_new(unsigned int timeout, cursors_destroyer destroy);
+
+// adds idle cursor with the state, returns its id
+uint64_t cursors_add(struct cursors * cursors, void * state);
+
+// returns state of idle cursor, which is taken until it is put back, or NULL
+void * cursors_take(struct cursors * cursors, uint64_t id);
+
+// puts taken cursor back, its timeout starts again
+void cursors_put(struct cursors * cursors, uint64_t id, void * state);
+
+// destroys idle cursors
+void cursors_clear(struct cursors * cursors);
+
+// destroys idle cursors, taken ones must be put back or destroyed before
+void cursors_delete(struct cursors * cursors);
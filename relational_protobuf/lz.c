@@ -0,0 +1,178 @@
+#include "lz.h"
+
+#include <string.h>
+
+
+#define LZ_HASH_BITS (12)
+
+// matches end before the last bytes of data, so the last token always has literals
+#define LZ_LAST_LITERALS (5)
+
+// length of 15 in token is continued by the following bytes
+#define LZ_LENGTH_CONTINUED (15)
+
+
+static uint32_t lz_read32(const uint8_t * ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+
+    return value;
+}
+
+static uint32_t lz_hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t * lz_put_length(uint8_t * dst, size_t length) {
+    length -= LZ_LENGTH_CONTINUED;
+
+    for (; length >= 255; length -= 255) {
+        *dst++ = 255;
+    }
+
+    *dst++ = (uint8_t) length;
+    return dst;
+}
+
+// puts token with literals and match, the last token has no match
+static uint8_t * lz_put_token(uint8_t * dst, const uint8_t * literals, size_t literals_length,
+    size_t match_length, size_t offset, bool last) {
+
+    const size_t match_code = last ? 0 : match_length - LZ_MIN_MATCH;
+    uint8_t * const token = dst++;
+
+    *token = (uint8_t) ((literals_length < LZ_LENGTH_CONTINUED ? literals_length : LZ_LENGTH_CONTINUED) << 4
+        | (match_code < LZ_LENGTH_CONTINUED ? match_code : LZ_LENGTH_CONTINUED));
+
+    if (literals_length >= LZ_LENGTH_CONTINUED) {
+        dst = lz_put_length(dst, literals_length);
+    }
+
+    memcpy(dst, literals, literals_length);
+    dst += literals_length;
+
+    if (last) {
+        return dst;
+    }
+
+    *dst++ = (uint8_t) (offset & 0xFF);
+    *dst++ = (uint8_t) (offset >> 8);
+
+    if (match_code >= LZ_LENGTH_CONTINUED) {
+        dst = lz_put_length(dst, match_code);
+    }
+
+    return dst;
+}
+
+static bool lz_get_length(const uint8_t ** src, const uint8_t * end, size_t * length) {
+    uint8_t byte;
+
+    do {
+        if (*src == end) {
+            return false;
+        }
+
+        byte = *(*src)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+size_t lz_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz_compress(const uint8_t * src, size_t size, uint8_t * dst) {
+    // positions of the last 4 bytes with the hash plus one, zero for none
+    size_t table[1 << LZ_HASH_BITS] = { 0 };
+
+    uint8_t * out = dst;
+    size_t anchor = 0;
+
+    for (size_t i = 0; i + LZ_LAST_LITERALS + LZ_MIN_MATCH <= size; ) {
+        const uint32_t hash = lz_hash(lz_read32(src + i));
+        const size_t candidate = table[hash];
+
+        table[hash] = i + 1;
+
+        if (candidate == 0 || i + 1 - candidate > LZ_WINDOW || lz_read32(src + candidate - 1) != lz_read32(src + i)) {
+            ++i;
+            continue;
+        }
+
+        const size_t match = candidate - 1;
+
+        size_t length = LZ_MIN_MATCH;
+        while (i + length < size - LZ_LAST_LITERALS && src[match + length] == src[i + length]) {
+            ++length;
+        }
+
+        out = lz_put_token(out, src + anchor, i - anchor, length, i - match, false);
+
+        i += length;
+        anchor = i;
+    }
+
+    out = lz_put_token(out, src + anchor, size - anchor, 0, 0, true);
+    return out - dst;
+}
+
+bool lz_decompress(const uint8_t * src, size_t size, uint8_t * dst, size_t dst_size) {
+    const uint8_t * const end = src + size;
+    size_t done = 0;
+
+    while (src < end) {
+        const uint8_t token = *src++;
+
+        size_t literals = token >> 4;
+        if (literals == LZ_LENGTH_CONTINUED && !lz_get_length(&src, end, &literals)) {
+            return false;
+        }
+
+        if ((size_t) (end - src) < literals || dst_size - done < literals) {
+            return false;
+        }
+
+        memcpy(dst + done, src, literals);
+        src += literals;
+        done += literals;
+
+        // the last token
+        if (src == end) {
+            break;
+        }
+
+        if (end - src < 2) {
+            return false;
+        }
+
+        const size_t offset = src[0] | (size_t) src[1] << 8;
+        src += 2;
+
+        size_t length = token & 0xF;
+        if (length == LZ_LENGTH_CONTINUED && !lz_get_length(&src, end, &length)) {
+            return false;
+        }
+
+        length += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > done || dst_size - done < length) {
+            return false;
+        }
+
+        // match may overlap the bytes it makes
+        if (offset >= length) {
+            memcpy(dst + done, dst + done - offset, length);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                dst[done + i] = dst[done - offset + i];
+            }
+        }
+
+        done += length;
+    }
+
+    return done == dst_size;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// LZ77 block codec in the manner of LZ4: block is a sequence of tokens, each token
+// is followed by literals copied as is and by match copied from the decompressed data
+// before it, the last token of block has only literals
+//
+// Token structure:
+// - Lengths: <uint8_t>, high 4 bits are amount of literals, low 4 bits are length of match
+//   minus LZ_MIN_MATCH, 15 is continued by bytes added to it up to the first byte less than 255
+// - Literals: <uint8_t[]>
+// - Match offset: <uint16_t>, distance back from the end of literals (absent in the last token)
+//
+// Matches are found by hash of 4 bytes, so compression is fast and decompression
+// is a loop of copies, which is what pages read through the buffer pool need
+
+#define LZ_MIN_MATCH (4)
+#define LZ_WINDOW (65535)
+
+
+// the most size of compressed block of data of the size
+size_t lz_bound(size_t size);
+
+// compresses data into dst of lz_bound(size) bytes, returns size of compressed block
+size_t lz_compress(const uint8_t * src, size_t size, uint8_t * dst);
+
+// decompresses block into dst of exactly dst_size bytes, returns false for broken block
+bool lz_decompress(const uint8_t * src, size_t size, uint8_t * dst, size_t dst_size);
@@ -28,7 +28,18 @@ void yyerror(Request ** result, char ** error, const char * str);
     InsertRequest * insert_request;
     DeleteRequest * delete_request;
     SelectRequest * select_request;
+    VacuumRequest * vacuum_request;
+    CreateIndexRequest * create_index_request;
+    FetchRequest * fetch_request;
+    CloseCursorRequest * close_cursor_request;
+    StatsRequest * stats_request;
+    PrepareRequest * prepare_request;
+    ExecuteRequest * execute_request;
+    DeallocateRequest * deallocate_request;
     SelectRequest__Join * select_request__join;
+    SelectRequest__Aggregate * select_request__aggregate;
+    SelectRequest__Order * select_request__order;
+    AggregateFunction aggregate_function;
     UpdateRequest * update_request;
     WhereExpr * where_expr;
 
@@ -47,16 +58,34 @@ void yyerror(Request ** result, char ** error, const char * str);
         Value ** content;
     } array_Value;
 
+    struct {
+        size_t amount;
+        InsertRequest__Row ** content;
+    } array_InsertRequest__Row;
+
     struct {
         size_t amount;
         SelectRequest__Join ** content;
     } array_SelectRequest__Join;
 
+    struct {
+        size_t amount;
+        SelectRequest__Order ** content;
+    } array_SelectRequest__Order;
+
     struct {
         size_t amount;
         struct ql_update_request_set * content;
     } array_ql_update_request_set;
 
+    // selected columns and aggregates
+    struct {
+        size_t n_columns;
+        char ** columns;
+        size_t n_aggregates;
+        SelectRequest__Aggregate ** aggregates;
+    } select_list;
+
     struct {
         size_t amount;
         char ** content;
@@ -68,18 +97,21 @@ void yyerror(Request ** result, char ** error, const char * str);
     } maybe_uint64;
 
     char * str;
+    bool boolean;
     int64_t int64;
     uint64_t uint64;
     double double_;
 }
 
-%token T_CREATE T_TABLE T_INT T_UINT T_NUM T_STR T_DROP T_INSERT T_VALUES T_INTO
+%token T_CREATE T_TABLE T_COLUMNAR T_COMPRESSED T_DICTIONARY T_INT T_UINT T_NUM T_STR T_DROP T_INSERT T_VALUES T_INTO
     T_NULL T_DELETE T_FROM T_WHERE T_JOIN T_ON T_EQ_OP T_NE_OP T_LT_OP T_GT_OP T_LE_OP T_GE_OP
-    T_SELECT T_ASTERISK T_OFFSET T_LIMIT T_UPDATE T_SET
+    T_SELECT T_ASTERISK T_OFFSET T_LIMIT T_STREAM T_UPDATE T_SET T_VACUUM
+    T_DECLARE T_CURSOR T_FOR T_FETCH T_CLOSE T_COUNT T_SUM T_MIN T_MAX T_AVG T_GROUP T_BY T_ORDER T_ASC T_DESC T_STATS
+    T_PREPARE T_EXECUTE T_DEALLOCATE
 
-%token<str> T_IDENTIFIER T_DBL_QUOTED T_STR_LITERAL
+%token<str> T_IDENTIFIER T_DBL_QUOTED T_STR_LITERAL T_INDEX
 %token<int64> T_INT_LITERAL
-%token<uint64> T_UINT_LITERAL
+%token<uint64> T_UINT_LITERAL T_PARAMETER
 %token<double_> T_NUM_LITERAL
 
 %left T_OR_OP
@@ -87,7 +119,7 @@ void yyerror(Request ** result, char ** error, const char * str);
 
 %type<value_type> type
 %type<value> value
-%type<request> command
+%type<request> command prepared_command
 %type<create_table_request> create_table_command
 %type<create_table_request__column> column_declaration
 %type<drop_table_request> drop_table_command
@@ -95,16 +127,32 @@ void yyerror(Request ** result, char ** error, const char * str);
 %type<delete_request> delete_command
 %type<select_request> select_command
 %type<select_request__join> join_stmt
+%type<select_request__aggregate> aggregate
+%type<select_request__order> order
+%type<boolean> order_direction dictionary_non_req
+%type<aggregate_function> aggregate_function
+%type<select_list> select_list select_list_req
 %type<update_request> update_command
+%type<vacuum_request> vacuum_command
+%type<create_index_request> create_index_command
+%type<select_request> declare_cursor_command
+%type<fetch_request> fetch_command
+%type<close_cursor_request> close_cursor_command
+%type<stats_request> stats_command
+%type<prepare_request> prepare_command
+%type<execute_request> execute_command
+%type<deallocate_request> deallocate_command
 %type<where_expr> where_stmt_non_req where_stmt where_expr
 %type<update_request_set> update_value
 %type<array_CreateTableRequest__Column> columns_declaration_list columns_declaration_list_req
 %type<array_Value> values_list values_list_req
+%type<array_InsertRequest__Row> rows_list_req
 %type<array_SelectRequest__Join> join_stmts join_stmts_non_null
+%type<array_SelectRequest__Order> order_by_stmt_non_req orders_list_req
 %type<array_ql_update_request_set> update_values_list_req
-%type<array_str> braced_names_list_non_req braced_names_list names_list_req names_list_or_asterisk
+%type<array_str> braced_names_list_non_req braced_names_list names_list_req group_by_stmt_non_req
 %type<maybe_uint64> offset_stmt_non_req limit_stmt_non_req
-%type<str> name
+%type<str> name table_name keyword_name
 %type<uint64> offset_stmt limit_stmt
 
 %%
@@ -126,27 +174,92 @@ command
     | delete_command        { $$ = make_request(REQUEST__ACTION_DELETE, $1); }
     | select_command        { $$ = make_request(REQUEST__ACTION_SELECT, $1); }
     | update_command        { $$ = make_request(REQUEST__ACTION_UPDATE, $1); }
+    | vacuum_command        { $$ = make_request(REQUEST__ACTION_VACUUM, $1); }
+    | create_index_command  { $$ = make_request(REQUEST__ACTION_CREATE_INDEX, $1); }
+    | declare_cursor_command    { $$ = make_request(REQUEST__ACTION_SELECT, $1); }
+    | fetch_command         { $$ = make_request(REQUEST__ACTION_FETCH, $1); }
+    | close_cursor_command  { $$ = make_request(REQUEST__ACTION_CLOSE_CURSOR, $1); }
+    | stats_command         { $$ = make_request(REQUEST__ACTION_STATS, $1); }
+    | prepare_command       { $$ = make_request(REQUEST__ACTION_PREPARE, $1); }
+    | execute_command       { $$ = make_request(REQUEST__ACTION_EXECUTE, $1); }
+    | deallocate_command    { $$ = make_request(REQUEST__ACTION_DEALLOCATE, $1); }
     ;
 
 create_table_command
-    : T_CREATE t_table_non_req name '(' columns_declaration_list ')'    {
+    : T_CREATE table_name '(' columns_declaration_list ')'    {
+        $$ = malloc(sizeof(CreateTableRequest));
+        create_table_request__init($$);
+
+        $$->table = $2;
+        $$->n_columns = $4.amount;
+        $$->columns = $4.content;
+    }
+    | T_CREATE T_COLUMNAR table_name '(' columns_declaration_list ')'    {
         $$ = malloc(sizeof(CreateTableRequest));
         create_table_request__init($$);
 
         $$->table = $3;
         $$->n_columns = $5.amount;
         $$->columns = $5.content;
+        $$->has_columnar = true;
+        $$->columnar = true;
+    }
+    | T_CREATE T_COLUMNAR T_COMPRESSED table_name '(' columns_declaration_list ')'    {
+        $$ = malloc(sizeof(CreateTableRequest));
+        create_table_request__init($$);
+
+        $$->table = $4;
+        $$->n_columns = $6.amount;
+        $$->columns = $6.content;
+        $$->has_columnar = true;
+        $$->columnar = true;
+        $$->has_compressed = true;
+        $$->compressed = true;
     }
     ;
 
-t_table_non_req
-    : /* empty */
-    | T_TABLE
+// optional TABLE is a part of table name, so create of table named index
+// is told apart from CREATE INDEX by the next token
+table_name
+    : name          { $$ = $1; }
+    | T_TABLE name  { $$ = $2; }
     ;
 
+// index is a keyword only in CREATE INDEX, it is a name everywhere else
 name
     : T_IDENTIFIER  { $$ = $1; }
     | T_DBL_QUOTED  { $$ = $1; }
+    | T_INDEX       { $$ = $1; }
+    | keyword_name  { $$ = $1; }
+    ;
+
+// words that became keywords after tables and columns could be named by them,
+// they are names wherever a keyword can not be there
+keyword_name
+    : T_COLUMNAR    { $$ = strdup("columnar"); }
+    | T_COMPRESSED  { $$ = strdup("compressed"); }
+    | T_DICTIONARY  { $$ = strdup("dictionary"); }
+    | T_VACUUM      { $$ = strdup("vacuum"); }
+    | T_STREAM      { $$ = strdup("stream"); }
+    | T_COUNT       { $$ = strdup("count"); }
+    | T_SUM         { $$ = strdup("sum"); }
+    | T_MIN         { $$ = strdup("min"); }
+    | T_MAX         { $$ = strdup("max"); }
+    | T_AVG         { $$ = strdup("avg"); }
+    | T_GROUP       { $$ = strdup("group"); }
+    | T_BY          { $$ = strdup("by"); }
+    | T_ORDER       { $$ = strdup("order"); }
+    | T_ASC         { $$ = strdup("asc"); }
+    | T_DESC        { $$ = strdup("desc"); }
+    | T_DECLARE     { $$ = strdup("declare"); }
+    | T_CURSOR      { $$ = strdup("cursor"); }
+    | T_FOR         { $$ = strdup("for"); }
+    | T_FETCH       { $$ = strdup("fetch"); }
+    | T_CLOSE       { $$ = strdup("close"); }
+    | T_STATS       { $$ = strdup("stats"); }
+    | T_PREPARE     { $$ = strdup("prepare"); }
+    | T_EXECUTE     { $$ = strdup("execute"); }
+    | T_DEALLOCATE  { $$ = strdup("deallocate"); }
     ;
 
 columns_declaration_list
@@ -169,15 +282,22 @@ columns_declaration_list_req
     ;
 
 column_declaration
-    : name type     {
+    : name type dictionary_non_req  {
         $$ = malloc(sizeof(CreateTableRequest__Column));
         create_table_request__column__init($$);
 
         $$->name = $1;
         $$->type = $2;
+        $$->has_dictionary = $3;
+        $$->dictionary = $3;
     }
     ;
 
+dictionary_non_req
+    : /* empty */   { $$ = false; }
+    | T_DICTIONARY  { $$ = true; }
+    ;
+
 type
     : T_INT     { $$ = VALUE_TYPE__INT; }
     | T_UINT    { $$ = VALUE_TYPE__UINT; }
@@ -186,24 +306,46 @@ type
     ;
 
 drop_table_command
-    : T_DROP t_table_non_req name   {
+    : T_DROP table_name   {
         $$ = malloc(sizeof(DropTableRequest));
         drop_table_request__init($$);
 
-        $$->table = $3;
+        $$->table = $2;
     }
     ;
 
 insert_command
-    : T_INSERT t_into_non_req name braced_names_list_non_req T_VALUES '(' values_list ')'   {
+    : T_INSERT t_into_non_req name braced_names_list_non_req T_VALUES rows_list_req   {
         $$ = malloc(sizeof(InsertRequest));
         insert_request__init($$);
 
         $$->table = $3;
         $$->n_columns = $4.amount;
         $$->columns = $4.content;
-        $$->n_values = $7.amount;
-        $$->values = $7.content;
+        $$->n_rows = $6.amount;
+        $$->rows = $6.content;
+    }
+    ;
+
+rows_list_req
+    : '(' values_list ')'   {
+        $$.amount = 1;
+        $$.content = malloc(sizeof(*($$.content)));
+        $$.content[0] = malloc(sizeof(InsertRequest__Row));
+        insert_request__row__init($$.content[0]);
+
+        $$.content[0]->n_values = $2.amount;
+        $$.content[0]->values = $2.content;
+    }
+    | rows_list_req ',' '(' values_list ')' {
+        $$ = $1;
+        $$.content = realloc($$.content, sizeof(*($$.content)) * ($$.amount + 1));
+        $$.content[$$.amount] = malloc(sizeof(InsertRequest__Row));
+        insert_request__row__init($$.content[$$.amount]);
+
+        $$.content[$$.amount]->n_values = $4.amount;
+        $$.content[$$.amount]->values = $4.content;
+        ++$$.amount;
     }
     ;
 
@@ -289,6 +431,13 @@ value
 
         $$->value_case = VALUE__VALUE__NOT_SET;
     }
+    | T_PARAMETER   {
+        $$ = malloc(sizeof(Value));
+        value__init($$);
+
+        $$->value_case = VALUE__VALUE_PARAMETER;
+        $$->parameter = (uint32_t) $1;
+    }
     ;
 
 delete_command
@@ -403,26 +552,140 @@ where_expr
     ;
 
 select_command
-    : T_SELECT names_list_or_asterisk T_FROM name join_stmts where_stmt_non_req offset_stmt_non_req limit_stmt_non_req {
+    : T_SELECT select_list T_FROM name join_stmts where_stmt_non_req group_by_stmt_non_req order_by_stmt_non_req
+            offset_stmt_non_req limit_stmt_non_req {
         $$ = malloc(sizeof(SelectRequest));
         select_request__init($$);
 
         $$->table = $4;
-        $$->n_columns = $2.amount;
-        $$->columns = $2.content;
+        $$->n_columns = $2.n_columns;
+        $$->columns = $2.columns;
+        $$->n_aggregates = $2.n_aggregates;
+        $$->aggregates = $2.aggregates;
         $$->where = $6;
-        $$->has_offset = $7.present;
-        $$->offset = $7.value;
-        $$->has_limit = $8.present;
-        $$->limit = $8.value;
+        $$->n_group_by = $7.amount;
+        $$->group_by = $7.content;
+        $$->n_order_by = $8.amount;
+        $$->order_by = $8.content;
+        $$->has_offset = $9.present;
+        $$->offset = $9.value;
+        $$->has_limit = $10.present;
+        $$->limit = $10.value;
         $$->n_joins = $5.amount;
         $$->joins = $5.content;
     }
+    | select_command T_STREAM  {
+        $$ = $1;
+        $$->has_stream = true;
+        $$->stream = true;
+    }
+    ;
+
+select_list
+    : select_list_req   { $$ = $1; }
+    | T_ASTERISK        { $$.n_columns = 0; $$.columns = NULL; $$.n_aggregates = 0; $$.aggregates = NULL; }
+    ;
+
+select_list_req
+    : name  {
+        $$.n_columns = 1;
+        $$.columns = malloc(sizeof(*($$.columns)));
+        $$.columns[0] = $1;
+        $$.n_aggregates = 0;
+        $$.aggregates = NULL;
+    }
+    | aggregate {
+        $$.n_columns = 0;
+        $$.columns = NULL;
+        $$.n_aggregates = 1;
+        $$.aggregates = malloc(sizeof(*($$.aggregates)));
+        $$.aggregates[0] = $1;
+    }
+    | select_list_req ',' name  {
+        $$ = $1;
+        $$.columns = realloc($$.columns, sizeof(*($$.columns)) * ($$.n_columns + 1));
+        $$.columns[$$.n_columns] = $3;
+        ++$$.n_columns;
+    }
+    | select_list_req ',' aggregate {
+        $$ = $1;
+        $$.aggregates = realloc($$.aggregates, sizeof(*($$.aggregates)) * ($$.n_aggregates + 1));
+        $$.aggregates[$$.n_aggregates] = $3;
+        ++$$.n_aggregates;
+    }
+    ;
+
+aggregate
+    : aggregate_function '(' name ')'   {
+        $$ = malloc(sizeof(SelectRequest__Aggregate));
+        select_request__aggregate__init($$);
+
+        $$->function = $1;
+        $$->column = $3;
+    }
+    | aggregate_function '(' T_ASTERISK ')' {
+        $$ = malloc(sizeof(SelectRequest__Aggregate));
+        select_request__aggregate__init($$);
+
+        $$->function = $1;
+    }
     ;
 
-names_list_or_asterisk
-    : names_list_req    { $$ = $1; }
-    | T_ASTERISK        { $$.amount = 0; $$.content = NULL; }
+aggregate_function
+    : T_COUNT   { $$ = AGGREGATE_FUNCTION__COUNT; }
+    | T_SUM     { $$ = AGGREGATE_FUNCTION__SUM; }
+    | T_MIN     { $$ = AGGREGATE_FUNCTION__MIN; }
+    | T_MAX     { $$ = AGGREGATE_FUNCTION__MAX; }
+    | T_AVG     { $$ = AGGREGATE_FUNCTION__AVG; }
+    ;
+
+group_by_stmt_non_req
+    : /* empty */                   { $$.amount = 0; $$.content = NULL; }
+    | T_GROUP T_BY names_list_req   { $$ = $3; }
+    ;
+
+order_by_stmt_non_req
+    : /* empty */                   { $$.amount = 0; $$.content = NULL; }
+    | T_ORDER T_BY orders_list_req  { $$ = $3; }
+    ;
+
+orders_list_req
+    : order {
+        $$.amount = 1;
+        $$.content = malloc(sizeof(*($$.content)));
+        $$.content[0] = $1;
+    }
+    | orders_list_req ',' order {
+        $$ = $1;
+        $$.content = realloc($$.content, sizeof(*($$.content)) * ($$.amount + 1));
+        $$.content[$$.amount] = $3;
+        ++$$.amount;
+    }
+    ;
+
+order
+    : name order_direction  {
+        $$ = malloc(sizeof(SelectRequest__Order));
+        select_request__order__init($$);
+
+        $$->column = $1;
+        $$->has_descending = true;
+        $$->descending = $2;
+    }
+    | aggregate order_direction {
+        $$ = malloc(sizeof(SelectRequest__Order));
+        select_request__order__init($$);
+
+        $$->aggregate = $1;
+        $$->has_descending = true;
+        $$->descending = $2;
+    }
+    ;
+
+order_direction
+    : /* empty */   { $$ = false; }
+    | T_ASC         { $$ = false; }
+    | T_DESC        { $$ = true; }
     ;
 
 join_stmts
@@ -513,6 +776,115 @@ update_value
     : name T_EQ_OP value    { $$.column = $1; $$.value = $3; }
     ;
 
+vacuum_command
+    : T_VACUUM  {
+        $$ = malloc(sizeof(VacuumRequest));
+        vacuum_request__init($$);
+    }
+    | T_VACUUM table_name {
+        $$ = malloc(sizeof(VacuumRequest));
+        vacuum_request__init($$);
+
+        $$->table = $2;
+    }
+    ;
+
+create_index_command
+    : T_CREATE T_INDEX T_ON name '(' name ')'  {
+        free($2);
+
+        $$ = malloc(sizeof(CreateIndexRequest));
+        create_index_request__init($$);
+
+        $$->table = $4;
+        $$->column = $6;
+    }
+    ;
+
+declare_cursor_command
+    : T_DECLARE T_CURSOR T_FOR select_command  {
+        $$ = $4;
+        $$->has_cursor = true;
+        $$->cursor = true;
+    }
+    ;
+
+fetch_command
+    : T_FETCH T_FROM T_UINT_LITERAL  {
+        $$ = malloc(sizeof(FetchRequest));
+        fetch_request__init($$);
+
+        $$->cursor = $3;
+    }
+    | T_FETCH T_UINT_LITERAL T_FROM T_UINT_LITERAL  {
+        $$ = malloc(sizeof(FetchRequest));
+        fetch_request__init($$);
+
+        $$->cursor = $4;
+        $$->has_amount = true;
+        $$->amount = $2;
+    }
+    ;
+
+close_cursor_command
+    : T_CLOSE T_UINT_LITERAL  {
+        $$ = malloc(sizeof(CloseCursorRequest));
+        close_cursor_request__init($$);
+
+        $$->cursor = $2;
+    }
+    ;
+
+stats_command
+    : T_STATS   {
+        $$ = malloc(sizeof(StatsRequest));
+        stats_request__init($$);
+    }
+    ;
+
+prepare_command
+    : T_PREPARE prepared_command    {
+        $$ = malloc(sizeof(PrepareRequest));
+        prepare_request__init($$);
+
+        $$->request = $2;
+    }
+    ;
+
+prepared_command
+    : insert_command        { $$ = make_request(REQUEST__ACTION_INSERT, $1); }
+    | delete_command        { $$ = make_request(REQUEST__ACTION_DELETE, $1); }
+    | select_command        { $$ = make_request(REQUEST__ACTION_SELECT, $1); }
+    | update_command        { $$ = make_request(REQUEST__ACTION_UPDATE, $1); }
+    | declare_cursor_command    { $$ = make_request(REQUEST__ACTION_SELECT, $1); }
+    ;
+
+execute_command
+    : T_EXECUTE T_UINT_LITERAL  {
+        $$ = malloc(sizeof(ExecuteRequest));
+        execute_request__init($$);
+
+        $$->statement = $2;
+    }
+    | T_EXECUTE T_UINT_LITERAL '(' values_list ')'  {
+        $$ = malloc(sizeof(ExecuteRequest));
+        execute_request__init($$);
+
+        $$->statement = $2;
+        $$->n_parameters = $4.amount;
+        $$->parameters = $4.content;
+    }
+    ;
+
+deallocate_command
+    : T_DEALLOCATE T_UINT_LITERAL   {
+        $$ = malloc(sizeof(DeallocateRequest));
+        deallocate_request__init($$);
+
+        $$->statement = $2;
+    }
+    ;
+
 %%
 
 static Request * make_request(Request__ActionCase action_case, void * action) {
@@ -546,6 +918,38 @@ static Request * make_request(Request__ActionCase action_case, void * action) {
         result->update = action;
         break;
 
+        case REQUEST__ACTION_VACUUM:
+        result->vacuum = action;
+        break;
+
+        case REQUEST__ACTION_CREATE_INDEX:
+        result->create_index = action;
+        break;
+
+        case REQUEST__ACTION_FETCH:
+        result->fetch = action;
+        break;
+
+        case REQUEST__ACTION_CLOSE_CURSOR:
+        result->close_cursor = action;
+        break;
+
+        case REQUEST__ACTION_STATS:
+        result->stats = action;
+        break;
+
+        case REQUEST__ACTION_PREPARE:
+        result->prepare = action;
+        break;
+
+        case REQUEST__ACTION_EXECUTE:
+        result->execute = action;
+        break;
+
+        case REQUEST__ACTION_DEALLOCATE:
+        result->deallocate = action;
+        break;
+
         default:
         break;
     }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// edge-triggered epoll loop that serves connections by frames: every frame
+// is 4-byte length in network byte order and the data of that length.
+// The loop reads and writes non-blocking sockets into connection buffers
+// and hands complete frames to executor threads, frames of one connection
+// are handled one by one in their order, so do responses.
+struct reactor;
+
+// handles frame of connection: output is set to allocated bytes sent back
+// to client (NULL to send nothing), returns false to close the connection
+// after the output is sent
+typedef bool (* reactor_handler)(const uint8_t * frame, uint32_t size, uint8_t ** output, size_t * output_size, void * context);
+
+// destroys state kept by connection when it is closed
+typedef void (* reactor_state_destructor)(void * state);
+
+
+struct reactor * reactor_new(int server_socket, unsigned int threads, reactor_handler handler,
+    reactor_state_destructor destroy_state, void * context);
+
+// state of connection of the frame handled by the calling thread (NULL
+// at first): it is kept between frames and destroyed with the connection
+void ** reactor_state(void);
+
+// sends allocated output of the frame handled by the calling thread before
+// the handler returns, waits while client has not taken enough of output
+// sent before; returns false when client is gone or reactor stops, or when
+// the client has not taken output in time: the rest of output of the frame
+// is dropped then and connection is closed after the handler returns
+bool reactor_send(uint8_t * output, size_t output_size);
+
+// waits for events and handles them, returns false on wait error;
+// the wait is interrupted by signals caught by the calling thread
+bool reactor_poll(struct reactor * reactor);
+
+// waits for executors and closes connections
+void reactor_delete(struct reactor * reactor);
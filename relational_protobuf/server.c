@@ -9,13 +9,32 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <stdatomic.h>
 
 #include "api.pb-c.h"
 #include "storage.h"
+#include "reactor.h"
+#include "cursors.h"
+#include "aggregate.h"
+#include "sort.h"
 #include "utils.h"
 
 
-static volatile bool closing = false;
+#define STREAM_CHUNK_ROWS (1000)
+#define CURSOR_TIMEOUT (300)
+#define MEMORY_BUDGET (64)
+
+
+static atomic_bool closing = false;
+
+// memory of aggregation and sort of every select before they spill rows to temporary files
+static size_t memory_budget;
+
+// cursors of selects by their ids
+static struct cursors * cursors;
+
+// incremented by every request that changes schema, plans of prepared statements are resolved again after that
+static atomic_uint_fast64_t schema_generation = 0;
 
 static void close_handler(int sig, siginfo_t * info, void * context) {
     closing = true;
@@ -43,6 +62,35 @@ static void make_success_amount_response(uint64_t amount, Response * response) {
     success_response->amount = amount;
 }
 
+// packs response into frame: its length in network byte order and the response
+static uint8_t * pack_response(const Response * response, size_t * frame_size) {
+    size_t response_size = response__get_packed_size(response);
+    if ((int64_t) response_size > (int64_t) UINT32_MAX) {
+        printf("Response is too long: %zu bytes.\n", response_size);
+
+        response_size = 0;
+    }
+
+    uint8_t * const response_buffer = malloc(sizeof(uint32_t) + response_size);
+    if (!response_buffer) {
+        return NULL;
+    }
+
+    if (response_size > 0) {
+        response_size = response__pack(response, response_buffer + sizeof(uint32_t));
+    }
+
+    const uint32_t response_size_n = htonl((uint32_t) response_size);
+    memcpy(response_buffer, &response_size_n, sizeof(response_size_n));
+
+    if (response_size > 0) {
+        printf("Sent response of %zu bytes.\n", response_size);
+    }
+
+    *frame_size = sizeof(uint32_t) + response_size;
+    return response_buffer;
+}
+
 static const char * print_Value_type(const Value * value) {
     switch (value->value_case) {
         case VALUE__VALUE__NOT_SET:
@@ -60,12 +108,15 @@ static const char * print_Value_type(const Value * value) {
         case VALUE__VALUE_STR:
             return "str";
 
+        case VALUE__VALUE_PARAMETER:
+            return "parameter";
+
         default:
             return NULL;
     }
 }
 
-static Value * make_Value_from_value(struct storage_value * value) {
+static Value * make_Value_from_kept_value(const struct storage_value * value) {
     Value * const result = malloc(sizeof(Value));
 
     value__init(result);
@@ -97,11 +148,19 @@ static Value * make_Value_from_value(struct storage_value * value) {
             break;
     }
 
+    return result;
+}
+
+static Value * make_Value_from_value(struct storage_value * value) {
+    Value * const result = make_Value_from_kept_value(value);
+
     storage_value_delete(value);
     return result;
 }
 
 static const struct storage_value * make_value_from_Value(const Value * value, struct storage_value * container) {
+    container->view = false;
+
     switch (value->value_case) {
         case VALUE__VALUE_INT:
             container->type = STORAGE_COLUMN_TYPE_INT;
@@ -137,6 +196,8 @@ static void handle_request_create_table(const CreateTableRequest * request, stru
     table->position = 0;
     table->next = 0;
     table->first_row = 0;
+    table->format = request->has_columnar && request->columnar ? STORAGE_TABLE_FORMAT_COLUMNAR : STORAGE_TABLE_FORMAT_INLINE;
+    table->compressed = request->has_compressed && request->compressed;
     table->name = strdup(request->table);
     table->columns.amount = request->n_columns;
     table->columns.columns = malloc(sizeof(*table->columns.columns) * request->n_columns);
@@ -144,6 +205,21 @@ static void handle_request_create_table(const CreateTableRequest * request, stru
     for (int i = 0; i < request->n_columns; ++i) {
         table->columns.columns[i].name = strdup(request->columns[i]->name);
         table->columns.columns[i].type = (enum storage_column_type) request->columns[i]->type;
+        table->columns.columns[i].dictionary = request->columns[i]->has_dictionary && request->columns[i]->dictionary;
+
+        if (table->columns.columns[i].dictionary && table->columns.columns[i].type != STORAGE_COLUMN_TYPE_STR) {
+            // names of the next columns are not set yet
+            table->columns.amount = i + 1;
+            storage_table_delete(table);
+            make_error_response("only str columns can have dictionary", response);
+            return;
+        }
+    }
+
+    if (table->compressed && table->format != STORAGE_TABLE_FORMAT_COLUMNAR) {
+        storage_table_delete(table);
+        make_error_response("only columnar tables can be compressed", response);
+        return;
     }
 
     errno = 0;
@@ -189,17 +265,9 @@ static bool map_columns_to_indexes(unsigned int request_columns_amount, char **
         }
     } else {
         for (unsigned int i = 0; i < columns_count; ++i) {
-            bool found = false;
-
-            for (unsigned int j = 0; j < table_columns_amount; ++j) {
-                if (strcmp(request_columns_names[i], storage_joined_table_get_column(table, j).name) == 0) {
-                    (*columns_indexes)[i] = j;
-                    found = true;
-                    break;
-                }
-            }
+            const int index = storage_joined_table_find_column(table, request_columns_names[i]);
 
-            if (!found) {
+            if (index < 0) {
                 size_t msg_length = 41 + strlen(request_columns_names[i]);
 
                 char msg[msg_length];
@@ -208,6 +276,8 @@ static bool map_columns_to_indexes(unsigned int request_columns_amount, char **
                 make_error_response(msg, response);
                 return false;
             }
+
+            (*columns_indexes)[i] = index;
         }
     }
 
@@ -297,638 +367,2079 @@ static bool check_values(unsigned int request_values_amount, Value ** request_va
     return true;
 }
 
-static void handle_request_insert(const InsertRequest * request, struct storage * storage, Response * response) {
-    struct storage_table * table = storage_find_table(storage, request->table);
+static const WhereValueOp * get_where_value_op(const WhereExpr * where) {
+    switch (where->op_case) {
+        case WHERE_EXPR__OP_EQ:
+            return where->eq;
 
-    if (!table) {
-        make_error_response("table with the specified name is not exists", response);
-        return;
+        case WHERE_EXPR__OP_NE:
+            return where->ne;
+
+        case WHERE_EXPR__OP_LT:
+            return where->lt;
+
+        case WHERE_EXPR__OP_GT:
+            return where->gt;
+
+        case WHERE_EXPR__OP_LE:
+            return where->le;
+
+        case WHERE_EXPR__OP_GE:
+            return where->ge;
+
+        default:
+            return NULL;
     }
+}
 
-    unsigned int columns_amount;
-    unsigned int * columns_indexes;
-    struct storage_joined_table * joined_table = storage_joined_table_wrap(table);
+// targets of jumps that terminate where program
+#define WHERE_ACCEPT (-1)
+#define WHERE_REJECT (-2)
 
-    if (!map_columns_to_indexes(request->n_columns, request->columns, joined_table, &columns_amount, &columns_indexes, response)) {
-        storage_joined_table_delete(joined_table);
-        return;
+typedef uint8_t (* where_comparator)(const struct storage_value * left, const struct storage_value * right);
+
+// where expression compiled against the columns of joined table,
+// leaves are laid out left to right and "and"/"or" are turned into jumps
+struct where_program {
+    unsigned int amount;
+
+    struct where_instruction {
+        uint16_t table;
+        uint16_t column;
+
+        where_comparator compare;
+        struct storage_value value;
+
+        uint8_t null_outcome;
+        uint8_t accepted;
+
+        int on_true;
+        int on_false;
+    } * instructions;
+};
+
+static uint8_t where_compare_int(int64_t left, int64_t right) {
+    return left < right ? STORAGE_OUTCOME_LESS : left > right ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+}
+
+static uint8_t where_compare_uint(uint64_t left, uint64_t right) {
+    return left < right ? STORAGE_OUTCOME_LESS : left > right ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+}
+
+static uint8_t where_compare_num(double left, double right) {
+    if (left < right) {
+        return STORAGE_OUTCOME_LESS;
     }
 
-    if (!check_values(request->n_values, request->values, table, columns_amount, columns_indexes, response)) {
-        free(columns_indexes);
-        storage_joined_table_delete(joined_table);
-        return;
+    if (left > right) {
+        return STORAGE_OUTCOME_GREATER;
     }
 
-    struct storage_row * row = storage_table_add_row(table);
-    for (unsigned int i = 0; i < columns_amount; ++i) {
-        struct storage_value value;
+    return left == right ? STORAGE_OUTCOME_EQUAL : STORAGE_OUTCOME_UNORDERED;
+}
 
-        storage_row_set_value(row, columns_indexes[i], make_value_from_Value(request->values[i], &value));
+static uint8_t where_compare_int_int(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_int(left->value._int, right->value._int);
+}
 
-        storage_value_destroy(value);
+static uint8_t where_compare_int_uint(const struct storage_value * left, const struct storage_value * right) {
+    if (left->value._int < 0) {
+        return STORAGE_OUTCOME_LESS;
     }
 
-    free(columns_indexes);
-    storage_row_delete(row);
-    storage_joined_table_delete(joined_table);
+    return where_compare_uint((uint64_t) left->value._int, right->value.uint);
+}
 
-    make_success_response(response);
+static uint8_t where_compare_int_num(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num((double) left->value._int, right->value.num);
 }
 
-static bool is_where_correct(const struct storage_joined_table * table, const WhereExpr * where, Response * response) {
-    if (!where) {
-        return true;
+static uint8_t where_compare_uint_int(const struct storage_value * left, const struct storage_value * right) {
+    if (right->value._int < 0) {
+        return STORAGE_OUTCOME_GREATER;
     }
 
-    const uint16_t table_columns_amount = storage_joined_table_get_columns_amount(table);
-    const WhereValueOp * where_value_op;
-    const WhereExprOp * where_expr_op;
+    return where_compare_uint(left->value.uint, (uint64_t) right->value._int);
+}
 
-    switch (where->op_case) {
-        case WHERE_EXPR__OP_EQ:
-            where_value_op = where->eq;
-            break;
+static uint8_t where_compare_uint_uint(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_uint(left->value.uint, right->value.uint);
+}
 
-        case WHERE_EXPR__OP_NE:
-            where_value_op = where->ne;
-            break;
+static uint8_t where_compare_uint_num(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num((double) left->value.uint, right->value.num);
+}
 
-        case WHERE_EXPR__OP_LT:
-            where_value_op = where->lt;
-            break;
+static uint8_t where_compare_num_int(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num(left->value.num, (double) right->value._int);
+}
 
-        case WHERE_EXPR__OP_GT:
-            where_value_op = where->gt;
-            break;
+static uint8_t where_compare_num_uint(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num(left->value.num, (double) right->value.uint);
+}
 
-        case WHERE_EXPR__OP_LE:
-            where_value_op = where->le;
-            break;
+static uint8_t where_compare_num_num(const struct storage_value * left, const struct storage_value * right) {
+    return where_compare_num(left->value.num, right->value.num);
+}
 
-        case WHERE_EXPR__OP_GE:
-            where_value_op = where->ge;
-            break;
+static uint8_t where_compare_str_str(const struct storage_value * left, const struct storage_value * right) {
+    const int result = strcmp(left->value.str, right->value.str);
+
+    return result < 0 ? STORAGE_OUTCOME_LESS : result > 0 ? STORAGE_OUTCOME_GREATER : STORAGE_OUTCOME_EQUAL;
+}
+
+// comparison of any not NULL cell with NULL
+static uint8_t where_compare_any_null(const struct storage_value * left, const struct storage_value * right) {
+    return STORAGE_OUTCOME_GREATER;
+}
+
+static where_comparator where_get_comparator(enum storage_column_type left, enum storage_column_type right) {
+    static const where_comparator comparators[4][4] = {
+        [STORAGE_COLUMN_TYPE_INT] = {
+            [STORAGE_COLUMN_TYPE_INT] = where_compare_int_int,
+            [STORAGE_COLUMN_TYPE_UINT] = where_compare_int_uint,
+            [STORAGE_COLUMN_TYPE_NUM] = where_compare_int_num,
+        },
+        [STORAGE_COLUMN_TYPE_UINT] = {
+            [STORAGE_COLUMN_TYPE_INT] = where_compare_uint_int,
+            [STORAGE_COLUMN_TYPE_UINT] = where_compare_uint_uint,
+            [STORAGE_COLUMN_TYPE_NUM] = where_compare_uint_num,
+        },
+        [STORAGE_COLUMN_TYPE_NUM] = {
+            [STORAGE_COLUMN_TYPE_INT] = where_compare_num_int,
+            [STORAGE_COLUMN_TYPE_UINT] = where_compare_num_uint,
+            [STORAGE_COLUMN_TYPE_NUM] = where_compare_num_num,
+        },
+        [STORAGE_COLUMN_TYPE_STR] = {
+            [STORAGE_COLUMN_TYPE_STR] = where_compare_str_str,
+        },
+    };
+
+    return comparators[left][right];
+}
+
+// splits index of joined table column into index of table and index of column in it
+static void where_locate_column(const struct storage_joined_table * table, int index, struct where_instruction * instruction) {
+    uint16_t i = 0;
 
+    while (index >= table->tables.tables[i].table->columns.amount) {
+        index -= table->tables.tables[i].table->columns.amount;
+        ++i;
+    }
+
+    instruction->table = i;
+    instruction->column = (uint16_t) index;
+}
+
+static unsigned int count_where_comparisons(const WhereExpr * where) {
+    switch (where->op_case) {
         case WHERE_EXPR__OP_AND:
-            where_expr_op = where->and_;
-            break;
+            return count_where_comparisons(where->and_->left) + count_where_comparisons(where->and_->right);
 
         case WHERE_EXPR__OP_OR:
-            where_expr_op = where->or_;
-            break;
+            return count_where_comparisons(where->or_->left) + count_where_comparisons(where->or_->right);
 
         default:
-            make_error_response("bad request", response);
-            return false;
+            return 1;
     }
+}
 
+static bool compile_where_expr(const struct storage_joined_table * table, const WhereExpr * where,
+        struct where_instruction * instructions, int position, int on_true, int on_false, Response * response) {
     switch (where->op_case) {
-        case WHERE_EXPR__OP_EQ:
-        case WHERE_EXPR__OP_NE:
-            if (where_value_op->value->value_case == VALUE__VALUE__NOT_SET) {
-                return true;
+        case WHERE_EXPR__OP_AND:
+            {
+                const int right = position + (int) count_where_comparisons(where->and_->left);
+
+                return compile_where_expr(table, where->and_->left, instructions, position, right, on_false, response)
+                    && compile_where_expr(table, where->and_->right, instructions, right, on_true, on_false, response);
             }
 
-        case WHERE_EXPR__OP_LT:
-        case WHERE_EXPR__OP_GT:
-        case WHERE_EXPR__OP_LE:
-        case WHERE_EXPR__OP_GE:
-            if (where_value_op->value->value_case == VALUE__VALUE__NOT_SET) {
-                make_error_response("NULL value is not comparable", response);
-                return false;
+        case WHERE_EXPR__OP_OR:
+            {
+                const int right = position + (int) count_where_comparisons(where->or_->left);
+
+                return compile_where_expr(table, where->or_->left, instructions, position, on_true, right, response)
+                    && compile_where_expr(table, where->or_->right, instructions, right, on_true, on_false, response);
             }
 
-            for (unsigned int i = 0; i < table_columns_amount; ++i) {
-                struct storage_column column = storage_joined_table_get_column(table, i);
+        default:
+            break;
+    }
 
-                if (strcmp(column.name, where_value_op->column) == 0) {
-                    switch (column.type) {
-                        case STORAGE_COLUMN_TYPE_INT:
-                        case STORAGE_COLUMN_TYPE_UINT:
-                        case STORAGE_COLUMN_TYPE_NUM:
-                            switch (where_value_op->value->value_case) {
-                                case VALUE__VALUE_INT:
-                                case VALUE__VALUE_UINT:
-                                case VALUE__VALUE_NUM:
-                                    return true;
+    const WhereValueOp * const where_value_op = get_where_value_op(where);
 
-                                default:
-                                    break;
-                            }
+    if (!where_value_op) {
+        make_error_response("bad request", response);
+        return false;
+    }
 
-                            break;
+    const int index = storage_joined_table_find_column(table, where_value_op->column);
 
-                        case STORAGE_COLUMN_TYPE_STR:
-                            if (where_value_op->value->value_case == VALUE__VALUE_STR) {
-                                return true;
-                            }
+    if (index < 0) {
+        const size_t msg_length = 41 + strlen(where_value_op->column);
 
-                            break;
-                    }
+        char msg[msg_length];
+        snprintf(msg, msg_length, "column with name %s is not exists in table", where_value_op->column);
+        make_error_response(msg, response);
+        return false;
+    }
 
-                    const char * const column_type = storage_column_type_to_string(column.type);
-                    const char * const value_type = print_Value_type(where_value_op->value);
-                    const size_t msg_length = 31 + strlen(column_type) + strlen(value_type);
+    struct where_instruction * const instruction = &instructions[position];
+    where_locate_column(table, index, instruction);
 
-                    char msg[msg_length];
-                    snprintf(msg, msg_length, "types %s and %s are not comparable", column_type, value_type);
-                    make_error_response(msg, response);
-                    return false;
-                }
-            }
+    instruction->on_true = on_true;
+    instruction->on_false = on_false;
 
-            {
-                const size_t msg_length = 41 + strlen(where_value_op->column);
+    switch (where->op_case) {
+        case WHERE_EXPR__OP_EQ:
+            instruction->accepted = STORAGE_OUTCOME_EQUAL;
+            break;
 
-                char msg[msg_length];
-                snprintf(msg, msg_length, "column with name %s is not exists in table", where_value_op->column);
-                make_error_response(msg, response);
-                return false;
-            }
+        case WHERE_EXPR__OP_NE:
+            instruction->accepted = STORAGE_OUTCOME_LESS | STORAGE_OUTCOME_GREATER | STORAGE_OUTCOME_UNORDERED | STORAGE_OUTCOME_NULL;
+            break;
 
-        case WHERE_EXPR__OP_AND:
-        case WHERE_EXPR__OP_OR:
-            return is_where_correct(table, where_expr_op->left, response)
-                && is_where_correct(table, where_expr_op->right, response);
+        case WHERE_EXPR__OP_LT:
+            instruction->accepted = STORAGE_OUTCOME_LESS;
+            break;
+
+        case WHERE_EXPR__OP_GT:
+            instruction->accepted = STORAGE_OUTCOME_GREATER;
+            break;
+
+        case WHERE_EXPR__OP_LE:
+            instruction->accepted = STORAGE_OUTCOME_LESS | STORAGE_OUTCOME_EQUAL | STORAGE_OUTCOME_UNORDERED;
+            break;
+
+        case WHERE_EXPR__OP_GE:
+            instruction->accepted = STORAGE_OUTCOME_GREATER | STORAGE_OUTCOME_EQUAL | STORAGE_OUTCOME_UNORDERED;
+            break;
 
         default:
-            return false; // unreachable
+            break; // unreachable
     }
+
+    return true;
 }
 
-static bool compare_values_not_null(WhereExpr__OpCase op, struct storage_value left, const Value * right) {
-    switch (op) {
-        case WHERE_EXPR__OP_EQ:
-            switch (left.type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            return left.value._int == right->int_;
+// compiles where against columns of joined table, values are put into program by bind_where; returns false on error
+static bool compile_where(const struct storage_joined_table * table, const WhereExpr * where,
+        struct where_program * program, Response * response) {
+    program->amount = where ? count_where_comparisons(where) : 0;
+    program->instructions = malloc(sizeof(struct where_instruction) * program->amount);
 
-                        case VALUE__VALUE_UINT:
-                            if (left.value._int < 0) {
-                                return false;
-                            }
+    // instructions without value are destroyed as comparisons with NULL
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        program->instructions[i].compare = where_compare_any_null;
+    }
 
-                            return ((uint64_t) left.value._int) == right->uint;
+    return !where || compile_where_expr(table, where, program->instructions, 0, WHERE_ACCEPT, WHERE_REJECT, response);
+}
 
-                        case VALUE__VALUE_NUM:
-                            return ((double) left.value._int) == right->num;
+static bool bind_where_expr(const struct storage_joined_table * table, const WhereExpr * where,
+        struct where_instruction * instructions, unsigned int * position, Response * response) {
+    switch (where->op_case) {
+        case WHERE_EXPR__OP_AND:
+            return bind_where_expr(table, where->and_->left, instructions, position, response)
+                && bind_where_expr(table, where->and_->right, instructions, position, response);
 
-                        default:
-                            return false;
-                    }
+        case WHERE_EXPR__OP_OR:
+            return bind_where_expr(table, where->or_->left, instructions, position, response)
+                && bind_where_expr(table, where->or_->right, instructions, position, response);
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            if (right->int_ < 0) {
-                                return false;
-                            }
+        default:
+            break;
+    }
 
-                            return left.value.uint == ((uint64_t) right->int_);
+    const WhereValueOp * const where_value_op = get_where_value_op(where);
+    struct where_instruction * const instruction = &instructions[(*position)++];
 
-                        case VALUE__VALUE_UINT:
-                            return left.value.uint == right->uint;
+    if (instruction->compare != where_compare_any_null) {
+        storage_value_destroy(instruction->value);
+    }
 
-                        case VALUE__VALUE_NUM:
-                            return ((double) left.value.uint) == right->num;
+    instruction->compare = where_compare_any_null;
+    instruction->null_outcome = STORAGE_OUTCOME_EQUAL;
 
-                        default:
-                            return false;
-                    }
+    if (where_value_op->value->value_case == VALUE__VALUE__NOT_SET) {
+        if (where->op_case != WHERE_EXPR__OP_EQ && where->op_case != WHERE_EXPR__OP_NE) {
+            make_error_response("NULL value is not comparable", response);
+            return false;
+        }
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            return left.value.num == ((double) right->int_);
+        return true;
+    }
 
-                        case VALUE__VALUE_UINT:
-                            return left.value.num == ((double) right->uint);
+    const enum storage_column_type type = table->tables.tables[instruction->table].table->columns.columns[instruction->column].type;
 
-                        case VALUE__VALUE_NUM:
-                            return left.value.num == right->num;
+    struct storage_value value;
+    const bool converted = make_value_from_Value(where_value_op->value, &value) != NULL;
+    const where_comparator compare = converted ? where_get_comparator(type, value.type) : NULL;
 
-                        default:
-                            return false;
-                    }
+    if (!compare) {
+        if (converted) {
+            storage_value_destroy(value);
+        }
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    if (right->value_case == VALUE__VALUE_STR) {
-                        return strcmp(left.value.str, right->str) == 0;
-                    } else {
-                        return false;
-                    }
-            }
+        const char * const column_type = storage_column_type_to_string(type);
+        const char * const value_type = print_Value_type(where_value_op->value);
+        const size_t msg_length = 31 + strlen(column_type) + strlen(value_type);
 
-        case WHERE_EXPR__OP_NE:
-            return !compare_values_not_null(WHERE_EXPR__OP_EQ, left, right);
+        char msg[msg_length];
+        snprintf(msg, msg_length, "types %s and %s are not comparable", column_type, value_type);
+        make_error_response(msg, response);
+        return false;
+    }
 
-        case WHERE_EXPR__OP_LT:
-            switch (left.type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            return left.value._int < right->int_;
+    instruction->compare = compare;
+    instruction->value = value;
+    instruction->null_outcome = STORAGE_OUTCOME_NULL;
+    return true;
+}
 
-                        case VALUE__VALUE_UINT:
-                            if (left.value._int < 0) {
-                                return true;
-                            }
+// puts values of where into its compiled program, they must be comparable with their columns;
+// program keeps copies of values, the previously bound ones are destroyed; returns false on error
+static bool bind_where(const struct storage_joined_table * table, const WhereExpr * where,
+        struct where_program * program, Response * response) {
+    unsigned int position = 0;
 
-                            return ((uint64_t) left.value._int) < right->uint;
+    return !where || bind_where_expr(table, where, program->instructions, &position, response);
+}
 
-                        case VALUE__VALUE_NUM:
-                            return ((double) left.value._int) < right->num;
+static bool eval_where(const struct storage_joined_row * row, const struct where_program * program) {
+    int position = program->amount > 0 ? 0 : WHERE_ACCEPT;
 
-                        default:
-                            return false;
-                    }
+    while (position >= 0) {
+        const struct where_instruction * const instruction = &program->instructions[position];
+        struct storage_value * const value = storage_row_get_value(row->rows[instruction->table], instruction->column);
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            if (right->int_ < 0) {
-                                return false;
-                            }
+        const uint8_t outcome = value ? instruction->compare(value, &instruction->value) : instruction->null_outcome;
+        storage_value_delete(value);
 
-                            return left.value.uint < ((uint64_t) right->int_);
+        position = (outcome & instruction->accepted) ? instruction->on_true : instruction->on_false;
+    }
 
-                        case VALUE__VALUE_UINT:
-                            return left.value.uint < right->uint;
+    return position == WHERE_ACCEPT;
+}
 
-                        case VALUE__VALUE_NUM:
-                            return ((double) left.value.uint) < right->num;
+static void destroy_where_program(struct where_program program) {
+    for (unsigned int i = 0; i < program.amount; ++i) {
+        if (program.instructions[i].compare != where_compare_any_null) {
+            storage_value_destroy(program.instructions[i].value);
+        }
+    }
 
-                        default:
-                            return false;
-                    }
+    free(program.instructions);
+}
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            return left.value.num < ((double) right->int_);
+// iterates rows of joined table where program is true: single table is read
+// by parallel scan of batches filtered by whole vectors, joined tables are read row by row
+struct where_scan {
+    struct storage_joined_table * table;
+    const struct where_program * program;
 
-                        case VALUE__VALUE_UINT:
-                            return left.value.num < ((double) right->uint);
+    bool started;
+    struct storage_joined_row * row;
 
-                        case VALUE__VALUE_NUM:
-                            return left.value.num < right->num;
+    // vector of batch compared by every instruction
+    uint16_t * vectors;
 
-                        default:
-                            return false;
-                    }
+    // rows are taken from job by morsels or selected at once
+    struct storage_scan_job * job;
+    struct storage_index_scan * selection;
+    struct storage_index_scan morsel;
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    if (right->value_case == VALUE__VALUE_STR) {
-                        return strcmp(left.value.str, right->str) < 0;
-                    } else {
-                        return false;
-                    }
+    // the current selected row wrapped into joined row
+    struct storage_row * selected_row;
+    struct storage_joined_row selected_joined_row;
+};
 
-            }
+// tells whether rows of row group may satisfy program: comparisons are replaced
+// by outcomes possible for cells bounded by zone maps and jumps are followed for both results
+static bool where_scan_may_match(const struct storage_batch * batch, const struct storage_zone * zones, void * context) {
+    const struct where_scan * const scan = context;
+    const struct where_program * const program = scan->program;
 
-        case WHERE_EXPR__OP_GT:
-            switch (left.type) {
-                case STORAGE_COLUMN_TYPE_INT:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            return left.value._int > right->int_;
+    if (program->amount == 0) {
+        return true;
+    }
 
-                        case VALUE__VALUE_UINT:
-                            if (left.value._int < 0) {
-                                return false;
-                            }
+    bool reachable[program->amount];
+    memset(reachable, 0, sizeof(reachable));
+    reachable[0] = true;
 
-                            return ((uint64_t) left.value._int) > right->uint;
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        if (!reachable[i]) {
+            continue;
+        }
 
-                        case VALUE__VALUE_NUM:
-                            return ((double) left.value._int) > right->num;
+        const struct where_instruction * const instruction = &program->instructions[i];
+        const bool is_null = instruction->compare == where_compare_any_null;
+        const uint16_t vector = scan->vectors[i];
 
-                        default:
-                            return false;
-                    }
+        const uint8_t outcomes = storage_zone_get_outcomes(&zones[vector], batch->columns.vectors[vector].type,
+            is_null ? NULL : &instruction->value);
 
-                case STORAGE_COLUMN_TYPE_UINT:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            if (right->int_ < 0) {
-                                return true;
-                            }
+        const int targets[] = {
+            (outcomes & instruction->accepted) ? instruction->on_true : WHERE_REJECT,
+            (outcomes & ~instruction->accepted) ? instruction->on_false : WHERE_REJECT,
+        };
 
-                            return left.value.uint > ((uint64_t) right->int_);
+        for (int j = 0; j < 2; ++j) {
+            if (targets[j] == WHERE_ACCEPT) {
+                return true;
+            }
 
-                        case VALUE__VALUE_UINT:
-                            return left.value.uint > right->uint;
+            if (targets[j] >= 0) {
+                reachable[targets[j]] = true;
+            }
+        }
+    }
 
-                        case VALUE__VALUE_NUM:
-                            return ((double) left.value.uint) > right->num;
+    return false;
+}
 
-                        default:
-                            return false;
-                    }
+// selects rows of batch where program is true: every instruction compares
+// whole vector and moves rows waiting on it by its jumps, which only go forward
+static void eval_where_batch(struct storage_batch * batch, void * context) {
+    const struct where_scan * const scan = context;
+    const struct where_program * const program = scan->program;
 
-                case STORAGE_COLUMN_TYPE_NUM:
-                    switch (right->value_case) {
-                        case VALUE__VALUE_INT:
-                            return left.value.num > ((double) right->int_);
+    int positions[STORAGE_BATCH_ROWS];
+    uint8_t result[STORAGE_BATCH_ROWS];
 
-                        case VALUE__VALUE_UINT:
-                            return left.value.num > ((double) right->uint);
+    for (uint32_t j = 0; j < batch->amount; ++j) {
+        positions[j] = program->amount > 0 ? 0 : WHERE_ACCEPT;
+    }
 
-                        case VALUE__VALUE_NUM:
-                            return left.value.num > right->num;
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        const struct where_instruction * const instruction = &program->instructions[i];
+        const bool is_null = instruction->compare == where_compare_any_null;
 
-                        default:
-                            return false;
-                    }
+        storage_batch_compare(batch, scan->vectors[i], is_null ? NULL : &instruction->value, instruction->accepted, result);
 
-                case STORAGE_COLUMN_TYPE_STR:
-                    if (right->value_case == VALUE__VALUE_STR) {
-                        return strcmp(left.value.str, right->str) > 0;
-                    } else {
-                        return false;
-                    }
+        for (uint32_t j = 0; j < batch->amount; ++j) {
+            if (positions[j] == (int) i) {
+                positions[j] = result[j] ? instruction->on_true : instruction->on_false;
             }
+        }
+    }
 
-        case WHERE_EXPR__OP_LE:
-            return !compare_values_not_null(WHERE_EXPR__OP_GT, left, right);
-
-        case WHERE_EXPR__OP_GE:
-            return !compare_values_not_null(WHERE_EXPR__OP_LT, left, right);
-
-        default:
-            return false;
+    batch->selected = 0;
+    for (uint32_t j = 0; j < batch->amount; ++j) {
+        if (positions[j] == WHERE_ACCEPT) {
+            batch->selection[batch->selected++] = (uint16_t) j;
+        }
     }
 }
 
-static bool compare_values(WhereExpr__OpCase op, struct storage_value * left, const Value * right) {
-    switch (op) {
-        case WHERE_EXPR__OP_EQ:
-            if (left == NULL || right->value_case == VALUE__VALUE__NOT_SET) {
-                return left == NULL && right->value_case == VALUE__VALUE__NOT_SET;
-            }
-
-            break;
+// scan stops after limit rows (0 for no limit), rows of single table are selected
+// at once for modifying requests, since scan threads must not read them while they are written
+static void init_where_scan(struct where_scan * scan, struct storage_joined_table * table,
+        const struct where_program * program, uint64_t limit, bool modifying) {
+    scan->table = table;
+    scan->program = program;
+    scan->started = false;
+    scan->row = NULL;
+    scan->vectors = NULL;
+    scan->job = NULL;
+    scan->selection = NULL;
+    scan->morsel.table = table->tables.tables[0].table;
+    scan->morsel.amount = 0;
+    scan->morsel.rows = NULL;
+    scan->selected_row = NULL;
+
+    if (table->tables.amount > 1) {
+        return;
+    }
 
-        case WHERE_EXPR__OP_NE:
-            if (left == NULL || right->value_case == VALUE__VALUE__NOT_SET) {
-                return (left == NULL) != (right->value_case == VALUE__VALUE__NOT_SET);
-            }
+    uint16_t columns_amount = 0;
+    uint16_t * const columns = malloc(sizeof(uint16_t) * program->amount);
+    scan->vectors = malloc(sizeof(uint16_t) * program->amount);
 
-            break;
+    for (unsigned int i = 0; i < program->amount; ++i) {
+        const uint16_t column = program->instructions[i].column;
 
-        case WHERE_EXPR__OP_LT:
-        case WHERE_EXPR__OP_GT:
-        case WHERE_EXPR__OP_LE:
-        case WHERE_EXPR__OP_GE:
-            if (left == NULL || right->value_case == VALUE__VALUE__NOT_SET) {
-                return false;
-            }
+        uint16_t vector = 0;
+        while (vector < columns_amount && columns[vector] != column) {
+            ++vector;
+        }
 
-            break;
+        if (vector == columns_amount) {
+            columns[columns_amount++] = column;
+        }
 
-        default:
-            return false;
+        scan->vectors[i] = vector;
     }
 
-    return compare_values_not_null(op, *left, right);
-}
+    if (modifying) {
+        scan->selection = storage_table_select(table->tables.tables[0].table, table->tables.tables[0].scan,
+            columns_amount, columns, where_scan_may_match, eval_where_batch, scan, limit);
 
-static bool eval_where(const struct storage_joined_row * row, const WhereExpr * where) {
-    if (!where) {
-        return true;
+        scan->morsel = *scan->selection;
+    } else {
+        scan->job = storage_table_scan_parallel(table->tables.tables[0].table, table->tables.tables[0].scan,
+            columns_amount, columns, where_scan_may_match, eval_where_batch, scan, limit);
     }
 
-    const uint16_t table_columns_amount = storage_joined_table_get_columns_amount(row->table);
+    free(columns);
 
-    const WhereValueOp *  where_value_op;
-    switch (where->op_case) {
-        case WHERE_EXPR__OP_EQ:
-            where_value_op = where->eq;
+    scan->selected_joined_row.table = table;
+    scan->selected_joined_row.rows = &scan->selected_row;
+    scan->selected_joined_row.matches = NULL;
+}
+
+// returned row is valid until the next call
+static struct storage_joined_row * where_scan_next(struct where_scan * scan) {
+    if (scan->table->tables.amount > 1) {
+        if (!scan->started) {
+            scan->started = true;
+            scan->row = storage_joined_table_get_first_row(scan->table);
+        } else if (scan->row) {
+            scan->row = storage_joined_row_next(scan->row);
+        }
+
+        while (scan->row && !eval_where(scan->row, scan->program)) {
+            scan->row = storage_joined_row_next(scan->row);
+        }
+
+        return scan->row;
+    }
+
+    if (!scan->started) {
+        scan->started = true;
+        scan->selected_row = storage_index_scan_get_first_row(&scan->morsel);
+    } else if (scan->selected_row) {
+        scan->selected_row = storage_row_next(scan->selected_row);
+    }
+
+    while (!scan->selected_row && scan->job && storage_scan_job_next(scan->job, &scan->morsel)) {
+        scan->selected_row = storage_index_scan_get_first_row(&scan->morsel);
+    }
+
+    return scan->selected_row ? &scan->selected_joined_row : NULL;
+}
+
+static void destroy_where_scan(struct where_scan * scan) {
+    storage_joined_row_delete(scan->row);
+    storage_row_delete(scan->selected_row);
+    storage_scan_job_delete(scan->job);
+    storage_index_scan_delete(scan->selection);
+    free(scan->vectors);
+}
+
+// returns indexed column of the first table compared with a value in conjunction of where,
+// position is of the first comparison of where in its compiled program
+static int find_indexed_column(const struct storage_joined_table * table, const WhereExpr * where,
+    const struct where_program * program, unsigned int position) {
+    switch (where->op_case) {
+        case WHERE_EXPR__OP_EQ:
+        case WHERE_EXPR__OP_LT:
+        case WHERE_EXPR__OP_GT:
+        case WHERE_EXPR__OP_LE:
+        case WHERE_EXPR__OP_GE:
+            {
+                const struct where_instruction * const instruction = &program->instructions[position];
+
+                if (instruction->compare != where_compare_any_null && instruction->table == 0
+                    && storage_table_has_index(table->tables.tables[0].table, instruction->column)) {
+                    return instruction->column;
+                }
+
+                return -1;
+            }
+
+        case WHERE_EXPR__OP_AND:
+            {
+                const int column = find_indexed_column(table, where->and_->left, program, position);
+
+                return column >= 0 ? column
+                    : find_indexed_column(table, where->and_->right, program, position + count_where_comparisons(where->and_->left));
+            }
+
+        default:
+            return -1;
+    }
+}
+
+struct index_bound {
+    const struct storage_value * value;
+    bool inclusive;
+};
+
+// keeps the tighter bound, direction is 1 for low bound and -1 for high bound
+static void set_index_bound(struct index_bound * bound, const struct storage_value * value, bool inclusive, int direction) {
+    if (bound->value) {
+        const int result = storage_value_compare(value, bound->value) * direction;
+
+        if (result < 0 || (result == 0 && inclusive)) {
+            return;
+        }
+    }
+
+    bound->value = value;
+    bound->inclusive = inclusive;
+}
+
+static void narrow_index_bounds(const WhereExpr * where, const struct where_program * program, unsigned int position,
+    int column, struct index_bound * low, struct index_bound * high) {
+    if (where->op_case == WHERE_EXPR__OP_AND) {
+        narrow_index_bounds(where->and_->left, program, position, column, low, high);
+        narrow_index_bounds(where->and_->right, program, position + count_where_comparisons(where->and_->left), column, low, high);
+        return;
+    }
+
+    if (where->op_case == WHERE_EXPR__OP_OR) {
+        return;
+    }
+
+    const struct where_instruction * const instruction = &program->instructions[position];
+
+    if (instruction->compare == where_compare_any_null || instruction->table != 0 || instruction->column != column) {
+        return;
+    }
+
+    switch (where->op_case) {
+        case WHERE_EXPR__OP_EQ:
+            set_index_bound(low, &instruction->value, true, 1);
+            set_index_bound(high, &instruction->value, true, -1);
+            break;
+
+        case WHERE_EXPR__OP_LT:
+            set_index_bound(high, &instruction->value, false, -1);
+            break;
+
+        case WHERE_EXPR__OP_GT:
+            set_index_bound(low, &instruction->value, false, 1);
+            break;
+
+        case WHERE_EXPR__OP_LE:
+            set_index_bound(high, &instruction->value, true, -1);
+            break;
+
+        case WHERE_EXPR__OP_GE:
+            set_index_bound(low, &instruction->value, true, 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// makes the first table iterated by index if where limits its indexed column,
+// where is still evaluated for every found row; columns and values are taken from its bound program
+static void use_index(struct storage_joined_table * table, const WhereExpr * where, const struct where_program * program) {
+    if (!where) {
+        return;
+    }
+
+    const int column = find_indexed_column(table, where, program, 0);
+
+    if (column < 0) {
+        return;
+    }
+
+    struct index_bound low = { NULL, false }, high = { NULL, false };
+    narrow_index_bounds(where, program, 0, column, &low, &high);
+
+    table->tables.tables[0].scan = storage_table_index_scan(table->tables.tables[0].table, column,
+        low.value, low.inclusive, high.value, high.inclusive);
+}
+
+// request resolved against tables of the schema: tables and columns are found by names
+// and where is compiled once, so execute of prepared statement only binds values to it
+struct request_plan {
+    struct storage_joined_table * table;
+
+    // selected or modified columns, keys of selected columns for aggregated select
+    unsigned int columns_amount;
+    unsigned int * columns_indexes;
+
+    struct where_program where;
+
+    // ordered select: columns of orders; orders of sorted rows or groups
+    unsigned int * orders_indexes;
+    struct sort_key * orders;
+
+    // aggregated select: grouped columns, functions of selected aggregates and then of orders,
+    // columns of their arguments (-1 for all rows)
+    unsigned int keys_amount;
+    unsigned int * keys_indexes;
+    unsigned int functions_amount;
+    enum aggregate_function * functions;
+    int * arguments_indexes;
+};
+
+static void init_request_plan(struct request_plan * plan) {
+    plan->table = NULL;
+    plan->columns_amount = 0;
+    plan->columns_indexes = NULL;
+    plan->where.amount = 0;
+    plan->where.instructions = NULL;
+    plan->orders_indexes = NULL;
+    plan->orders = NULL;
+    plan->keys_amount = 0;
+    plan->keys_indexes = NULL;
+    plan->functions_amount = 0;
+    plan->functions = NULL;
+    plan->arguments_indexes = NULL;
+}
+
+// tables of plan are kept by catalog, plan of prepared statement may outlive them
+static void destroy_request_plan(struct request_plan * plan) {
+    if (plan->table) {
+        for (int i = 0; i < plan->table->tables.amount; ++i) {
+            plan->table->tables.tables[i].table = NULL;
+        }
+    }
+
+    storage_joined_table_delete(plan->table);
+    free(plan->columns_indexes);
+    destroy_where_program(plan->where);
+    free(plan->orders_indexes);
+    free(plan->orders);
+    free(plan->keys_indexes);
+    free(plan->functions);
+    free(plan->arguments_indexes);
+}
+
+static bool resolve_insert(const InsertRequest * request, struct storage * storage, struct request_plan * plan, Response * response) {
+    struct storage_table * table = storage_find_table(storage, request->table);
+
+    if (!table) {
+        make_error_response("table with the specified name is not exists", response);
+        return false;
+    }
+
+    plan->table = storage_joined_table_wrap(table);
+
+    return map_columns_to_indexes(request->n_columns, request->columns, plan->table,
+        &plan->columns_amount, &plan->columns_indexes, response);
+}
+
+static void run_insert(const InsertRequest * request, struct request_plan * plan, Response * response) {
+    struct storage_table * const table = plan->table->tables.tables[0].table;
+    const unsigned int columns_amount = plan->columns_amount;
+
+    // requests without rows have the only row in values
+    const InsertRequest__Row single_row = { .n_values = request->n_values, .values = request->values };
+    const size_t rows_amount = request->n_rows > 0 ? request->n_rows : 1;
+
+    for (size_t i = 0; i < rows_amount; ++i) {
+        const InsertRequest__Row * const row = request->n_rows > 0 ? request->rows[i] : &single_row;
+
+        if (!check_values(row->n_values, row->values, table, columns_amount, plan->columns_indexes, response)) {
+            return;
+        }
+    }
+
+    // cells of columns that are not in request are NULL
+    struct storage_value * const values = calloc(rows_amount * columns_amount, sizeof(*values));
+    const struct storage_value ** const cells = calloc(rows_amount * table->columns.amount, sizeof(*cells));
+
+    for (size_t i = 0; i < rows_amount; ++i) {
+        const InsertRequest__Row * const row = request->n_rows > 0 ? request->rows[i] : &single_row;
+
+        for (unsigned int j = 0; j < columns_amount; ++j) {
+            cells[i * table->columns.amount + plan->columns_indexes[j]]
+                = make_value_from_Value(row->values[j], &values[i * columns_amount + j]);
+        }
+    }
+
+    storage_table_add_rows(table, rows_amount, cells);
+
+    for (size_t i = 0; i < rows_amount * columns_amount; ++i) {
+        storage_value_destroy(values[i]);
+    }
+
+    free(cells);
+    free(values);
+
+    make_success_amount_response(rows_amount, response);
+}
+
+static bool resolve_delete(const DeleteRequest * request, struct storage * storage, struct request_plan * plan, Response * response) {
+    struct storage_table * const table = storage_find_table(storage, request->table);
+
+    if (!table) {
+        make_error_response("table with the specified name is not exists", response);
+        return false;
+    }
+
+    plan->table = storage_joined_table_wrap(table);
+    return compile_where(plan->table, request->where, &plan->where, response);
+}
+
+static void run_delete(const DeleteRequest * request, struct request_plan * plan, Response * response) {
+    if (!bind_where(plan->table, request->where, &plan->where, response)) {
+        return;
+    }
+
+    use_index(plan->table, request->where, &plan->where);
+
+    struct where_scan scan;
+    init_where_scan(&scan, plan->table, &plan->where, 0, true);
+
+    unsigned long long amount = 0;
+    for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+        storage_row_remove(row->rows[0]);
+        ++amount;
+    }
+
+    destroy_where_scan(&scan);
+    make_success_amount_response(amount, response);
+}
+
+// sends rows of table as a chunk of streamed select and frees them, returns false when client is gone
+// or has not taken previous chunks in time: read locks of select are kept while it waits for client,
+// so a stalled client blocks writers for REACTOR_STREAM_TIMEOUT at most and is disconnected then
+static bool send_table_chunk(Table * table) {
+    SuccessResponse success_response = SUCCESS_RESPONSE__INIT;
+    success_response.value_case = SUCCESS_RESPONSE__VALUE_TABLE;
+    success_response.table = table;
+
+    Response response = RESPONSE__INIT;
+    response.payload_case = RESPONSE__PAYLOAD_SUCCESS;
+    response.success = &success_response;
+
+    size_t frame_size;
+    uint8_t * const frame = pack_response(&response, &frame_size);
+
+    for (size_t i = 0; i < table->n_rows; ++i) {
+        protobuf_c_message_free_unpacked((ProtobufCMessage *) table->rows[i], NULL);
+    }
+
+    table->n_rows = 0;
+    return frame && reactor_send(frame, frame_size);
+}
+
+// joins tables of select request into the plan, returns false on error
+static bool resolve_select_table(const SelectRequest * request, struct storage * storage, struct request_plan * plan, Response * response) {
+    struct storage_table * table = storage_find_table(storage, request->table);
+
+    if (!table) {
+        make_error_response("table with the specified name is not exists", response);
+        return false;
+    }
+
+    struct storage_joined_table * joined_table = storage_joined_table_new(request->n_joins + 1);
+    joined_table->tables.tables[0].table = table;
+    joined_table->tables.tables[0].t_column_index = 0;
+    joined_table->tables.tables[0].s_column_index = 0;
+
+    plan->table = joined_table;
+
+    for (int i = 0; i < request->n_joins; ++i) {
+        joined_table->tables.tables[i + 1].table = storage_find_table(storage, request->joins[i]->table);
+
+        if (!joined_table->tables.tables[i + 1].table) {
+            make_error_response("table with the specified name is not exists", response);
+            return false;
+        }
+
+        joined_table->tables.tables[i + 1].t_column_index =
+            (uint16_t) storage_table_find_column(joined_table->tables.tables[i + 1].table, request->joins[i]->t_column);
+
+        if (joined_table->tables.tables[i + 1].t_column_index >= joined_table->tables.tables[i + 1].table->columns.amount) {
+            make_error_response("column with the specified name is not exists in table", response);
+            return false;
+        }
+
+        uint16_t slice_columns = 0;
+        joined_table->tables.tables[i + 1].s_column_index = (uint16_t) -1;
+        for (int tbl_index = 0; tbl_index <= i; ++tbl_index) {
+            const int index = storage_table_find_column(joined_table->tables.tables[tbl_index].table, request->joins[i]->s_column);
+
+            if (index >= 0) {
+                joined_table->tables.tables[i + 1].s_column_index = slice_columns + index;
+            }
+
+            slice_columns += joined_table->tables.tables[tbl_index].table->columns.amount;
+            if (joined_table->tables.tables[i + 1].s_column_index < slice_columns) {
+                break;
+            }
+        }
+
+        if (joined_table->tables.tables[i + 1].s_column_index >= slice_columns) {
+            make_error_response("column with the specified name is not exists in the join slice", response);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// makes table of answer with names of columns and space for rows
+static Table * make_select_answer(const struct storage_joined_table * table, unsigned int columns_amount,
+        const unsigned int * columns_indexes, size_t rows_capacity) {
+    Table * const answer = malloc(sizeof(Table));
+    table__init(answer);
+
+    answer->n_columns = columns_amount;
+    answer->columns = malloc(sizeof(char *) * columns_amount);
+
+    for (unsigned int i = 0; i < columns_amount; ++i) {
+        answer->columns[i] = strdup(storage_joined_table_get_column(table, columns_indexes[i]).name);
+    }
+
+    answer->rows = malloc(sizeof(Table__Row *) * rows_capacity);
+    return answer;
+}
+
+static Table__Row * make_select_row(const struct storage_joined_row * row, unsigned int columns_amount, const unsigned int * columns_indexes) {
+    Table__Row * const values_row = malloc(sizeof(Table__Row));
+    table__row__init(values_row);
+
+    values_row->n_cells = columns_amount;
+    values_row->cells = malloc(sizeof(Value *) * columns_amount);
+
+    for (unsigned int i = 0; i < columns_amount; ++i) {
+        values_row->cells[i] = make_Value_from_value(storage_joined_row_get_value(row, columns_indexes[i]));
+    }
+
+    return values_row;
+}
+
+// select kept between fetches of its cursor: scan of joined table is resumed by every fetch
+// while rows of its tables are not removed or moved (see storage_table_get_version)
+struct select_cursor {
+    struct storage_joined_table * table;
+    uint64_t * versions;
+
+    unsigned int columns_amount;
+    unsigned int * columns_indexes;
+
+    struct where_program where;
+    struct where_scan scan;
+
+    uint64_t to_skip;
+    uint64_t left;
+};
+
+static void destroy_select_cursor(void * state) {
+    struct select_cursor * const cursor = state;
+
+    destroy_where_scan(&cursor->scan);
+    destroy_where_program(cursor->where);
+    free(cursor->columns_indexes);
+    free(cursor->versions);
+    storage_joined_table_delete(cursor->table);
+    free(cursor);
+}
+
+// declares cursor of select, its rows are taken by fetches from offset up to limit (no limit by default);
+// cursor takes joined table, columns and where of the plan
+static void declare_select_cursor(const SelectRequest * request, struct request_plan * plan, Response * response) {
+    struct select_cursor * const cursor = malloc(sizeof(*cursor));
+    cursor->table = plan->table;
+    cursor->versions = malloc(sizeof(uint64_t) * plan->table->tables.amount);
+    cursor->columns_amount = plan->columns_amount;
+    cursor->columns_indexes = plan->columns_indexes;
+    cursor->where = plan->where;
+    cursor->to_skip = request->has_offset ? request->offset : 0;
+    cursor->left = request->has_limit ? request->limit : UINT64_MAX;
+
+    plan->table = NULL;
+    plan->columns_indexes = NULL;
+    plan->where.amount = 0;
+    plan->where.instructions = NULL;
+
+    for (int i = 0; i < cursor->table->tables.amount; ++i) {
+        cursor->versions[i] = storage_table_get_version(cursor->table->tables.tables[i].table);
+    }
+
+    init_where_scan(&cursor->scan, cursor->table, &cursor->where,
+        cursor->left < UINT64_MAX - cursor->to_skip ? cursor->to_skip + cursor->left : 0, false);
+
+    // scan threads must not read tables after the request
+    if (cursor->scan.job) {
+        storage_scan_job_pause(cursor->scan.job);
+    }
+
+    SuccessResponse * const success_response = make_success_response(response);
+    success_response->value_case = SUCCESS_RESPONSE__VALUE_CURSOR;
+    success_response->cursor = cursors_add(cursors, cursor);
+}
+
+static const char * const aggregate_functions_names[] = {"count", "sum", "min", "max", "avg"};
+
+// checks aggregates, returns indexes of their columns (-1 for all rows) or NULL on error
+static int * map_aggregates_to_indexes(size_t aggregates_amount, SelectRequest__Aggregate * const * aggregates,
+        const struct storage_joined_table * table, Response * response) {
+    int * const indexes = malloc(sizeof(int) * (aggregates_amount + 1));
+
+    for (size_t i = 0; i < aggregates_amount; ++i) {
+        const SelectRequest__Aggregate * const aggregate = aggregates[i];
+
+        if ((unsigned int) aggregate->function > AGGREGATE_FUNCTION__AVG) {
+            free(indexes);
+
+            make_error_response("bad aggregate function", response);
+            return NULL;
+        }
+
+        if (!aggregate->column) {
+            if (aggregate->function != AGGREGATE_FUNCTION__COUNT) {
+                free(indexes);
+
+                make_error_response("only count can be applied to all rows", response);
+                return NULL;
+            }
+
+            indexes[i] = -1;
+            continue;
+        }
+
+        indexes[i] = storage_joined_table_find_column(table, aggregate->column);
+
+        if (indexes[i] < 0) {
+            free(indexes);
+
+            make_error_response("column with the specified name is not exists in table", response);
+            return NULL;
+        }
+
+        if ((aggregate->function == AGGREGATE_FUNCTION__SUM || aggregate->function == AGGREGATE_FUNCTION__AVG)
+                && storage_joined_table_get_column(table, (uint16_t) indexes[i]).type == STORAGE_COLUMN_TYPE_STR) {
+            free(indexes);
+
+            make_error_response("sum and avg can not be applied to strings", response);
+            return NULL;
+        }
+    }
+
+    return indexes;
+}
+
+static bool is_same_aggregate(const SelectRequest__Aggregate * a, const SelectRequest__Aggregate * b) {
+    if (a->function != b->function || !a->column != !b->column) {
+        return false;
+    }
+
+    return !a->column || strcmp(a->column, b->column) == 0;
+}
+
+// maps orders of select to columns of joined table, returns NULL on error
+static unsigned int * map_orders_to_indexes(const SelectRequest * request, const struct storage_joined_table * table, Response * response) {
+    unsigned int * const indexes = malloc(sizeof(unsigned int) * (request->n_order_by + 1));
+
+    for (size_t i = 0; i < request->n_order_by; ++i) {
+        const SelectRequest__Order * const order = request->order_by[i];
+
+        if (!order->column == !order->aggregate) {
+            free(indexes);
+
+            make_error_response("order must have either column or aggregate", response);
+            return NULL;
+        }
+
+        if (order->aggregate) {
+            free(indexes);
+
+            make_error_response("only aggregated rows can be ordered by aggregates", response);
+            return NULL;
+        }
+
+        const int index = storage_joined_table_find_column(table, order->column);
+
+        if (index < 0) {
+            free(indexes);
+
+            make_error_response("column with the specified name is not exists in table", response);
+            return NULL;
+        }
+
+        indexes[i] = (unsigned int) index;
+    }
+
+    return indexes;
+}
+
+// maps orders of aggregated select to columns of group (keys and then aggregates),
+// aggregates of orders which are not selected are added to aggregates, returns false on error
+static bool map_aggregated_orders(const SelectRequest * request, const struct storage_joined_table * table,
+        unsigned int keys_amount, const unsigned int * keys_indexes, size_t * aggregates_amount,
+        SelectRequest__Aggregate ** aggregates, struct sort_key * orders, Response * response) {
+    for (size_t i = 0; i < request->n_order_by; ++i) {
+        const SelectRequest__Order * const order = request->order_by[i];
+        orders[i].descending = order->has_descending && order->descending;
+
+        if (!order->column == !order->aggregate) {
+            make_error_response("order must have either column or aggregate", response);
+            return false;
+        }
+
+        if (order->aggregate) {
+            size_t index = 0;
+            while (index < *aggregates_amount && !is_same_aggregate(aggregates[index], order->aggregate)) {
+                ++index;
+            }
+
+            if (index == *aggregates_amount) {
+                aggregates[(*aggregates_amount)++] = order->aggregate;
+            }
+
+            orders[i].column = keys_amount + index;
+            continue;
+        }
+
+        const int index = storage_joined_table_find_column(table, order->column);
+
+        orders[i].column = keys_amount;
+        for (unsigned int j = 0; j < keys_amount; ++j) {
+            if (keys_indexes[j] == index) {
+                orders[i].column = j;
+                break;
+            }
+        }
+
+        if (orders[i].column == keys_amount) {
+            make_error_response("only grouped columns can order aggregated rows", response);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// makes table of answer with names of selected grouped columns and then names of aggregates, such as sum(price)
+static Table * make_aggregated_answer(const SelectRequest * request, const struct storage_joined_table * table,
+        unsigned int columns_amount, const unsigned int * columns_keys, const unsigned int * keys_indexes, size_t rows_capacity) {
+    Table * const answer = malloc(sizeof(Table));
+    table__init(answer);
+
+    answer->n_columns = columns_amount + request->n_aggregates;
+    answer->columns = malloc(sizeof(char *) * answer->n_columns);
+
+    for (unsigned int i = 0; i < columns_amount; ++i) {
+        answer->columns[i] = strdup(storage_joined_table_get_column(table, keys_indexes[columns_keys[i]]).name);
+    }
+
+    for (size_t i = 0; i < request->n_aggregates; ++i) {
+        const char * const function = aggregate_functions_names[request->aggregates[i]->function];
+        const char * const column = request->aggregates[i]->column ? request->aggregates[i]->column : "*";
+
+        const size_t length = strlen(function) + strlen(column) + 3;
+        answer->columns[columns_amount + i] = malloc(length);
+        snprintf(answer->columns[columns_amount + i], length, "%s(%s)", function, column);
+    }
+
+    answer->rows = malloc(sizeof(Table__Row *) * rows_capacity);
+    return answer;
+}
+
+// sends the last chunk and amount of rows of streamed select or answers with table of rows
+static void finish_select_answer(Table * answer, size_t amount, bool stream, Response * response) {
+    if (stream) {
+        if (answer->n_rows > 0) {
+            send_table_chunk(answer);
+        }
+
+        table__free_unpacked(answer, NULL);
+        make_success_amount_response(amount, response);
+        return;
+    }
+
+    SuccessResponse * const success_response = make_success_response(response);
+    success_response->value_case = SUCCESS_RESPONSE__VALUE_TABLE;
+    success_response->table = answer;
+}
+
+// maps grouped columns, selected columns, aggregates and orders of aggregated select, returns false on error
+static bool resolve_select_aggregated(const SelectRequest * request, struct request_plan * plan, Response * response) {
+    if (request->n_group_by > 0 && !map_columns_to_indexes(request->n_group_by, request->group_by, plan->table,
+            &plan->keys_amount, &plan->keys_indexes, response)) {
+        return false;
+    }
+
+    plan->columns_amount = request->n_columns > 0 ? request->n_columns : plan->keys_amount;
+    plan->columns_indexes = malloc(sizeof(unsigned int) * (plan->columns_amount + 1));
+
+    for (unsigned int i = 0; i < plan->columns_amount; ++i) {
+        const int index = request->n_columns > 0
+            ? storage_joined_table_find_column(plan->table, request->columns[i]) : (int) plan->keys_indexes[i];
+
+        plan->columns_indexes[i] = plan->keys_amount;
+        for (unsigned int j = 0; j < plan->keys_amount; ++j) {
+            if (plan->keys_indexes[j] == index) {
+                plan->columns_indexes[i] = j;
+                break;
+            }
+        }
+
+        if (plan->columns_indexes[i] == plan->keys_amount) {
+            make_error_response("only grouped columns can be selected with aggregates", response);
+            return false;
+        }
+    }
+
+    // selected aggregates and then aggregates of orders
+    size_t aggregates_amount = request->n_aggregates;
+    SelectRequest__Aggregate ** const aggregates = malloc(sizeof(SelectRequest__Aggregate *) * (request->n_aggregates + request->n_order_by + 1));
+    memcpy(aggregates, request->aggregates, sizeof(SelectRequest__Aggregate *) * request->n_aggregates);
+
+    plan->orders = malloc(sizeof(struct sort_key) * (request->n_order_by + 1));
+
+    const bool correct = map_aggregated_orders(request, plan->table, plan->keys_amount, plan->keys_indexes,
+            &aggregates_amount, aggregates, plan->orders, response)
+        && (plan->arguments_indexes = map_aggregates_to_indexes(aggregates_amount, aggregates, plan->table, response));
+
+    // functions of api have the same values
+    plan->functions_amount = aggregates_amount;
+    plan->functions = malloc(sizeof(enum aggregate_function) * (aggregates_amount + 1));
+    for (unsigned int i = 0; i < aggregates_amount; ++i) {
+        plan->functions[i] = (enum aggregate_function) aggregates[i]->function;
+    }
+
+    free(aggregates);
+    return correct;
+}
+
+// aggregated select returns a row for each group of rows with the same values of grouped columns
+// (one group of every row without them): selected columns, which must be grouped ones (all of them by default),
+// and then aggregates of the group; groups are aggregated by hash in bounded memory (see aggregate.h)
+// and sorted after that when they are ordered
+static void run_select_aggregated(const SelectRequest * request, struct request_plan * plan,
+        size_t offset, size_t limit, bool stream, Response * response) {
+    // count of all rows counts a value that is never NULL
+    static struct storage_value row_argument = { .type = STORAGE_COLUMN_TYPE_UINT };
+
+    const unsigned int keys_amount = plan->keys_amount;
+    const unsigned int functions_amount = plan->functions_amount;
+    const unsigned int group_size = keys_amount + functions_amount;
+
+    struct aggregate * const aggregate = aggregate_new(keys_amount, functions_amount, plan->functions, memory_budget);
+    struct storage_value ** const group = malloc(sizeof(struct storage_value *) * (group_size + 1));
+
+    {
+        struct where_scan scan;
+        init_where_scan(&scan, plan->table, &plan->where, 0, false);
+
+        for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+            for (unsigned int i = 0; i < keys_amount; ++i) {
+                group[i] = storage_joined_row_get_value(row, plan->keys_indexes[i]);
+            }
+
+            for (unsigned int i = 0; i < functions_amount; ++i) {
+                group[keys_amount + i] = plan->arguments_indexes[i] < 0 ? &row_argument
+                    : storage_joined_row_get_value(row, (uint16_t) plan->arguments_indexes[i]);
+            }
+
+            aggregate_add(aggregate, group, group + keys_amount);
+
+            for (unsigned int i = 0; i < group_size; ++i) {
+                if (group[i] != &row_argument) {
+                    storage_value_delete(group[i]);
+                }
+            }
+        }
+
+        destroy_where_scan(&scan);
+    }
+
+    struct sort * sort = NULL;
+
+    if (request->n_order_by > 0) {
+        sort = sort_new(group_size, request->n_order_by, plan->orders, limit < SIZE_MAX - offset ? offset + limit : SIZE_MAX, memory_budget);
+
+        while (aggregate_next(aggregate, group)) {
+            sort_add(sort, group);
+
+            for (unsigned int i = 0; i < group_size; ++i) {
+                storage_value_delete(group[i]);
+            }
+        }
+    }
+
+    Table * const answer = make_aggregated_answer(request, plan->table, plan->columns_amount, plan->columns_indexes,
+        plan->keys_indexes, stream ? STREAM_CHUNK_ROWS : limit);
+
+    size_t amount = 0, to_skip = offset;
+    bool sending = true;
+
+    while (sending && amount < limit && (sort ? sort_next(sort, group) : aggregate_next(aggregate, group))) {
+        if (to_skip > 0) {
+            --to_skip;
+        } else if (stream && answer->n_rows == STREAM_CHUNK_ROWS && !send_table_chunk(answer)) {
+            sending = false;
+        } else {
+            Table__Row * const values_row = malloc(sizeof(Table__Row));
+            table__row__init(values_row);
+
+            values_row->n_cells = plan->columns_amount + request->n_aggregates;
+            values_row->cells = malloc(sizeof(Value *) * values_row->n_cells);
+
+            for (unsigned int i = 0; i < plan->columns_amount; ++i) {
+                values_row->cells[i] = make_Value_from_kept_value(group[plan->columns_indexes[i]]);
+            }
+
+            for (size_t i = 0; i < request->n_aggregates; ++i) {
+                values_row->cells[plan->columns_amount + i] = make_Value_from_kept_value(group[keys_amount + i]);
+            }
+
+            answer->rows[answer->n_rows++] = values_row;
+            ++amount;
+        }
+
+        for (unsigned int i = 0; i < group_size; ++i) {
+            storage_value_delete(group[i]);
+        }
+    }
+
+    if (sort) {
+        sort_delete(sort);
+    }
+
+    free(group);
+    aggregate_delete(aggregate);
+
+    finish_select_answer(answer, amount, stream, response);
+}
+
+// rows of ordered select are values of selected columns and then values of orders, returns false on error
+static bool resolve_select_ordered(const SelectRequest * request, struct request_plan * plan, Response * response) {
+    plan->orders_indexes = map_orders_to_indexes(request, plan->table, response);
+
+    if (!plan->orders_indexes) {
+        return false;
+    }
+
+    plan->orders = malloc(sizeof(struct sort_key) * (request->n_order_by + 1));
+    for (unsigned int i = 0; i < request->n_order_by; ++i) {
+        plan->orders[i].column = plan->columns_amount + i;
+        plan->orders[i].descending = request->order_by[i]->has_descending && request->order_by[i]->descending;
+    }
+
+    return true;
+}
+
+// ordered select sorts all rows of where, only the first rows of offset and limit
+// are kept when there is limit, the others are spilled by sort (see sort.h)
+static void run_select_ordered(const SelectRequest * request, struct request_plan * plan,
+        size_t offset, size_t limit, bool stream, Response * response) {
+    const unsigned int columns_amount = plan->columns_amount;
+    const unsigned int orders_amount = request->n_order_by;
+    const unsigned int row_size = columns_amount + orders_amount;
+
+    struct sort * const sort = sort_new(row_size, orders_amount, plan->orders, limit < SIZE_MAX - offset ? offset + limit : SIZE_MAX, memory_budget);
+    struct storage_value ** const values = malloc(sizeof(struct storage_value *) * (row_size + 1));
+
+    {
+        struct where_scan scan;
+        init_where_scan(&scan, plan->table, &plan->where, 0, false);
+
+        for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+            for (unsigned int i = 0; i < columns_amount; ++i) {
+                values[i] = storage_joined_row_get_value(row, plan->columns_indexes[i]);
+            }
+
+            for (unsigned int i = 0; i < orders_amount; ++i) {
+                values[columns_amount + i] = storage_joined_row_get_value(row, plan->orders_indexes[i]);
+            }
+
+            sort_add(sort, values);
+
+            for (unsigned int i = 0; i < row_size; ++i) {
+                storage_value_delete(values[i]);
+            }
+        }
+
+        destroy_where_scan(&scan);
+    }
+
+    Table * const answer = make_select_answer(plan->table, columns_amount, plan->columns_indexes, stream ? STREAM_CHUNK_ROWS : limit);
+
+    size_t amount = 0, to_skip = offset;
+    bool sending = true;
+
+    while (sending && amount < limit && sort_next(sort, values)) {
+        if (to_skip > 0) {
+            --to_skip;
+        } else if (stream && answer->n_rows == STREAM_CHUNK_ROWS && !send_table_chunk(answer)) {
+            sending = false;
+        } else {
+            Table__Row * const values_row = malloc(sizeof(Table__Row));
+            table__row__init(values_row);
+
+            values_row->n_cells = columns_amount;
+            values_row->cells = malloc(sizeof(Value *) * values_row->n_cells);
+
+            for (unsigned int i = 0; i < columns_amount; ++i) {
+                values_row->cells[i] = make_Value_from_kept_value(values[i]);
+            }
+
+            answer->rows[answer->n_rows++] = values_row;
+            ++amount;
+        }
+
+        for (unsigned int i = 0; i < row_size; ++i) {
+            storage_value_delete(values[i]);
+        }
+    }
+
+    free(values);
+    sort_delete(sort);
+
+    finish_select_answer(answer, amount, stream, response);
+}
+
+static bool resolve_select(const SelectRequest * request, struct storage * storage, struct request_plan * plan, Response * response) {
+    const bool stream = request->has_stream && request->stream;
+    const bool cursor = request->has_cursor && request->cursor;
+    const size_t limit = request->has_limit ? request->limit : stream ? SIZE_MAX : 10;
+
+    if (stream && cursor) {
+        make_error_response("rows of cursor are fetched, they can not be streamed", response);
+        return false;
+    }
+
+    if (cursor && (request->n_aggregates > 0 || request->n_group_by > 0)) {
+        make_error_response("aggregated rows can not be fetched by cursor", response);
+        return false;
+    }
+
+    if (cursor && request->n_order_by > 0) {
+        make_error_response("ordered rows can not be fetched by cursor", response);
+        return false;
+    }
+
+    if (!stream && !cursor && limit > 1000) {
+        make_error_response("limit is too high", response);
+        return false;
+    }
+
+    if (!resolve_select_table(request, storage, plan, response) || !compile_where(plan->table, request->where, &plan->where, response)) {
+        return false;
+    }
+
+    if (request->n_aggregates > 0 || request->n_group_by > 0) {
+        return resolve_select_aggregated(request, plan, response);
+    }
+
+    if (!map_columns_to_indexes(request->n_columns, request->columns, plan->table, &plan->columns_amount, &plan->columns_indexes, response)) {
+        return false;
+    }
+
+    return request->n_order_by == 0 || resolve_select_ordered(request, plan, response);
+}
+
+// streamed select sends rows by chunks of table as they are read
+// and then amount of them, it has no limit unless it is requested
+static void run_select(const SelectRequest * request, struct request_plan * plan, Response * response) {
+    const bool stream = request->has_stream && request->stream;
+    const size_t offset = request->has_offset ? request->offset : 0;
+    const size_t limit = request->has_limit ? request->limit : stream ? SIZE_MAX : 10;
+
+    if (!bind_where(plan->table, request->where, &plan->where, response)) {
+        return;
+    }
+
+    use_index(plan->table, request->where, &plan->where);
+
+    if (request->n_aggregates > 0 || request->n_group_by > 0) {
+        run_select_aggregated(request, plan, offset, limit, stream, response);
+        return;
+    }
+
+    if (request->has_cursor && request->cursor) {
+        declare_select_cursor(request, plan, response);
+        return;
+    }
+
+    if (request->n_order_by > 0) {
+        run_select_ordered(request, plan, offset, limit, stream, response);
+        return;
+    }
+
+    Table * const answer = make_select_answer(plan->table, plan->columns_amount, plan->columns_indexes, stream ? STREAM_CHUNK_ROWS : limit);
+    size_t amount = 0;
+
+    {
+        struct where_scan scan;
+        init_where_scan(&scan, plan->table, &plan->where, limit < SIZE_MAX - offset ? offset + limit : 0, false);
+
+        size_t to_skip = offset;
+        for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+            if (to_skip > 0) {
+                --to_skip;
+                continue;
+            }
+
+            if (amount == limit) {
+                break;
+            }
+
+            if (stream && answer->n_rows == STREAM_CHUNK_ROWS && !send_table_chunk(answer)) {
+                break;
+            }
+
+            answer->rows[answer->n_rows++] = make_select_row(row, plan->columns_amount, plan->columns_indexes);
+            ++amount;
+        }
+
+        destroy_where_scan(&scan);
+    }
+
+    finish_select_answer(answer, amount, stream, response);
+}
+
+// locks tables of cursor for the request, returns false when their rows are removed or moved since declaration
+static bool lock_select_cursor(struct select_cursor * cursor, struct storage * storage) {
+    bool actual = true;
+
+    for (int i = 0; i < cursor->table->tables.amount; ++i) {
+        struct storage_table * const table = storage_find_table(storage, cursor->table->tables.tables[i].table->name);
+
+        actual = actual && table && storage_table_get_version(table) == cursor->versions[i];
+    }
+
+    return actual;
+}
+
+// fetch resumes scan of cursor where the previous one stopped
+static void handle_request_fetch(const FetchRequest * request, struct storage * storage, Response * response) {
+    const uint64_t limit = request->has_amount ? request->amount : 10;
+
+    if (limit > 1000) {
+        make_error_response("amount is too high", response);
+        return;
+    }
+
+    struct select_cursor * const cursor = cursors_take(cursors, request->cursor);
+
+    if (!cursor) {
+        make_error_response("cursor with the specified id is not exists", response);
+        return;
+    }
+
+    if (!lock_select_cursor(cursor, storage)) {
+        destroy_select_cursor(cursor);
+
+        make_error_response("rows of cursor tables are removed or moved, cursor is closed", response);
+        return;
+    }
+
+    Table * const answer = make_select_answer(cursor->table, cursor->columns_amount, cursor->columns_indexes, limit);
+
+    while (answer->n_rows < limit && cursor->left > 0) {
+        struct storage_joined_row * const row = where_scan_next(&cursor->scan);
+
+        if (!row) {
+            cursor->left = 0;
+            break;
+        }
+
+        if (cursor->to_skip > 0) {
+            --cursor->to_skip;
+            continue;
+        }
+
+        answer->rows[answer->n_rows++] = make_select_row(row, cursor->columns_amount, cursor->columns_indexes);
+        --cursor->left;
+    }
+
+    if (cursor->scan.job) {
+        storage_scan_job_pause(cursor->scan.job);
+    }
+
+    cursors_put(cursors, request->cursor, cursor);
+
+    SuccessResponse * const success_response = make_success_response(response);
+    success_response->value_case = SUCCESS_RESPONSE__VALUE_TABLE;
+    success_response->table = answer;
+}
+
+static void handle_request_close_cursor(const CloseCursorRequest * request, Response * response) {
+    struct select_cursor * const cursor = cursors_take(cursors, request->cursor);
+
+    if (!cursor) {
+        make_error_response("cursor with the specified id is not exists", response);
+        return;
+    }
+
+    destroy_select_cursor(cursor);
+    make_success_response(response);
+}
+
+static bool resolve_update(const UpdateRequest * request, struct storage * storage, struct request_plan * plan, Response * response) {
+    struct storage_table * table = storage_find_table(storage, request->table);
+
+    if (!table) {
+        make_error_response("table with the specified name is not exists", response);
+        return false;
+    }
+
+    plan->table = storage_joined_table_wrap(table);
+
+    return compile_where(plan->table, request->where, &plan->where, response)
+        && map_columns_to_indexes(request->n_columns, request->columns, plan->table,
+            &plan->columns_amount, &plan->columns_indexes, response);
+}
+
+static void run_update(const UpdateRequest * request, struct request_plan * plan, Response * response) {
+    struct storage_table * const table = plan->table->tables.tables[0].table;
+
+    if (!bind_where(plan->table, request->where, &plan->where, response)
+        || !check_values(request->n_values, request->values, table, plan->columns_amount, plan->columns_indexes, response)) {
+        return;
+    }
+
+    use_index(plan->table, request->where, &plan->where);
+
+    struct where_scan scan;
+    init_where_scan(&scan, plan->table, &plan->where, 0, true);
+
+    unsigned long long amount = 0;
+    for (struct storage_joined_row * row = where_scan_next(&scan); row; row = where_scan_next(&scan)) {
+        for (unsigned int i = 0; i < plan->columns_amount; ++i) {
+            struct storage_value value;
+
+            storage_row_set_value(row->rows[0], plan->columns_indexes[i], make_value_from_Value(request->values[i], &value));
+
+            storage_value_destroy(value);
+        }
+
+        ++amount;
+    }
+
+    destroy_where_scan(&scan);
+    make_success_amount_response(amount, response);
+}
+
+// resolves insert, delete, select or update request into plan, which must be destroyed even on error;
+// returns false on error
+static bool resolve_request(const Request * request, struct storage * storage, struct request_plan * plan, Response * response) {
+    init_request_plan(plan);
+
+    switch (request->action_case) {
+        case REQUEST__ACTION_INSERT:
+            return resolve_insert(request->insert, storage, plan, response);
+
+        case REQUEST__ACTION_DELETE:
+            return resolve_delete(request->delete_, storage, plan, response);
+
+        case REQUEST__ACTION_SELECT:
+            return resolve_select(request->select, storage, plan, response);
+
+        case REQUEST__ACTION_UPDATE:
+            return resolve_update(request->update, storage, plan, response);
+
+        default:
+            return false; // unreachable
+    }
+}
+
+// runs request by its plan, cursor of select takes joined table of plan (it is NULL after that)
+static void run_request(const Request * request, struct request_plan * plan, Response * response) {
+    switch (request->action_case) {
+        case REQUEST__ACTION_INSERT:
+            run_insert(request->insert, plan, response);
+            return;
+
+        case REQUEST__ACTION_DELETE:
+            run_delete(request->delete_, plan, response);
+            return;
+
+        case REQUEST__ACTION_SELECT:
+            run_select(request->select, plan, response);
+            return;
+
+        case REQUEST__ACTION_UPDATE:
+            run_update(request->update, plan, response);
+            return;
+
+        default:
+            return; // unreachable
+    }
+}
+
+static void handle_request_planned(const Request * request, struct storage * storage, Response * response) {
+    struct request_plan plan;
+
+    if (resolve_request(request, storage, &plan, response)) {
+        run_request(request, &plan, response);
+    }
+
+    destroy_request_plan(&plan);
+}
+
+// prepared request of connection, its plan is kept between executes while schema is not changed
+struct statement {
+    uint64_t id;
+
+    // copy of the prepared request, values of its parameters are put into their places by execute
+    Request * request;
+    uint32_t parameters_amount;
+
+    size_t places_amount;
+    struct statement_place {
+        Value * value;
+        uint32_t parameter;
+    } * places;
+
+    // plan is resolved by schema of the generation
+    bool resolved;
+    uint64_t generation;
+    struct request_plan plan;
+
+    struct statement * next;
+};
+
+// prepared statements of connection, they are kept in its state
+struct statements {
+    uint64_t last_id;
+    struct statement * first;
+};
+
+static void add_statement_place(struct statement * statement, Value * value) {
+    if (value->value_case != VALUE__VALUE_PARAMETER) {
+        return;
+    }
+
+    statement->places = realloc(statement->places, sizeof(*statement->places) * (statement->places_amount + 1));
+    statement->places[statement->places_amount].value = value;
+    statement->places[statement->places_amount].parameter = value->parameter;
+    ++statement->places_amount;
+
+    if (statement->parameters_amount < value->parameter) {
+        statement->parameters_amount = value->parameter;
+    }
+}
+
+static void add_where_places(struct statement * statement, const WhereExpr * where) {
+    if (!where) {
+        return;
+    }
+
+    switch (where->op_case) {
+        case WHERE_EXPR__OP_AND:
+            add_where_places(statement, where->and_->left);
+            add_where_places(statement, where->and_->right);
+            return;
+
+        case WHERE_EXPR__OP_OR:
+            add_where_places(statement, where->or_->left);
+            add_where_places(statement, where->or_->right);
+            return;
+
+        default:
             break;
+    }
+
+    const WhereValueOp * const where_value_op = get_where_value_op(where);
+
+    if (where_value_op) {
+        add_statement_place(statement, where_value_op->value);
+    }
+}
+
+// finds places of parameters in values and where of the prepared request
+static void add_request_places(struct statement * statement) {
+    const Request * const request = statement->request;
+
+    switch (request->action_case) {
+        case REQUEST__ACTION_INSERT:
+            for (size_t i = 0; i < request->insert->n_values; ++i) {
+                add_statement_place(statement, request->insert->values[i]);
+            }
+
+            for (size_t i = 0; i < request->insert->n_rows; ++i) {
+                for (size_t j = 0; j < request->insert->rows[i]->n_values; ++j) {
+                    add_statement_place(statement, request->insert->rows[i]->values[j]);
+                }
+            }
+
+            return;
+
+        case REQUEST__ACTION_DELETE:
+            add_where_places(statement, request->delete_->where);
+            return;
+
+        case REQUEST__ACTION_SELECT:
+            add_where_places(statement, request->select->where);
+            return;
+
+        case REQUEST__ACTION_UPDATE:
+            for (size_t i = 0; i < request->update->n_values; ++i) {
+                add_statement_place(statement, request->update->values[i]);
+            }
+
+            add_where_places(statement, request->update->where);
+            return;
+
+        default:
+            return;
+    }
+}
+
+static struct statement * find_statement(struct statements * statements, uint64_t id) {
+    for (struct statement * statement = statements->first; statement; statement = statement->next) {
+        if (statement->id == id) {
+            return statement;
+        }
+    }
+
+    return NULL;
+}
+
+static void delete_statement(struct statement * statement) {
+    if (statement->resolved) {
+        destroy_request_plan(&statement->plan);
+    }
+
+    request__free_unpacked(statement->request, NULL);
+    free(statement->places);
+    free(statement);
+}
+
+// destroys statements of closed connection, they are not executed anymore
+static void destroy_statements(void * state) {
+    struct statements * const statements = state;
+
+    while (statements->first) {
+        struct statement * const statement = statements->first;
+
+        statements->first = statement->next;
+        delete_statement(statement);
+    }
+
+    free(statements);
+}
+
+// statements of connection of the handled frame
+static struct statements * get_connection_statements(void) {
+    void ** const state = reactor_state();
+
+    if (!*state) {
+        struct statements * const statements = malloc(sizeof(*statements));
 
-        case WHERE_EXPR__OP_NE:
-            where_value_op = where->ne;
-            break;
+        statements->last_id = 0;
+        statements->first = NULL;
+        *state = statements;
+    }
 
-        case WHERE_EXPR__OP_LT:
-            where_value_op = where->lt;
-            break;
+    return *state;
+}
 
-        case WHERE_EXPR__OP_GT:
-            where_value_op = where->gt;
-            break;
+// copies request by packing it, since request of frame is freed after handling
+static Request * copy_request(const Request * request) {
+    const size_t size = request__get_packed_size(request);
+    uint8_t * const buffer = malloc(size + 1);
 
-        case WHERE_EXPR__OP_LE:
-            where_value_op = where->le;
-            break;
+    request__pack(request, buffer);
+    Request * const copy = request__unpack(NULL, size, buffer);
 
-        case WHERE_EXPR__OP_GE:
-            where_value_op = where->ge;
-            break;
+    free(buffer);
+    return copy;
+}
 
-        case WHERE_EXPR__OP_AND:
-        case WHERE_EXPR__OP_OR:
+// prepare copies request and resolves its plan, so errors of names are returned by it
+static void handle_request_prepare(const PrepareRequest * request, struct statements * statements,
+        struct storage * storage, Response * response) {
+    switch (request->request->action_case) {
+        case REQUEST__ACTION_INSERT:
+        case REQUEST__ACTION_DELETE:
+        case REQUEST__ACTION_SELECT:
+        case REQUEST__ACTION_UPDATE:
             break;
 
         default:
-            errno = EINVAL;
-            return false;
+            make_error_response("only insert, delete, select and update requests can be prepared", response);
+            return;
     }
 
-    switch (where->op_case) {
-        case WHERE_EXPR__OP_EQ:
-        case WHERE_EXPR__OP_NE:
-        case WHERE_EXPR__OP_LT:
-        case WHERE_EXPR__OP_GT:
-        case WHERE_EXPR__OP_LE:
-        case WHERE_EXPR__OP_GE:
-            for (unsigned int i = 0; i < table_columns_amount; ++i) {
-                if (strcmp(storage_joined_table_get_column(row->table, i).name, where_value_op->column) == 0) {
-                    return compare_values(where->op_case, storage_joined_row_get_value(row, i), where_value_op->value);
-                }
-            }
-
-            errno = EINVAL;
-            return false;
+    struct statement * const statement = malloc(sizeof(*statement));
+    statement->request = copy_request(request->request);
+    statement->parameters_amount = 0;
+    statement->places_amount = 0;
+    statement->places = NULL;
+    statement->resolved = false;
 
-        case WHERE_EXPR__OP_AND:
-            return eval_where(row, where->and_->left) && eval_where(row, where->and_->right);
+    add_request_places(statement);
 
-        case WHERE_EXPR__OP_OR:
-            return eval_where(row, where->or_->left) || eval_where(row, where->or_->right);
+    for (size_t i = 0; i < statement->places_amount; ++i) {
+        if (statement->places[i].parameter == 0) {
+            delete_statement(statement);
 
-        default:
-            return false; // unreachable
+            make_error_response("parameters are numbered from 1", response);
+            return;
+        }
     }
-}
-
-static void handle_request_delete(const DeleteRequest * request, struct storage * storage, Response * response) {
-    struct storage_table * const table = storage_find_table(storage, request->table);
 
-    if (!table) {
-        make_error_response("table with the specified name is not exists", response);
+    if (!resolve_request(statement->request, storage, &statement->plan, response)) {
+        destroy_request_plan(&statement->plan);
+        delete_statement(statement);
         return;
     }
 
-    struct storage_joined_table * joined_table = storage_joined_table_wrap(table);
+    statement->resolved = true;
+    statement->generation = atomic_load(&schema_generation);
+    statement->id = ++statements->last_id;
+    statement->next = statements->first;
+    statements->first = statement;
 
-    if (!is_where_correct(joined_table, request->where, response)) {
-        storage_joined_table_delete(joined_table);
-        return;
-    }
+    Prepared * const prepared = malloc(sizeof(*prepared));
+    prepared__init(prepared);
 
-    unsigned long long amount = 0;
-    for (struct storage_joined_row * row = storage_joined_table_get_first_row(joined_table); row; row = storage_joined_row_next(row)) {
-        if (eval_where(row, request->where)) {
-            storage_row_remove(row->rows[0]);
-            ++amount;
-        }
-    }
+    prepared->statement = statement->id;
+    prepared->parameters = statement->parameters_amount;
 
-    storage_joined_table_delete(joined_table);
-    make_success_amount_response(amount, response);
+    SuccessResponse * const success_response = make_success_response(response);
+    success_response->value_case = SUCCESS_RESPONSE__VALUE_PREPARED;
+    success_response->prepared = prepared;
 }
 
-static void handle_request_select(const SelectRequest * request, struct storage * storage, Response * response) {
-    const size_t offset = request->has_offset ? request->offset : 0;
-    const size_t limit = request->has_limit ? request->limit : 10;
+// locks tables of kept plan for the request or resolves plan again after schema changes, returns false on error
+static bool lock_statement_plan(struct statement * statement, struct storage * storage, Response * response) {
+    const uint64_t generation = atomic_load(&schema_generation);
 
-    if (limit > 1000) {
-        make_error_response("limit is too high", response);
-        return;
+    if (statement->resolved && statement->generation == generation) {
+        for (int i = 0; i < statement->plan.table->tables.amount; ++i) {
+            storage_find_table(storage, statement->plan.table->tables.tables[i].table->name);
+        }
+
+        return true;
     }
 
-    struct storage_table * table = storage_find_table(storage, request->table);
+    if (statement->resolved) {
+        destroy_request_plan(&statement->plan);
+    }
 
-    if (!table) {
-        make_error_response("table with the specified name is not exists", response);
-        return;
+    statement->resolved = resolve_request(statement->request, storage, &statement->plan, response);
+
+    if (!statement->resolved) {
+        destroy_request_plan(&statement->plan);
+        return false;
     }
 
-    struct storage_joined_table * joined_table = storage_joined_table_new(request->n_joins + 1);
-    joined_table->tables.tables[0].table = table;
-    joined_table->tables.tables[0].t_column_index = 0;
-    joined_table->tables.tables[0].s_column_index = 0;
+    statement->generation = generation;
+    return true;
+}
 
-    for (int i = 0; i < request->n_joins; ++i) {
-        joined_table->tables.tables[i + 1].table = storage_find_table(storage, request->joins[i]->table);
+// puts value of parameter into its place, string of the value is borrowed
+static void put_parameter_value(Value * place, const Value * value) {
+    place->value_case = value->value_case;
 
-        if (!joined_table->tables.tables[i + 1].table) {
-            storage_joined_table_delete(joined_table);
+    switch (value->value_case) {
+        case VALUE__VALUE_INT:
+            place->int_ = value->int_;
+            break;
 
-            make_error_response("table with the specified name is not exists", response);
-            return;
-        }
+        case VALUE__VALUE_UINT:
+            place->uint = value->uint;
+            break;
 
-        joined_table->tables.tables[i + 1].t_column_index = (uint16_t) -1;
-        for (int j = 0; j < joined_table->tables.tables[i + 1].table->columns.amount; ++j) {
-            if (strcmp(request->joins[i]->t_column, joined_table->tables.tables[i + 1].table->columns.columns[j].name) == 0) {
-                joined_table->tables.tables[i + 1].t_column_index = j;
-                break;
-            }
-        }
+        case VALUE__VALUE_NUM:
+            place->num = value->num;
+            break;
 
-        if (joined_table->tables.tables[i + 1].t_column_index >= joined_table->tables.tables[i + 1].table->columns.amount) {
-            storage_joined_table_delete(joined_table);
+        case VALUE__VALUE_STR:
+            place->str = value->str;
+            break;
 
-            make_error_response("column with the specified name is not exists in table", response);
-            return;
-        }
+        case VALUE__VALUE_PARAMETER:
+            place->parameter = value->parameter;
+            break;
 
-        uint16_t slice_columns = 0;
-        joined_table->tables.tables[i + 1].s_column_index = (uint16_t) -1;
-        for (int tbl_index = 0, col_index = 0; tbl_index <= i; ++tbl_index) {
-            for (int tbl_col_index = 0; tbl_col_index < joined_table->tables.tables[tbl_index].table->columns.amount; ++tbl_col_index, ++col_index) {
-                if (strcmp(request->joins[i]->s_column, joined_table->tables.tables[tbl_index].table->columns.columns[tbl_col_index].name) == 0) {
-                    joined_table->tables.tables[i + 1].s_column_index = col_index;
-                    break;
-                }
-            }
+        default:
+            break;
+    }
+}
 
-            slice_columns += joined_table->tables.tables[tbl_index].table->columns.amount;
-            if (joined_table->tables.tables[i + 1].s_column_index < slice_columns) {
-                break;
-            }
-        }
+// execute puts values of parameters into places of prepared request and runs it by its plan
+static void handle_request_execute(const ExecuteRequest * request, struct statements * statements,
+        struct storage * storage, Response * response) {
+    struct statement * const statement = find_statement(statements, request->statement);
 
-        if (joined_table->tables.tables[i + 1].s_column_index >= slice_columns) {
-            storage_joined_table_delete(joined_table);
+    if (!statement) {
+        make_error_response("statement with the specified id is not exists", response);
+        return;
+    }
 
-            make_error_response("column with the specified name is not exists in the join slice", response);
-            return;
-        }
+    if (request->n_parameters != statement->parameters_amount) {
+        make_error_response("values amount is not equals to parameters amount", response);
+        return;
     }
 
-    if (!is_where_correct(joined_table, request->where, response)) {
-        storage_joined_table_delete(joined_table);
+    if (!lock_statement_plan(statement, storage, response)) {
         return;
     }
 
-    unsigned int columns_amount;
-    unsigned int * columns_indexes;
+    for (size_t i = 0; i < statement->places_amount; ++i) {
+        put_parameter_value(statement->places[i].value, request->parameters[statement->places[i].parameter - 1]);
+    }
 
-    if (!map_columns_to_indexes(request->n_columns, request->columns, joined_table, &columns_amount, &columns_indexes, response)) {
-        storage_joined_table_delete(joined_table);
-        return;
+    run_request(statement->request, &statement->plan, response);
+
+    for (size_t i = 0; i < statement->places_amount; ++i) {
+        statement->places[i].value->value_case = VALUE__VALUE_PARAMETER;
+        statement->places[i].value->parameter = statement->places[i].parameter;
     }
 
-    Table * const answer = malloc(sizeof(Table));
-    table__init(answer);
+    if (statement->plan.table) {
+        storage_joined_table_reset(statement->plan.table);
+    } else {
+        destroy_request_plan(&statement->plan);
+        statement->resolved = false;
+    }
+}
 
-    {
-        answer->n_columns = columns_amount;
-        answer->columns = malloc(sizeof(char *) * columns_amount);
+static void handle_request_deallocate(const DeallocateRequest * request, struct statements * statements, Response * response) {
+    for (struct statement ** statement = &statements->first; *statement; statement = &(*statement)->next) {
+        if ((*statement)->id == request->statement) {
+            struct statement * const deallocated = *statement;
 
-        for (unsigned int i = 0; i < columns_amount; ++i) {
-            answer->columns[i] = strdup(storage_joined_table_get_column(joined_table, columns_indexes[i]).name);
+            *statement = deallocated->next;
+            delete_statement(deallocated);
+            make_success_response(response);
+            return;
         }
     }
 
-    {
-        answer->rows = malloc(sizeof(Table__Row *) * limit);
+    make_error_response("statement with the specified id is not exists", response);
+}
 
-        unsigned int to_skip = offset, amount = 0;
-        for (struct storage_joined_row * row = storage_joined_table_get_first_row(joined_table); row; row = storage_joined_row_next(row)) {
-            if (eval_where(row, request->where)) {
-                if (to_skip > 0) {
-                    --to_skip;
-                    continue;
-                }
+static void handle_request_vacuum(const VacuumRequest * request, struct storage * storage, Response * response) {
+    if (!request->table) {
+        make_success_amount_response(storage_vacuum(storage), response);
+        return;
+    }
 
-                if (amount == limit) {
-                    break;
-                }
+    struct storage_table * table = storage_find_table(storage, request->table);
 
-                Table__Row * const values_row = malloc(sizeof(Table__Row));
-                table__row__init(values_row);
+    if (!table) {
+        make_error_response("table with the specified name is not exists", response);
+        return;
+    }
 
-                values_row->n_cells = columns_amount;
-                values_row->cells = malloc(sizeof(Value *) * columns_amount);
+    const uint64_t amount = storage_table_vacuum(table);
 
-                for (unsigned int i = 0; i < columns_amount; ++i) {
-                    values_row->cells[i] = make_Value_from_value(storage_joined_row_get_value(row, columns_indexes[i]));
-                }
+    storage_table_delete(table);
+    make_success_amount_response(amount, response);
+}
 
-                answer->rows[amount] = values_row;
-                ++amount;
-            }
-        }
+static void handle_request_stats(struct storage * storage, Response * response) {
+    struct storage_stats storage_stats;
+    storage_get_stats(storage, &storage_stats);
 
-        answer->n_rows = amount;
-    }
+    Stats * const stats = malloc(sizeof(*stats));
+    stats__init(stats);
 
-    free(columns_indexes);
-    storage_joined_table_delete(joined_table);
+    stats->size = storage_stats.size;
+    stats->tables = storage_stats.tables;
+    stats->row_groups = storage_stats.row_groups;
+    stats->compressed_row_groups = storage_stats.compressed_row_groups;
+    stats->body_size = storage_stats.body_size;
+    stats->stored_size = storage_stats.stored_size;
+    stats->compression_ratio = storage_stats.stored_size ? (double) storage_stats.body_size / storage_stats.stored_size : 1;
 
     SuccessResponse * const success_response = make_success_response(response);
-    success_response->value_case = SUCCESS_RESPONSE__VALUE_TABLE;
-    success_response->table = answer;
+    success_response->value_case = SUCCESS_RESPONSE__VALUE_STATS;
+    success_response->stats = stats;
 }
 
-static void handle_request_update(const UpdateRequest * request, struct storage * storage, Response * response) {
+static void handle_request_create_index(const CreateIndexRequest * request, struct storage * storage, Response * response) {
     struct storage_table * table = storage_find_table(storage, request->table);
 
     if (!table) {
@@ -936,48 +2447,31 @@ static void handle_request_update(const UpdateRequest * request, struct storage
         return;
     }
 
-    struct storage_joined_table * joined_table = storage_joined_table_wrap(table);
-
-    if (!is_where_correct(joined_table, request->where, response)) {
-        storage_joined_table_delete(joined_table);
-        return;
-    }
-
-    unsigned int columns_amount;
-    unsigned int * columns_indexes;
+    const int column = storage_table_find_column(table, request->column);
 
-    if (!map_columns_to_indexes(request->n_columns, request->columns, joined_table, &columns_amount, &columns_indexes, response)) {
-        storage_joined_table_delete(joined_table);
-        return;
-    }
+    if (column < 0) {
+        storage_table_delete(table);
 
-    if (!check_values(request->n_values, request->values, table, columns_amount, columns_indexes, response)) {
-        free(columns_indexes);
-        storage_joined_table_delete(joined_table);
+        make_error_response("column with the specified name is not exists in table", response);
         return;
     }
 
-    unsigned long long amount = 0;
-    for (struct storage_joined_row * row = storage_joined_table_get_first_row(joined_table); row; row = storage_joined_row_next(row)) {
-        if (eval_where(row, request->where)) {
-            for (unsigned int i = 0; i < columns_amount; ++i) {
-                struct storage_value value;
-
-                storage_row_set_value(row->rows[0], columns_indexes[i], make_value_from_Value(request->values[i], &value));
+    errno = 0;
+    storage_table_add_index(table, column);
+    const int error = errno;
 
-                storage_value_destroy(value);
-            }
+    storage_table_delete(table);
 
-            ++amount;
-        }
+    if (error == EEXIST) {
+        make_error_response("an index on the column is already exists", response);
+    } else if (error) {
+        make_error_response("indexes are not supported by the storage file version", response);
+    } else {
+        make_success_response(response);
     }
-
-    free(columns_indexes);
-    storage_joined_table_delete(joined_table);
-    make_success_amount_response(amount, response);
 }
 
-static void handle_request(const Request * request, struct storage * storage, Response * response) {
+static void handle_request(const Request * request, struct statements * statements, struct storage * storage, Response * response) {
     switch (request->action_case) {
         case REQUEST__ACTION_CREATE_TABLE:
             handle_request_create_table(request->create_table, storage, response);
@@ -988,19 +2482,42 @@ static void handle_request(const Request * request, struct storage * storage, Re
             return;
 
         case REQUEST__ACTION_INSERT:
-            handle_request_insert(request->insert, storage, response);
+        case REQUEST__ACTION_DELETE:
+        case REQUEST__ACTION_SELECT:
+        case REQUEST__ACTION_UPDATE:
+            handle_request_planned(request, storage, response);
             return;
 
-        case REQUEST__ACTION_DELETE:
-            handle_request_delete(request->delete_, storage, response);
+        case REQUEST__ACTION_VACUUM:
+            handle_request_vacuum(request->vacuum, storage, response);
             return;
 
-        case REQUEST__ACTION_SELECT:
-            handle_request_select(request->select, storage, response);
+        case REQUEST__ACTION_CREATE_INDEX:
+            handle_request_create_index(request->create_index, storage, response);
             return;
 
-        case REQUEST__ACTION_UPDATE:
-            handle_request_update(request->update, storage, response);
+        case REQUEST__ACTION_FETCH:
+            handle_request_fetch(request->fetch, storage, response);
+            return;
+
+        case REQUEST__ACTION_CLOSE_CURSOR:
+            handle_request_close_cursor(request->close_cursor, response);
+            return;
+
+        case REQUEST__ACTION_STATS:
+            handle_request_stats(storage, response);
+            return;
+
+        case REQUEST__ACTION_PREPARE:
+            handle_request_prepare(request->prepare, statements, storage, response);
+            return;
+
+        case REQUEST__ACTION_EXECUTE:
+            handle_request_execute(request->execute, statements, storage, response);
+            return;
+
+        case REQUEST__ACTION_DEALLOCATE:
+            handle_request_deallocate(request->deallocate, statements, response);
             return;
 
         default:
@@ -1009,106 +2526,149 @@ static void handle_request(const Request * request, struct storage * storage, Re
     }
 }
 
-static void handle_client(int socket, struct storage * storage) {
-    printf("Connected\n");
+// tables are added and removed alone, modified by one request at a time and read concurrently;
+// execute locks as its prepared request, prepare only reads schema
+static enum storage_lock request_lock(const Request * request, struct statements * statements) {
+    if (request->action_case == REQUEST__ACTION_EXECUTE) {
+        const struct statement * const statement = find_statement(statements, request->execute->statement);
 
-    while (!closing) {
-        uint32_t request_size;
+        return statement ? request_lock(statement->request, statements) : STORAGE_LOCK_READ;
+    }
 
-        if (!read_full(socket, &request_size, sizeof(request_size))) {
-            if (errno == EPIPE || errno == ECONNRESET) {
-                errno = 0;
-            }
+    switch (request->action_case) {
+        case REQUEST__ACTION_CREATE_TABLE:
+        case REQUEST__ACTION_DROP_TABLE:
+        case REQUEST__ACTION_VACUUM:
+            return STORAGE_LOCK_SCHEMA;
 
-            break;
-        }
+        case REQUEST__ACTION_INSERT:
+        case REQUEST__ACTION_DELETE:
+        case REQUEST__ACTION_UPDATE:
+        case REQUEST__ACTION_CREATE_INDEX:
+            return STORAGE_LOCK_WRITE;
 
-        request_size = ntohl(request_size);
-        if (request_size == 0) {
-            continue;
-        }
+        default:
+            return STORAGE_LOCK_READ;
+    }
+}
 
-        uint8_t * const request_buffer = malloc(request_size);
-        if (!request_buffer) {
-            break;
-        }
+// handles request frame of client, response is sent back in frame of the same format
+static bool handle_frame(const uint8_t * frame, uint32_t size, uint8_t ** output, size_t * output_size, void * context) {
+    struct storage * const storage = context;
+    struct statements * const statements = get_connection_statements();
 
-        if (!read_full(socket, request_buffer, request_size)) {
-            break;
-        }
+    *output = NULL;
+    *output_size = 0;
 
-        Request * const request = request__unpack(NULL, request_size, request_buffer);
-        if (!request) {
-            printf("An error occurred while request receiving.\n");
-            free(request_buffer);
-            continue;
-        }
+    Request * const request = request__unpack(NULL, size, frame);
+    if (!request) {
+        printf("An error occurred while request receiving.\n");
+        return true;
+    }
 
-        free(request_buffer);
-        printf("Received request of %"PRIu32" bytes.\n", request_size);
+    printf("Received request of %"PRIu32" bytes.\n", size);
 
-        Response response = RESPONSE__INIT;
-        handle_request(request, storage, &response);
-        if (response.payload_case == RESPONSE__PAYLOAD__NOT_SET) {
-            request__free_unpacked(request, NULL);
-            break;
-        }
+    Response response = RESPONSE__INIT;
+    const enum storage_lock lock = request_lock(request, statements);
+    storage_begin(storage, lock);
 
+    // cursors keep tables, which may be removed or vacuumed by the request,
+    // plans of prepared statements are resolved again
+    if (lock == STORAGE_LOCK_SCHEMA) {
+        cursors_clear(cursors);
+        atomic_fetch_add(&schema_generation, 1);
+    }
 
-        size_t response_size = response__get_packed_size(&response);
-        if ((int64_t) response_size > (int64_t) UINT32_MAX) {
-            printf("Response is too long: %zu bytes.\n", response_size);
+    handle_request(request, statements, storage, &response);
 
-            response_size = 0;
-        }
+    // rows read from damaged body are zeros, so result of the request is not sent
+    if (storage_read_failed()) {
+        make_error_response("data of table is damaged", &response);
+    }
 
-        uint8_t * const response_buffer = malloc(response_size);
-        if (!response_buffer && response_size > 0) {
-            request__free_unpacked(request, NULL);
-            break;
-        }
+    storage_sync(storage, storage_end(storage));
 
-        if (response_buffer) {
-            response_size = response__pack(&response, response_buffer);
-        }
+    request__free_unpacked(request, NULL);
+
+    if (response.payload_case == RESPONSE__PAYLOAD__NOT_SET) {
+        return false;
+    }
 
-        request__free_unpacked(request, NULL);
+    // TODO free response with table
+    *output = pack_response(&response, output_size);
+    return *output != NULL;
+}
 
-        const uint32_t response_size_n = htonl((uint32_t) response_size);
-        if (!write_full(socket, &response_size_n, sizeof(response_size_n))) {
-            free(response_buffer);
-            request__free_unpacked(request, NULL);
-            break;
-        }
+int main(int argc, char * argv[]) {
+    unsigned int storage_flags = STORAGE_FLAG_SYNC_BATCH;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long scan_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long budget = MEMORY_BUDGET;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:mp:s:t:")) != -1) {
+        switch (opt) {
+            case 'b':
+                budget = strtol(optarg, NULL, 10);
+
+                if (budget <= 0) {
+                    fprintf(stderr, "Bad memory budget: %s\n", optarg);
+                    return 1;
+                }
 
-        if (response_buffer) {
-            if (!write_full(socket, response_buffer, response_size)) {
-                free(response_buffer);
                 break;
-            }
 
-            printf("Sent response of %zu bytes.\n", response_size);
-            // TODO free response with table
-            free(response_buffer);
-        }
-    }
+            case 'm':
+                storage_flags |= STORAGE_FLAG_MMAP;
+                break;
 
-    if (errno) {
-        perror("Error while handling client");
-        errno = 0;
-    }
+            case 'p':
+                scan_threads = strtol(optarg, NULL, 10);
+
+                if (scan_threads <= 0) {
+                    fprintf(stderr, "Bad scan threads amount: %s\n", optarg);
+                    return 1;
+                }
 
-    close(socket);
-    printf("Disconnected\n");
+                break;
 
-}
+            case 's':
+                storage_flags &= ~(STORAGE_FLAG_SYNC_BATCH | STORAGE_FLAG_SYNC_COMMIT);
 
-int main(int argc, char * argv[]) {
-    if (argc < 2) {
+                if (strcmp(optarg, "batch") == 0) {
+                    storage_flags |= STORAGE_FLAG_SYNC_BATCH;
+                } else if (strcmp(optarg, "commit") == 0) {
+                    storage_flags |= STORAGE_FLAG_SYNC_COMMIT;
+                } else if (strcmp(optarg, "off") != 0) {
+                    fprintf(stderr, "Unknown sync mode: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            case 't':
+                threads = strtol(optarg, NULL, 10);
+
+                if (threads <= 0) {
+                    fprintf(stderr, "Bad threads amount: %s\n", optarg);
+                    return 1;
+                }
+
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-b memory budget MiB] [-m] [-p scan threads] [-s off|batch|commit] [-t threads] <storage file>\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
         return 0;
     }
 
-    int fd = open(argv[1], O_RDWR);
+    memory_budget = (size_t) budget * 1024 * 1024;
+
+    int fd = open(argv[optind], O_RDWR);
     struct storage * storage;
 
     if (fd < 0 && errno != ENOENT) {
@@ -1116,11 +2676,29 @@ int main(int argc, char * argv[]) {
         return errno;
     }
 
-    if (fd < 0 && errno == ENOENT) {
-        fd = open(argv[1], O_CREAT | O_RDWR, 0644);
-        storage = storage_init(fd);
+    // write-ahead log is kept next to storage file
+    char * const wal_path = malloc(strlen(argv[optind]) + sizeof(".wal"));
+    strcpy(wal_path, argv[optind]);
+    strcat(wal_path, ".wal");
+
+    const int wal_fd = open(wal_path, O_CREAT | O_RDWR, 0644);
+    free(wal_path);
+
+    if (wal_fd < 0) {
+        perror("Error while opening log file");
+        return errno;
+    }
+
+    if (fd < 0) {
+        fd = open(argv[optind], O_CREAT | O_RDWR, 0644);
+        storage = storage_init(fd, wal_fd, storage_flags);
     } else {
-        storage = storage_open(fd);
+        storage = storage_open(fd, wal_fd, storage_flags);
+    }
+
+    // scans of large tables are split between scan threads
+    if (storage) {
+        storage_set_scan_threads(storage, (unsigned int) scan_threads);
     }
 
     // create the server socket
@@ -1140,7 +2718,7 @@ int main(int argc, char * argv[]) {
     }
 
     // second argument is a backlog - how many connections can be waiting for this socket simultaneously
-    listen(server_socket, 1);
+    listen(server_socket, SOMAXCONN);
 
     {
         struct sigaction sa;
@@ -1153,18 +2731,19 @@ int main(int argc, char * argv[]) {
         sigaction(SIGTERM, &sa, NULL);
     }
 
-    while (!closing) {
-        int ret = accept(server_socket, NULL, NULL);
+    // cursors that are not fetched for the timeout are closed
+    cursors = cursors_new(CURSOR_TIMEOUT, destroy_select_cursor);
 
-        if (ret < 0) {
-            break;
-        }
+    // connections are served by event loop and requests are handled by executor threads
+    struct reactor * const reactor = reactor_new(server_socket, (unsigned int) threads, handle_frame, destroy_statements, storage);
 
-        handle_client(ret, storage);
-    }
+    while (!closing && reactor_poll(reactor));
 
+    reactor_delete(reactor);
     close(server_socket);
+    cursors_delete(cursors);
     storage_delete(storage);
+    close(wal_fd);
     close(fd);
 
     printf("Bye!\n");
@@ -0,0 +1,519 @@
+#include "sort.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+
+// the most runs merged at once, more of them are merged into one run before
+#define SORT_MERGE_WAYS (64)
+
+
+struct sort_row {
+    uint64_t sequence;
+    size_t memory;
+    struct storage_value * values[];
+};
+
+// source of merge: run file or sorted rows of memory, head is the least row of it not taken yet
+struct sort_source {
+    FILE * file;
+    struct sort_row ** rows;
+    size_t rows_amount;
+    size_t next_row;
+
+    struct sort_row * head;
+};
+
+// sources are kept in heap by their heads
+struct sort_merge {
+    size_t sources_amount;
+    struct sort_source * sources;
+    size_t heap_amount;
+    size_t * heap;
+};
+
+struct sort {
+    unsigned int columns_amount;
+    unsigned int keys_amount;
+    struct sort_key * keys;
+    size_t limit;
+    size_t memory_budget;
+    uint64_t sequence;
+
+    // rows of memory, they are kept in heap with the greatest row on top when there is limit
+    size_t memory;
+    size_t rows_amount;
+    size_t rows_capacity;
+    struct sort_row ** rows;
+
+    // sorted runs of spilled rows
+    size_t runs_amount;
+    FILE * runs[SORT_MERGE_WAYS];
+
+    bool merging;
+    struct sort_merge merge;
+    size_t taken;
+};
+
+
+static int sort_compare_values(const struct sort * sort, struct storage_value * const * a, uint64_t a_sequence,
+        struct storage_value * const * b, uint64_t b_sequence) {
+    for (unsigned int i = 0; i < sort->keys_amount; ++i) {
+        const struct storage_value * const a_value = a[sort->keys[i].column];
+        const struct storage_value * const b_value = b[sort->keys[i].column];
+
+        int result;
+        if (!a_value || !b_value) {
+            result = (a_value != NULL) - (b_value != NULL);
+        } else {
+            result = storage_value_compare(a_value, b_value);
+        }
+
+        if (result != 0) {
+            return sort->keys[i].descending ? -result : result;
+        }
+    }
+
+    return a_sequence < b_sequence ? -1 : a_sequence > b_sequence;
+}
+
+static int sort_compare_rows(const struct sort * sort, const struct sort_row * a, const struct sort_row * b) {
+    return sort_compare_values(sort, a->values, a->sequence, b->values, b->sequence);
+}
+
+static void sort_delete_row(const struct sort * sort, struct sort_row * row) {
+    for (unsigned int i = 0; i < sort->columns_amount; ++i) {
+        storage_value_delete(row->values[i]);
+    }
+
+    free(row);
+}
+
+static struct sort_row * sort_copy_row(struct sort * sort, struct storage_value * const * values) {
+    struct sort_row * const row = malloc(sizeof(struct sort_row) + sizeof(struct storage_value *) * sort->columns_amount);
+    row->sequence = sort->sequence;
+    row->memory = sizeof(struct sort_row) + sizeof(struct storage_value *) * sort->columns_amount;
+
+    for (unsigned int i = 0; i < sort->columns_amount; ++i) {
+        if (!values[i]) {
+            row->values[i] = NULL;
+            continue;
+        }
+
+        row->values[i] = malloc(sizeof(struct storage_value));
+        *row->values[i] = *values[i];
+        row->values[i]->view = false;
+        row->memory += sizeof(struct storage_value);
+
+        if (values[i]->type == STORAGE_COLUMN_TYPE_STR) {
+            row->values[i]->value.str = strdup(values[i]->value.str);
+            row->memory += strlen(values[i]->value.str) + 1;
+        }
+    }
+
+    return row;
+}
+
+// heap of rows has the greatest row on top
+static void sort_sift_up(const struct sort * sort, struct sort_row ** rows, size_t index) {
+    while (index > 0) {
+        const size_t parent = (index - 1) / 2;
+
+        if (sort_compare_rows(sort, rows[parent], rows[index]) >= 0) {
+            break;
+        }
+
+        struct sort_row * const row = rows[parent];
+        rows[parent] = rows[index];
+        rows[index] = row;
+        index = parent;
+    }
+}
+
+static void sort_sift_down(const struct sort * sort, struct sort_row ** rows, size_t amount, size_t index) {
+    while (index * 2 + 1 < amount) {
+        size_t child = index * 2 + 1;
+
+        if (child + 1 < amount && sort_compare_rows(sort, rows[child + 1], rows[child]) > 0) {
+            ++child;
+        }
+
+        if (sort_compare_rows(sort, rows[index], rows[child]) >= 0) {
+            break;
+        }
+
+        struct sort_row * const row = rows[child];
+        rows[child] = rows[index];
+        rows[index] = row;
+        index = child;
+    }
+}
+
+// sorts rows by heap sort, heap of limited sort stays heap while it is built
+static void sort_rows(const struct sort * sort, struct sort_row ** rows, size_t amount) {
+    for (size_t i = amount / 2; i > 0; --i) {
+        sort_sift_down(sort, rows, amount, i - 1);
+    }
+
+    for (size_t i = amount; i > 1; --i) {
+        struct sort_row * const row = rows[0];
+        rows[0] = rows[i - 1];
+        rows[i - 1] = row;
+
+        sort_sift_down(sort, rows, i - 1, 0);
+    }
+}
+
+static void sort_write_value(FILE * file, const struct storage_value * value) {
+    const uint8_t tag = value ? (uint8_t) (value->type + 1) : 0;
+    fwrite(&tag, sizeof(tag), 1, file);
+
+    if (!value) {
+        return;
+    }
+
+    if (value->type != STORAGE_COLUMN_TYPE_STR) {
+        fwrite(&value->value, sizeof(value->value.uint), 1, file);
+        return;
+    }
+
+    const uint32_t length = (uint32_t) strlen(value->value.str);
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(value->value.str, 1, length, file);
+}
+
+// reads value written by sort_write_value, returns false at the end of file
+static bool sort_read_value(FILE * file, struct storage_value ** value) {
+    uint8_t tag;
+    if (fread(&tag, sizeof(tag), 1, file) != 1) {
+        return false;
+    }
+
+    *value = NULL;
+    if (tag == 0) {
+        return true;
+    }
+
+    struct storage_value * const result = malloc(sizeof(*result));
+    result->type = (enum storage_column_type) (tag - 1);
+    result->view = false;
+
+    if (result->type != STORAGE_COLUMN_TYPE_STR) {
+        if (fread(&result->value, sizeof(result->value.uint), 1, file) != 1) {
+            free(result);
+            return false;
+        }
+
+        *value = result;
+        return true;
+    }
+
+    uint32_t length;
+    if (fread(&length, sizeof(length), 1, file) != 1) {
+        free(result);
+        return false;
+    }
+
+    result->value.str = malloc(length + 1);
+    if (fread(result->value.str, 1, length, file) != length) {
+        storage_value_delete(result);
+        return false;
+    }
+
+    result->value.str[length] = '\0';
+    *value = result;
+    return true;
+}
+
+static void sort_write_row(const struct sort * sort, FILE * file, const struct sort_row * row) {
+    fwrite(&row->sequence, sizeof(row->sequence), 1, file);
+
+    for (unsigned int i = 0; i < sort->columns_amount; ++i) {
+        sort_write_value(file, row->values[i]);
+    }
+}
+
+// reads row written by sort_write_row, returns NULL at the end of file
+static struct sort_row * sort_read_row(const struct sort * sort, FILE * file) {
+    struct sort_row * const row = malloc(sizeof(struct sort_row) + sizeof(struct storage_value *) * sort->columns_amount);
+    row->memory = 0;
+
+    if (fread(&row->sequence, sizeof(row->sequence), 1, file) != 1) {
+        free(row);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < sort->columns_amount; ++i) {
+        if (!sort_read_value(file, &row->values[i])) {
+            for (unsigned int j = 0; j < i; ++j) {
+                storage_value_delete(row->values[j]);
+            }
+
+            free(row);
+            return NULL;
+        }
+    }
+
+    return row;
+}
+
+static struct sort_row * sort_source_read(const struct sort * sort, struct sort_source * source) {
+    if (source->file) {
+        return sort_read_row(sort, source->file);
+    }
+
+    return source->next_row < source->rows_amount ? source->rows[source->next_row++] : NULL;
+}
+
+// heap of sources has source with the least head on top
+static void sort_merge_sift_down(const struct sort * sort, struct sort_merge * merge, size_t index) {
+    while (index * 2 + 1 < merge->heap_amount) {
+        size_t child = index * 2 + 1;
+
+        if (child + 1 < merge->heap_amount && sort_compare_rows(sort,
+                merge->sources[merge->heap[child + 1]].head, merge->sources[merge->heap[child]].head) < 0) {
+            ++child;
+        }
+
+        if (sort_compare_rows(sort, merge->sources[merge->heap[index]].head, merge->sources[merge->heap[child]].head) <= 0) {
+            break;
+        }
+
+        const size_t source = merge->heap[child];
+        merge->heap[child] = merge->heap[index];
+        merge->heap[index] = source;
+        index = child;
+    }
+}
+
+// merges runs files and sorted rows of memory (if there are any), files are closed by merge
+static void sort_merge_init(const struct sort * sort, struct sort_merge * merge, FILE * const * files, size_t files_amount,
+        struct sort_row ** rows, size_t rows_amount) {
+    merge->sources_amount = files_amount + (rows ? 1 : 0);
+    merge->sources = malloc(sizeof(struct sort_source) * (merge->sources_amount + 1));
+    merge->heap = malloc(sizeof(size_t) * (merge->sources_amount + 1));
+    merge->heap_amount = 0;
+
+    for (size_t i = 0; i < merge->sources_amount; ++i) {
+        struct sort_source * const source = &merge->sources[i];
+
+        source->file = i < files_amount ? files[i] : NULL;
+        source->rows = i < files_amount ? NULL : rows;
+        source->rows_amount = i < files_amount ? 0 : rows_amount;
+        source->next_row = 0;
+
+        if (source->file) {
+            rewind(source->file);
+        }
+
+        source->head = sort_source_read(sort, source);
+
+        if (source->head) {
+            merge->heap[merge->heap_amount++] = i;
+        }
+    }
+
+    for (size_t i = merge->heap_amount / 2; i > 0; --i) {
+        sort_merge_sift_down(sort, merge, i - 1);
+    }
+}
+
+// takes the least row of sources, returns NULL when there are no rows any more
+static struct sort_row * sort_merge_next(const struct sort * sort, struct sort_merge * merge) {
+    if (merge->heap_amount == 0) {
+        return NULL;
+    }
+
+    struct sort_source * const source = &merge->sources[merge->heap[0]];
+    struct sort_row * const row = source->head;
+
+    source->head = sort_source_read(sort, source);
+
+    if (!source->head) {
+        merge->heap[0] = merge->heap[--merge->heap_amount];
+    }
+
+    sort_merge_sift_down(sort, merge, 0);
+    return row;
+}
+
+static void sort_merge_destroy(const struct sort * sort, struct sort_merge * merge) {
+    for (size_t i = 0; i < merge->sources_amount; ++i) {
+        struct sort_source * const source = &merge->sources[i];
+
+        if (source->head) {
+            sort_delete_row(sort, source->head);
+        }
+
+        if (source->file) {
+            fclose(source->file);
+            continue;
+        }
+
+        for (size_t j = source->next_row; j < source->rows_amount; ++j) {
+            sort_delete_row(sort, source->rows[j]);
+        }
+    }
+
+    free(merge->heap);
+    free(merge->sources);
+}
+
+// merges all runs into one run, only the first rows of limit are kept,
+// runs are kept as they are when temporary file can not be created
+static void sort_merge_runs(struct sort * sort) {
+    FILE * const file = tmpfile();
+
+    if (!file) {
+        return;
+    }
+
+    struct sort_merge merge;
+    sort_merge_init(sort, &merge, sort->runs, sort->runs_amount, NULL, 0);
+
+    struct sort_row * row;
+    for (size_t amount = 0; amount < sort->limit && (row = sort_merge_next(sort, &merge)); ++amount) {
+        sort_write_row(sort, file, row);
+        sort_delete_row(sort, row);
+    }
+
+    sort_merge_destroy(sort, &merge);
+
+    sort->runs[0] = file;
+    sort->runs_amount = 1;
+}
+
+// sorts rows of memory and spills them as a new run, rows are kept when temporary file can not be created
+static void sort_spill(struct sort * sort) {
+    if (sort->runs_amount == SORT_MERGE_WAYS) {
+        sort_merge_runs(sort);
+
+        if (sort->runs_amount == SORT_MERGE_WAYS) {
+            return;
+        }
+    }
+
+    FILE * const file = tmpfile();
+
+    if (!file) {
+        return;
+    }
+
+    sort_rows(sort, sort->rows, sort->rows_amount);
+
+    for (size_t i = 0; i < sort->rows_amount; ++i) {
+        sort_write_row(sort, file, sort->rows[i]);
+        sort_delete_row(sort, sort->rows[i]);
+    }
+
+    sort->runs[sort->runs_amount++] = file;
+    sort->rows_amount = 0;
+    sort->memory = 0;
+}
+
+struct sort * sort_new(unsigned int columns_amount, unsigned int keys_amount,
+        const struct sort_key * keys, size_t limit, size_t memory_budget) {
+    struct sort * const sort = malloc(sizeof(struct sort));
+
+    sort->columns_amount = columns_amount;
+    sort->keys_amount = keys_amount;
+    sort->keys = malloc(sizeof(struct sort_key) * (keys_amount + 1));
+    memcpy(sort->keys, keys, sizeof(struct sort_key) * keys_amount);
+    sort->limit = limit;
+    sort->memory_budget = memory_budget;
+    sort->sequence = 0;
+
+    sort->memory = 0;
+    sort->rows_amount = 0;
+    sort->rows_capacity = 16;
+    sort->rows = malloc(sizeof(struct sort_row *) * sort->rows_capacity);
+
+    sort->runs_amount = 0;
+    sort->merging = false;
+    sort->taken = 0;
+    return sort;
+}
+
+void sort_add(struct sort * sort, struct storage_value * const * row) {
+    const uint64_t sequence = sort->sequence++;
+
+    // row that is not less than the greatest of the first rows of limit is not taken
+    if (sort->limit == 0 || (sort->rows_amount == sort->limit
+            && sort_compare_values(sort, row, sequence, sort->rows[0]->values, sort->rows[0]->sequence) >= 0)) {
+        return;
+    }
+
+    struct sort_row * const copy = sort_copy_row(sort, row);
+    copy->sequence = sequence;
+
+    if (sort->rows_amount == sort->limit) {
+        sort->memory -= sort->rows[0]->memory;
+        sort_delete_row(sort, sort->rows[0]);
+
+        sort->rows[0] = copy;
+        sort_sift_down(sort, sort->rows, sort->rows_amount, 0);
+    } else {
+        if (sort->rows_amount == sort->rows_capacity) {
+            sort->rows_capacity *= 2;
+            sort->rows = realloc(sort->rows, sizeof(struct sort_row *) * sort->rows_capacity);
+        }
+
+        sort->rows[sort->rows_amount++] = copy;
+
+        if (sort->limit != SIZE_MAX) {
+            sort_sift_up(sort, sort->rows, sort->rows_amount - 1);
+        }
+    }
+
+    sort->memory += copy->memory + sizeof(struct sort_row *);
+
+    if (sort->memory > sort->memory_budget) {
+        sort_spill(sort);
+    }
+}
+
+bool sort_next(struct sort * sort, struct storage_value ** row) {
+    if (!sort->merging) {
+        sort_rows(sort, sort->rows, sort->rows_amount);
+        sort_merge_init(sort, &sort->merge, sort->runs, sort->runs_amount, sort->rows, sort->rows_amount);
+
+        sort->runs_amount = 0;
+        sort->merging = true;
+    }
+
+    if (sort->taken == sort->limit) {
+        return false;
+    }
+
+    struct sort_row * const next = sort_merge_next(sort, &sort->merge);
+
+    if (!next) {
+        return false;
+    }
+
+    memcpy(row, next->values, sizeof(struct storage_value *) * sort->columns_amount);
+    free(next);
+
+    ++sort->taken;
+    return true;
+}
+
+void sort_delete(struct sort * sort) {
+    if (sort->merging) {
+        sort_merge_destroy(sort, &sort->merge);
+    } else {
+        for (size_t i = 0; i < sort->rows_amount; ++i) {
+            sort_delete_row(sort, sort->rows[i]);
+        }
+
+        for (size_t i = 0; i < sort->runs_amount; ++i) {
+            fclose(sort->runs[i]);
+        }
+    }
+
+    free(sort->rows);
+    free(sort->keys);
+    free(sort);
+}